@@ -1,214 +1,246 @@
 
 #include "AStar.h"
 
-#include <algorithm>
 #include <cstdlib>
-#include <set>
 
-/* Build path from `start` to `end` */
+/* Build path from `start` to `end`, reporting to the stats and observer */
 Path AStar::build(const Point &start, const Point &end)
 {
-    /* Indices referring to the nodes in this->allNodes in the open or closed
-       sets */
-    std::set<int> openSet;
-    std::set<int> closedSet;
-
-    // Create initial node
-    Node initialNode = Node(start, start.getManhattanDistanceTo(end));
-        
-    // Create final node (with heuristic zero)
-    Node finalNode = Node(end, 0);
-        
-    // If initial or final nodes are full, return empty path
-    if (this->grid.getSquare(initialNode.getPosition()) == FULL ||
-        this->grid.getSquare(finalNode.getPosition()) == FULL)
-        {
-            return Path();
-        }
-        
-    // Add initial node to the vector of all nodes
-    allNodes.push_back(initialNode);
-
-    // And get its index in the nodes vector, adding it to the closed set
-    int initialIndex = allNodes.size() - 1;
-    closedSet.insert(initialIndex);
-        
-    // Add all empty neighbours of the start point to the open set
-    std::set<Point> neighbours = this->grid.getEmptyNeighbours(start);
-        
-    // If the start point is surrounded by obstacles, return empty path
-    if (neighbours.size() == 0) {
-        return Path();
-    }
-        
-    /* For each empty neighbour of the initial node, create the node and
-       construct an initial open set */
-    for (std::set<Point>::const_iterator it = neighbours.begin();
-	 it != neighbours.end(); ++it) {
-
-	// Create node with heuristic
-        Node node(*it, it->getManhattanDistanceTo(end));
-                
-        // Calculate gvalue, set parent index, and add to vector of all nodes
-        node.setgvalue(this->calculategvalue(initialNode, node));
-        node.setParentIndex(initialIndex);
-        allNodes.push_back(node);
-
-        // Add current index to open set
-        openSet.insert(allNodes.size() - 1);
-    }
+    int cost;
+    return this->build(start, end, cost);
+}
 
-    // Index of minimum fvalue node
-    int minimum = 0;
-
-    // While not next to final node, and open set isn't empty
-    while (!this->isNextTo(minimum, end) && openSet.size() != 0) {
-        // Get smallest Node
-        minimum = this->getSmallest(openSet);
-                
-        // Move from open set to closed set
-        openSet.erase(minimum);
-        closedSet.insert(minimum);
-                
-	// Iterate over each empty neighbour of the minimum f-value node
-        neighbours = this->grid.getEmptyNeighbours(allNodes.at(minimum).getPosition());
-        for (std::set<Point>::const_iterator it = neighbours.begin();
-	     it != neighbours.end(); ++it) {
-
-            // Add new node to the open set if not already in either closed or open set
-            if (getNodeByPoint(openSet, *it) == -1 &&
-		getNodeByPoint(closedSet, *it) == -1) {
-                                        
-                Node node(*it, it->getManhattanDistanceTo(end));
-                
-                // Calculate gvalue, set parent to minimum fvalue node, add node
-                // to vector of all nodes
-                node.setgvalue(this->calculategvalue(allNodes.at(minimum), node));
-                node.setParentIndex(minimum);
-                allNodes.push_back(node);
-
-                // Add new index to open set
-                openSet.insert(allNodes.size() - 1);
-            }
-                        
-            // Check whether the node is in the open set (and not the closed set)
-            int openNeighbour = getNodeByPoint(openSet, *it);
-                        
-            // If it is in the open set, do the g-value test
-            if (openNeighbour != -1) {
-                // Decide whether to set parent of the node to the minimum
-                // f-value node by calculating gvalue
-                                
-                // Calculate direct gvalue
-                int gvalueToTest = this->calculategvalue(allNodes.at(minimum),
-                                                         allNodes.at(openNeighbour));
-                                
-		// If the current gvalue is greater than the g-value would be
-		// with the minimum node, set the parent to the minimum node
-                if (allNodes.at(openNeighbour).getgvalue() > gvalueToTest) {
-                    allNodes.at(openNeighbour).setParentIndex(minimum);
-                }
-            }
-        }
-    }
-        
-    // We didn't find a path, so return an empty path
-    if (!this->isNextTo(closedSet, end)) {
-        return Path();
+Path AStar::build(const Point &requestedStart, const Point &requestedEnd, int &cost)
+{
+    STATS_ADD(stats, searches, 1);
+
+    Point start = this->snap(requestedStart), end = this->snap(requestedEnd);
+
+    if (observer)
+        observer->searchStarted(start, end);
+
+    // Each movement rule gets a search specialised for it, another for
+    // landmarks if there are some to use, and another for bigger agents
+    bool alt = this->useLandmarks();
+    bool sized = this->isSized();
+
+    Path path;
+    switch (movement) {
+    case FOUR_CONNECTED:
+        path = sized ? this->run(fourConnectedSized, start, end, cost) :
+            alt ? this->run(fourConnectedALT, start, end, cost) :
+            this->run(fourConnected, start, end, cost);
+        break;
+    case EIGHT_CONNECTED:
+        path = sized ? this->run(eightConnectedSized, start, end, cost) :
+            alt ? this->run(eightConnectedALT, start, end, cost) :
+            this->run(eightConnected, start, end, cost);
+        break;
+    case NO_CORNER_CUTTING:
+        path = sized ? this->run(noCornerCuttingSized, start, end, cost) :
+            alt ? this->run(noCornerCuttingALT, start, end, cost) :
+            this->run(noCornerCutting, start, end, cost);
+        break;
+    case NO_SQUEEZING:
+        path = sized ? this->run(noSqueezingSized, start, end, cost) :
+            alt ? this->run(noSqueezingALT, start, end, cost) :
+            this->run(noSqueezing, start, end, cost);
+        break;
     }
-        
-    // Add final parent
-    finalNode.setParentIndex(minimum);
-        
-    // Reconstruct path backwards
-    Path reversed;
-    reversed.push_back(finalNode.getPosition());
-        
-    Node previous = allNodes.at(finalNode.getParentIndex());
-        
-    // Loop through the parent of each node in order, adding it to the path
-    while (previous != initialNode) {
-        reversed.push_back(previous.getPosition());
-                
-	// Get the parent of the current node
-        previous = allNodes.at(previous.getParentIndex());
+
+    if (observer)
+        observer->searchFinished(path);
+
+    return path;
+}
+
+/* Start a search to run a slice at a time, as build() would run it */
+SearchTask *AStar::startSearch(const Point &requestedStart, const Point &requestedEnd)
+{
+    Point start = this->snap(requestedStart), end = this->snap(requestedEnd);
+    bool alt = this->useLandmarks();
+    bool sized = this->isSized();
+
+    switch (movement) {
+    case FOUR_CONNECTED:
+        return sized ? this->startTask(fourConnectedSized, start, end) :
+            alt ? this->startTask(fourConnectedALT, start, end) :
+            this->startTask(fourConnected, start, end);
+    case EIGHT_CONNECTED:
+        return sized ? this->startTask(eightConnectedSized, start, end) :
+            alt ? this->startTask(eightConnectedALT, start, end) :
+            this->startTask(eightConnected, start, end);
+    case NO_CORNER_CUTTING:
+        return sized ? this->startTask(noCornerCuttingSized, start, end) :
+            alt ? this->startTask(noCornerCuttingALT, start, end) :
+            this->startTask(noCornerCutting, start, end);
+    case NO_SQUEEZING:
+        return sized ? this->startTask(noSqueezingSized, start, end) :
+            alt ? this->startTask(noSqueezingALT, start, end) :
+            this->startTask(noSqueezing, start, end);
     }
 
-    // Add the initial point
-    reversed.push_back(initialNode.getPosition());
-        
-    return reversed;
+    return 0;
 }
 
-/* Calculate g-value from `from` to `to` */
-int AStar::calculategvalue(const Node &from, const Node &to) const {
-    Point difference = from.getPosition() - to.getPosition();
-    int x = std::abs(difference.getx());
-    int y = std::abs(difference.gety());
-        
-    if (x == 1 && y == 1)
-        return from.getgvalue() + this->diagonalCost;
-    else
-        return from.getgvalue() + this->cardinalCost;
+/* Heuristic for the costs, never more than the cheapest terrain allows */
+template <class Heuristic>
+void AStar::makeHeuristic(Heuristic &heuristic) const
+{
+    int minCost = this->grid.getMinCost();
+    heuristic = Heuristic(minCost * cardinalCost, minCost * diagonalCost);
 }
 
-/* Get node from `set` at point `p` */
-int AStar::getNodeByPoint(const std::set<int> &set, const Point &p) const {
-    for (std::set<int>::iterator it = set.begin(); it != set.end(); ++it) {
-        if (allNodes.at(*it).getPosition() == p)
-            return *it;
-    }
-        
-    return -1;
+template <class Base>
+void AStar::makeHeuristic(LandmarkHeuristic<Base> &heuristic) const
+{
+    int minCost = this->grid.getMinCost();
+    heuristic = LandmarkHeuristic<Base>(Base(minCost * cardinalCost, minCost * diagonalCost),
+                                        landmarks);
+}
+
+/* Set up one of the specialised searches */
+template <class Search>
+void AStar::configure(Search &search) const
+{
+    typename Search::HeuristicType heuristic;
+    this->makeHeuristic(heuristic);
+
+    search.setCardinalCost(cardinalCost);
+    search.setDiagonalCost(diagonalCost);
+    search.setHeuristic(heuristic);
+    search.setStats(stats);
+    search.setObserver(observer);
+    search.setControl(control);
+}
+
+/* Set up and run one of the specialised searches */
+template <class Search>
+Path AStar::run(Search &search, const Point &start, const Point &end, int &cost)
+{
+    expansions = 0;
+    cost = -1;
+
+    // If they are in different regions, searching would flood the whole
+    // region of the start point for nothing
+    if (!this->getComponents().connected(start, end))
+        return Path();
+
+    this->configure(search);
+
+    Path path = search.search(start, end, cost);
+    expansions = search.getExpansions();
+
+    return path;
 }
 
-/* Return true if `p` neighbour of `p2` */
-bool AStar::isNextTo(const Point &p, const Point &p2) const {
-    std::set<Point> neighbours = this->grid.getNeighbours(p2);
+/* Task with its own search of the same type as `search` */
+template <class Search>
+SearchTask *AStar::startTask(const Search &search, const Point &start, const Point &end)
+{
+    BasicSearchTask<Search> *task = new BasicSearchTask<Search>(Search(search.getGrid()));
+    this->configure(task->getSearch());
 
-    /* return true if p is in the neighbours of p2 */
-    return neighbours.find(p) != neighbours.end();
+    // Left failed if the points aren't connected, as build() does
+    if (this->getComponents().connected(start, end))
+        task->begin(start, end);
+
+    return task;
 }
 
-/* Return true if Node at index `n` is neighbour of `p2` */
-bool AStar::isNextTo(int n, const Point &p2) const {
-    return this->isNextTo(this->allNodes.at(n).getPosition(), p2);
+/* Key paths cached for this pathfinder by its movement costs and agent size */
+std::vector<int> AStar::getCostParameters() const {
+    std::vector<int> costs;
+    costs.push_back(cardinalCost);
+    costs.push_back(diagonalCost);
+    costs.push_back(movement);
+    costs.push_back(agentSize);
+    costs.push_back(snapToEmpty);
+    return costs;
 }
 
-/* Return true if any of the Nodes indexed in `closedSet` are neighbour of `p2` */
-bool AStar::isNextTo(const std::set<int> &closedSet, const Point &p2) const {
-    std::set<Point> neighbours = this->grid.getNeighbours(p2);
-        
-    for (std::set<int>::iterator it = closedSet.begin(); it != closedSet.end(); ++it) {
-                
-        if (neighbours.find(allNodes.at(*it).getPosition()) != neighbours.end()) {
-            return true;
-        }
-    }
-        
-    return false;
+/* Whether the movement rule looks at the squares beside a diagonal */
+bool AStar::diagonalsNeedSides() const {
+    return movement == NO_CORNER_CUTTING || movement == NO_SQUEEZING;
 }
 
-/* Get the node from `openSet` with the smallest f-value */
-int AStar::getSmallest(const std::set<int> &openSet) const {
-    int minimum = *openSet.begin();
-    for (std::set<int>::const_iterator it = openSet.begin(); it != openSet.end(); ++it) {
-        if (allNodes.at(*it).getfvalue() < allNodes.at(minimum).getfvalue())
-            minimum = *it;
+/* Landmarks for this grid, or for another grid with the same squares */
+bool AStar::useLandmarks()
+{
+    if (!landmarks)
+        return false;
+
+    if (landmarks->matches(&this->grid, cardinalCost, diagonalCost, movement))
+        return true;
+
+    const Grid *other = landmarks->getGrid();
+    if (!landmarks->matches(other, cardinalCost, diagonalCost, movement))
+        return false;
+
+    // The grids are only compared again once either has changed
+    if (other != sharedGrid || other->getVersion() != sharedVersion ||
+        this->grid.getVersion() != ownVersion) {
+        sharedGrid = other;
+        sharedVersion = other->getVersion();
+        ownVersion = this->grid.getVersion();
+        sharedMatch = this->grid.sameSquares(*other);
     }
-        
-    return minimum;
+
+    return sharedMatch;
 }
 
-/* Define comparison operators for nodes to compare by their positions */
-bool Node::operator<(const Node &n2) const {
-    return this->p < n2.p;
+/* Nearest EMPTY square to a blocked point, if asked to snap */
+Point AStar::snap(const Point &p) const
+{
+    if (!snapToEmpty || this->isSized() || this->grid.getSquare(p) == EMPTY)
+        return p;
+
+    Point nearest = this->grid.getNearestEmpty(p);
+
+    // A grid with nothing EMPTY has nowhere to snap to, so fail as before
+    return nearest.getx() < 0 ? p : nearest;
 }
 
-bool Node::operator==(const Node &n2) const {
-    return this->p == n2.p;
+/* Search for agents of `size` where `clearance` says they fit */
+bool AStar::setAgentSize(int size, const Clearance *clearance)
+{
+    agentSize = 1;
+
+    if (size <= 1)
+        return true;
+
+    // Clearance of another grid would tell nothing about this one
+    if (!clearance || !clearance->matches(&this->grid) || clearance->getMaxClearance() < size)
+        return false;
+
+    agentSize = size;
+    sizedGrid = ClearanceGrid(&this->grid, clearance, size);
+    return true;
+}
+
+/* Add up the cost of each move along `path` */
+int AStar::pathCost(const Path &path) const {
+    int cost = 0;
+
+    for (std::size_t i = 1; i < path.size(); ++i) {
+        if (path[i] != path[i - 1])
+            cost += this->moveCost(path[i - 1], path[i]);
+    }
+
+    return cost;
 }
 
-bool Node::operator!=(const Node &n2) const {
-    return !(this->p == n2.p);
+/* Cost of a single move, weighted by the terrain on both ends */
+int AStar::moveCost(const Point &a, const Point &b) const {
+    Point difference = a - b;
+    int x = std::abs(difference.getx());
+    int y = std::abs(difference.gety());
+
+    int base = (x == 1 && y == 1) ? this->diagonalCost : this->cardinalCost;
+
+    // Bigger agents pay for the most expensive squares under them
+    if (this->isSized())
+        return base * (sizedGrid.getCost(a) + sizedGrid.getCost(b)) / 2;
+
+    return base * (this->grid.getCost(a) + this->grid.getCost(b)) / 2;
 }
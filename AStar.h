@@ -1,63 +1,59 @@
 #ifndef ASTAR_H_
 #define ASTAR_H_
 
+#include "BasicAStar.h"
+#include "Clearance.h"
+#include "Landmarks.h"
 #include "PathFinder.h"
 #include "Point.h"
-
-/**
- * Node class used in the A* pathfinding to represent a node on the grid
- */
-class Node {
- public:
- Node() : p(Point(0, 0)), heuristic(0), gvalue(0), parentIndex(-1) { }
- Node(Point pos, int heuristic) : p(pos), heuristic(heuristic),
-	gvalue(0), parentIndex(-1) { }
-
-    /* Position of the node on the grid */
-    Point getPosition() const { return p; }
-    void setPosition(const Point &p) { this->p = p; }
-
-    int getfvalue() const { return heuristic + gvalue; }
-
-    int getHeuristic() const { return heuristic; }
-    void setHeuristic(int heuristic) { this->heuristic = heuristic; }
-	
-    int getgvalue() const { return gvalue; }
-    void setgvalue(int gvalue) { this->gvalue = gvalue; }
-
-    int getParentIndex() const { return parentIndex; }
-    void setParentIndex(int parentIndex) { this->parentIndex = parentIndex; }
-
-    /* Comparison operators just compare the points of the nodes */
-    bool operator<(const Node &n2) const;
-    bool operator==(const Node &n2) const;
-    bool operator!=(const Node &n2) const;
-	
- private:
-    Point p;
-    int heuristic;
-    int gvalue;
-	
-    /**
-     * Index of the parent node of this node in this->allNodes, set equal to -1
-     * if not set to a node */
-    int parentIndex;
-};
+#include "SearchTask.h"
 
 /**
  * Class to find a path between a start and end point on a Grid using the 
  * A* pathfinding algortihm.
+ *
+ * The search itself is BasicAStar, instantiated with int costs for each
+ * movement rule, again with LandmarkHeuristic for use with Landmarks, and
+ * again on a ClearanceGrid for agents bigger than one square.
  */
 class AStar : public PathFinder {
  public:
 
- AStar(Grid grid) : PathFinder(grid), cardinalCost(10), diagonalCost(14) { }
+ AStar(Grid grid) : PathFinder(grid), cardinalCost(10), diagonalCost(14),
+	movement(EIGHT_CONNECTED), expansions(0), landmarks(0), sharedGrid(0), sharedVersion(0),
+	ownVersion(0), sharedMatch(false), snapToEmpty(false),
+	fourConnected(&this->grid), eightConnected(&this->grid), noCornerCutting(&this->grid), noSqueezing(&this->grid),
+	fourConnectedALT(&this->grid), eightConnectedALT(&this->grid),
+	noCornerCuttingALT(&this->grid), noSqueezingALT(&this->grid), agentSize(1),
+	sizedGrid(&this->grid, 0, 1), fourConnectedSized(&sizedGrid),
+	eightConnectedSized(&sizedGrid), noCornerCuttingSized(&sizedGrid),
+	noSqueezingSized(&sizedGrid) { }
     
     /**
      * Build and return a Path between the start and end points, returning
-     * an empty path on failure, or on success the path in reverse order
+     * an empty path on failure, or on success the path in reverse order.
+     *
+     * The path is one of the cheapest (see moveCost()), as the search
+     * only stops once `end` is taken from the open set.
      */
     Path build(const Point &start, const Point &end);
+
+    /**
+     * Same as above, also setting `cost` to the cost of the path, or to -1 if
+     * there is none
+     */
+    Path build(const Point &start, const Point &end, int &cost);
+
+    /**
+     * The cardinal and diagonal costs, the movement rule and the other
+     * settings below, which change the paths returned
+     */
+    std::vector<int> getCostParameters() const;
+
+    /**
+     * True under NO_CORNER_CUTTING and NO_SQUEEZING
+     */
+    bool diagonalsNeedSides() const;
 	
     /**
      * Get and set the cardinal and diagonal movement costs
@@ -67,55 +63,172 @@ class AStar : public PathFinder {
 	
     int getDiagonalCost() const { return diagonalCost; }
     void setDiagonalCost(int diagonalCost) { this->diagonalCost = diagonalCost; }
+
+    /**
+     * Get and set which moves are allowed, EIGHT_CONNECTED by default. Each
+     * rule has its own copy of the search, picked once per build()
+     */
+    Movement getMovement() const { return movement; }
+    void setMovement(Movement movement) { this->movement = movement; }
+
+    /**
+     * Use `landmarks` to guide searches, or stop with 0. They are only used
+     * while they are for this pathfinder's costs and movement rule (see
+     * Landmarks::matches()), and for its grid or another with the same
+     * squares, so pathfinders with copies of one grid can share them. The
+     * caller keeps ownership
+     */
+    void setLandmarks(const Landmarks *landmarks) {
+        this->landmarks = landmarks;
+        sharedGrid = 0;
+    }
+
+    /**
+     * Move a FULL or off the grid start or end point to the nearest EMPTY
+     * square (see Grid::getNearestEmpty()) rather than failing, so the path
+     * starts or ends there instead. Off by default, and only for one square
+     * agents, as the nearest EMPTY square may not fit a bigger one
+     */
+    bool getSnapToEmpty() const { return snapToEmpty; }
+    void setSnapToEmpty(bool snapToEmpty) { this->snapToEmpty = snapToEmpty; }
+
+    /**
+     * Plan for an agent `size` squares across, placed by its top-left
+     * corner, where `clearance` of this pathfinder's grid says it fits, or
+     * for one square again with a size of 1. Paths are of the top-left
+     * corner, and cost as the most expensive square under the agent at each
+     * end of a move. Landmarks are only used for one square. The caller keeps
+     * ownership of `clearance`. Return false, planning for one square, if
+     * `clearance` is for another grid or stops below `size`
+     */
+    bool setAgentSize(int size, const Clearance *clearance);
+    int getAgentSize() const { return agentSize; }
+
+    /**
+     * Start a search from `start` to `end` that runs a slice at a time,
+     * with the same settings as build() but its own copy of the search
+     * state, so that many can be in flight at once (see SearchScheduler).
+     * The caller owns the task, and this pathfinder's grid must not change
+     * until it finishes
+     */
+    SearchTask *startSearch(const Point &start, const Point &end);
+
+    /**
+     * Sum of the costs of the moves along `path` (see moveCost()), in
+     * either order. Repeated points (e.g. where waypoint legs join) cost nothing
+     */
+    int pathCost(const Path &path) const;
+
+    /**
+     * Number of nodes moved to the closed set by the last call to build()
+     */
+    int getExpansions() const { return expansions; }
 	
  private:
     int cardinalCost; /* Cost of moving north/south/east/west */
     int diagonalCost; /* Cost of moving north-east/north-west/south-east/south-west */
 
+    Movement movement;
+
+    int expansions;
+
+    const Landmarks *landmarks;
+
+    /* Grid of the landmarks if it isn't this->grid, its version and this
+       grid's when they were last compared, and whether they were the same */
+    const Grid *sharedGrid;
+    unsigned long sharedVersion;
+    unsigned long ownVersion;
+    bool sharedMatch;
+
+    bool snapToEmpty;
+
     /**
-     * Vector containing all of the nodes, which we reference by index
+     * The search compiled for each movement rule, without and with landmarks
      */
-    std::vector<Node> allNodes;
+    BasicAStar<Grid, ManhattanHeuristic<int>, int, MovePolicy<FOUR_CONNECTED> > fourConnected;
+    BasicAStar<Grid, OctileHeuristic<int>, int, MovePolicy<EIGHT_CONNECTED> > eightConnected;
+    BasicAStar<Grid, OctileHeuristic<int>, int, MovePolicy<NO_CORNER_CUTTING> > noCornerCutting;
+    BasicAStar<Grid, OctileHeuristic<int>, int, MovePolicy<NO_SQUEEZING> > noSqueezing;
+
+    BasicAStar<Grid, LandmarkHeuristic<ManhattanHeuristic<int> >, int,
+               MovePolicy<FOUR_CONNECTED> > fourConnectedALT;
+    BasicAStar<Grid, LandmarkHeuristic<OctileHeuristic<int> >, int,
+               MovePolicy<EIGHT_CONNECTED> > eightConnectedALT;
+    BasicAStar<Grid, LandmarkHeuristic<OctileHeuristic<int> >, int,
+               MovePolicy<NO_CORNER_CUTTING> > noCornerCuttingALT;
+    BasicAStar<Grid, LandmarkHeuristic<OctileHeuristic<int> >, int,
+               MovePolicy<NO_SQUEEZING> > noSqueezingALT;
+
+    int agentSize;
+
+    /* The grid as an agent of agentSize sees it, and its searches */
+    ClearanceGrid sizedGrid;
+
+    BasicAStar<ClearanceGrid, ManhattanHeuristic<int>, int,
+               MovePolicy<FOUR_CONNECTED> > fourConnectedSized;
+    BasicAStar<ClearanceGrid, OctileHeuristic<int>, int,
+               MovePolicy<EIGHT_CONNECTED> > eightConnectedSized;
+    BasicAStar<ClearanceGrid, OctileHeuristic<int>, int,
+               MovePolicy<NO_CORNER_CUTTING> > noCornerCuttingSized;
+    BasicAStar<ClearanceGrid, OctileHeuristic<int>, int,
+               MovePolicy<NO_SQUEEZING> > noSqueezingSized;
 
     /**
-     * Calculate g-value based on relative positions of to and from nodes.
-     *
-     * Uses diagonal cost if on a diagonal one square away from each other, else
-     * uses the cardinal cost.
+     * Return true if searches are for an agent bigger than one square
      */
-    int calculategvalue(const Node &from, const Node &to) const;
+    bool isSized() const { return agentSize > 1; }
 
     /**
-     * Given a `set` of integers corresponding to nodes indexed by
-     * this->allNodes, return the index of the node at the grid position `p` or
-     * -1 if there is no node in this->allNodes with position `p`
+     * Return true if there are landmarks and they fit this grid, costs and
+     * movement rule (see setLandmarks())
      */
-    int getNodeByPoint(const std::set<int> &set, const Point &p) const;
+    bool useLandmarks();
 
     /**
-     * Given a point `p` on the grid, return true if it is a neighbour of the
-     * the point `p2`
+     * `p`, or the nearest EMPTY square if snapping and it is FULL
      */
-    bool isNextTo(const Point &p, const Point &p2) const;
+    Point snap(const Point &p) const;
 
     /**
-     * Given an int `n` corresponding to the index of a node in this->allNodes,
-     * return true if it is a neighbour of the point `p2`
+     * Cost of moving between `a` and `b`, which are one square apart.
+     *
+     * Uses diagonal cost if on a diagonal one square away from each other, else
+     * uses the cardinal cost, times the average of the cost multipliers of the
+     * two squares (so moves cost the same both ways). For bigger agents those
+     * are the most expensive under the agent at each end.
      */
-    bool isNextTo(int n, const Point &p2) const;
+    int moveCost(const Point &a, const Point &b) const;
 
     /**
-     * Given a set, `closedSet`, of integers corresponding to nodes indexed by
-     * this->allNodes, return true if any of the nodes referred to by
-     * `closedSet` are neighbours of the point `p2`
+     * Set `heuristic` to one for this pathfinder's costs, scaled by the
+     * cheapest terrain on the grid, and for LandmarkHeuristic its landmarks
      */
-    bool isNextTo(const std::set<int> &closedSet, const Point &p2) const;
-    
+    template <class Heuristic>
+    void makeHeuristic(Heuristic &heuristic) const;
+
+    template <class Base>
+    void makeHeuristic(LandmarkHeuristic<Base> &heuristic) const;
+
+    /**
+     * Give `search` this pathfinder's costs and heuristic, and the stats,
+     * observer and control
+     */
+    template <class Search>
+    void configure(Search &search) const;
+
+    /**
+     * Configure and run `search`
+     */
+    template <class Search>
+    Path run(Search &search, const Point &start, const Point &end, int &cost);
+
     /**
-     * Given a set, `openSet`, of integers corresponding to nodes indexed by
-     * this->allNodes, return the index of the node with the smallest f-value
+     * Task for a new search of the same type as `search`, configured and
+     * begun from `start` to `end`
      */
-    int getSmallest(const std::set<int> &openSet) const;
+    template <class Search>
+    SearchTask *startTask(const Search &search, const Point &start, const Point &end);
 };
 
 #endif /* ASTAR_H_ */
@@ -0,0 +1,427 @@
+#ifndef BASIC_ASTAR_H_
+#define BASIC_ASTAR_H_
+
+#include <algorithm>
+#include <cstdlib>
+#include <set>
+#include <utility>
+#include <vector>
+
+#include "Movement.h"
+#include "NodeStore.h"
+#include "Point.h"
+#include "SearchControl.h"
+#include "SearchStats.h"
+#include "SearchTrace.h"
+#include "Square.h"
+
+typedef std::vector<Point> Path;
+
+/**
+ * Where a resumable search stands: still going, or finished with or
+ * without a path
+ */
+enum SearchStatus {
+    SEARCH_RUNNING,
+    SEARCH_FOUND,
+    SEARCH_FAILED
+};
+
+/**
+ * Movement rule `M` as a type, for BasicAStar's Policy parameter
+ */
+template <Movement M>
+struct MovePolicy {
+    static const Movement movement = M;
+
+    /**
+     * Mask of the moves from `p` on `grid` (see Movement.h)
+     */
+    template <class GridT>
+    static unsigned moves(const GridT &grid, const Point &p) {
+        return grid.template getMoves<M>(p);
+    }
+};
+
+/**
+ * Octile distance between two points, for moves in eight directions: the
+ * cardinal cost for each straight step and the diagonal cost for each
+ * diagonal one. The costs must already be scaled by the cheapest terrain
+ * multiplier, so that the estimate never exceeds the real cost
+ */
+template <class Cost>
+class OctileHeuristic {
+ public:
+    OctileHeuristic(Cost cardinal = 10, Cost diagonal = 14)
+        : cardinal(std::min(cardinal, diagonal)),
+          diagonal(std::min(diagonal, Cost(2 * std::min(cardinal, diagonal)))) { }
+
+    Cost operator()(const Point &p, const Point &end) const {
+        int x = std::abs(p.getx() - end.getx());
+        int y = std::abs(p.gety() - end.gety());
+
+        return Cost(cardinal * std::abs(x - y) + diagonal * std::min(x, y));
+    }
+
+ private:
+    /* A straight step never costs more than a diagonal one, as cheap
+       diagonals can zig-zag along a straight line */
+    Cost cardinal;
+
+    /* A diagonal never costs more than going round it */
+    Cost diagonal;
+};
+
+/**
+ * Manhattan distance times the cardinal cost, for four-connected moves
+ */
+template <class Cost>
+class ManhattanHeuristic {
+ public:
+    ManhattanHeuristic(Cost cardinal = 10, Cost diagonal = 14) : cardinal(cardinal) { }
+
+    Cost operator()(const Point &p, const Point &end) const {
+        return Cost(cardinal * (std::abs(p.getx() - end.getx()) +
+                                std::abs(p.gety() - end.gety())));
+    }
+
+ private:
+    Cost cardinal;
+};
+
+/**
+ * A* search compiled for one grid type, heuristic, cost type and movement
+ * policy, so that the heuristic, neighbour generation and cost arithmetic are
+ * all inlined into the search loop.
+ *
+ * GridT needs getSquare(Point), getCost(Point) and getMoves<M>(Point), as
+ * Grid has, and whatever its node store (see SearchStorage) needs: the
+ * default DenseNodeStore needs getWidth() and getHeight(). Heuristic is a function object giving a
+ * Cost estimate from a Point to the end that never overestimates. Cost can be
+ * any integer or floating point type big enough for the longest path; moves
+ * cost the cardinal or diagonal cost times the average terrain multiplier of
+ * their two squares, rounded down for integer types.
+ *
+ * A search can also be run a slice at a time: begin() it, then call step()
+ * until it stops returning SEARCH_RUNNING. Everything it needs is kept in
+ * the object between calls, and the grid must not change in the meantime.
+ *
+ * Header-only, as every instantiation is specialised at compile time. AStar
+ * wraps the int instantiations behind the PathFinder interface.
+ */
+template <class GridT, class Heuristic, class Cost, class Policy>
+class BasicAStar {
+ public:
+    typedef GridT GridType;
+    typedef Heuristic HeuristicType;
+    typedef Cost CostType;
+
+    BasicAStar(const GridT *grid, Cost cardinalCost = 10, Cost diagonalCost = 14)
+        : grid(grid), cardinalCost(cardinalCost), diagonalCost(diagonalCost),
+          heuristic(cardinalCost, diagonalCost), stats(0), observer(0), control(0),
+          expansions(0), status(SEARCH_FAILED), found(-1), closest(-1) { }
+
+    /**
+     * Search for a cheapest path from `start` to `end`, returning it in
+     * reverse order and setting `cost` to its cost, or returning an empty
+     * path and setting `cost` to -1 if there is none or the control cancelled
+     * the search
+     */
+    Path search(const Point &start, const Point &end, Cost &cost);
+
+    /**
+     * Start a search from `start` to `end`, forgetting any previous one,
+     * without expanding anything yet
+     */
+    void begin(const Point &start, const Point &end);
+
+    /**
+     * Expand up to `maxExpansions` more nodes of the search begun, or as
+     * many as it takes if negative, and return where it stands. A search
+     * the control cancels fails
+     */
+    SearchStatus step(long maxExpansions);
+
+    SearchStatus getStatus() const { return status; }
+
+    /**
+     * The path found, in reverse order, and its cost, or an empty path and
+     * -1 until the search finds one
+     */
+    Path getPath() const { return status == SEARCH_FOUND ? pathTo(found) : Path(); }
+    Cost getCost() const { return status == SEARCH_FOUND ? store.gvalue(found) : Cost(-1); }
+
+    /**
+     * The best path so far, in reverse order: the one found, or else the one
+     * to the expanded square the heuristic puts nearest the end. Empty if
+     * nothing has been expanded
+     */
+    Path getBestPath() const {
+        return pathTo(status == SEARCH_FOUND ? found : closest);
+    }
+
+    /**
+     * The grid searched
+     */
+    const GridT *getGrid() const { return grid; }
+
+    /**
+     * Cost of moving between `a` and `b`, which are one square apart
+     */
+    Cost moveCost(const Point &a, const Point &b) const {
+        return moveCost(a.getx() != b.getx() && a.gety() != b.gety(),
+                        grid->getCost(a), grid->getCost(b));
+    }
+
+    /**
+     * Get and set the cardinal and diagonal movement costs, and the
+     * heuristic, which setHeuristic() must be called again for if they change
+     */
+    Cost getCardinalCost() const { return cardinalCost; }
+    void setCardinalCost(Cost cardinalCost) { this->cardinalCost = cardinalCost; }
+
+    Cost getDiagonalCost() const { return diagonalCost; }
+    void setDiagonalCost(Cost diagonalCost) { this->diagonalCost = diagonalCost; }
+
+    void setHeuristic(const Heuristic &heuristic) { this->heuristic = heuristic; }
+
+    /**
+     * Attach statistics, an observer or a control as for PathFinder, or 0
+     */
+    void setStats(SearchStats *stats) { this->stats = stats; }
+    void setObserver(SearchObserver *observer) { this->observer = observer; }
+    void setControl(SearchControl *control) { this->control = control; }
+
+    /**
+     * Number of nodes moved to the closed set by the last search(), or since
+     * the last begin()
+     */
+    int getExpansions() const { return expansions; }
+
+ private:
+    /**
+     * Entry of the open set: the f-value and heuristic of a square, so that
+     * ties on f go to the square nearest the end, then the square's index
+     */
+    typedef std::pair<std::pair<Cost, Cost>, int> OpenEntry;
+
+    /**
+     * Number of expansions between polls of this->control
+     */
+    static const int controlInterval = 256;
+
+    const GridT *grid;
+
+    Cost cardinalCost;
+    Cost diagonalCost;
+    Heuristic heuristic;
+
+    SearchStats *stats;
+    SearchObserver *observer;
+    SearchControl *control;
+
+    int expansions;
+
+    /**
+     * Cost of a diagonal or cardinal move between squares with cost
+     * multipliers `a` and `b`
+     */
+    Cost moveCost(bool diagonal, int a, int b) const {
+        return Cost((diagonal ? diagonalCost : cardinalCost) * (a + b)) / Cost(2);
+    }
+
+    /* Search state of every square reached */
+    typename SearchStorage<GridT, Cost>::Type store;
+
+    /* Open set ordered by f-value, where improving a square's g-value is
+       erasing its entry and inserting it again */
+    std::set<OpenEntry> openSet;
+
+    Point goal;
+    SearchStatus status;
+
+    /* Index of the end once found, and of the expanded square with the
+       smallest heuristic, or -1 */
+    int found;
+    int closest;
+    Cost closestHeuristic;
+
+    /**
+     * Path from the start to square `index` in reverse order, or an empty
+     * path for -1
+     */
+    Path pathTo(int index) const {
+        Path reversed;
+        for (int i = index; i != -1; i = store.parent(i))
+            reversed.push_back(store.point(i));
+
+        return reversed;
+    }
+};
+
+template <class GridT, class Heuristic, class Cost, class Policy>
+Path BasicAStar<GridT, Heuristic, Cost, Policy>::search(const Point &start, const Point &end,
+                                                        Cost &cost)
+{
+    begin(start, end);
+    step(-1);
+
+    cost = getCost();
+    return getPath();
+}
+
+template <class GridT, class Heuristic, class Cost, class Policy>
+void BasicAStar<GridT, Heuristic, Cost, Policy>::begin(const Point &start, const Point &end)
+{
+    // Forget any previous search
+    store.reset(*grid);
+    openSet.clear();
+    expansions = 0;
+    goal = end;
+    found = -1;
+    closest = -1;
+
+    // If start or end are full, there is no path
+    status = SEARCH_FAILED;
+    if (grid->getSquare(start) == FULL || grid->getSquare(end) == FULL)
+        return;
+
+    int first = store.index(start);
+    Cost firstHeuristic = heuristic(start, end);
+    STATS_ADD(stats, heuristicEvaluations, 1);
+
+    store.gvalue(first) = Cost(0);
+    store.parent(first) = -1;
+    store.state(first) = OPEN;
+    openSet.insert(OpenEntry(std::make_pair(firstHeuristic, firstHeuristic), first));
+    STATS_ADD(stats, generated, 1);
+    STATS_MAX(stats, openPeak, openSet.size());
+
+    if (observer)
+        observer->nodeGenerated(start, 0);
+
+    status = SEARCH_RUNNING;
+}
+
+template <class GridT, class Heuristic, class Cost, class Policy>
+SearchStatus BasicAStar<GridT, Heuristic, Cost, Policy>::step(long maxExpansions)
+{
+    long stepped = 0;
+    while (status == SEARCH_RUNNING && (maxExpansions < 0 || stepped++ < maxExpansions)) {
+        if (openSet.empty()) {
+            status = SEARCH_FAILED;
+            break;
+        }
+
+        // Move the smallest f-value square from the open set to the closed set
+        STATS_TIMER_START(popTimer);
+        int minimum = openSet.begin()->second;
+        Cost minimumHeuristic = openSet.begin()->first.second;
+        openSet.erase(openSet.begin());
+        store.state(minimum) = CLOSED;
+        STATS_TIMER_ADD(stats, openListTime, popTimer);
+
+        Point position = store.point(minimum);
+        Cost g = store.gvalue(minimum);
+
+        ++expansions;
+        STATS_ADD(stats, expanded, 1);
+
+        if (closest == -1 || minimumHeuristic < closestHeuristic) {
+            closest = minimum;
+            closestHeuristic = minimumHeuristic;
+        }
+
+        // Let the control stop us, and tell it how far we have got
+        if (control != 0 && expansions % controlInterval == 0) {
+            if (control->cancelled()) {
+                status = SEARCH_FAILED;
+                break;
+            }
+
+            control->progress(expansions);
+        }
+
+        if (observer)
+            observer->nodeExpanded(position, (int)g);
+
+        // Nothing left in the open set can make the path to the end cheaper
+        if (position == goal) {
+            found = minimum;
+            status = SEARCH_FOUND;
+            break;
+        }
+
+        // Relax each neighbour of the minimum f-value square the policy allows,
+        // reading cost multipliers through the node store, which may know
+        // where they are without asking the grid
+        STATS_TIMER_START(neighbourTimer);
+        unsigned moves = Policy::moves(*grid, position);
+        int positionCost = store.cost(*grid, minimum, position);
+        STATS_TIMER_ADD(stats, neighbourTime, neighbourTimer);
+
+        for (int i = 0; i < 8; ++i) {
+            if ((moves & (1u << i)) == 0)
+                continue;
+
+            Point next(position.getx() + moveDx[i], position.gety() + moveDy[i]);
+            int index = store.neighbour(minimum, position, i);
+
+            STATS_TIMER_START(openTimer);
+
+            Cost gvalueToTest = g + moveCost(moveDx[i] != 0 && moveDy[i] != 0, positionCost,
+                                             store.cost(*grid, index, next));
+
+            unsigned char &state = store.state(index);
+
+            if (state == UNSEEN) {
+                // First time reached
+                Cost h = heuristic(next, goal);
+                STATS_ADD(stats, heuristicEvaluations, 1);
+
+                store.gvalue(index) = gvalueToTest;
+                store.parent(index) = minimum;
+                state = OPEN;
+
+                openSet.insert(OpenEntry(std::make_pair(gvalueToTest + h, h), index));
+                STATS_ADD(stats, generated, 1);
+                STATS_MAX(stats, openPeak, openSet.size());
+
+                if (observer)
+                    observer->nodeGenerated(next, (int)gvalueToTest);
+            } else if (gvalueToTest < store.gvalue(index)) {
+                // Cheaper route to a square already reached, so update its
+                // g-value and parent and move it up the open set, or back
+                // into it if closed. Consistent heuristics never find a
+                // cheaper route to a closed square, but ones that are only
+                // admissible, like LandmarkHeuristic, can. The heuristic
+                // isn't stored, so it is worked out again to find the old
+                // entry
+                Cost h = heuristic(next, goal);
+                if (state == OPEN)
+                    openSet.erase(OpenEntry(std::make_pair(store.gvalue(index) + h, h), index));
+                else
+                    STATS_ADD(stats, reopened, 1);
+
+                store.gvalue(index) = gvalueToTest;
+                store.parent(index) = minimum;
+                state = OPEN;
+
+                openSet.insert(OpenEntry(std::make_pair(gvalueToTest + h, h), index));
+
+                if (observer)
+                    observer->nodeGenerated(next, (int)gvalueToTest);
+            }
+
+            STATS_TIMER_ADD(stats, openListTime, openTimer);
+        }
+    }
+
+    // The open set isn't needed once finished
+    if (status != SEARCH_RUNNING)
+        openSet.clear();
+
+    return status;
+}
+
+#endif /* BASIC_ASTAR_H_ */
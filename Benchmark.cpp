@@ -0,0 +1,3622 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <sstream>
+#include <set>
+#include <string>
+#include <vector>
+
+#if __cplusplus >= 201103L
+#include <atomic>
+#include <thread>
+#endif
+
+#include <sys/resource.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "AStar.h"
+#include "BasicAStar.h"
+#include "ChunkedGrid.h"
+#include "Clearance.h"
+#include "CommandLine.h"
+#include "Components.h"
+#include "Dijkstra.h"
+#include "Grid.h"
+#include "GridKernels.h"
+#include "Landmarks.h"
+#include "MapFile.h"
+#include "MapGenerator.h"
+#include "MultiAgentPlanner.h"
+#include "PathDatabase.h"
+#include "QueryAnswerer.h"
+#include "Random.h"
+#include "SearchScheduler.h"
+#include "SearchStats.h"
+#include "SearchTrace.h"
+#include "SharedGrid.h"
+
+/**
+ * Benchmark suite in the style of Google Benchmark: every registered benchmark
+ * is run with a growing number of iterations until it has taken at least the
+ * minimum time, and the result is reported per iteration as JSON.
+ *
+ * Before timing anything, AStar is checked against the Dijkstra oracle on
+ * random grids, as timings of a search that returns wrong paths are useless.
+ *
+ * On Linux, hardware counters (instructions, cache misses and L1 data cache
+ * read misses) are read with perf_event_open and reported per iteration too,
+ * where the kernel allows it (see /proc/sys/kernel/perf_event_paranoid).
+ *
+ * Usage: benchmark [--filter substring] [--min-time seconds] [--out file]
+ *        benchmark --check
+ */
+
+/* Seed for every map and query, so runs are comparable */
+static const uint64_t seed = 12345;
+
+/**
+ * Map families the pathfinding benchmarks run on
+ */
+enum Family {
+    EMPTY_MAP, RANDOM_MAP, MAZE_MAP, ROOMS_MAP, CAVES_MAP
+};
+
+static const char *familyNames[] = { "empty", "random", "maze", "rooms", "caves" };
+
+/**
+ * Monotonic time in nanoseconds
+ */
+static double now()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/**
+ * Peak resident memory in kB. On Linux this is VmHWM, which resetPeakMemory()
+ * can reset between benchmarks; elsewhere it is the peak of the whole process
+ */
+static long peakMemory()
+{
+    std::ifstream status("/proc/self/status");
+    std::string line;
+
+    while (std::getline(status, line))
+        if (line.compare(0, 6, "VmHWM:") == 0)
+            return std::atol(line.c_str() + 6);
+
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+static void resetPeakMemory()
+{
+    // Writing 5 to clear_refs resets VmHWM to the current RSS
+    std::ofstream clearRefs("/proc/self/clear_refs");
+    clearRefs << "5";
+}
+
+/**
+ * Hardware counters for this process, counting only while started. Counters
+ * the kernel or CPU don't support read as -1
+ */
+class PerfCounters {
+ public:
+    enum Counter {
+        INSTRUCTIONS, CACHE_MISSES, L1D_MISSES, COUNTERS
+    };
+
+    PerfCounters() {
+        for (int i = 0; i < COUNTERS; ++i)
+            fds[i] = -1;
+
+#ifdef __linux__
+        fds[INSTRUCTIONS] = open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+        fds[CACHE_MISSES] = open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+        fds[L1D_MISSES] = open(PERF_TYPE_HW_CACHE,
+                               PERF_COUNT_HW_CACHE_L1D |
+                               (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                               (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+#endif
+    }
+
+    ~PerfCounters() {
+#ifdef __linux__
+        for (int i = 0; i < COUNTERS; ++i)
+            if (fds[i] != -1)
+                close(fds[i]);
+#endif
+    }
+
+    /**
+     * Zero the counters and start counting
+     */
+    void start() {
+#ifdef __linux__
+        for (int i = 0; i < COUNTERS; ++i)
+            if (fds[i] != -1) {
+                ioctl(fds[i], PERF_EVENT_IOC_RESET, 0);
+                ioctl(fds[i], PERF_EVENT_IOC_ENABLE, 0);
+            }
+#endif
+    }
+
+    void stop() {
+#ifdef __linux__
+        for (int i = 0; i < COUNTERS; ++i)
+            if (fds[i] != -1)
+                ioctl(fds[i], PERF_EVENT_IOC_DISABLE, 0);
+#endif
+    }
+
+    /**
+     * Count since the last start(), or -1 if `counter` isn't available
+     */
+    double read(Counter counter) const {
+#ifdef __linux__
+        uint64_t value;
+        if (fds[counter] != -1 && ::read(fds[counter], &value, sizeof(value)) == sizeof(value))
+            return (double)value;
+#endif
+        return -1;
+    }
+
+ private:
+    int fds[COUNTERS];
+
+#ifdef __linux__
+    static int open(uint32_t type, uint64_t config) {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+
+        return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+#endif
+
+    // Not copyable, as it owns the file descriptors
+    PerfCounters(const PerfCounters &);
+    PerfCounters &operator=(const PerfCounters &);
+};
+
+/**
+ * State passed to a benchmark, which does its setup and then loops on
+ * keepRunning(), adding to `expansions` if it runs searches
+ */
+class BenchState {
+ public:
+    BenchState(int iterations, Family family, int size, PerfCounters *counters = 0)
+        : family(family), size(size), expansions(0), iterations(iterations),
+          remaining(iterations), start(0), elapsed(0), counters(counters) { }
+
+    bool keepRunning() {
+        if (remaining == iterations) {
+            if (counters)
+                counters->start();
+            start = now();
+        }
+
+        if (remaining-- > 0)
+            return true;
+
+        elapsed = now() - start;
+        if (counters)
+            counters->stop();
+        return false;
+    }
+
+    int getIterations() const { return iterations; }
+    double getElapsed() const { return elapsed; }
+
+    Family family;
+    int size;
+    double expansions;
+
+ private:
+    int iterations;
+    int remaining;
+    double start;
+    double elapsed;
+    PerfCounters *counters;
+};
+
+typedef void (*BenchFunction)(BenchState &state);
+
+struct Benchmark {
+    std::string name;
+    BenchFunction run;
+    Family family;
+    int size;
+};
+
+/**
+ * Build a `size` by `size` map of the given family
+ */
+static Grid makeMap(Family family, int size)
+{
+    Random random(seed);
+    Grid grid(size, size);
+
+    switch (family) {
+    case EMPTY_MAP:
+        break;
+    case RANDOM_MAP:
+        generateRandomFill(grid, 0.25, random);
+        break;
+    case MAZE_MAP:
+        generateDivisionMaze(grid, random);
+        break;
+    case ROOMS_MAP:
+        generateRooms(grid, size / 4, 3, size / 4 + 3, random);
+        break;
+    case CAVES_MAP:
+        generateCaves(grid, 0.4, size / 8.0, random);
+        break;
+    }
+
+    return grid;
+}
+
+/**
+ * Return a random EMPTY point from `random`, or (0, 0) if there are none
+ */
+static Point randomEmptyPoint(const Grid &grid, Random &random)
+{
+    Point p = grid.getEmptyPoint(random);
+    return p.getx() < 0 ? Point(0, 0) : p;
+}
+
+/**
+ * Random solvable queries of `n` points each on `grid`, all in the largest
+ * component so that they measure searches rather than rejections
+ */
+static std::vector<std::vector<Point> > makeQueries(Grid &grid, int count, int n)
+{
+    Random random(seed + 1);
+    Components components(&grid);
+
+    int largest = -1;
+    for (int tries = 0; tries < 64; ++tries) {
+        int label = components.getLabel(randomEmptyPoint(grid, random));
+        if (largest == -1 || components.getSize(label) > components.getSize(largest))
+            largest = label;
+    }
+
+    std::vector<std::vector<Point> > queries(count);
+    for (int i = 0; i < count; ++i)
+        while ((int)queries[i].size() < n) {
+            Point p = randomEmptyPoint(grid, random);
+            if (components.getLabel(p) == largest)
+                queries[i].push_back(p);
+        }
+
+    return queries;
+}
+
+static void benchGetSquare(BenchState &state)
+{
+    Grid grid = makeMap(RANDOM_MAP, state.size);
+    int n = state.size * state.size;
+    int i = 0;
+    int full = 0;
+
+    while (state.keepRunning()) {
+        full += grid.getSquare(Point(i % state.size, (i / state.size) % state.size));
+        i = (i + 7919) % n;
+    }
+
+    // Keep the loop from being optimised away
+    if (full < 0)
+        std::cerr << full;
+}
+
+static void benchSetSquare(BenchState &state)
+{
+    Grid grid(state.size, state.size);
+    Random random(seed);
+
+    while (state.keepRunning())
+        grid.setSquare(Point(random.nextBelow(state.size), random.nextBelow(state.size)),
+                       random.nextBelow(2) ? FULL : EMPTY);
+}
+
+static void benchGetEmptyNeighbours(BenchState &state)
+{
+    Grid grid = makeMap(RANDOM_MAP, state.size);
+    Random random(seed);
+    std::size_t total = 0;
+
+    while (state.keepRunning())
+        total += grid.getEmptyNeighbours(Point(random.nextBelow(state.size),
+                                               random.nextBelow(state.size))).size();
+
+    if (total == 0)
+        std::cerr << total;
+}
+
+static void benchClear(BenchState &state)
+{
+    Grid grid = makeMap(RANDOM_MAP, state.size);
+
+    while (state.keepRunning())
+        grid.clear();
+}
+
+static void benchPopulate(BenchState &state)
+{
+    Grid grid(state.size, state.size);
+    Random random(seed);
+
+    while (state.keepRunning()) {
+        grid.clear();
+        grid.populate(state.size * state.size / 4, random);
+    }
+}
+
+/* A map with only one square in `emptyPercent` EMPTY */
+static Grid makeFullMap(int size, int emptyPercent)
+{
+    Random random(seed);
+    Grid grid(size, size);
+    grid.populate(size * size - size * size * emptyPercent / 100, random);
+    return grid;
+}
+
+static void benchGetEmptyPoint(BenchState &state)
+{
+    Grid grid = makeFullMap(state.size, 5);
+    Random random(seed);
+    long total = 0;
+
+    while (state.keepRunning())
+        total += grid.getEmptyPoint(random).getx();
+
+    if (total < 0)
+        std::cerr << total;
+}
+
+/* Picking squares until one is EMPTY, as getEmptyPoint() did before its index */
+static void benchGetEmptyPointRejection(BenchState &state)
+{
+    Grid grid = makeFullMap(state.size, 5);
+    Random random(seed);
+    long total = 0;
+
+    while (state.keepRunning()) {
+        Point p;
+        do {
+            p = Point(random.nextBelow(state.size), random.nextBelow(state.size));
+        } while (grid.getSquare(p) == FULL);
+
+        total += p.getx();
+    }
+
+    if (total < 0)
+        std::cerr << total;
+}
+
+static void benchGetNearestEmpty(BenchState &state)
+{
+    Grid grid = makeMap(state.family, state.size);
+    Random random(seed);
+    long total = 0;
+
+    while (state.keepRunning())
+        total += grid.getNearestEmpty(Point(random.nextBelow(state.size),
+                                            random.nextBelow(state.size))).getx();
+
+    if (total < 0)
+        std::cerr << total;
+}
+
+static void benchCountFull(BenchState &state)
+{
+    Grid grid = makeMap(RANDOM_MAP, state.size);
+    int total = 0;
+
+    while (state.keepRunning())
+        total += grid.countFull();
+
+    if (total < 0)
+        std::cerr << total;
+}
+
+static void benchAStar(BenchState &state)
+{
+    Grid grid = makeMap(state.family, state.size);
+    std::vector<std::vector<Point> > queries = makeQueries(grid, 64, 2);
+
+    AStar pathfinder(grid);
+    int i = 0;
+
+    while (state.keepRunning()) {
+        const std::vector<Point> &query = queries[i++ % queries.size()];
+        pathfinder.build(query[0], query[1]);
+        state.expansions += pathfinder.getExpansions();
+    }
+}
+
+/**
+ * AStar.build guided by eight landmarks, built before timing
+ */
+static void benchAStarLandmarks(BenchState &state)
+{
+    Grid grid = makeMap(state.family, state.size);
+    std::vector<std::vector<Point> > queries = makeQueries(grid, 64, 2);
+
+    AStar pathfinder(grid);
+    Landmarks landmarks(&pathfinder.grid);
+    pathfinder.setLandmarks(&landmarks);
+    int i = 0;
+
+    while (state.keepRunning()) {
+        const std::vector<Point> &query = queries[i++ % queries.size()];
+        pathfinder.build(query[0], query[1]);
+        state.expansions += pathfinder.getExpansions();
+    }
+}
+
+/**
+ * Paths read from a PathDatabase, built before timing
+ */
+static void benchPathDatabaseFind(BenchState &state)
+{
+    Grid grid = makeMap(state.family, state.size);
+    std::vector<std::vector<Point> > queries = makeQueries(grid, 64, 2);
+
+    PathDatabase database;
+    database.build(grid);
+    int i = 0;
+
+    while (state.keepRunning()) {
+        const std::vector<Point> &query = queries[i++ % queries.size()];
+        database.find(query[0], query[1]);
+    }
+}
+
+/**
+ * Building a PathDatabase on every core
+ */
+static void benchPathDatabaseBuild(BenchState &state)
+{
+    Grid grid = makeMap(state.family, state.size);
+    PathDatabase database;
+
+    while (state.keepRunning())
+        database.build(grid);
+}
+
+/**
+ * One frame of 64 searches in flight sharing a budget of 1024 expansions,
+ * starting each again as it finishes
+ */
+static void benchSearchScheduler(BenchState &state)
+{
+    Grid grid = makeMap(state.family, state.size);
+    std::vector<std::vector<Point> > queries = makeQueries(grid, 64, 2);
+
+    AStar pathfinder(grid);
+    SearchScheduler scheduler;
+    std::map<int, int> queryOf;
+
+    for (std::size_t q = 0; q < queries.size(); ++q)
+        queryOf[scheduler.add(pathfinder.startSearch(queries[q][0], queries[q][1]))] = q;
+
+    while (state.keepRunning()) {
+        std::vector<int> finished = scheduler.step(1024);
+        state.expansions += 1024;
+
+        for (std::size_t i = 0; i < finished.size(); ++i) {
+            const std::vector<Point> &query = queries[queryOf[finished[i]]];
+            queryOf[scheduler.add(pathfinder.startSearch(query[0], query[1]))] =
+                queryOf[finished[i]];
+            queryOf.erase(finished[i]);
+            scheduler.remove(finished[i]);
+        }
+    }
+}
+
+/**
+ * Count expansions of every leg built by a waypoint query
+ */
+class CountingAStar : public AStar {
+ public:
+    CountingAStar(Grid grid) : AStar(grid), total(0) { }
+
+    Path build(const Point &start, const Point &end) {
+        Path path = AStar::build(start, end);
+        total += getExpansions();
+        return path;
+    }
+
+    double total;
+};
+
+static void benchWaypoints(BenchState &state)
+{
+    Grid grid = makeMap(state.family, state.size);
+    std::vector<std::vector<Point> > queries = makeQueries(grid, 16, 6);
+
+    CountingAStar pathfinder(grid);
+    int i = 0;
+
+    while (state.keepRunning())
+        pathfinder.buildFromWaypoints(queries[i++ % queries.size()]);
+
+    state.expansions = pathfinder.total;
+}
+
+static void benchWaypointsHeuristic(BenchState &state)
+{
+    Grid grid = makeMap(state.family, state.size);
+    std::vector<std::vector<Point> > queries = makeQueries(grid, 16, 6);
+
+    CountingAStar pathfinder(grid);
+    int i = 0;
+
+    while (state.keepRunning())
+        pathfinder.buildWithHeuristic(queries[i++ % queries.size()]);
+
+    state.expansions = pathfinder.total;
+}
+
+/**
+ * AStar.build under a movement rule other than the default
+ */
+template <Movement M>
+static void benchAStarMovement(BenchState &state)
+{
+    Grid grid = makeMap(state.family, state.size);
+    std::vector<std::vector<Point> > queries = makeQueries(grid, 64, 2);
+
+    AStar pathfinder(grid);
+    pathfinder.setMovement(M);
+    int i = 0;
+
+    while (state.keepRunning()) {
+        const std::vector<Point> &query = queries[i++ % queries.size()];
+        pathfinder.build(query[0], query[1]);
+        state.expansions += pathfinder.getExpansions();
+    }
+}
+
+/**
+ * A Grid as an agent `size` squares across sees it, testing every square
+ * under the agent: what ClearanceGrid tells in O(1), to check it against
+ * and compare its speed with
+ */
+class FootprintGrid {
+ public:
+    FootprintGrid(const Grid *grid, int size) : grid(grid), size(size) { }
+
+    Square getSquare(const Point &p) const {
+        for (int dy = 0; dy < size; ++dy)
+            for (int dx = 0; dx < size; ++dx)
+                if (grid->getSquare(Point(p.getx() + dx, p.gety() + dy)) == FULL)
+                    return FULL;
+        return EMPTY;
+    }
+
+    uint8_t getCost(const Point &p) const {
+        uint8_t most = 0;
+        for (int dy = 0; dy < size; ++dy)
+            for (int dx = 0; dx < size; ++dx)
+                most = std::max(most, grid->getCost(Point(p.getx() + dx, p.gety() + dy)));
+        return most;
+    }
+
+    int getMinCost() const { return grid->getMinCost(); }
+
+    template <Movement M>
+    unsigned getMoves(const Point &p) const {
+        unsigned mask = 0;
+        for (int i = 0; i < 8; ++i)
+            mask |= (unsigned)(getSquare(Point(p.getx() + moveDx[i], p.gety() + moveDy[i])) ==
+                               EMPTY) << i;
+        return allowedMoves<M>(mask);
+    }
+
+    int getWidth() const { return grid->getWidth(); }
+    int getHeight() const { return grid->getHeight(); }
+
+ private:
+    const Grid *grid;
+    int size;
+};
+
+/**
+ * Queries of makeQueries() where an agent `size` squares across fits at
+ * both ends
+ */
+static std::vector<std::vector<Point> > makeSizedQueries(Grid &grid, int size)
+{
+    std::vector<std::vector<Point> > queries = makeQueries(grid, 1024, 2), sized;
+    FootprintGrid footprint(&grid, size);
+
+    for (std::size_t q = 0; q < queries.size() && sized.size() < 64; ++q)
+        if (footprint.getSquare(queries[q][0]) == EMPTY &&
+            footprint.getSquare(queries[q][1]) == EMPTY)
+            sized.push_back(queries[q]);
+
+    return sized;
+}
+
+/**
+ * AStar.build for an agent three squares across, using Clearance
+ */
+static void benchAStarSized(BenchState &state)
+{
+    Grid grid = makeMap(state.family, state.size);
+    std::vector<std::vector<Point> > queries = makeSizedQueries(grid, 3);
+
+    AStar pathfinder(grid);
+    Clearance clearance(&pathfinder.grid);
+    pathfinder.setAgentSize(3, &clearance);
+    int i = 0;
+
+    while (state.keepRunning()) {
+        const std::vector<Point> &query = queries[i++ % queries.size()];
+        pathfinder.build(query[0], query[1]);
+        state.expansions += pathfinder.getExpansions();
+    }
+}
+
+/**
+ * The same searches as AStar.build.agent3, testing all nine squares under
+ * the agent for each neighbour rather than looking up their clearance
+ */
+static void benchFootprintSearch(BenchState &state)
+{
+    Grid grid = makeMap(state.family, state.size);
+    std::vector<std::vector<Point> > queries = makeSizedQueries(grid, 3);
+
+    FootprintGrid footprint(&grid, 3);
+    BasicAStar<FootprintGrid, OctileHeuristic<int>, int, MovePolicy<EIGHT_CONNECTED> >
+        search(&footprint);
+    int cost;
+    int i = 0;
+
+    while (state.keepRunning()) {
+        const std::vector<Point> &query = queries[i++ % queries.size()];
+        search.search(query[0], query[1], cost);
+        state.expansions += search.getExpansions();
+    }
+}
+
+/**
+ * Clearance following one square changing per iteration
+ */
+static void benchClearanceUpdate(BenchState &state)
+{
+    Grid grid = makeMap(state.family, state.size);
+    Clearance clearance(&grid);
+    Random random(seed);
+
+    while (state.keepRunning()) {
+        Point p(random.nextBelow(grid.getWidth()), random.nextBelow(grid.getHeight()));
+        grid.setSquare(p, grid.getSquare(p) == FULL ? EMPTY : FULL);
+    }
+}
+
+/**
+ * BasicAStar used directly, eight-connected with `Cost` costs
+ */
+template <class Cost>
+static void benchBasicAStar(BenchState &state)
+{
+    Grid grid = makeMap(state.family, state.size);
+    std::vector<std::vector<Point> > queries = makeQueries(grid, 64, 2);
+
+    BasicAStar<Grid, OctileHeuristic<Cost>, Cost, MovePolicy<EIGHT_CONNECTED> > search(&grid);
+    Cost cost;
+    int i = 0;
+
+    while (state.keepRunning()) {
+        const std::vector<Point> &query = queries[i++ % queries.size()];
+        search.search(query[0], query[1], cost);
+        state.expansions += search.getExpansions();
+    }
+}
+
+/**
+ * `n` agents on `grid` with different starts and different goals, all in the
+ * largest component
+ */
+static std::vector<Agent> makeAgents(Grid &grid, int n)
+{
+    std::vector<std::vector<Point> > points = makeQueries(grid, 4 * n, 2);
+    std::set<Point> starts, goals;
+    std::vector<Agent> agents;
+
+    for (std::size_t i = 0; i < points.size() && (int)agents.size() < n; ++i)
+        if (starts.insert(points[i][0]).second && goals.insert(points[i][1]).second)
+            agents.push_back(Agent(points[i][0], points[i][1]));
+        else
+            starts.erase(points[i][0]);
+
+    return agents;
+}
+
+/**
+ * Cooperative A* for 100 agents at once
+ */
+static void benchMultiAgentPlan(BenchState &state)
+{
+    Grid grid = makeMap(state.family, state.size);
+    std::vector<Agent> agents = makeAgents(grid, 100);
+
+    MultiAgentPlanner planner(&grid);
+    std::vector<TimedPath> paths;
+
+    while (state.keepRunning()) {
+        planner.plan(agents, paths);
+        state.expansions += planner.getExpansions();
+    }
+}
+
+/**
+ * One tick of windowed cooperative A* for 100 agents, moving each agent one
+ * step and giving it a new goal once there
+ */
+static void benchMultiAgentWindow(BenchState &state)
+{
+    Grid grid = makeMap(state.family, state.size);
+    std::vector<Agent> agents = makeAgents(grid, 100);
+    std::vector<std::vector<Point> > goals = makeQueries(grid, 256, 1);
+
+    std::vector<Point> positions, targets;
+    for (std::size_t i = 0; i < agents.size(); ++i) {
+        positions.push_back(agents[i].start);
+        targets.push_back(agents[i].goal);
+    }
+
+    MultiAgentPlanner planner(&grid);
+    std::vector<TimedPath> paths;
+    int next = 0;
+
+    while (state.keepRunning()) {
+        planner.planWindow(positions, targets, paths);
+        state.expansions += planner.getExpansions();
+
+        for (std::size_t i = 0; i < positions.size(); ++i) {
+            positions[i] = paths[i][1];
+            if (positions[i] == targets[i])
+                targets[i] = goals[next++ % goals.size()][0];
+        }
+    }
+}
+
+/**
+ * Conflict-based search for 6 agents
+ */
+static void benchMultiAgentConflictBased(BenchState &state)
+{
+    Grid grid = makeMap(state.family, state.size);
+    std::vector<Agent> agents = makeAgents(grid, 6);
+
+    MultiAgentPlanner planner(&grid);
+    std::vector<TimedPath> paths;
+
+    while (state.keepRunning()) {
+        planner.planConflictBased(agents, paths);
+        state.expansions += planner.getExpansions();
+    }
+}
+
+/**
+ * Copy of `grid` as a ChunkedGrid bounded to the same rectangle, moved by
+ * `offset`
+ */
+static void copyToChunked(const Grid &grid, ChunkedGrid &chunked, const Point &offset)
+{
+    chunked.setBounds(offset.getx(), offset.gety(), grid.getWidth(), grid.getHeight());
+
+    for (int y = 0; y < grid.getHeight(); ++y)
+        for (int x = 0; x < grid.getWidth(); ++x) {
+            chunked.setSquare(Point(x, y) + offset, grid.getSquare(Point(x, y)));
+            chunked.setCost(Point(x, y) + offset, grid.getCost(Point(x, y)));
+        }
+}
+
+/**
+ * BasicAStar on a ChunkedGrid copy of the map, to compare with
+ * BasicAStar.search.int32
+ */
+static void benchChunkedGrid(BenchState &state)
+{
+    Grid grid = makeMap(state.family, state.size);
+    std::vector<std::vector<Point> > queries = makeQueries(grid, 64, 2);
+
+    ChunkedGrid chunked;
+    copyToChunked(grid, chunked, Point(0, 0));
+
+    BasicAStar<ChunkedGrid, OctileHeuristic<int>, int, MovePolicy<EIGHT_CONNECTED> > search(&chunked);
+    int cost;
+    int i = 0;
+
+    while (state.keepRunning()) {
+        const std::vector<Point> &query = queries[i++ % queries.size()];
+        search.search(query[0], query[1], cost);
+        state.expansions += search.getExpansions();
+    }
+}
+
+/**
+ * BasicAStar across a mostly empty million by million ChunkedGrid with walls
+ * scattered through it, so only the chunks near the path hold data
+ */
+static void benchChunkedGridSparse(BenchState &state)
+{
+    Random random(seed);
+    ChunkedGrid chunked;
+    chunked.setBounds(-500000, -500000, 1000000, 1000000);
+
+    for (int i = 0; i < 2000; ++i) {
+        int x = (int)random.nextBelow(4000) - 2000, y = (int)random.nextBelow(4000) - 2000;
+        if (random.nextBelow(2))
+            chunked.fillRect(x, y, 1 + random.nextBelow(100), 2, FULL);
+        else
+            chunked.fillRect(x, y, 2, 1 + random.nextBelow(100), FULL);
+    }
+
+    BasicAStar<ChunkedGrid, OctileHeuristic<int>, int, MovePolicy<EIGHT_CONNECTED> > search(&chunked);
+    int cost;
+    int i = 0;
+
+    while (state.keepRunning()) {
+        Point start(-1000 + i % 7, -1000), end(1000, 1000 - i % 5);
+        chunked.setSquare(start, EMPTY);
+        chunked.setSquare(end, EMPTY);
+        search.search(start, end, cost);
+        state.expansions += search.getExpansions();
+        ++i;
+    }
+}
+
+#if __cplusplus >= 201103L
+/**
+ * BasicAStar on a SharedGrid copy of the map, pinning a snapshot for each
+ * search, to compare with BasicAStar.search.int32
+ */
+static void benchSharedGridSearch(BenchState &state)
+{
+    Grid grid = makeMap(state.family, state.size);
+    std::vector<std::vector<Point> > queries = makeQueries(grid, 64, 2);
+
+    SharedGrid shared(grid);
+    SnapshotReader reader(shared);
+
+    BasicAStar<GridSnapshot, OctileHeuristic<int>, int, MovePolicy<EIGHT_CONNECTED> >
+        search(&reader.getSnapshot());
+    int cost;
+    int i = 0;
+
+    while (state.keepRunning()) {
+        const std::vector<Point> &query = queries[i++ % queries.size()];
+        reader.pin();
+        search.search(query[0], query[1], cost);
+        reader.unpin();
+        state.expansions += search.getExpansions();
+    }
+}
+
+/**
+ * One square changed and published per iteration, copying its page and the
+ * page table, with a reader pinning between publishes
+ */
+static void benchSharedGridPublish(BenchState &state)
+{
+    Grid grid = makeMap(state.family, state.size);
+    SharedGrid shared(grid);
+    SnapshotReader reader(shared);
+    Random random(seed);
+
+    while (state.keepRunning()) {
+        Point p(random.nextBelow(grid.getWidth()), random.nextBelow(grid.getHeight()));
+        reader.pin();
+        shared.setSquare(p, reader.getSnapshot().getSquare(p) == FULL ? EMPTY : FULL);
+        reader.unpin();
+        shared.publish();
+    }
+}
+#endif
+
+static void benchDijkstra(BenchState &state)
+{
+    Grid grid = makeMap(state.family, state.size);
+    std::vector<std::vector<Point> > queries = makeQueries(grid, 64, 2);
+
+    Dijkstra pathfinder(grid);
+    int i = 0;
+
+    while (state.keepRunning()) {
+        const std::vector<Point> &query = queries[i++ % queries.size()];
+        pathfinder.build(query[0], query[1]);
+        state.expansions += pathfinder.getExpansions();
+    }
+}
+
+/**
+ * Return true if `path` (in reverse order, as build() returns it) is a chain
+ * of moves between EMPTY squares from `start` to `end` allowed by `movement`,
+ * on a Grid or a FootprintGrid
+ */
+template <class G>
+static bool validPath(const G &grid, const Path &path, const Point &start, const Point &end,
+                      Movement movement)
+{
+    if (path.empty() || path.front() != end || path.back() != start)
+        return false;
+
+    for (std::size_t i = 0; i < path.size(); ++i) {
+        if (grid.getSquare(path[i]) == FULL)
+            return false;
+
+        if (i > 0) {
+            int dx = std::abs(path[i].getx() - path[i - 1].getx());
+            int dy = std::abs(path[i].gety() - path[i - 1].gety());
+
+            if (dx > 1 || dy > 1 || dx + dy == 0)
+                return false;
+
+            if (dx == 1 && dy == 1) {
+                // Squares beside the diagonal
+                bool side1 = grid.getSquare(Point(path[i].getx(), path[i - 1].gety())) == EMPTY;
+                bool side2 = grid.getSquare(Point(path[i - 1].getx(), path[i].gety())) == EMPTY;
+
+                if (movement == FOUR_CONNECTED ||
+                    (movement == NO_CORNER_CUTTING && !(side1 && side2)) ||
+                    (movement == NO_SQUEEZING && !(side1 || side2)))
+                    return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Check that an AStar answering through a PathCache, from exact hits and from
+ * sub-paths of cached routes, returns paths as cheap as an AStar without one
+ * on random grids under each movement rule and for bigger agents, as squares
+ * open and close and costs change under it.
+ * Return the number of mismatches
+ */
+static int checkPathCache()
+{
+    Random random(seed + 8);
+    int failures = 0;
+    int queries = 0;
+    unsigned long hits = 0, subPathHits = 0;
+
+    for (int g = 0; g < 20; ++g) {
+        int width = 10 + random.nextBelow(40);
+        int height = 10 + random.nextBelow(40);
+
+        Grid grid(width, height);
+        generateRandomFill(grid, random.nextDouble() * 0.3, random);
+        if (g % 2 == 1)
+            for (int i = 0; i < width * height / 8; ++i)
+                grid.setCost(randomEmptyPoint(grid, random), 1 + random.nextBelow(9));
+
+        AStar cached(grid), plain(grid);
+        PathCache cache(g % 4 == 0 ? 4096 : 1 << 20);
+        cached.setCache(&cache);
+
+        // Walls block diagonal moves beside them under some rules
+        Movement movement = (Movement)((g / 5) % 4);
+        cached.setMovement(movement);
+        plain.setMovement(movement);
+
+        // And for bigger agents, which a wall blocks up and left of it too
+        Clearance cachedClearance(&cached.grid, 4), plainClearance(&plain.grid, 4);
+        int size = g % 5 >= 3 ? 2 + random.nextBelow(2) : 1;
+        cached.setAgentSize(size, &cachedClearance);
+        plain.setAgentSize(size, &plainClearance);
+
+        // Few enough end points that queries repeat, before and after edits
+        std::vector<Point> points;
+        for (int i = 0; i < 6; ++i)
+            points.push_back(randomEmptyPoint(grid, random));
+
+        // Last path found, for edits right beside it
+        Path last;
+
+        for (int round = 0; round < 10; ++round) {
+            for (int q = 0; q < 30; ++q) {
+                Point start = points[random.nextBelow(points.size())];
+                Point end = points[random.nextBelow(points.size())];
+
+                // Then part of a route already found, which the cache answers
+                // from that route
+                if (q % 3 == 2) {
+                    Path route = cached.find(start, end);
+                    if (route.size() > 2) {
+                        std::size_t i = random.nextBelow(route.size() - 1);
+                        std::size_t j = i + 1 + random.nextBelow(route.size() - 1 - i);
+                        start = route[j];
+                        end = route[i];
+                    }
+                }
+
+                int cost;
+                Path path = cached.find(start, end);
+                plain.build(start, end, cost);
+                ++queries;
+
+                bool valid = size > 1 ?
+                    validPath(FootprintGrid(&plain.grid, size), path, start, end, movement) :
+                    validPath(plain.grid, path, start, end, movement);
+                bool ok = cost == -1 ? path.empty() : valid && plain.pathCost(path) == cost;
+
+                if (!path.empty())
+                    last = path;
+
+                if (!ok) {
+                    std::cerr << "Mismatch on cached grid " << g << " from " << start
+                              << " to " << end << ": cost " << cost << ", cached path of "
+                              << path.size() << " squares" << std::endl;
+                    ++failures;
+                }
+            }
+
+            int edits = 1 + random.nextBelow(20);
+            for (int e = 0; e < edits; ++e) {
+                Point p(random.nextBelow(width), random.nextBelow(height));
+
+                // Often under or just beside the agent somewhere along a path,
+                // where off the grid is left alone
+                if (!last.empty() && random.nextBelow(2) == 0) {
+                    Point q = last[random.nextBelow(last.size())];
+                    p = Point(q.getx() - 1 + random.nextBelow(size + 2),
+                              q.gety() - 1 + random.nextBelow(size + 2));
+                }
+
+                if (random.nextBelow(2) == 0) {
+                    // Often back to 1, which can shorten any route
+                    uint8_t cost = random.nextBelow(2) ? 1 : 1 + random.nextBelow(9);
+                    cached.grid.setCost(p, cost);
+                    plain.grid.setCost(p, cost);
+                } else {
+                    // Mostly walls, which keep the routes around them
+                    Square s = random.nextBelow(4) ? FULL : EMPTY;
+                    cached.grid.setSquare(p, s);
+                    plain.grid.setSquare(p, s);
+                }
+            }
+        }
+
+        hits += cache.getHits();
+        subPathHits += cache.getSubPathHits();
+
+        if (cache.getMemoryUsage() > cache.getBudget()) {
+            std::cerr << "Cache of grid " << g << " uses " << cache.getMemoryUsage()
+                      << " bytes of " << cache.getBudget() << std::endl;
+            ++failures;
+        }
+    }
+
+    // Hits are what is being checked, so there have to be some
+    if (hits == 0 || subPathHits == 0) {
+        std::cerr << "No cache hits of some kind: " << hits << " hits, " << subPathHits
+                  << " from sub-paths" << std::endl;
+        ++failures;
+    }
+
+    std::cerr << "Checked " << queries << " cached queries against AStar, " << hits
+              << " hits of which " << subPathHits << " from sub-paths, " << failures
+              << " mismatches" << std::endl;
+
+    return failures;
+}
+
+/**
+ * Return the number of squares of `grid` whose label in `components`
+ * disagrees with a flood fill from scratch, where labels agree if the same
+ * squares share them, plus any mismatch in the count or sizes
+ */
+static int compareComponents(const Grid &grid, const Components &components)
+{
+    int width = grid.getWidth(), height = grid.getHeight();
+    std::vector<int> labels(width * height, -1);
+    std::vector<int> sizes;
+
+    for (int i = 0; i < width * height; ++i) {
+        if (labels[i] != -1 || grid.getSquare(Point(i % width, i / width)) == FULL)
+            continue;
+
+        int label = sizes.size();
+        sizes.push_back(0);
+
+        std::vector<Point> stack(1, Point(i % width, i / width));
+        labels[i] = label;
+        while (!stack.empty()) {
+            Point p = stack.back();
+            stack.pop_back();
+            ++sizes[label];
+
+            std::set<Point> neighbours = grid.getEmptyNeighbours(p);
+            for (std::set<Point>::const_iterator n = neighbours.begin(); n != neighbours.end(); ++n)
+                if (labels[n->gety() * width + n->getx()] == -1) {
+                    labels[n->gety() * width + n->getx()] = label;
+                    stack.push_back(*n);
+                }
+        }
+    }
+
+    int mismatches = components.count() != (int)sizes.size();
+
+    // Each flood fill label must go with exactly one label of `components`
+    std::map<int, int> forwards, backwards;
+    for (int i = 0; i < width * height; ++i) {
+        int expected = labels[i];
+        int label = components.getLabel(Point(i % width, i / width));
+
+        if (expected == -1 || label == -1) {
+            mismatches += expected != label;
+            continue;
+        }
+
+        if (!forwards.count(expected) && !backwards.count(label)) {
+            forwards[expected] = label;
+            backwards[label] = expected;
+            mismatches += components.getSize(label) != sizes[expected];
+        }
+
+        mismatches += forwards[expected] != label || backwards[label] != expected;
+    }
+
+    return mismatches;
+}
+
+/**
+ * Check that Components keeps the same labels as a flood fill from scratch
+ * while random grids have squares opened and filled one at a time, which it
+ * patches up, and change in bulk, which it relabels.
+ * Return the number of mismatches
+ */
+static int checkComponents()
+{
+    Random random(seed + 9);
+    int failures = 0;
+    int edits = 0;
+
+    for (int g = 0; g < 30; ++g) {
+        int width = 1 + random.nextBelow(60);
+        int height = 1 + random.nextBelow(60);
+
+        Grid grid(width, height);
+        generateRandomFill(grid, random.nextDouble() * 0.6, random);
+        Components components(&grid);
+
+        for (int round = 0; round < 20; ++round) {
+            if (round % 5 == 4) {
+                Grid other(width, height);
+                switch (random.nextBelow(3)) {
+                case 0:
+                    grid.fillRect(random.nextBelow(width), random.nextBelow(height),
+                                  1 + random.nextBelow(8), 1 + random.nextBelow(8),
+                                  random.nextBelow(2) ? FULL : EMPTY);
+                    break;
+                case 1:
+                    grid.populate(random.nextBelow(width * height / 4 + 1), random);
+                    break;
+                default:
+                    generateRandomFill(other, random.nextDouble() * 0.6, random);
+                    grid = other;
+                    break;
+                }
+                ++edits;
+            } else {
+                int n = 1 + random.nextBelow(width * height / 8 + 1);
+                for (int e = 0; e < n; ++e, ++edits) {
+                    Point p(random.nextBelow(width), random.nextBelow(height));
+                    if (random.nextBelow(5) == 0)
+                        grid.setCost(p, 1 + random.nextBelow(9));
+                    else
+                        grid.setSquare(p, random.nextBelow(2) ? FULL : EMPTY);
+                }
+            }
+
+            int mismatches = compareComponents(grid, components);
+            if (mismatches) {
+                std::cerr << mismatches << " squares with the wrong component on grid " << g
+                          << " after round " << round << std::endl;
+                failures += mismatches;
+            }
+        }
+    }
+
+    std::cerr << "Checked components after " << edits << " edits, " << failures
+              << " mismatches" << std::endl;
+
+    return failures;
+}
+
+/* Bit position for the kernel check, half the time next to a word boundary */
+static int randomBit(Random &random, int bits)
+{
+    if (random.nextBelow(2))
+        return random.nextBelow(bits + 1);
+
+    int bit = 64 * random.nextBelow(bits / 64 + 1) + (int)random.nextBelow(3) - 1;
+    return std::max(0, std::min(bits, bit));
+}
+
+static bool getBit(const uint64_t *row, int i)
+{
+    return (row[i >> 6] >> (i & 63)) & 1;
+}
+
+/**
+ * Return true if `grid` has the same squares as `model`, FULL where it is
+ * true, and counts them the same
+ */
+static bool sameBits(const Grid &grid, const std::vector<bool> &model)
+{
+    int full = 0;
+    for (int y = 0; y < grid.getHeight(); ++y)
+        for (int x = 0; x < grid.getWidth(); ++x) {
+            bool bit = model[y * grid.getWidth() + x];
+            full += bit;
+            if ((grid.getSquare(Point(x, y)) == FULL) != bit)
+                return false;
+        }
+
+    return grid.countFull() == full;
+}
+
+/**
+ * Check the GridKernels bit operations against setting and reading one bit
+ * at a time, on ranges starting and ending in every position of a word,
+ * and then Grid's bulk operations built on them, clipped at every edge of
+ * grids just under, at and over whole words wide. Return the number of
+ * mismatches
+ */
+static int checkGridKernels()
+{
+    Random random(seed + 10);
+    int failures = 0;
+    int operations = 0;
+
+    const int words = 6, bits = words * 64;
+
+    for (int i = 0; i < 20000; ++i, ++operations) {
+        uint64_t row[words], expected[words], src[words];
+        for (int w = 0; w < words; ++w) {
+            row[w] = expected[w] = random.next();
+            src[w] = random.next();
+        }
+
+        int from = randomBit(random, bits), to = randomBit(random, bits);
+        if (from > to)
+            std::swap(from, to);
+
+        std::size_t count = 0;
+        const char *name = 0;
+
+        switch (i % 5) {
+        case 0: {
+            bool value = random.nextBelow(2);
+            fillBits(row, from, to, value);
+            for (int b = from; b < to; ++b)
+                expected[b >> 6] = (expected[b >> 6] & ~((uint64_t)1 << (b & 63))) |
+                    ((uint64_t)value << (b & 63));
+            name = "fillBits";
+            break;
+        }
+        case 1:
+            invertBits(row, from, to);
+            for (int b = from; b < to; ++b)
+                expected[b >> 6] ^= (uint64_t)1 << (b & 63);
+            name = "invertBits";
+            break;
+        case 2: {
+            // Half the time at the same place in a word, which copies whole
+            // words in the middle
+            int n = to - from;
+            int srcFrom = random.nextBelow(2) ? from : random.nextBelow(bits - n + 1);
+            copyBits(src, srcFrom, row, from, n);
+            for (int b = 0; b < n; ++b) {
+                int d = from + b;
+                expected[d >> 6] = (expected[d >> 6] & ~((uint64_t)1 << (d & 63))) |
+                    ((uint64_t)getBit(src, srcFrom + b) << (d & 63));
+            }
+            name = "copyBits";
+            break;
+        }
+        case 3:
+            for (int b = from; b < to; ++b)
+                count += getBit(row, b);
+            if (countBits(row, from, to) != count)
+                expected[0] = ~row[0];
+            name = "countBits";
+            break;
+        default:
+            for (int b = 0; b < to / 64 * 64; ++b)
+                count += getBit(row, b);
+            if (countWords(row, to / 64) != count)
+                expected[0] = ~row[0];
+            name = "countWords";
+            break;
+        }
+
+        if (!std::equal(row, row + words, expected)) {
+            std::cerr << name << " wrong on bits " << from << " to " << to << std::endl;
+            ++failures;
+        }
+    }
+
+    static const int widths[] = { 1, 63, 64, 65, 127, 128, 129, 255, 256, 257, 300 };
+    for (int g = 0; g < 40; ++g) {
+        int width = widths[g % 11];
+        int height = 1 + random.nextBelow(20);
+
+        Grid grid(width, height), other(width + random.nextBelow(70), height + 3);
+        generateRandomFill(grid, 0.5, random);
+        generateRandomFill(other, 0.5, random);
+
+        std::vector<bool> model(width * height);
+        for (int y = 0; y < height; ++y)
+            for (int x = 0; x < width; ++x)
+                model[y * width + x] = grid.getSquare(Point(x, y)) == FULL;
+
+        for (int round = 0; round < 20; ++round, ++operations) {
+            // Rectangles may start off the grid and run past its far edges
+            int x = random.nextBelow(width + 20) - 10, y = random.nextBelow(height + 4) - 2;
+            int w = random.nextBelow(width + 70), h = random.nextBelow(height + 4);
+            const char *name = 0;
+
+            switch (random.nextBelow(4)) {
+            case 0: {
+                Square s = random.nextBelow(2) ? FULL : EMPTY;
+                grid.fillRect(x, y, w, h, s);
+                for (int j = std::max(y, 0); j < std::min(y + h, height); ++j)
+                    for (int i = std::max(x, 0); i < std::min(x + w, width); ++i)
+                        model[j * width + i] = s == FULL;
+                name = "fillRect";
+                break;
+            }
+            case 1: {
+                int srcx = random.nextBelow(other.getWidth() + 20) - 10;
+                int srcy = random.nextBelow(other.getHeight() + 4) - 2;
+                grid.copyRegion(other, srcx, srcy, w, h, x, y);
+                for (int j = 0; j < h; ++j)
+                    for (int i = 0; i < w; ++i) {
+                        Point from(srcx + i, srcy + j), to(x + i, y + j);
+                        if (from.getx() >= 0 && from.gety() >= 0 &&
+                            from.getx() < other.getWidth() && from.gety() < other.getHeight() &&
+                            to.getx() >= 0 && to.gety() >= 0 && to.getx() < width &&
+                            to.gety() < height)
+                            model[to.gety() * width + to.getx()] = other.getSquare(from) == FULL;
+                    }
+                name = "copyRegion";
+                break;
+            }
+            case 2:
+                grid.invert();
+                for (std::size_t i = 0; i < model.size(); ++i)
+                    model[i] = !model[i];
+                name = "invert";
+                break;
+            default:
+                if (random.nextBelow(4) == 0) {
+                    grid.clear();
+                    model.assign(model.size(), false);
+                    name = "clear";
+                } else {
+                    Point p(random.nextBelow(width), random.nextBelow(height));
+                    grid.setSquare(p, model[p.gety() * width + p.getx()] ? EMPTY : FULL);
+                    model[p.gety() * width + p.getx()] = !model[p.gety() * width + p.getx()];
+                    name = "setSquare";
+                }
+                break;
+            }
+
+            if (!sameBits(grid, model)) {
+                std::cerr << name << " wrong on a " << width << " by " << height
+                          << " grid in round " << round << std::endl;
+                ++failures;
+
+                // Start again from the grid rather than repeat the mismatch
+                for (int j = 0; j < height; ++j)
+                    for (int i = 0; i < width; ++i)
+                        model[j * width + i] = grid.getSquare(Point(i, j)) == FULL;
+            }
+        }
+    }
+
+    std::cerr << "Checked " << operations << " bit operations against single bits, "
+              << failures << " mismatches" << std::endl;
+
+    return failures;
+}
+
+/**
+ * Counts what a Grid tells its observers
+ */
+class CountingObserver : public GridObserver {
+ public:
+    CountingObserver() : changes(0), resets(0) { }
+
+    void squareChanged(const Grid &grid, const Point &p, Square previous) { ++changes; }
+    void costChanged(const Grid &grid, const Point &p, uint8_t previous) { ++changes; }
+    void gridReset(const Grid &grid) { ++resets; }
+
+    int changes;
+    int resets;
+};
+
+/**
+ * Run map generator `generator` on `grid`, 0 to 4 for random fill, division
+ * maze, Prim's maze, rooms and caves
+ */
+static void generateMap(int generator, Grid &grid, Random &random)
+{
+    int size = std::min(grid.getWidth(), grid.getHeight());
+
+    switch (generator) {
+    case 0:
+        generateRandomFill(grid, 0.3, random);
+        break;
+    case 1:
+        generateDivisionMaze(grid, random);
+        break;
+    case 2:
+        generatePrimMaze(grid, random);
+        break;
+    case 3:
+        generateRooms(grid, size / 4 + 1, 3, size / 4 + 3, random);
+        break;
+    default:
+        generateCaves(grid, 0.4, size / 8.0, random);
+        break;
+    }
+}
+
+/**
+ * Check that every map generator gives the same map from the same seed and
+ * leaves its generator in the same state, and that another seed gives
+ * another map. That last only holds on maps big enough for caves to be more
+ * than a square across, as noise sampled only at its lattice points is the
+ * same everywhere. Also check that observers see one reset, that random fill
+ * and caves have exactly the density asked for, that mazes and rooms are all
+ * one component, and that populate() fills exactly as many squares as asked.
+ * Return the number of mismatches
+ */
+static int checkMapGenerators()
+{
+    static const char *names[] = { "random fill", "division maze", "Prim's maze", "rooms",
+                                   "caves" };
+
+    Random random(seed + 11);
+    int failures = 0;
+    int maps = 0;
+
+    for (int g = 0; g < 25; ++g) {
+        int width = 1 + random.nextBelow(80);
+        int height = 1 + random.nextBelow(80);
+
+        for (int generator = 0; generator < 5; ++generator, ++maps) {
+            uint64_t mapSeed = random.next();
+            Random first(mapSeed), second(mapSeed), other(mapSeed + 1);
+
+            Grid grid(width, height), again(width, height), different(width, height);
+            CountingObserver observer;
+            grid.attach(&observer);
+
+            generateMap(generator, grid, first);
+            generateMap(generator, again, second);
+            generateMap(generator, different, other);
+            grid.detach(&observer);
+
+            std::string problem;
+            int full = grid.countFull();
+            int wanted = generator == 0 ? (int)(0.3 * width * height + 0.5) :
+                generator == 4 ? (int)(0.4 * width * height + 0.5) : full;
+            Components components(&grid);
+
+            if (grid.toString() != again.toString() || first.next() != second.next())
+                problem = "differs from the same seed";
+            else if (std::min(width, height) >= 16 && grid.toString() == different.toString())
+                problem = "is the same from another seed";
+            else if (observer.resets != 1 || observer.changes != 0)
+                problem = "isn't a single reset";
+            else if (full != wanted)
+                problem = "has the wrong number of FULL squares";
+            else if (generator != 0 && generator != 4 && components.count() > 1)
+                problem = "isn't all connected";
+
+            if (!problem.empty()) {
+                std::cerr << names[generator] << " " << width << " by " << height << " "
+                          << problem << std::endl;
+                ++failures;
+            }
+        }
+
+        // Both ways of populating, few and many squares at once
+        Grid grid(width, height);
+        generateRandomFill(grid, random.nextDouble() * 0.5, random);
+        int empty = width * height - grid.countFull();
+        int n = random.nextBelow(2) ? random.nextBelow(empty / 16 + 1) :
+            random.nextBelow(empty + 10);
+
+        grid.populate(n, random);
+        if (grid.countFull() != width * height - empty + std::min(n, empty)) {
+            std::cerr << "populate(" << n << ") with " << empty << " EMPTY squares left "
+                      << width * height - grid.countFull() << std::endl;
+            ++failures;
+        }
+    }
+
+    std::cerr << "Checked " << maps << " generated maps, " << failures << " mismatches"
+              << std::endl;
+
+    return failures;
+}
+
+/**
+ * Write `grid` as a map, in the Moving AI format or as plain rows, drawing
+ * each square as any of the characters readMap() takes for it, with Windows
+ * line ends half the time
+ */
+static std::string writeMap(const Grid &grid, bool movingAI, Random &random)
+{
+    static const char empty[] = "o.GS";
+    static const char full[] = "x@OTW";
+
+    const char *end = random.nextBelow(2) ? "\r\n" : "\n";
+    std::ostringstream ss;
+
+    if (movingAI)
+        ss << "type octile" << end << "height " << grid.getHeight() << end << "width "
+           << grid.getWidth() << end << "map" << end;
+
+    for (int y = 0; y < grid.getHeight(); ++y) {
+        for (int x = 0; x < grid.getWidth(); ++x) {
+            Point p(x, y);
+            if (grid.getSquare(p) == FULL)
+                ss << full[random.nextBelow(5)];
+            else if (grid.getCost(p) > 1)
+                ss << (char)('0' + grid.getCost(p));
+            else
+                ss << empty[random.nextBelow(4)];
+        }
+        ss << end;
+    }
+
+    return ss.str();
+}
+
+/**
+ * Return true if `a` and `b` have the same size, squares and costs
+ */
+static bool sameMap(const Grid &a, const Grid &b)
+{
+    if (a.getWidth() != b.getWidth() || a.getHeight() != b.getHeight())
+        return false;
+
+    for (int y = 0; y < a.getHeight(); ++y)
+        for (int x = 0; x < a.getWidth(); ++x)
+            if (a.getSquare(Point(x, y)) != b.getSquare(Point(x, y)) ||
+                a.getCost(Point(x, y)) != b.getCost(Point(x, y)))
+                return false;
+
+    return true;
+}
+
+/**
+ * Check that readMap() reads back random maps written in both formats, and
+ * that it refuses maps with a bad header, a short or long row, the wrong
+ * number of rows or an unknown square, with an error and the grid left
+ * alone. Return the number of mismatches
+ */
+static int checkMapFile()
+{
+    Random random(seed + 12);
+    int failures = 0;
+    int maps = 0;
+
+    for (int g = 0; g < 100; ++g, ++maps) {
+        int width = 1 + random.nextBelow(60);
+        int height = 1 + random.nextBelow(60);
+
+        Grid grid(width, height);
+        generateRandomFill(grid, random.nextDouble() * 0.5, random);
+        // Maps only give costs to EMPTY squares
+        for (int i = 0; g % 2 == 1 && i < width * height / 4; ++i) {
+            Point p(random.nextBelow(width), random.nextBelow(height));
+            if (grid.getSquare(p) == EMPTY)
+                grid.setCost(p, 1 + random.nextBelow(9));
+        }
+
+        bool movingAI = g % 4 < 2;
+        std::string text = writeMap(grid, movingAI, random);
+
+        Grid read(1, 1);
+        std::string error;
+        std::istringstream in(text);
+        if (!readMap(in, read, error) || !sameMap(grid, read)) {
+            std::cerr << (movingAI ? "Moving AI" : "Plain") << " map " << width << " by "
+                      << height << " didn't read back: " << error << std::endl;
+            ++failures;
+        }
+
+        // Break it in one of the ways it can be broken
+        std::vector<std::string> lines;
+        std::istringstream split(text);
+        std::string line;
+        while (std::getline(split, line))
+            lines.push_back(line);
+
+        int header = movingAI ? 4 : 0;
+        int row = header + random.nextBelow(height);
+        int x = random.nextBelow(width);
+        int damage = random.nextBelow(movingAI ? 6 : 4);
+
+        // A row one square wide emptied would be a blank line, which is skipped
+        if (damage == 0 || (damage == 1 && width == 1))
+            lines[row].insert(x, "o");
+        else if (damage == 1)
+            lines[row].erase(x, 1);
+        else if (damage == 2)
+            lines[row][x] = "? #0a"[random.nextBelow(5)];
+        else if (damage == 3 && movingAI)
+            lines.erase(lines.begin() + row);
+        else if (damage == 3)
+            lines.insert(lines.begin() + row, std::string(width + 1, 'o'));
+        else if (damage == 4)
+            lines[1 + random.nextBelow(2)] = random.nextBelow(2) ? "height 0" : "width -3";
+        else
+            lines.erase(lines.begin() + 3);
+
+        std::string broken;
+        for (std::size_t i = 0; i < lines.size(); ++i)
+            broken += lines[i] + "\n";
+
+        Grid left(grid);
+        error.clear();
+        std::istringstream brokenIn(broken);
+        if (readMap(brokenIn, left, error) || error.empty() || !sameMap(grid, left)) {
+            std::cerr << "Map " << width << " by " << height << " with damage " << damage
+                      << " wasn't refused cleanly: " << error << std::endl;
+            ++failures;
+        }
+    }
+
+    Grid grid(3, 3);
+    std::string error;
+    std::istringstream empty("");
+    if (readMap(empty, grid, error) || error.empty()) {
+        std::cerr << "An empty map wasn't refused" << std::endl;
+        ++failures;
+    }
+
+    std::cerr << "Checked " << maps << " maps read and refused, " << failures << " mismatches"
+              << std::endl;
+
+    return failures;
+}
+
+/**
+ * Check that parseQuery() skips blank lines and comments, reads the points
+ * of random queries of every length, and finds queries invalid for an odd
+ * number of coordinates, a point off the grid, anything that isn't a number
+ * or fewer than two points. Return the number of mismatches
+ */
+static int checkQueryParsing()
+{
+    Random random(seed + 13);
+    int failures = 0;
+    int queries = 0;
+
+    Grid grid(40, 30);
+
+    static const char *skipped[] = { "", "   ", "\t", "# 1 2 3 4", "  #comment", "#" };
+    for (std::size_t i = 0; i < sizeof(skipped) / sizeof(skipped[0]); ++i, ++queries) {
+        std::vector<Point> points;
+        bool valid;
+        if (parseQuery(skipped[i], grid, points, valid)) {
+            std::cerr << "Query \"" << skipped[i] << "\" wasn't skipped" << std::endl;
+            ++failures;
+        }
+    }
+
+    for (int q = 0; q < 2000; ++q, ++queries) {
+        std::vector<Point> expected;
+        bool expectValid = true;
+        std::ostringstream line;
+
+        if (random.nextBelow(2))
+            line << " ";
+
+        int count = random.nextBelow(6);
+        for (int i = 0; i < count; ++i) {
+            Point p(random.nextBelow(grid.getWidth()), random.nextBelow(grid.getHeight()));
+
+            // Now and then off the grid, on one side or another
+            if (random.nextBelow(20) == 0) {
+                int side = random.nextBelow(4);
+                p = Point(side == 0 ? -1 - random.nextBelow(5) :
+                          side == 1 ? grid.getWidth() + random.nextBelow(5) : p.getx(),
+                          side == 2 ? -1 - random.nextBelow(5) :
+                          side == 3 ? grid.getHeight() + random.nextBelow(5) : p.gety());
+                expectValid = false;
+            } else {
+                expected.push_back(p);
+            }
+
+            line << (i ? (random.nextBelow(2) ? " " : "\t ") : "") << p.getx() << " "
+                 << p.gety();
+        }
+
+        if (count < 2)
+            expectValid = false;
+
+        // Now and then spoilt at the end
+        int tail = random.nextBelow(10);
+        if (tail == 0) {
+            line << " " << random.nextBelow(40);
+            expectValid = false;
+        } else if (tail == 1) {
+            line << " x";
+            expectValid = false;
+        } else if (tail == 2) {
+            line << "  ";
+        }
+
+        if (line.str().find_first_not_of(" \t") == std::string::npos)
+            continue;
+
+        std::vector<Point> points;
+        bool valid;
+        bool parsed = parseQuery(line.str(), grid, points, valid);
+
+        if (!parsed || valid != expectValid || (valid && points != expected)) {
+            std::cerr << "Query \"" << line.str() << "\" parsed as "
+                      << (!parsed ? "skipped" : valid ? "valid" : "invalid") << std::endl;
+            ++failures;
+        }
+    }
+
+    std::cerr << "Checked " << queries << " parsed queries, " << failures << " mismatches"
+              << std::endl;
+
+    return failures;
+}
+
+/**
+ * Check the query server's answers with a round trip through its wire
+ * format: requests on random maps, some for a map or point that isn't there,
+ * are written as a client would, read back in pieces of any size, answered
+ * and their replies read as a client would. Every reply must be for its
+ * request, with its flags, the status and cost AStar gives and, if asked for,
+ * a path from start to end costing that. Return the number of mismatches
+ */
+static int checkQueryServer()
+{
+    static const int moveCosts[][2] = { { 10, 14 }, { 1, 1 }, { 5, 12 } };
+
+    Random random(seed + 14);
+    int failures = 0;
+    int queries = 0;
+
+    for (int g = 0; g < 12; ++g) {
+        const int *costs = moveCosts[g % 3];
+        Movement movement = (Movement)(g % 4);
+
+        std::vector<Grid> maps;
+        for (int i = 0; i < 3; ++i) {
+            Grid grid(5 + random.nextBelow(50), 5 + random.nextBelow(50));
+            generateRandomFill(grid, random.nextDouble() * 0.4, random);
+            for (int j = 0; i == 1 && j < grid.getWidth() * grid.getHeight() / 4; ++j)
+                grid.setCost(randomEmptyPoint(grid, random), 1 + random.nextBelow(9));
+            maps.push_back(grid);
+        }
+
+        std::vector<Components *> components;
+        std::vector<Landmarks *> landmarks;
+        std::vector<AStar *> astars;
+        for (std::size_t i = 0; i < maps.size(); ++i) {
+            components.push_back(new Components(&maps[i]));
+            landmarks.push_back(g % 2 ? new Landmarks(&maps[i], 4, costs[0], costs[1], movement) :
+                                0);
+            astars.push_back(new AStar(maps[i]));
+            astars[i]->setCardinalCost(costs[0]);
+            astars[i]->setDiagonalCost(costs[1]);
+            astars[i]->setMovement(movement);
+        }
+
+        QueryAnswerer answerer(maps, components, landmarks, movement, costs[0], costs[1]);
+
+        std::vector<QueryRequest> sent;
+        std::string written;
+        for (int q = 0; q < 100; ++q) {
+            QueryRequest request;
+            request.id = random.next();
+            request.map = random.nextBelow(20) == 0 ? maps.size() : random.nextBelow(maps.size());
+            request.flags = random.nextBelow(2) ? QUERY_WANT_PATH : 0;
+
+            const Grid &grid = maps[request.map < maps.size() ? request.map : 0];
+            request.startX = random.nextBelow(grid.getWidth() + 2);
+            request.startY = random.nextBelow(grid.getHeight() + 2);
+            request.endX = random.nextBelow(grid.getWidth() + 2);
+            request.endY = random.nextBelow(grid.getHeight() + 2);
+
+            // Now and then a path one square long
+            if (random.nextBelow(10) == 0) {
+                request.endX = request.startX;
+                request.endY = request.startY;
+            }
+
+            sent.push_back(request);
+            written.append((const char *)&request, sizeof(request));
+        }
+
+        // Read in pieces, as they come off a socket
+        std::vector<QueryRequest> received;
+        std::string in;
+        for (std::size_t at = 0; at < written.size();) {
+            std::size_t piece = 1 + random.nextBelow(3 * sizeof(QueryRequest));
+            piece = std::min(piece, written.size() - at);
+            in.append(written, at, piece);
+            at += piece;
+            takeRequests(in, received);
+        }
+
+        if (received.size() != sent.size() || !in.empty() ||
+            std::memcmp(&received[0], &sent[0], sent.size() * sizeof(QueryRequest)) != 0) {
+            std::cerr << "Requests on grid " << g << " didn't survive being read" << std::endl;
+            ++failures;
+        }
+
+        std::string replies;
+        std::vector<QueryPoint> points;
+        for (std::size_t i = 0; i < received.size(); ++i) {
+            QueryReply reply;
+            answerer.answer(received[i], reply, points);
+            appendReply(replies, reply, points);
+        }
+
+        std::size_t at = 0;
+        for (std::size_t i = 0; i < sent.size(); ++i, ++queries) {
+            const QueryRequest &request = sent[i];
+
+            QueryReply reply;
+            bool ok = at + sizeof(reply) <= replies.size();
+            if (ok) {
+                std::memcpy(&reply, replies.data() + at, sizeof(reply));
+                at += sizeof(reply);
+            }
+
+            std::vector<QueryPoint> path;
+            if (ok && (reply.flags & QUERY_WANT_PATH) && reply.status == QUERY_FOUND) {
+                ok = at + reply.length * sizeof(QueryPoint) <= replies.size();
+                if (ok) {
+                    path.resize(reply.length);
+                    std::memcpy(&path[0], replies.data() + at, reply.length * sizeof(QueryPoint));
+                    at += reply.length * sizeof(QueryPoint);
+                }
+            }
+
+            ok = ok && reply.id == request.id && reply.flags == request.flags;
+
+            bool valid = request.map < maps.size() &&
+                request.startX < maps[request.map].getWidth() &&
+                request.startY < maps[request.map].getHeight() &&
+                request.endX < maps[request.map].getWidth() &&
+                request.endY < maps[request.map].getHeight();
+
+            if (ok && !valid) {
+                ok = reply.status == QUERY_INVALID && reply.cost == -1 && reply.length == 0;
+            } else if (ok) {
+                Point start(request.startX, request.startY), end(request.endX, request.endY);
+                AStar &astar = *astars[request.map];
+                int cost;
+                astar.build(start, end, cost);
+
+                ok = reply.cost == cost &&
+                    reply.status == (cost == -1 ? QUERY_NO_PATH : QUERY_FOUND) &&
+                    (cost == -1) == (reply.length == 0);
+
+                // Paths come start first
+                if (ok && cost != -1 && (request.flags & QUERY_WANT_PATH)) {
+                    Path found;
+                    for (std::size_t j = path.size(); j-- > 0;)
+                        found.push_back(Point(path[j].x, path[j].y));
+
+                    ok = validPath(maps[request.map], found, start, end, movement) &&
+                        astar.pathCost(found) == cost;
+                }
+            }
+
+            if (!ok) {
+                std::cerr << "Wrong reply to request " << i << " on grid " << g << std::endl;
+                ++failures;
+                break;
+            }
+        }
+
+        if (at != replies.size()) {
+            std::cerr << "Replies on grid " << g << " have " << replies.size() - at
+                      << " bytes left over" << std::endl;
+            ++failures;
+        }
+
+        for (std::size_t i = 0; i < maps.size(); ++i) {
+            delete components[i];
+            delete landmarks[i];
+            delete astars[i];
+        }
+    }
+
+    std::cerr << "Checked " << queries << " server replies against AStar, " << failures
+              << " mismatches" << std::endl;
+
+    return failures;
+}
+
+/**
+ * SearchTrace that also records the searches it is told of starting and
+ * finishing
+ */
+class RecordingTrace : public SearchTrace {
+ public:
+    RecordingTrace() : started(0), finished(0) { }
+
+    void searchStarted(const Point &start, const Point &end) {
+        ++started;
+        this->start = start;
+        this->end = end;
+    }
+
+    void searchFinished(const Path &path) {
+        ++finished;
+        this->path = path;
+    }
+
+    int started;
+    int finished;
+    Point start;
+    Point end;
+    Path path;
+};
+
+/**
+ * Check that a SearchTrace attached to AStar sees each search start and
+ * finish once, with its points and path, and every expansion in order, from
+ * the start to the end when there is a path. Check writeOrder() and
+ * writeHeatMap() read back as that order, and that the SearchStats output
+ * has every counter in order, matching the trace when built with
+ * PATHFINDER_STATS and all zero otherwise. Return the number of mismatches
+ */
+static int checkSearchTrace()
+{
+    Random random(seed + 15);
+    int failures = 0;
+    int queries = 0;
+
+    for (int g = 0; g < 20; ++g) {
+        int width = 5 + random.nextBelow(40);
+        int height = 5 + random.nextBelow(40);
+
+        Grid grid(width, height);
+        generateRandomFill(grid, random.nextDouble() * 0.4, random);
+        if (g % 2 == 1)
+            for (int i = 0; i < width * height / 4; ++i)
+                grid.setCost(randomEmptyPoint(grid, random), 1 + random.nextBelow(9));
+
+        AStar astar(grid);
+        astar.setMovement((Movement)(g % 4));
+
+        RecordingTrace trace;
+        SearchStats stats;
+        astar.setObserver(&trace);
+        astar.setStats(&stats);
+
+        long expansions = 0, generated = 0;
+
+        for (int q = 0; q < 20; ++q, ++queries) {
+            Point start(random.nextBelow(width), random.nextBelow(height));
+            Point end(random.nextBelow(width), random.nextBelow(height));
+
+            trace.clear();
+            int started = trace.started, finished = trace.finished;
+            Path path = astar.find(start, end);
+
+            const std::vector<Point> &expanded = trace.getExpanded();
+            expansions += expanded.size();
+            generated += trace.getGenerated();
+
+            std::string problem;
+            if (trace.started != started + 1 || trace.finished != finished + 1 ||
+                trace.start != start || trace.end != end || trace.path != path)
+                problem = "wasn't started and finished once";
+            else if ((int)expanded.size() != astar.getExpansions() ||
+                     trace.getGenerated() < (long)expanded.size())
+                problem = "has the wrong number of nodes";
+            else if (!expanded.empty() && expanded.front() != start)
+                problem = "didn't expand the start first";
+            else if (!path.empty() && expanded.back() != end)
+                problem = "didn't expand the end last";
+
+            // The first expansion of each square, as both writers give it
+            std::map<Point, int> first;
+            for (std::size_t i = 0; i < expanded.size(); ++i)
+                first.insert(std::make_pair(expanded[i], (int)i));
+
+            std::ostringstream order;
+            trace.writeOrder(order, grid);
+            std::istringstream orderIn(order.str());
+
+            for (int y = 0; y < height && problem.empty(); ++y) {
+                std::string row;
+                std::getline(orderIn, row);
+                std::istringstream cells(row);
+
+                for (int x = 0; x < width && problem.empty(); ++x) {
+                    Point p(x, y);
+                    int value;
+                    char comma;
+                    std::map<Point, int>::iterator i = first.find(p);
+                    int wanted = grid.getSquare(p) == FULL ? -2 :
+                        i == first.end() ? -1 : i->second;
+
+                    if (!(cells >> value) || value != wanted ||
+                        (x + 1 < width && !(cells >> comma && comma == ',')))
+                        problem = "has the wrong order written";
+                }
+            }
+
+            // Squares expanded earlier are brighter, and no darker than 128
+            std::ostringstream heat;
+            trace.writeHeatMap(heat, grid);
+            std::istringstream heatIn(heat.str());
+            std::string magic;
+            int w, h, maximum;
+            heatIn >> magic >> w >> h >> maximum;
+            if (problem.empty() && (magic != "P2" || w != width || h != height || maximum != 255))
+                problem = "has the wrong heat map header";
+
+            std::vector<int> brightness(expanded.size(), -1);
+            for (int y = 0; y < height && problem.empty(); ++y)
+                for (int x = 0; x < width && problem.empty(); ++x) {
+                    Point p(x, y);
+                    int value;
+                    std::map<Point, int>::iterator i = first.find(p);
+
+                    if (!(heatIn >> value))
+                        problem = "has a short heat map";
+                    else if (grid.getSquare(p) == FULL ? value != 0 :
+                             i == first.end() ? value != 64 : value < 128 || value > 255)
+                        problem = "has the wrong heat map";
+                    else if (i != first.end())
+                        brightness[i->second] = value;
+                }
+
+            int last = 255;
+            for (std::size_t i = 0; i < brightness.size() && problem.empty(); ++i) {
+                if (brightness[i] == -1)
+                    continue;
+                if (brightness[i] > last)
+                    problem = "has a heat map brighter later";
+                last = brightness[i];
+            }
+
+            if (!problem.empty()) {
+                std::cerr << "Trace from " << start << " to " << end << " on grid " << g << " "
+                          << problem << std::endl;
+                ++failures;
+            }
+        }
+
+#ifdef PATHFINDER_STATS
+        bool counted = stats.searches == 20 && stats.expanded == expansions &&
+            stats.generated <= generated && stats.generated >= stats.expanded &&
+            (expansions == 0 || (stats.openPeak > 0 && stats.heuristicEvaluations > 0));
+#else
+        bool counted = stats.searches == 0 && stats.expanded == 0 && stats.generated == 0 &&
+            stats.openPeak == 0 && stats.heuristicEvaluations == 0;
+#endif
+
+        // Every counter, named in order
+        static const char *names[] = { "searches", "expanded", "generated", "reopened",
+                                       "openPeak", "heuristicEvaluations", "neighbourTimeNs",
+                                       "openListTimeNs" };
+        double values[] = { (double)stats.searches, (double)stats.expanded,
+                            (double)stats.generated, (double)stats.reopened,
+                            (double)stats.openPeak, (double)stats.heuristicEvaluations,
+                            stats.neighbourTime, stats.openListTime };
+
+        std::ostringstream line;
+        line << stats;
+        std::istringstream pairs(line.str());
+        std::string pair;
+        int n = 0;
+        for (; pairs >> pair && n < 8; ++n) {
+            std::string name = names[n];
+            std::istringstream value(pair.substr(name.size() + 1));
+            double read;
+
+            // Times are written to six figures
+            if (pair.compare(0, name.size() + 1, name + "=") != 0 || !(value >> read) ||
+                std::abs(read - values[n]) > 1e-5 * std::abs(values[n]))
+                break;
+        }
+
+        if (!counted || n != 8 || pairs >> pair) {
+            std::cerr << "Stats of grid " << g << " are wrong: " << stats << std::endl;
+            ++failures;
+        }
+
+        trace.clear();
+        stats.reset();
+        astar.setObserver(0);
+        astar.setStats(0);
+    }
+
+    std::cerr << "Checked the traces and stats of " << queries << " searches, " << failures
+              << " mismatches" << std::endl;
+
+    return failures;
+}
+
+/**
+ * Compare AStar with the Dijkstra oracle on seeded random grids, with and
+ * without terrain costs, with a few move costs and under every movement rule,
+ * printing every mismatch.
+ * Return the number of mismatches
+ */
+static int checkAgainstOracle()
+{
+    Random random(seed);
+    int failures = 0;
+    int queries = 0;
+
+    // Including diagonals cheaper than straight steps
+    static const int moveCosts[][2] = { { 10, 14 }, { 1, 1 }, { 2, 3 }, { 5, 12 }, { 10, 5 } };
+
+    for (int g = 0; g < 200; ++g) {
+        int width = 2 + random.nextBelow(40);
+        int height = 2 + random.nextBelow(40);
+
+        Grid grid(width, height);
+        generateRandomFill(grid, random.nextDouble() * 0.45, random);
+
+        // Half of the grids get terrain costs
+        if (g % 2 == 1) {
+            for (int y = 0; y < height; ++y)
+                for (int x = 0; x < width; ++x)
+                    grid.setCost(Point(x, y), 1 + random.nextBelow(9));
+        }
+
+        AStar astar(grid);
+        Dijkstra dijkstra(grid);
+
+        const int *costs = moveCosts[g % 5];
+        astar.setCardinalCost(costs[0]);
+        astar.setDiagonalCost(costs[1]);
+        dijkstra.setCardinalCost(costs[0]);
+        dijkstra.setDiagonalCost(costs[1]);
+
+        Movement movement = (Movement)((g / 5) % 4);
+        astar.setMovement(movement);
+        dijkstra.setMovement(movement);
+
+        for (int q = 0; q < 20; ++q, ++queries) {
+            Point start(random.nextBelow(width), random.nextBelow(height));
+            Point end(random.nextBelow(width), random.nextBelow(height));
+
+            int astarCost, oracleCost;
+            Path path = astar.build(start, end, astarCost);
+            dijkstra.build(start, end, oracleCost);
+
+            bool ok = astarCost == oracleCost;
+            if (ok && astarCost != -1)
+                ok = validPath(grid, path, start, end, movement) && astar.pathCost(path) == astarCost;
+
+            // With even move costs nothing is rounded, so a float search
+            // must agree too
+            if (ok && costs[0] % 2 == 0 && costs[1] % 2 == 0 && movement == EIGHT_CONNECTED) {
+                BasicAStar<Grid, OctileHeuristic<float>, float, MovePolicy<EIGHT_CONNECTED> >
+                    search(&grid, costs[0], costs[1]);
+                search.setHeuristic(OctileHeuristic<float>(costs[0] * grid.getMinCost(),
+                                                           costs[1] * grid.getMinCost()));
+
+                float floatCost;
+                search.search(start, end, floatCost);
+                ok = floatCost == oracleCost;
+            }
+
+            if (!ok) {
+                std::cerr << "Mismatch on grid " << g << " from " << start << " to " << end
+                          << ": AStar cost " << astarCost << ", Dijkstra cost " << oracleCost
+                          << std::endl;
+                ++failures;
+            }
+        }
+    }
+
+    std::cerr << "Checked " << queries << " AStar queries against Dijkstra, "
+              << failures << " mismatches" << std::endl;
+
+    return failures;
+}
+
+/**
+ * Return true if `path` (in forward order, with waits) is a chain of moves
+ * allowed by `movement` from `start` to `end`
+ */
+static bool validTimedPath(const Grid &grid, const TimedPath &path, const Point &start,
+                           const Point &end, Movement movement)
+{
+    Path moves;
+    for (std::size_t i = path.size(); i-- > 0;)
+        if (moves.empty() || moves.back() != path[i])
+            moves.push_back(path[i]);
+
+    return validPath(grid, moves, start, end, movement);
+}
+
+/**
+ * Check that MultiAgentPlanner's plans are valid and collision-free, and
+ * that conflict-based search is never worse than cooperative A*, on seeded
+ * random grids under every movement rule, printing every failure.
+ * Return the number of failures
+ */
+static int checkMultiAgent()
+{
+    Random random(seed);
+    int failures = 0;
+    int plans = 0;
+
+    for (int g = 0; g < 40; ++g) {
+        Grid grid(24, 24);
+        generateRandomFill(grid, 0.2, random);
+        Movement movement = (Movement)(g % 4);
+
+        MultiAgentPlanner planner(&grid);
+        planner.setMovement(movement);
+        planner.setMaxTime(200);
+
+        Conflict conflict;
+        std::vector<TimedPath> paths;
+        bool ok = true;
+
+        // Cooperative A*, and conflict-based search on the first few agents
+        std::vector<Agent> agents = makeAgents(grid, 20);
+        int cooperativeCost = -1;
+
+        for (int round = 0; round < 2 && ok; ++round) {
+            std::vector<Agent> group = agents;
+            if (round == 1)
+                group.resize(4);
+
+            bool planned = round == 0 ? planner.plan(group, paths)
+                                      : planner.planConflictBased(group, paths);
+            if (!planned)
+                continue;
+
+            ++plans;
+            ok = !MultiAgentPlanner::findConflict(paths, conflict);
+
+            int cost = 0;
+            for (std::size_t i = 0; i < group.size() && ok; ++i) {
+                ok = validTimedPath(grid, paths[i], group[i].start, group[i].goal, movement);
+                cost += paths[i].size() - 1;
+            }
+
+            // The same four agents planned cooperatively, to compare costs
+            if (round == 0) {
+                std::vector<Agent> firstFour(agents.begin(), agents.begin() + 4);
+                if (planner.plan(firstFour, paths)) {
+                    cooperativeCost = 0;
+                    for (std::size_t i = 0; i < paths.size(); ++i)
+                        cooperativeCost += paths[i].size() - 1;
+                }
+            } else if (cooperativeCost != -1 && cost > cooperativeCost) {
+                ok = false;
+            }
+        }
+
+        // Windowed planning, following each window's first step
+        std::vector<Point> positions, goals;
+        for (std::size_t i = 0; i < agents.size(); ++i) {
+            positions.push_back(agents[i].start);
+            goals.push_back(agents[i].goal);
+        }
+
+        for (int tick = 0; tick < 50 && ok; ++tick) {
+            if (!planner.planWindow(positions, goals, paths))
+                continue;
+
+            ++plans;
+            ok = !MultiAgentPlanner::findConflict(paths, conflict);
+
+            for (std::size_t i = 0; i < positions.size() && ok; ++i) {
+                ok = (int)paths[i].size() == planner.getWindow() + 1 &&
+                    validTimedPath(grid, paths[i], positions[i], paths[i].back(), movement);
+                positions[i] = paths[i][1];
+            }
+        }
+
+        if (!ok) {
+            std::cerr << "Bad multi-agent plan on grid " << g << std::endl;
+            ++failures;
+        }
+    }
+
+    std::cerr << "Checked " << plans << " multi-agent plans, " << failures << " failures"
+              << std::endl;
+
+    return failures;
+}
+
+/**
+ * Check that BasicAStar finds paths as cheap on a ChunkedGrid copy of random
+ * grids, placed across chunk boundaries at negative coordinates, as AStar does
+ * on the originals, with most chunks paged out between searches.
+ * Return the number of mismatches
+ */
+static int checkChunkedGrid()
+{
+    Random random(seed);
+    int failures = 0;
+    int queries = 0;
+
+    std::string pageFile = "chunked_check.tmp";
+
+    for (int g = 0; g < 20; ++g) {
+        Grid grid(100 + g * 7, 90 + g * 5);
+        generateRandomFill(grid, 0.3, random);
+        if (g % 2)
+            for (int i = 0; i < 500; ++i)
+                grid.setCost(randomEmptyPoint(grid, random), 1 + random.nextBelow(5));
+
+        Point offset(-70 - g * 13, -33 + g * 29);
+        ChunkedGrid chunked(g % 3 == 0 ? FULL : EMPTY);
+        copyToChunked(grid, chunked, offset);
+
+        if (g % 4 == 0 && !chunked.setPageFile(pageFile)) {
+            std::cerr << "Can't open " << pageFile << std::endl;
+            return 1;
+        }
+
+        AStar astar(grid);
+        BasicAStar<ChunkedGrid, OctileHeuristic<int>, int, MovePolicy<NO_SQUEEZING> >
+            search(&chunked);
+        astar.setMovement(NO_SQUEEZING);
+
+        for (int q = 0; q < 20; ++q) {
+            Point start = randomEmptyPoint(grid, random);
+            Point end = randomEmptyPoint(grid, random);
+            ++queries;
+
+            int astarCost, chunkedCost;
+            astar.build(start, end, astarCost);
+            Path path = search.search(start + offset, end + offset, chunkedCost);
+
+            bool ok = astarCost == chunkedCost;
+            if (ok && chunkedCost != -1) {
+                for (std::size_t i = 0; i < path.size(); ++i)
+                    path[i] = path[i] - offset;
+                ok = validPath(grid, path, start, end, NO_SQUEEZING);
+            }
+
+            if (!ok) {
+                std::cerr << "Mismatch on chunked grid " << g << " from " << start << " to "
+                          << end << ": AStar cost " << astarCost << ", chunked cost "
+                          << chunkedCost << std::endl;
+                ++failures;
+            }
+
+            if (g % 4 == 0 && !chunked.pageOut(1)) {
+                std::cerr << "Paging out to " << pageFile << " failed" << std::endl;
+                ++failures;
+            }
+        }
+    }
+
+    std::remove(pageFile.c_str());
+
+    std::cerr << "Checked " << queries << " ChunkedGrid queries against AStar, "
+              << failures << " mismatches" << std::endl;
+
+    return failures;
+}
+
+/**
+ * Check that AStar with Landmarks finds paths as cheap as Dijkstra on random
+ * grids, including after squares open, costs drop and walls go up, that the
+ * landmark bound never exceeds the real cost, and that the tables read back
+ * from a file give the same bounds. Return the number of mismatches
+ */
+static int checkLandmarks()
+{
+    Random random(seed + 2);
+    int failures = 0;
+    int queries = 0;
+
+    std::string file = "landmarks_check.tmp";
+
+    // Including diagonals cheaper than straight steps. The last costs make
+    // tables too large for 16 bits, so they are scaled
+    static const int moveCosts[][2] = { { 10, 14 }, { 1, 1 }, { 5, 12 }, { 10, 5 },
+                                        { 500, 700 } };
+
+    for (int g = 0; g < 60; ++g) {
+        int width = 10 + random.nextBelow(50);
+        int height = 10 + random.nextBelow(50);
+
+        Grid grid(width, height);
+        generateRandomFill(grid, random.nextDouble() * 0.4, random);
+        if (g % 2 == 1)
+            for (int y = 0; y < height; ++y)
+                for (int x = 0; x < width; ++x)
+                    grid.setCost(Point(x, y), 1 + random.nextBelow(9));
+
+        const int *costs = moveCosts[g % 5];
+        Movement movement = (Movement)((g / 4) % 4);
+
+        AStar astar(grid);
+        Dijkstra dijkstra(grid);
+        astar.setCardinalCost(costs[0]);
+        astar.setDiagonalCost(costs[1]);
+        astar.setMovement(movement);
+        dijkstra.setCardinalCost(costs[0]);
+        dijkstra.setDiagonalCost(costs[1]);
+        dijkstra.setMovement(movement);
+
+        Landmarks landmarks(&astar.grid, 1 + g % 8, costs[0], costs[1], movement);
+        astar.setLandmarks(&landmarks);
+
+        for (int round = 0; round < 3; ++round) {
+            // Change both grids the same way between rounds
+            for (int i = 0; round > 0 && i < 40; ++i) {
+                Point p(random.nextBelow(width), random.nextBelow(height));
+                int change = random.nextBelow(3);
+
+                if (change == 0 || change == 1) {
+                    astar.grid.setSquare(p, change == 0 ? EMPTY : FULL);
+                    dijkstra.grid.setSquare(p, change == 0 ? EMPTY : FULL);
+                } else {
+                    uint8_t cost = astar.grid.getCost(p) / 2;
+                    astar.grid.setCost(p, cost);
+                    dijkstra.grid.setCost(p, cost);
+                }
+            }
+
+            for (int q = 0; q < 20; ++q, ++queries) {
+                Point start(random.nextBelow(width), random.nextBelow(height));
+                Point end(random.nextBelow(width), random.nextBelow(height));
+
+                int astarCost, oracleCost;
+                Path path = astar.build(start, end, astarCost);
+                dijkstra.build(start, end, oracleCost);
+
+                bool ok = astarCost == oracleCost;
+                if (ok && astarCost != -1)
+                    ok = validPath(astar.grid, path, start, end, movement) &&
+                        astar.pathCost(path) == astarCost &&
+                        landmarks.lowerBound(start, end) <= oracleCost;
+
+                if (!ok) {
+                    std::cerr << "Mismatch with landmarks on grid " << g << " round " << round
+                              << " from " << start << " to " << end << ": AStar cost "
+                              << astarCost << ", Dijkstra cost " << oracleCost << std::endl;
+                    ++failures;
+                }
+            }
+        }
+
+        // A pathfinder on a copy of the grid shares the landmarks while the
+        // two have the same squares, searching just as the original does,
+        // and searches without them while they differ
+        AStar copy(astar.grid), plain(astar.grid);
+        copy.setCardinalCost(costs[0]);
+        copy.setDiagonalCost(costs[1]);
+        copy.setMovement(movement);
+        copy.setLandmarks(&landmarks);
+        plain.setCardinalCost(costs[0]);
+        plain.setDiagonalCost(costs[1]);
+        plain.setMovement(movement);
+
+        Point flipped(random.nextBelow(width), random.nextBelow(height));
+        for (int step = 0; step < 3; ++step) {
+            if (step > 0) {
+                Square s = copy.grid.getSquare(flipped) == FULL ? EMPTY : FULL;
+                copy.grid.setSquare(flipped, s);
+                plain.grid.setSquare(flipped, s);
+            }
+
+            AStar &same = step == 1 ? plain : astar;
+            for (int q = 0; q < 10; ++q, ++queries) {
+                Point start(random.nextBelow(width), random.nextBelow(height));
+                Point end(random.nextBelow(width), random.nextBelow(height));
+
+                int copyCost, sameCost;
+                copy.build(start, end, copyCost);
+                same.build(start, end, sameCost);
+
+                if (copyCost != sameCost || copy.getExpansions() != same.getExpansions()) {
+                    std::cerr << "Mismatch with shared landmarks on grid " << g << " step "
+                              << step << " from " << start << " to " << end << ": cost "
+                              << copyCost << " in " << copy.getExpansions()
+                              << " expansions, expected " << sameCost << " in "
+                              << same.getExpansions() << std::endl;
+                    ++failures;
+                }
+            }
+        }
+
+        if (g % 10 != 0)
+            continue;
+
+        // Read back into landmarks picked afresh, which must then agree
+        Landmarks loaded(&astar.grid, 1 + g % 8, costs[0], costs[1], movement);
+        Landmarks otherCosts(&astar.grid, 1 + g % 8, costs[0] + 1, costs[1], movement);
+        bool ok = landmarks.save(file) && loaded.load(file) && !otherCosts.load(file) &&
+            loaded.count() == landmarks.count();
+
+        for (int i = 0; ok && i < 100; ++i) {
+            Point p(random.nextBelow(width), random.nextBelow(height));
+            Point q(random.nextBelow(width), random.nextBelow(height));
+            ok = loaded.lowerBound(p, q) == landmarks.lowerBound(p, q);
+        }
+
+        if (!ok) {
+            std::cerr << "Landmarks of grid " << g << " didn't survive " << file << std::endl;
+            ++failures;
+        }
+    }
+
+    std::remove(file.c_str());
+
+    std::cerr << "Checked " << queries << " AStar queries with landmarks against Dijkstra, "
+              << failures << " mismatches" << std::endl;
+
+    return failures;
+}
+
+/**
+ * Damage the database saved at `file`, of a grid `width` by `height`, one
+ * 32-bit word at a time and load it again, where it must either be refused
+ * or give paths that are chains of moves between the points asked for. Run
+ * under a sanitizer, this also shows lookups never read outside the file.
+ * Return the number of damaged files whose paths weren't
+ */
+static int checkDamagedDatabase(const std::string &file, int width, int height, Random &random)
+{
+    std::ifstream in(file.c_str(), std::ios::binary);
+    std::string bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    in.close();
+
+    int failures = 0;
+
+    for (int d = 0; d < 20; ++d) {
+        // All ones, zero or anything, anywhere, header included
+        uint32_t word = random.nextBelow(3) == 0 ? 0xFFFFFFFF :
+            random.nextBelow(2) ? 0 : (uint32_t)random.next();
+        std::string damaged = bytes;
+        std::memcpy(&damaged[4 * random.nextBelow(damaged.size() / 4)], &word, sizeof(word));
+
+        std::ofstream out(file.c_str(), std::ios::binary | std::ios::trunc);
+        out.write(damaged.data(), damaged.size());
+        out.close();
+
+        PathDatabase database;
+        if (!database.load(file))
+            continue;
+
+        for (int q = 0; q < 100; ++q) {
+            Point start(random.nextBelow(width), random.nextBelow(height));
+            Point end(random.nextBelow(width), random.nextBelow(height));
+            Path path = database.find(start, end);
+
+            bool ok = path.empty() || (path.front() == end && path.back() == start);
+            for (std::size_t i = 1; ok && i < path.size(); ++i)
+                ok = std::abs(path[i].getx() - path[i - 1].getx()) <= 1 &&
+                    std::abs(path[i].gety() - path[i - 1].gety()) <= 1;
+
+            if (!ok) {
+                std::cerr << "Damaged database gave a broken path from " << start << " to "
+                          << end << std::endl;
+                ++failures;
+                break;
+            }
+        }
+    }
+
+    return failures;
+}
+
+/**
+ * Check that paths from PathDatabase, built on two threads, are exactly as
+ * cheap as Dijkstra's on random grids, that the database mapped back in
+ * from its file gives the same first moves, and that damaged files are
+ * refused or still safe to use. Return the number of mismatches
+ */
+static int checkPathDatabase()
+{
+    Random random(seed + 3);
+    int failures = 0;
+    int queries = 0;
+
+    std::string file = "database_check.tmp";
+
+    // Including diagonals cheaper than straight steps
+    static const int moveCosts[][2] = { { 10, 14 }, { 1, 1 }, { 2, 3 }, { 5, 12 }, { 10, 5 } };
+
+    for (int g = 0; g < 40; ++g) {
+        int width = 2 + random.nextBelow(30);
+        int height = 2 + random.nextBelow(30);
+
+        Grid grid(width, height);
+        generateRandomFill(grid, random.nextDouble() * 0.45, random);
+        if (g % 2 == 1)
+            for (int y = 0; y < height; ++y)
+                for (int x = 0; x < width; ++x)
+                    grid.setCost(Point(x, y), 1 + random.nextBelow(9));
+
+        const int *costs = moveCosts[g % 5];
+        Movement movement = (Movement)((g / 4) % 4);
+
+        AStar astar(grid);
+        Dijkstra dijkstra(grid);
+        astar.setCardinalCost(costs[0]);
+        astar.setDiagonalCost(costs[1]);
+        dijkstra.setCardinalCost(costs[0]);
+        dijkstra.setDiagonalCost(costs[1]);
+        dijkstra.setMovement(movement);
+
+        PathDatabase database;
+        bool ok = database.build(grid, costs[0], costs[1], movement, 2) &&
+            database.matches(grid, costs[0], costs[1], movement);
+
+        for (int q = 0; ok && q < 50; ++q, ++queries) {
+            Point start(random.nextBelow(width), random.nextBelow(height));
+            Point end(random.nextBelow(width), random.nextBelow(height));
+
+            int oracleCost;
+            Path path = database.find(start, end);
+            dijkstra.build(start, end, oracleCost);
+
+            if (oracleCost == -1)
+                ok = path.empty();
+            else
+                ok = validPath(grid, path, start, end, movement) &&
+                    astar.pathCost(path) == oracleCost;
+
+            if (!ok)
+                std::cerr << "Mismatch on database for grid " << g << " from " << start
+                          << " to " << end << ": path cost " << astar.pathCost(path)
+                          << ", Dijkstra cost " << oracleCost << std::endl;
+        }
+
+        if (ok && g % 8 == 0) {
+            PathDatabase loaded;
+            ok = database.save(file) && loaded.load(file) &&
+                loaded.matches(grid, costs[0], costs[1], movement) &&
+                loaded.getBytes() == database.getBytes();
+
+            for (int i = 0; ok && i < 100; ++i) {
+                Point p(random.nextBelow(width), random.nextBelow(height));
+                Point q(random.nextBelow(width), random.nextBelow(height));
+                ok = loaded.firstMove(p, q) == database.firstMove(p, q);
+            }
+
+            // Any change to the grid makes it stale
+            grid.setSquare(Point(0, 0), grid.getSquare(Point(0, 0)) == FULL ? EMPTY : FULL);
+            ok = ok && !loaded.matches(grid, costs[0], costs[1], movement);
+
+            if (!ok)
+                std::cerr << "Database of grid " << g << " didn't survive " << file << std::endl;
+        }
+
+        if (ok && g % 8 == 0)
+            ok = checkDamagedDatabase(file, width, height, random) == 0;
+
+        if (!ok)
+            ++failures;
+    }
+
+    std::remove(file.c_str());
+
+    std::cerr << "Checked " << queries << " PathDatabase queries against Dijkstra, "
+              << failures << " mismatches" << std::endl;
+
+    return failures;
+}
+
+/**
+ * Check that searches run a slice at a time by SearchScheduler, with small
+ * budgets, find paths as cheap as AStar.build, that each running task gets
+ * the same share of a budget, and that partial paths are valid. Return the
+ * number of mismatches
+ */
+static int checkSearchScheduler()
+{
+    Random random(seed + 4);
+    int failures = 0;
+    int queries = 0;
+
+    const long slice = 16;
+
+    for (int g = 0; g < 40; ++g) {
+        int width = 10 + random.nextBelow(50);
+        int height = 10 + random.nextBelow(50);
+
+        Grid grid(width, height);
+        generateRandomFill(grid, random.nextDouble() * 0.4, random);
+        if (g % 2 == 1)
+            for (int i = 0; i < width * height / 4; ++i)
+                grid.setCost(randomEmptyPoint(grid, random), 1 + random.nextBelow(9));
+
+        Movement movement = (Movement)(g % 4);
+        AStar astar(grid);
+        astar.setMovement(movement);
+
+        SearchScheduler scheduler(slice);
+        std::vector<Point> starts, ends;
+        std::map<int, int> queryOf;
+
+        for (int q = 0; q < 20; ++q) {
+            starts.push_back(Point(random.nextBelow(width), random.nextBelow(height)));
+            ends.push_back(Point(random.nextBelow(width), random.nextBelow(height)));
+            queryOf[scheduler.add(astar.startSearch(starts.back(), ends.back()))] = q;
+        }
+
+        // A budget of one slice per running task gives each at least a slice,
+        // more where others finish early
+        std::vector<int> before;
+        std::vector<int> ids;
+        for (std::map<int, int>::iterator i = queryOf.begin(); i != queryOf.end(); ++i)
+            if (scheduler.get(i->first)->getStatus() == SEARCH_RUNNING) {
+                ids.push_back(i->first);
+                before.push_back(scheduler.get(i->first)->getExpansions());
+            }
+
+        scheduler.step(slice * ids.size());
+        for (std::size_t i = 0; i < ids.size(); ++i) {
+            SearchTask *task = scheduler.get(ids[i]);
+            if (task->getStatus() == SEARCH_RUNNING && task->getExpansions() - before[i] < slice) {
+                std::cerr << "Unfair turn on grid " << g << ": " << task->getExpansions()
+                          << " expansions" << std::endl;
+                ++failures;
+            }
+        }
+
+        while (scheduler.getRunningCount() > 0) {
+            // Partial paths lead from the start to somewhere reached
+            for (std::map<int, int>::iterator i = queryOf.begin(); i != queryOf.end(); ++i) {
+                SearchTask *task = scheduler.get(i->first);
+                Path best = task->getBestPath();
+                if (task->getStatus() == SEARCH_RUNNING &&
+                    !validPath(grid, best, starts[i->second], best.front(), movement)) {
+                    std::cerr << "Invalid partial path on grid " << g << std::endl;
+                    ++failures;
+                }
+            }
+
+            scheduler.step(1 + random.nextBelow(100));
+        }
+
+        for (std::map<int, int>::iterator i = queryOf.begin(); i != queryOf.end(); ++i) {
+            const Point &start = starts[i->second], &end = ends[i->second];
+            SearchTask *task = scheduler.get(i->first);
+            ++queries;
+
+            int cost;
+            astar.build(start, end, cost);
+
+            bool ok = task->getCost() == cost;
+            if (ok && cost != -1)
+                ok = task->getStatus() == SEARCH_FOUND &&
+                    validPath(grid, task->getPath(), start, end, movement) &&
+                    astar.pathCost(task->getPath()) == cost;
+
+            if (!ok) {
+                std::cerr << "Mismatch on scheduled search of grid " << g << " from " << start
+                          << " to " << end << ": task cost " << task->getCost()
+                          << ", AStar cost " << cost << std::endl;
+                ++failures;
+            }
+
+            scheduler.remove(i->first);
+        }
+    }
+
+    std::cerr << "Checked " << queries << " scheduled searches against AStar, "
+              << failures << " mismatches" << std::endl;
+
+    return failures;
+}
+
+/**
+ * Compare AStar for an agent `size` squares across, under movement rule `M`,
+ * with BasicAStar testing every square under the agent, on random queries.
+ * Return the number of mismatches
+ */
+template <Movement M>
+static int checkSizedQueries(AStar &astar, int size, Random &random, int &queries)
+{
+    const Grid &grid = astar.grid;
+    FootprintGrid footprint(&grid, size);
+    BasicAStar<FootprintGrid, OctileHeuristic<int>, int, MovePolicy<M> > search(&footprint);
+    int failures = 0;
+
+    astar.setMovement(M);
+
+    for (int q = 0; q < 10; ++q) {
+        Point start = randomEmptyPoint(grid, random);
+        Point end = randomEmptyPoint(grid, random);
+        ++queries;
+
+        int astarCost, footprintCost;
+        Path path = astar.build(start, end, astarCost);
+        search.search(start, end, footprintCost);
+
+        bool ok = astarCost == footprintCost;
+        for (std::size_t i = 0; ok && i < path.size(); ++i)
+            ok = footprint.getSquare(path[i]) == EMPTY;
+
+        if (!ok || (astarCost != -1 && !validPath(grid, path, start, end, M))) {
+            std::cerr << "Mismatch for an agent of size " << size << " from " << start
+                      << " to " << end << ": AStar cost " << astarCost << ", footprint cost "
+                      << footprintCost << std::endl;
+            ++failures;
+        }
+    }
+
+    return failures;
+}
+
+/**
+ * Check that Clearance matches the biggest square that fits at each point,
+ * and the most expensive square under agents there, tested square by square,
+ * on random grids and as they change, and that
+ * AStar for bigger agents finds paths as cheap as a search testing every
+ * square under the agent. Return the number of mismatches
+ */
+static int checkClearance()
+{
+    Random random(seed + 6);
+    int failures = 0;
+    int squares = 0;
+    int queries = 0;
+
+    for (int g = 0; g < 30; ++g) {
+        int width = 5 + random.nextBelow(80);
+        int height = 5 + random.nextBelow(80);
+
+        Grid grid(width, height);
+        generateRandomFill(grid, random.nextDouble() * 0.3, random);
+        if (g % 2 == 1)
+            for (int i = 0; i < width * height / 8; ++i)
+                grid.setCost(randomEmptyPoint(grid, random), 1 + random.nextBelow(9));
+
+        static const int maxClearances[] = { 2, 4, 16 };
+        int maxClearance = maxClearances[g % 3];
+
+        AStar astar(grid);
+        Clearance clearance(&astar.grid, maxClearance);
+
+        for (int round = 0; round < 10; ++round) {
+            int mismatches = 0;
+            for (int y = 0; y < height; ++y)
+                for (int x = 0; x < width; ++x) {
+                    int expected = 0;
+                    while (expected < maxClearance &&
+                           FootprintGrid(&astar.grid, expected + 1).getSquare(Point(x, y)) == EMPTY)
+                        ++expected;
+
+                    mismatches += clearance.get(Point(x, y)) != expected;
+                    ++squares;
+
+                    // And the most expensive square under agents of a few sizes
+                    static const int sizes[] = { 2, 3, 16 };
+                    for (int i = 0; i < 3 && sizes[i] <= maxClearance; ++i)
+                        mismatches += clearance.getCost(Point(x, y), sizes[i]) !=
+                            FootprintGrid(&astar.grid, sizes[i]).getCost(Point(x, y));
+                }
+
+            if (mismatches) {
+                std::cerr << mismatches << " squares with the wrong clearance or cost on grid " << g
+                          << " after round " << round << std::endl;
+                failures += mismatches;
+            }
+
+            for (int size = 2; size <= 3; ++size) {
+                if (astar.setAgentSize(size, &clearance) != (size <= maxClearance)) {
+                    std::cerr << "Agent size " << size << " taken for clearance up to "
+                              << maxClearance << std::endl;
+                    ++failures;
+                } else if (size <= maxClearance) {
+                    failures += g % 2 ?
+                        checkSizedQueries<NO_CORNER_CUTTING>(astar, size, random, queries) :
+                        checkSizedQueries<EIGHT_CONNECTED>(astar, size, random, queries);
+                }
+            }
+            astar.setAgentSize(1, 0);
+
+            int edits = 1 + random.nextBelow(20);
+            for (int e = 0; e < edits; ++e) {
+                Point p(random.nextBelow(width), random.nextBelow(height));
+                if (random.nextBelow(4) == 0)
+                    astar.grid.fillRect(p.getx(), p.gety(), 1 + random.nextBelow(4),
+                                        1 + random.nextBelow(4), random.nextBelow(2) ? FULL : EMPTY);
+                else if (random.nextBelow(3) == 0)
+                    astar.grid.setCost(p, 1 + random.nextBelow(9));
+                else
+                    astar.grid.setSquare(p, random.nextBelow(2) ? FULL : EMPTY);
+            }
+        }
+    }
+
+    std::cerr << "Checked the clearance of " << squares << " squares and " << queries
+              << " queries for bigger agents, " << failures << " mismatches" << std::endl;
+
+    return failures;
+}
+
+/**
+ * Return 1 if `grid` counts its EMPTY squares wrong, plus the number of FULL
+ * squares getEmptyPoint() returns
+ */
+static int checkEmptySquares(const Grid &grid, Random &random)
+{
+    int empty = 0;
+    for (int y = 0; y < grid.getHeight(); ++y)
+        for (int x = 0; x < grid.getWidth(); ++x)
+            empty += grid.getSquare(Point(x, y)) == EMPTY;
+
+    int mismatches = grid.countEmpty() != empty;
+
+    for (int i = 0; i < 50; ++i) {
+        Point p = grid.getEmptyPoint(random);
+        mismatches += empty ? grid.getSquare(p) == FULL : p != Point(-1, -1);
+    }
+
+    return mismatches;
+}
+
+/**
+ * Check that the index of EMPTY squares follows every kind of change to a
+ * grid, that sampling from it is uniform, that getNearestEmpty() finds a
+ * square as near as the nearest found square by square, and that AStar
+ * snapping to it finds paths as cheap as searching from the snapped points.
+ * Return the number of mismatches
+ */
+static int checkEmptyIndex()
+{
+    Random random(seed + 7);
+    int failures = 0;
+    int nearest = 0;
+    int queries = 0;
+
+    for (int g = 0; g < 30; ++g) {
+        int width = 1 + random.nextBelow(90);
+        int height = 1 + random.nextBelow(90);
+
+        Grid grid(width, height);
+        generateRandomFill(grid, random.nextDouble() * 0.95, random);
+
+        for (int round = 0; round < 10; ++round) {
+            // A copy takes the index too, so the same changes to it, even
+            // random ones, must leave it the same as the grid
+            Grid copy = grid;
+            Random populateRandom(random.next()), copyRandom = populateRandom;
+
+            switch (random.nextBelow(8)) {
+            case 0:
+                grid.clear();
+                copy.clear();
+                break;
+            case 1: {
+                int x = random.nextBelow(width), y = random.nextBelow(height);
+                int w = 1 + random.nextBelow(10), h = 1 + random.nextBelow(10);
+                Square s = random.nextBelow(2) ? FULL : EMPTY;
+                grid.fillRect(x, y, w, h, s);
+                copy.fillRect(x, y, w, h, s);
+                break;
+            }
+            case 2:
+                grid.invert();
+                copy.invert();
+                break;
+            case 3: {
+                int n = random.nextBelow(width * height / 2 + 1);
+                grid.populate(n, populateRandom);
+                copy.populate(n, copyRandom);
+                break;
+            }
+            case 4: {
+                Grid source(1 + random.nextBelow(width), 1 + random.nextBelow(height));
+                generateRandomFill(source, random.nextDouble(), random);
+                int x = random.nextBelow(width), y = random.nextBelow(height);
+                grid.copyRegion(source, 0, 0, source.getWidth(), source.getHeight(), x, y);
+                copy.copyRegion(source, 0, 0, source.getWidth(), source.getHeight(), x, y);
+                break;
+            }
+            default: {
+                int edits = 1 + random.nextBelow(width * height / 4 + 1);
+                for (int e = 0; e < edits; ++e) {
+                    Point p(random.nextBelow(width + 2) - 1, random.nextBelow(height + 2) - 1);
+                    Square s = random.nextBelow(2) ? FULL : EMPTY;
+                    grid.setSquare(p, s);
+                    copy.setSquare(p, s);
+                }
+                break;
+            }
+            }
+
+            Random copySamples = random;
+            int mismatches = checkEmptySquares(grid, random) + checkEmptySquares(copy, copySamples);
+            if (grid.toString() != copy.toString() ||
+                grid.getEmptyPoint(random) != copy.getEmptyPoint(copySamples))
+                ++mismatches;
+
+            if (mismatches) {
+                std::cerr << mismatches << " mismatches in the EMPTY squares of grid " << g
+                          << " after round " << round << std::endl;
+                failures += mismatches;
+            }
+
+            for (int q = 0; q < 10; ++q) {
+                Point p(random.nextBelow(width + 10) - 5, random.nextBelow(height + 10) - 5);
+                Point found = grid.getNearestEmpty(p);
+                ++nearest;
+
+                long best = -1;
+                for (int y = 0; y < height; ++y)
+                    for (int x = 0; x < width; ++x) {
+                        long dx = x - p.getx(), dy = y - p.gety();
+                        if (grid.getSquare(Point(x, y)) == EMPTY &&
+                            (best == -1 || dx * dx + dy * dy < best))
+                            best = dx * dx + dy * dy;
+                    }
+
+                long dx = found.getx() - p.getx(), dy = found.gety() - p.gety();
+                if (best == -1 ? found != Point(-1, -1) :
+                    grid.getSquare(found) == FULL || dx * dx + dy * dy != best) {
+                    std::cerr << "Nearest EMPTY square to " << p << " on grid " << g
+                              << " found at " << found << std::endl;
+                    ++failures;
+                }
+            }
+        }
+
+        if (grid.countEmpty() == 0)
+            continue;
+
+        AStar snapping(grid), plain(grid);
+        snapping.setSnapToEmpty(true);
+
+        for (int q = 0; q < 10; ++q) {
+            Point start(random.nextBelow(width), random.nextBelow(height));
+            Point end(random.nextBelow(width), random.nextBelow(height));
+            Point snappedStart = grid.getNearestEmpty(start);
+            Point snappedEnd = grid.getNearestEmpty(end);
+            ++queries;
+
+            int snappingCost, plainCost, unsnappedCost;
+            Path path = snapping.build(start, end, snappingCost);
+            plain.build(snappedStart, snappedEnd, plainCost);
+            plain.build(start, end, unsnappedCost);
+
+            bool blocked = grid.getSquare(start) == FULL || grid.getSquare(end) == FULL;
+            if (snappingCost != plainCost || (blocked && unsnappedCost != -1) ||
+                (snappingCost != -1 &&
+                 !validPath(grid, path, snappedStart, snappedEnd, EIGHT_CONNECTED))) {
+                std::cerr << "Mismatch snapping on grid " << g << " from " << start << " to "
+                          << end << ": cost " << snappingCost << ", from the nearest EMPTY "
+                          << "squares " << plainCost << std::endl;
+                ++failures;
+            }
+
+            // Waypoints snap the same way, so a blocked one is passed
+            // through at its nearest EMPTY square rather than failing
+            Point via(random.nextBelow(width), random.nextBelow(height));
+            Point snappedVia = grid.getNearestEmpty(via);
+
+            std::vector<Point> waypoints;
+            waypoints.push_back(start);
+            waypoints.push_back(via);
+            waypoints.push_back(end);
+
+            int firstCost, secondCost;
+            plain.build(snappedStart, snappedVia, firstCost);
+            plain.build(snappedVia, snappedEnd, secondCost);
+            bool reachable = firstCost != -1 && secondCost != -1;
+
+            if (snapping.buildFromWaypoints(waypoints).empty() == reachable ||
+                snapping.buildWithHeuristic(waypoints).empty() == reachable) {
+                std::cerr << "Mismatch snapping waypoints on grid " << g << " from " << start
+                          << " through " << via << " to " << end << ": expected "
+                          << (reachable ? "a path" : "none") << std::endl;
+                ++failures;
+            }
+        }
+    }
+
+    // Every EMPTY square of a small grid should come up as often as the others
+    Grid grid(8, 8);
+    grid.populate(54, random);
+
+    std::map<Point, int> counts;
+    for (int i = 0; i < 10000; ++i)
+        ++counts[grid.getEmptyPoint(random)];
+
+    for (std::map<Point, int>::const_iterator i = counts.begin(); i != counts.end(); ++i)
+        if (grid.getSquare(i->first) == FULL || i->second < 850 || i->second > 1150) {
+            std::cerr << "Square " << i->first << " sampled " << i->second
+                      << " times in 10000 from 10" << std::endl;
+            ++failures;
+        }
+    failures += counts.size() != 10;
+
+    std::cerr << "Checked the EMPTY squares of 30 grids, " << nearest << " nearest EMPTY "
+              << "squares and " << queries << " snapped queries, " << failures
+              << " mismatches" << std::endl;
+
+    return failures;
+}
+
+#if __cplusplus >= 201103L
+/**
+ * Return true if `snapshot` has the same squares and costs as `grid`
+ */
+static bool sameSquares(const GridSnapshot &snapshot, const Grid &grid)
+{
+    for (int y = 0; y < grid.getHeight(); ++y)
+        for (int x = 0; x < grid.getWidth(); ++x)
+            if (snapshot.getSquare(Point(x, y)) != grid.getSquare(Point(x, y)) ||
+                snapshot.getCost(Point(x, y)) != grid.getCost(Point(x, y)))
+                return false;
+
+    return snapshot.getMinCost() == grid.getMinCost();
+}
+
+/* What the threads of the SharedGrid stress check share */
+struct SharedGridStress {
+    SharedGridStress(const Grid &grid) : shared(grid), full(grid.countFull()), writing(true),
+                                         failures(0), pins(0) { }
+
+    SharedGrid shared;
+    int full;
+    std::atomic<bool> writing;
+    std::atomic<int> failures;
+    std::atomic<long> pins;
+};
+
+/**
+ * Move walls about, keeping the number of FULL squares the same in every
+ * version, publishing `versions` versions
+ */
+static void stressWriter(SharedGridStress &stress, Grid grid, int versions, Random random)
+{
+    // Give every reader time to start, even on one core
+    while (stress.pins < 3)
+        std::this_thread::yield();
+
+    for (int v = 0; v < versions; ++v) {
+        int moves = 1 + random.nextBelow(8);
+        for (int m = 0; m < moves; ++m) {
+            Point from, to = randomEmptyPoint(grid, random);
+            do {
+                from = Point(random.nextBelow(grid.getWidth()), random.nextBelow(grid.getHeight()));
+            } while (grid.getSquare(from) == EMPTY);
+
+            grid.setSquare(from, EMPTY);
+            grid.setSquare(to, FULL);
+            stress.shared.setSquare(from, EMPTY);
+            stress.shared.setSquare(to, FULL);
+        }
+
+        stress.shared.publish();
+    }
+
+    stress.writing = false;
+}
+
+/**
+ * Pin versions while the writer runs, checking each has all its walls and
+ * searching some of them
+ */
+static void stressReader(SharedGridStress &stress, Random random)
+{
+    SnapshotReader reader(stress.shared);
+    BasicAStar<GridSnapshot, OctileHeuristic<int>, int, MovePolicy<EIGHT_CONNECTED> >
+        search(&reader.getSnapshot());
+    unsigned long last = 0;
+
+    for (long pins = 0; stress.writing; ++pins) {
+        const GridSnapshot &snapshot = reader.pin();
+
+        int full = 0;
+        for (int y = 0; y < snapshot.getHeight(); ++y)
+            for (int x = 0; x < snapshot.getWidth(); ++x)
+                full += snapshot.getSquare(Point(x, y)) == FULL;
+
+        if (full != stress.full || snapshot.getVersion() < last) {
+            std::cerr << "Inconsistent snapshot " << snapshot.getVersion() << ": " << full
+                      << " FULL squares, not " << stress.full << std::endl;
+            ++stress.failures;
+        }
+        last = snapshot.getVersion();
+
+        if (pins % 8 == 0) {
+            int cost;
+            Point start(random.nextBelow(snapshot.getWidth()), random.nextBelow(snapshot.getHeight()));
+            Point end(random.nextBelow(snapshot.getWidth()), random.nextBelow(snapshot.getHeight()));
+            search.search(start, end, cost);
+        }
+
+        reader.unpin();
+        ++stress.pins;
+    }
+}
+
+/**
+ * Check that snapshots of a SharedGrid match a Grid given the same edits,
+ * that a pinned snapshot keeps its squares while later versions are
+ * published, and that BasicAStar finds paths on snapshots as cheap as AStar
+ * does on the Grid. Then change a SharedGrid from one thread while others
+ * pin and search it, checking every snapshot is a whole version, and that
+ * every old version is freed at the end. Run under ThreadSanitizer with
+ * `make tsan`. Return the number of mismatches
+ */
+static int checkSharedGrid()
+{
+    Random random(seed + 5);
+    int failures = 0;
+    int queries = 0;
+
+    for (int g = 0; g < 20; ++g) {
+        int width = 10 + random.nextBelow(200);
+        int height = 10 + random.nextBelow(150);
+
+        Grid grid(width, height);
+        generateRandomFill(grid, random.nextDouble() * 0.4, random);
+        if (g % 2 == 1)
+            for (int i = 0; i < width * height / 8; ++i)
+                grid.setCost(randomEmptyPoint(grid, random), 1 + random.nextBelow(9));
+
+        SharedGrid shared(grid);
+        SnapshotReader reader(shared), held(shared);
+        BasicAStar<GridSnapshot, OctileHeuristic<int>, int, MovePolicy<EIGHT_CONNECTED> >
+            search(&reader.getSnapshot());
+
+        for (int round = 0; round < 10; ++round) {
+            Grid before = grid;
+            held.pin();
+
+            int edits = 1 + random.nextBelow(50);
+            for (int e = 0; e < edits; ++e) {
+                Point p(random.nextBelow(width), random.nextBelow(height));
+                if (random.nextBelow(3) == 0) {
+                    uint8_t cost = random.nextBelow(10);
+                    grid.setCost(p, cost);
+                    shared.setCost(p, cost);
+                } else {
+                    Square s = random.nextBelow(2) ? FULL : EMPTY;
+                    grid.setSquare(p, s);
+                    shared.setSquare(p, s);
+                }
+            }
+            shared.publish();
+
+            if (!sameSquares(reader.pin(), grid) || !sameSquares(held.getSnapshot(), before)) {
+                std::cerr << "Snapshot of shared grid " << g << " differs after round "
+                          << round << std::endl;
+                ++failures;
+            }
+            held.unpin();
+
+            AStar astar(grid);
+            for (int q = 0; q < 5; ++q) {
+                Point start = randomEmptyPoint(grid, random);
+                Point end = randomEmptyPoint(grid, random);
+                ++queries;
+
+                int astarCost, snapshotCost;
+                astar.build(start, end, astarCost);
+                Path path = search.search(start, end, snapshotCost);
+
+                if (astarCost != snapshotCost ||
+                    (snapshotCost != -1 && !validPath(grid, path, start, end, EIGHT_CONNECTED))) {
+                    std::cerr << "Mismatch on shared grid " << g << " from " << start << " to "
+                              << end << ": AStar cost " << astarCost << ", snapshot cost "
+                              << snapshotCost << std::endl;
+                    ++failures;
+                }
+            }
+            reader.unpin();
+        }
+
+        shared.reclaim();
+        if (shared.getRetiredCount() != 0) {
+            std::cerr << "Shared grid " << g << " kept " << shared.getRetiredCount()
+                      << " old versions with nothing pinned" << std::endl;
+            ++failures;
+        }
+    }
+
+    Grid grid(150, 130);
+    generateRandomFill(grid, 0.3, random);
+    SharedGridStress stress(grid);
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 3; ++t)
+        threads.push_back(std::thread(stressReader, std::ref(stress), Random(random.next())));
+    threads.push_back(std::thread(stressWriter, std::ref(stress), grid, 2000,
+                                  Random(random.next())));
+
+    for (std::size_t t = 0; t < threads.size(); ++t)
+        threads[t].join();
+
+    stress.shared.reclaim();
+    if (stress.shared.getRetiredCount() != 0) {
+        std::cerr << "Shared grid kept " << stress.shared.getRetiredCount()
+                  << " old versions after its readers stopped" << std::endl;
+        ++stress.failures;
+    }
+    failures += stress.failures;
+
+    std::cerr << "Checked " << queries << " SharedGrid queries against AStar and "
+              << stress.pins << " snapshots pinned during " << stress.shared.getVersion() - 1
+              << " publishes, " << failures << " mismatches" << std::endl;
+
+    return failures;
+}
+#else
+static int checkSharedGrid()
+{
+    return 0;
+}
+#endif
+
+static void add(std::vector<Benchmark> &benchmarks, const std::string &name,
+                BenchFunction run, Family family, int size)
+{
+    std::stringstream ss;
+    ss << name << "/" << familyNames[family] << "/" << size;
+
+    Benchmark benchmark;
+    benchmark.name = ss.str();
+    benchmark.run = run;
+    benchmark.family = family;
+    benchmark.size = size;
+    benchmarks.push_back(benchmark);
+}
+
+static std::vector<Benchmark> registerBenchmarks()
+{
+    std::vector<Benchmark> benchmarks;
+
+    static const int gridSizes[] = { 64, 256, 1024 };
+    for (int i = 0; i < 3; ++i) {
+        add(benchmarks, "Grid.getSquare", benchGetSquare, RANDOM_MAP, gridSizes[i]);
+        add(benchmarks, "Grid.setSquare", benchSetSquare, EMPTY_MAP, gridSizes[i]);
+        add(benchmarks, "Grid.getEmptyNeighbours", benchGetEmptyNeighbours,
+            RANDOM_MAP, gridSizes[i]);
+        add(benchmarks, "Grid.clear", benchClear, RANDOM_MAP, gridSizes[i]);
+        add(benchmarks, "Grid.populate", benchPopulate, EMPTY_MAP, gridSizes[i]);
+        add(benchmarks, "Grid.countFull", benchCountFull, RANDOM_MAP, gridSizes[i]);
+    }
+
+    add(benchmarks, "Grid.getEmptyPoint", benchGetEmptyPoint, RANDOM_MAP, 1024);
+    add(benchmarks, "Grid.getEmptyPoint.rejection", benchGetEmptyPointRejection,
+        RANDOM_MAP, 1024);
+    for (int f = RANDOM_MAP; f <= CAVES_MAP; ++f)
+        add(benchmarks, "Grid.getNearestEmpty", benchGetNearestEmpty, (Family)f, 256);
+
+    static const int searchSizes[] = { 32, 64, 128 };
+    for (int f = EMPTY_MAP; f <= CAVES_MAP; ++f)
+        for (int i = 0; i < 3; ++i)
+            add(benchmarks, "AStar.build", benchAStar, (Family)f, searchSizes[i]);
+
+    for (int f = RANDOM_MAP; f <= CAVES_MAP; ++f) {
+        add(benchmarks, "AStar.build.landmarks", benchAStarLandmarks, (Family)f, 64);
+        add(benchmarks, "AStar.build.landmarks", benchAStarLandmarks, (Family)f, 128);
+    }
+
+    for (int f = RANDOM_MAP; f <= CAVES_MAP; ++f) {
+        add(benchmarks, "AStar.build.fourConnected", benchAStarMovement<FOUR_CONNECTED>,
+            (Family)f, 64);
+        add(benchmarks, "AStar.build.noCornerCutting", benchAStarMovement<NO_CORNER_CUTTING>,
+            (Family)f, 64);
+        add(benchmarks, "AStar.build.noSqueezing", benchAStarMovement<NO_SQUEEZING>,
+            (Family)f, 64);
+    }
+
+    for (int f = ROOMS_MAP; f <= CAVES_MAP; ++f) {
+        add(benchmarks, "AStar.build.agent3", benchAStarSized, (Family)f, 64);
+        add(benchmarks, "BasicAStar.search.footprint3", benchFootprintSearch, (Family)f, 64);
+    }
+    add(benchmarks, "Clearance.update", benchClearanceUpdate, CAVES_MAP, 512);
+
+    for (int f = RANDOM_MAP; f <= CAVES_MAP; ++f) {
+        add(benchmarks, "BasicAStar.search.int16", benchBasicAStar<int16_t>, (Family)f, 64);
+        add(benchmarks, "BasicAStar.search.int32", benchBasicAStar<int32_t>, (Family)f, 64);
+        add(benchmarks, "BasicAStar.search.float", benchBasicAStar<float>, (Family)f, 64);
+    }
+
+    for (int f = RANDOM_MAP; f <= CAVES_MAP; ++f)
+        add(benchmarks, "SearchScheduler.step", benchSearchScheduler, (Family)f, 64);
+
+    for (int f = RANDOM_MAP; f <= CAVES_MAP; ++f) {
+        add(benchmarks, "PathDatabase.find", benchPathDatabaseFind, (Family)f, 64);
+        add(benchmarks, "PathDatabase.build", benchPathDatabaseBuild, (Family)f, 32);
+    }
+
+    for (int f = RANDOM_MAP; f <= CAVES_MAP; ++f)
+        add(benchmarks, "ChunkedGrid.search", benchChunkedGrid, (Family)f, 64);
+    add(benchmarks, "ChunkedGrid.search.sparse", benchChunkedGridSparse, EMPTY_MAP, 1000000);
+
+#if __cplusplus >= 201103L
+    for (int f = RANDOM_MAP; f <= CAVES_MAP; ++f)
+        add(benchmarks, "SharedGrid.search", benchSharedGridSearch, (Family)f, 64);
+    add(benchmarks, "SharedGrid.publish", benchSharedGridPublish, RANDOM_MAP, 512);
+#endif
+
+    for (int f = EMPTY_MAP; f <= CAVES_MAP; ++f)
+        add(benchmarks, "Dijkstra.build", benchDijkstra, (Family)f, 64);
+
+    for (int f = RANDOM_MAP; f <= CAVES_MAP; ++f) {
+        add(benchmarks, "PathFinder.buildFromWaypoints", benchWaypoints, (Family)f, 64);
+        add(benchmarks, "PathFinder.buildWithHeuristic", benchWaypointsHeuristic,
+            (Family)f, 64);
+    }
+
+    for (int f = EMPTY_MAP; f <= CAVES_MAP; ++f) {
+        add(benchmarks, "MultiAgentPlanner.plan", benchMultiAgentPlan, (Family)f, 64);
+        add(benchmarks, "MultiAgentPlanner.planWindow", benchMultiAgentWindow, (Family)f, 64);
+        add(benchmarks, "MultiAgentPlanner.planConflictBased", benchMultiAgentConflictBased,
+            (Family)f, 32);
+    }
+
+    return benchmarks;
+}
+
+/**
+ * Escape `s` for use inside a JSON string
+ */
+static std::string jsonEscape(const std::string &s)
+{
+    std::string escaped;
+    for (std::size_t i = 0; i < s.size(); ++i) {
+        if (s[i] == '"' || s[i] == '\\')
+            escaped += '\\';
+        escaped += s[i];
+    }
+    return escaped;
+}
+
+int main(int argc, char **argv)
+{
+    std::string filter;
+    std::string out;
+    double minTime = 0.5;
+    bool checkOnly = false;
+
+    for (int i = 1; i < argc; ++i) {
+        if (!std::strcmp(argv[i], "--check"))
+            checkOnly = true;
+        else if (!std::strcmp(argv[i], "--filter") && i + 1 < argc)
+            filter = argv[++i];
+        else if (!std::strcmp(argv[i], "--min-time") && i + 1 < argc)
+            minTime = std::atof(argv[++i]);
+        else if (!std::strcmp(argv[i], "--out") && i + 1 < argc)
+            out = argv[++i];
+        else {
+            std::cerr << "Usage: " << argv[0]
+                      << " [--filter substring] [--min-time seconds] [--out file] | --check"
+                      << std::endl;
+            return 1;
+        }
+    }
+
+    if (checkPathCache() != 0 || checkComponents() != 0 || checkGridKernels() != 0 ||
+        checkMapGenerators() != 0 || checkMapFile() != 0 || checkQueryParsing() != 0 ||
+        checkQueryServer() != 0 || checkSearchTrace() != 0 || checkAgainstOracle() != 0 ||
+        checkMultiAgent() != 0 || checkChunkedGrid() != 0 || checkLandmarks() != 0 ||
+        checkPathDatabase() != 0 || checkSearchScheduler() != 0 || checkClearance() != 0 ||
+        checkEmptyIndex() != 0 || checkSharedGrid() != 0)
+        return 1;
+
+    if (checkOnly)
+        return 0;
+
+    std::ofstream file;
+    if (!out.empty())
+        file.open(out.c_str());
+    std::ostream &os = out.empty() ? std::cout : file;
+
+    std::vector<Benchmark> benchmarks = registerBenchmarks();
+    PerfCounters counters;
+
+    time_t date = std::time(0);
+    char dateString[64];
+    std::strftime(dateString, sizeof(dateString), "%Y-%m-%dT%H:%M:%S", std::gmtime(&date));
+
+    os << "{\n  \"context\": {\n"
+       << "    \"date\": \"" << dateString << "\",\n"
+       << "    \"seed\": " << seed << ",\n"
+       << "    \"min_time_s\": " << minTime << "\n"
+       << "  },\n  \"benchmarks\": [";
+
+    bool first = true;
+    for (std::size_t b = 0; b < benchmarks.size(); ++b) {
+        const Benchmark &benchmark = benchmarks[b];
+
+        if (benchmark.name.find(filter) == std::string::npos)
+            continue;
+
+        resetPeakMemory();
+
+        // Grow the iteration count until the run takes long enough to trust
+        int iterations = 1;
+        BenchState state(iterations, benchmark.family, benchmark.size, &counters);
+        for (;;) {
+            state = BenchState(iterations, benchmark.family, benchmark.size, &counters);
+            benchmark.run(state);
+
+            if (state.getElapsed() >= minTime * 1e9 || iterations >= 1000000000 / 10)
+                break;
+
+            // Aim a little past the minimum time, growing at most tenfold
+            double perIteration = state.getElapsed() / iterations;
+            double target = perIteration > 0 ? 1.4 * minTime * 1e9 / perIteration : 10.0 * iterations;
+            iterations = (int)std::min(std::max(target, iterations + 1.0), 10.0 * iterations);
+        }
+
+        double instructions = counters.read(PerfCounters::INSTRUCTIONS);
+        double cacheMisses = counters.read(PerfCounters::CACHE_MISSES);
+        double l1dMisses = counters.read(PerfCounters::L1D_MISSES);
+
+        std::cerr << benchmark.name << ": " << state.getElapsed() / iterations << " ns/op";
+        if (cacheMisses >= 0)
+            std::cerr << ", " << cacheMisses / iterations << " cache misses/op";
+        if (l1dMisses >= 0)
+            std::cerr << ", " << l1dMisses / iterations << " L1d misses/op";
+        std::cerr << std::endl;
+
+        os << (first ? "\n" : ",\n")
+           << "    {\"name\": \"" << jsonEscape(benchmark.name) << "\", "
+           << "\"iterations\": " << iterations << ", "
+           << "\"ns_per_op\": " << state.getElapsed() / iterations << ", "
+           << "\"expansions_per_op\": " << state.expansions / iterations << ", ";
+        if (instructions >= 0)
+            os << "\"instructions_per_op\": " << instructions / iterations << ", ";
+        if (cacheMisses >= 0)
+            os << "\"cache_misses_per_op\": " << cacheMisses / iterations << ", ";
+        if (l1dMisses >= 0)
+            os << "\"l1d_misses_per_op\": " << l1dMisses / iterations << ", ";
+        os << "\"peak_memory_kb\": " << peakMemory() << "}";
+        first = false;
+    }
+
+    os << "\n  ]\n}\n";
+
+    return 0;
+}
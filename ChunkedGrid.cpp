@@ -0,0 +1,410 @@
+#include "ChunkedGrid.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "GridKernels.h"
+
+const int ChunkedGrid::chunkBits;
+const int ChunkedGrid::chunkSize;
+const int ChunkedGrid::squaresPerChunk;
+
+ChunkIndex::ChunkIndex() : keys(64), values(64, -1), count(0)
+{
+}
+
+void ChunkIndex::insert(int cx, int cy, int value)
+{
+    if (2 * (count + 1) > keys.size()) {
+        // Double the slots and insert everything again
+        std::vector<uint64_t> oldKeys(keys.size() * 2);
+        std::vector<int> oldValues(values.size() * 2, -1);
+        oldKeys.swap(keys);
+        oldValues.swap(values);
+
+        for (std::size_t i = 0; i < oldKeys.size(); ++i)
+            if (oldValues[i] != -1) {
+                std::size_t j = slot(oldKeys[i]);
+                while (values[j] != -1)
+                    j = (j + 1) & (keys.size() - 1);
+
+                keys[j] = oldKeys[i];
+                values[j] = oldValues[i];
+            }
+    }
+
+    uint64_t key = makeKey(cx, cy);
+    std::size_t i = slot(key);
+    while (values[i] != -1)
+        i = (i + 1) & (keys.size() - 1);
+
+    keys[i] = key;
+    values[i] = value;
+    ++count;
+}
+
+void ChunkIndex::clear()
+{
+    if (count == 0)
+        return;
+
+    values.assign(values.size(), -1);
+    count = 0;
+}
+
+/* Bytes per chunk in the page file: a flags byte, the rows, then the costs */
+static const long recordBytes = 1 + ChunkedGrid::chunkSize * sizeof(uint64_t) +
+    ChunkedGrid::chunkSize * ChunkedGrid::chunkSize;
+
+static const char hasBits = 1;
+static const char hasCosts = 2;
+
+ChunkedGrid::ChunkedGrid(Square background)
+    : background(background), bounded(false), minX(0), minY(0), maxX(0), maxY(0),
+      resident(0), clock(0), mixed(0), nextFileRecord(0), version(0)
+{
+}
+
+void ChunkedGrid::setSquare(Point p, Square s)
+{
+    if (bounded && !inBounds(p))
+        return;
+
+    Chunk &c = chunkAt(chunkOf(p.getx()), chunkOf(p.gety()));
+    if (c.bits.empty()) {
+        if (c.uniform == s)
+            return;
+
+        makeMixed(c);
+    }
+
+    uint64_t &row = c.bits[p.gety() & (chunkSize - 1)];
+    uint64_t bit = (uint64_t)1 << (p.getx() & (chunkSize - 1));
+
+    if (((row & bit) != 0) == (s == FULL))
+        return;
+
+    if (s == FULL) {
+        row |= bit;
+        ++c.nFull;
+    } else {
+        row &= ~bit;
+        --c.nFull;
+    }
+
+    ++version;
+    collapse(c);
+}
+
+void ChunkedGrid::setCost(Point p, uint8_t cost)
+{
+    if (cost == 0)
+        cost = 1;
+
+    if (bounded && !inBounds(p))
+        return;
+
+    Chunk &c = chunkAt(chunkOf(p.getx()), chunkOf(p.gety()));
+    if (c.costs.empty()) {
+        if (c.uniformCost == cost)
+            return;
+
+        bool wasMixed = !c.bits.empty();
+        c.costs.assign(squaresPerChunk, c.uniformCost);
+        updateMixed(c, wasMixed);
+    }
+
+    uint8_t &square = c.costs[(p.gety() & (chunkSize - 1)) * chunkSize + (p.getx() & (chunkSize - 1))];
+    if (square != cost) {
+        square = cost;
+        ++version;
+    }
+}
+
+uint8_t ChunkedGrid::getCost(Point p) const
+{
+    if (bounded && !inBounds(p))
+        return 1;
+
+    int chunk = chunks.find(chunkOf(p.getx()), chunkOf(p.gety()));
+    if (chunk == -1)
+        return 1;
+
+    Chunk &c = store[chunk];
+    c.lastUsed = ++clock;
+    if (c.paged)
+        pageIn(c);
+
+    if (c.costs.empty())
+        return c.uniformCost;
+
+    return c.costs[(p.gety() & (chunkSize - 1)) * chunkSize + (p.getx() & (chunkSize - 1))];
+}
+
+const uint8_t *ChunkedGrid::getChunkCosts(int cx, int cy, uint8_t &uniform) const
+{
+    int chunk = chunks.find(cx, cy);
+    if (chunk == -1) {
+        uniform = 1;
+        return 0;
+    }
+
+    Chunk &c = store[chunk];
+    c.lastUsed = ++clock;
+    if (c.paged)
+        pageIn(c);
+
+    uniform = c.uniformCost;
+    return c.costs.empty() ? 0 : &c.costs[0];
+}
+
+void ChunkedGrid::fillRect(int x, int y, int w, int h, Square s)
+{
+    if (bounded) {
+        int x1 = std::min(x + w, maxX), y1 = std::min(y + h, maxY);
+        x = std::max(x, minX);
+        y = std::max(y, minY);
+        w = x1 - x;
+        h = y1 - y;
+    }
+
+    if (w <= 0 || h <= 0)
+        return;
+
+    for (int cy = chunkOf(y); cy <= chunkOf(y + h - 1); ++cy)
+        for (int cx = chunkOf(x); cx <= chunkOf(x + w - 1); ++cx) {
+            // Part of the rectangle in this chunk, in chunk coordinates
+            int x0 = std::max(x - cx * chunkSize, 0);
+            int x1 = std::min(x + w - cx * chunkSize, chunkSize);
+            int y0 = std::max(y - cy * chunkSize, 0);
+            int y1 = std::min(y + h - cy * chunkSize, chunkSize);
+
+            int chunk = chunks.find(cx, cy);
+            if (chunk == -1 && s == background)
+                continue;
+
+            Chunk &c = chunkAt(cx, cy);
+
+            if (x0 == 0 && x1 == chunkSize && y0 == 0 && y1 == chunkSize) {
+                // Covers the whole chunk, so it becomes uniform
+                bool wasMixed = !c.bits.empty() || !c.costs.empty();
+                std::vector<uint64_t>().swap(c.bits);
+                c.uniform = s;
+                c.nFull = s == FULL ? squaresPerChunk : 0;
+                updateMixed(c, wasMixed);
+                continue;
+            }
+
+            if (c.bits.empty()) {
+                if (c.uniform == s)
+                    continue;
+
+                makeMixed(c);
+            }
+
+            for (int row = y0; row < y1; ++row)
+                fillBits(&c.bits[row], x0, x1, s == FULL);
+
+            c.nFull = countWords(&c.bits[0], chunkSize);
+            collapse(c);
+        }
+
+    ++version;
+}
+
+void ChunkedGrid::setBounds(int x, int y, int w, int h)
+{
+    bounded = true;
+    minX = x;
+    minY = y;
+    maxX = x + w;
+    maxY = y + h;
+    ++version;
+}
+
+unsigned ChunkedGrid::getEmptyMask(const Point &p) const
+{
+    int x = p.getx() & (chunkSize - 1);
+    int y = p.gety() & (chunkSize - 1);
+
+    // Away from the edges of its chunk and of the bounds, all the neighbours
+    // are in the same chunk, so it is looked up just once
+    if (x > 0 && x < chunkSize - 1 && y > 0 && y < chunkSize - 1 &&
+        (!bounded || (p.getx() > minX && p.getx() < maxX - 1 &&
+                      p.gety() > minY && p.gety() < maxY - 1))) {
+        int chunk = chunks.find(chunkOf(p.getx()), chunkOf(p.gety()));
+        if (chunk == -1)
+            return background == EMPTY ? 0xFF : 0;
+
+        const uint64_t *bits = rows(chunk);
+        if (bits == 0)
+            return store[chunk].uniform == EMPTY ? 0xFF : 0;
+
+        unsigned mask = 0;
+        for (int i = 0; i < 8; ++i)
+            mask |= (unsigned)(((bits[y + moveDy[i]] >> (x + moveDx[i])) & 1) == 0) << i;
+
+        return mask;
+    }
+
+    unsigned mask = 0;
+    for (int i = 0; i < 8; ++i) {
+        Point q(p.getx() + moveDx[i], p.gety() + moveDy[i]);
+        mask |= (unsigned)(getSquare(q) == EMPTY) << i;
+    }
+
+    return mask;
+}
+
+bool ChunkedGrid::setPageFile(const std::string &path)
+{
+    if (pageFile.is_open()) {
+        for (std::size_t i = 0; i < store.size(); ++i)
+            if (store[i].paged)
+                pageIn(store[i]);
+
+        pageFile.close();
+    }
+
+    for (std::size_t i = 0; i < store.size(); ++i)
+        store[i].fileRecord = -1;
+    nextFileRecord = 0;
+
+    pageFile.clear();
+    pageFile.open(path.c_str(), std::ios::in | std::ios::out | std::ios::trunc | std::ios::binary);
+
+    return pageFile.is_open();
+}
+
+bool ChunkedGrid::pageOut(std::size_t maxResident)
+{
+    if (!pageFile.is_open())
+        return false;
+
+    if (resident <= maxResident)
+        return true;
+
+    // Resident mixed chunks, least recently used first
+    std::vector<std::pair<unsigned long, std::size_t> > candidates;
+    for (std::size_t i = 0; i < store.size(); ++i)
+        if (!store[i].paged && (!store[i].bits.empty() || !store[i].costs.empty()))
+            candidates.push_back(std::make_pair(store[i].lastUsed, i));
+
+    std::sort(candidates.begin(), candidates.end());
+
+    std::size_t evict = candidates.size() - std::min(candidates.size(), maxResident);
+    for (std::size_t k = 0; k < evict; ++k) {
+        Chunk &c = store[candidates[k].second];
+
+        if (c.fileRecord == -1)
+            c.fileRecord = nextFileRecord++;
+
+        char flags = (c.bits.empty() ? 0 : hasBits) | (c.costs.empty() ? 0 : hasCosts);
+        pageFile.seekp(c.fileRecord * recordBytes);
+        pageFile.write(&flags, 1);
+        if (!c.bits.empty())
+            pageFile.write((const char *)&c.bits[0], chunkSize * sizeof(uint64_t));
+
+        if (!c.costs.empty()) {
+            pageFile.seekp(c.fileRecord * recordBytes + 1 + chunkSize * sizeof(uint64_t));
+            pageFile.write((const char *)&c.costs[0], squaresPerChunk);
+        }
+
+        if (!pageFile)
+            return false;
+
+        std::vector<uint64_t>().swap(c.bits);
+        std::vector<uint8_t>().swap(c.costs);
+        c.paged = true;
+        --resident;
+    }
+
+    pageFile.flush();
+    return pageFile.good();
+}
+
+ChunkedGrid::Chunk &ChunkedGrid::chunkAt(int cx, int cy)
+{
+    int chunk = chunks.find(cx, cy);
+
+    if (chunk == -1) {
+        Chunk c;
+        c.cx = cx;
+        c.cy = cy;
+        c.uniform = background;
+        c.uniformCost = 1;
+        c.nFull = background == FULL ? squaresPerChunk : 0;
+        c.fileRecord = -1;
+        c.paged = false;
+        c.lastUsed = clock;
+
+        chunk = store.size();
+        store.push_back(c);
+        chunks.insert(cx, cy, chunk);
+    }
+
+    Chunk &c = store[chunk];
+    c.lastUsed = ++clock;
+    if (c.paged)
+        pageIn(c);
+
+    return c;
+}
+
+void ChunkedGrid::makeMixed(Chunk &c)
+{
+    bool wasMixed = !c.costs.empty();
+    c.bits.assign(chunkSize, c.uniform == FULL ? ~(uint64_t)0 : 0);
+    updateMixed(c, wasMixed);
+}
+
+void ChunkedGrid::collapse(Chunk &c)
+{
+    if (c.bits.empty() || (c.nFull != 0 && c.nFull != squaresPerChunk))
+        return;
+
+    c.uniform = c.nFull == 0 ? EMPTY : FULL;
+    std::vector<uint64_t>().swap(c.bits);
+    updateMixed(c, true);
+}
+
+void ChunkedGrid::updateMixed(const Chunk &c, bool wasMixed)
+{
+    bool isMixed = !c.bits.empty() || !c.costs.empty();
+
+    if (isMixed && !wasMixed) {
+        ++mixed;
+        ++resident;
+    } else if (!isMixed && wasMixed) {
+        --mixed;
+        --resident;
+    }
+}
+
+void ChunkedGrid::pageIn(Chunk &c) const
+{
+    char flags = 0;
+
+    pageFile.clear();
+    pageFile.seekg(c.fileRecord * recordBytes);
+    pageFile.read(&flags, 1);
+
+    if (flags & hasBits) {
+        c.bits.resize(chunkSize);
+        pageFile.read((char *)&c.bits[0], chunkSize * sizeof(uint64_t));
+    }
+
+    if (flags & hasCosts) {
+        c.costs.resize(squaresPerChunk);
+        pageFile.seekg(c.fileRecord * recordBytes + 1 + chunkSize * sizeof(uint64_t));
+        pageFile.read((char *)&c.costs[0], squaresPerChunk);
+    }
+
+    if (!pageFile || flags == 0) {
+        c.bits.assign(chunkSize, ~(uint64_t)0);
+        c.nFull = squaresPerChunk;
+    }
+
+    c.paged = false;
+    ++resident;
+}
@@ -0,0 +1,398 @@
+#ifndef CHUNKED_GRID_H_
+#define CHUNKED_GRID_H_
+
+#include <cstddef>
+#include <fstream>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "Movement.h"
+#include "NodeStore.h"
+#include "Point.h"
+#include "Square.h"
+
+/**
+ * Hash table from chunk coordinates to an int, with linear probing
+ */
+class ChunkIndex {
+ public:
+    ChunkIndex();
+
+    /**
+     * Value stored for chunk (`cx`, `cy`), or -1 if there is none
+     */
+    int find(int cx, int cy) const {
+        uint64_t key = makeKey(cx, cy);
+        std::size_t i = slot(key);
+
+        while (values[i] != -1) {
+            if (keys[i] == key)
+                return values[i];
+
+            i = (i + 1) & (keys.size() - 1);
+        }
+
+        return -1;
+    }
+
+    /**
+     * Store `value` (not -1) for chunk (`cx`, `cy`), which must not have one
+     */
+    void insert(int cx, int cy, int value);
+
+    void clear();
+
+ private:
+    /* Slots, a power of two of them, never more than half full. A value of
+       -1 marks an unused slot */
+    std::vector<uint64_t> keys;
+    std::vector<int> values;
+
+    std::size_t count;
+
+    static uint64_t makeKey(int cx, int cy) {
+        return ((uint64_t)(uint32_t)cy << 32) | (uint32_t)cx;
+    }
+
+    std::size_t slot(uint64_t key) const {
+        return (std::size_t)((key * 0x9E3779B97F4A7C15ULL) >> 32) & (keys.size() - 1);
+    }
+};
+
+/**
+ * Grid of Squares for very large or unbounded maps, split into 64 by 64
+ * chunks. Chunks are only made when something is set in them: until then
+ * every Square is the background. A chunk whose Squares are all the same is
+ * stored as that one Square, and only mixed chunks hold a bit per Square,
+ * one 64-bit word per row. Cost multipliers work the same way, with a byte
+ * per Square only in chunks where one has been set.
+ *
+ * Points can be anywhere, including negative coordinates. Points outside the
+ * bounds, if set, are FULL. Searches of an unbounded EMPTY background for an
+ * unreachable end never finish, so either set bounds or give the search a
+ * SearchControl.
+ *
+ * With a page file, pageOut() writes the least recently used mixed chunks to
+ * it and frees their memory, and reading a paged out chunk reads it back in.
+ * Reads can therefore write to the grid, so it is not safe to read from more
+ * than one thread at a time once paging is on.
+ *
+ * BasicAStar searches a ChunkedGrid with ChunkedNodeStore, so squares and
+ * their costs are found with one hash lookup per chunk rather than per square.
+ */
+class ChunkedGrid {
+ public:
+    static const int chunkBits = 6;
+    static const int chunkSize = 1 << chunkBits;
+
+    explicit ChunkedGrid(Square background = EMPTY);
+
+    /**
+     * Set the Square at point `p` to `s`. Points outside the bounds are
+     * ignored
+     */
+    void setSquare(Point p, Square s);
+
+    /**
+     * Return the square at point `p`
+     */
+    Square getSquare(Point p) const {
+        if (bounded && !inBounds(p))
+            return FULL;
+
+        int chunk = chunks.find(chunkOf(p.getx()), chunkOf(p.gety()));
+        if (chunk == -1)
+            return background;
+
+        const uint64_t *bits = rows(chunk);
+        if (bits == 0)
+            return store[chunk].uniform;
+
+        return ((bits[p.gety() & (chunkSize - 1)] >> (p.getx() & (chunkSize - 1))) & 1) ? FULL : EMPTY;
+    }
+
+    /**
+     * Set the cost multiplier of `p`, where 0 is taken as 1
+     */
+    void setCost(Point p, uint8_t cost);
+
+    /**
+     * Return the cost multiplier of `p`, 1 unless set
+     */
+    uint8_t getCost(Point p) const;
+
+    /**
+     * Cost multipliers of chunk (`cx`, `cy`) at y * chunkSize + x in chunk
+     * coordinates, read back in if paged out, or 0 if every Square of it
+     * costs the same, in which case `uniform` is set to that. Ignores the
+     * bounds. Valid until the grid is next changed or paged out
+     */
+    const uint8_t *getChunkCosts(int cx, int cy, uint8_t &uniform) const;
+
+    /**
+     * Smallest cost multiplier on the grid. There is always background with
+     * multiplier 1, so this is 1
+     */
+    int getMinCost() const { return 1; }
+
+    /**
+     * Set every Square in the `w` by `h` rectangle with top-left corner
+     * (x, y) to `s`, making chunks it covers whole uniform without touching
+     * their Squares
+     */
+    void fillRect(int x, int y, int w, int h, Square s);
+
+    /**
+     * Limit the grid to the `w` by `h` rectangle with top-left corner (x, y),
+     * outside which every Square is FULL
+     */
+    void setBounds(int x, int y, int w, int h);
+
+    /**
+     * Return a mask with bit i set if the neighbour (moveDx[i], moveDy[i])
+     * away from `p` is EMPTY (see Movement.h)
+     */
+    unsigned getEmptyMask(const Point &p) const;
+
+    /**
+     * Mask of the moves from `p` allowed under `M`, as Grid::getMoves()
+     */
+    template <Movement M>
+    unsigned getMoves(const Point &p) const { return allowedMoves<M>(getEmptyMask(p)); }
+
+    Square getBackground() const { return background; }
+
+    /**
+     * Use the file at `path`, which is overwritten, for paging out chunks.
+     * Chunks paged out to a previous file are read back in first. Returns
+     * false if the file can't be opened
+     */
+    bool setPageFile(const std::string &path);
+
+    /**
+     * Write the least recently used mixed chunks to the page file until no
+     * more than `maxResident` are held in memory. Returns false if there is
+     * no page file or writing fails
+     */
+    bool pageOut(std::size_t maxResident);
+
+    /**
+     * Number of chunks made, how many of those hold per-Square data, and how
+     * many of those are in memory rather than paged out
+     */
+    std::size_t getChunkCount() const { return store.size(); }
+    std::size_t getMixedCount() const { return mixed; }
+    std::size_t getResidentCount() const { return resident; }
+
+    /**
+     * Return a counter that changes whenever the grid does
+     */
+    unsigned long getVersion() const { return version; }
+
+    /**
+     * Chunk coordinate of coordinate `v`, rounding down for negative `v`
+     */
+    static int chunkOf(int v) { return v >= 0 ? v >> chunkBits : ~(~v >> chunkBits); }
+
+ private:
+    static const int squaresPerChunk = chunkSize * chunkSize;
+
+    struct Chunk {
+        int cx;
+        int cy;
+
+        /* Every Square's value while `bits` is empty */
+        Square uniform;
+
+        /* Every Square's cost while `costs` is empty */
+        uint8_t uniformCost;
+
+        /* Bit x of word y set if (x, y) is FULL, or empty */
+        std::vector<uint64_t> bits;
+
+        /* Cost of (x, y) at y * chunkSize + x, or empty */
+        std::vector<uint8_t> costs;
+
+        int nFull;
+
+        /* Record in the page file, or -1 if never written */
+        long fileRecord;
+
+        /* True if `bits` and `costs` are in the page file, not in memory */
+        bool paged;
+
+        /* Value of `clock` when last read or written */
+        unsigned long lastUsed;
+    };
+
+    Square background;
+
+    bool bounded;
+    int minX, minY, maxX, maxY;
+
+    /* Chunk coordinates to index in `store` */
+    ChunkIndex chunks;
+
+    /* Paging in from reads changes chunks, hence mutable */
+    mutable std::vector<Chunk> store;
+    mutable std::fstream pageFile;
+    mutable std::size_t resident;
+    mutable unsigned long clock;
+
+    std::size_t mixed;
+    long nextFileRecord;
+
+    unsigned long version;
+
+    bool inBounds(const Point &p) const {
+        return p.getx() >= minX && p.getx() < maxX && p.gety() >= minY && p.gety() < maxY;
+    }
+
+    /**
+     * Rows of chunk number `chunk`, read back in if paged out, or 0 if its
+     * Squares are uniform
+     */
+    const uint64_t *rows(int chunk) const {
+        Chunk &c = store[chunk];
+        c.lastUsed = ++clock;
+
+        if (c.paged)
+            pageIn(c);
+
+        return c.bits.empty() ? 0 : &c.bits[0];
+    }
+
+    /**
+     * Chunk (`cx`, `cy`), made uniform background if it doesn't exist, and
+     * read back in if paged out
+     */
+    Chunk &chunkAt(int cx, int cy);
+
+    /**
+     * Give `c` a bit per Square, if it doesn't have them
+     */
+    void makeMixed(Chunk &c);
+
+    /**
+     * Drop the bits of `c` if its Squares are all the same
+     */
+    void collapse(Chunk &c);
+
+    void updateMixed(const Chunk &c, bool wasMixed);
+
+    /**
+     * Read `c` back in from the page file. If that fails every Square of it
+     * is FULL, so paths avoid what was lost
+     */
+    void pageIn(Chunk &c) const;
+
+    // Not copyable, as chunks may be in the page file
+    ChunkedGrid(const ChunkedGrid &);
+    ChunkedGrid &operator=(const ChunkedGrid &);
+};
+
+/**
+ * Search state of BasicAStar for a ChunkedGrid, in arrays of 64 by 64 blocks
+ * allocated as the search reaches new chunks. A square's index is its
+ * block's number times 4096 plus its place in the block, so only moves out
+ * of a block look up a chunk, and the position of a node is still implied by
+ * its index. Each block also keeps its chunk's cost multipliers, fetched when
+ * the block is made. Members are as DenseNodeStore
+ */
+template <class Cost>
+class ChunkedNodeStore {
+ public:
+    ChunkedNodeStore() : grid(0) { }
+
+    void reset(const ChunkedGrid &grid) {
+        this->grid = &grid;
+        blocks.clear();
+        blockX.clear();
+        blockY.clear();
+        blockCosts.clear();
+        uniformCosts.clear();
+        states.clear();
+    }
+
+    int index(const Point &p) {
+        int cx = ChunkedGrid::chunkOf(p.getx());
+        int cy = ChunkedGrid::chunkOf(p.gety());
+
+        int block = blocks.find(cx, cy);
+        if (block == -1) {
+            block = blockX.size();
+            blocks.insert(cx, cy, block);
+            blockX.push_back(cx);
+            blockY.push_back(cy);
+
+            uint8_t uniform = 1;
+            blockCosts.push_back(grid->getChunkCosts(cx, cy, uniform));
+            uniformCosts.push_back(uniform);
+
+            std::size_t size = (block + 1) * squaresPerBlock;
+            states.resize(size, UNSEEN);
+            gvalues.resize(size);
+            parents.resize(size);
+        }
+
+        return block * squaresPerBlock + (p.gety() & mask) * ChunkedGrid::chunkSize +
+            (p.getx() & mask);
+    }
+
+    int neighbour(int index, const Point &p, int move) {
+        int x = (index & mask) + moveDx[move];
+        int y = ((index >> ChunkedGrid::chunkBits) & mask) + moveDy[move];
+
+        if (x >= 0 && x < ChunkedGrid::chunkSize && y >= 0 && y < ChunkedGrid::chunkSize)
+            return index + moveDy[move] * ChunkedGrid::chunkSize + moveDx[move];
+
+        return this->index(Point(p.getx() + moveDx[move], p.gety() + moveDy[move]));
+    }
+
+    Point point(int index) const {
+        int block = index / squaresPerBlock;
+        return Point(blockX[block] * ChunkedGrid::chunkSize + (index & mask),
+                     blockY[block] * ChunkedGrid::chunkSize + ((index >> ChunkedGrid::chunkBits) & mask));
+    }
+
+    template <class GridT>
+    uint8_t cost(const GridT &, int index, const Point &) const {
+        int block = index / squaresPerBlock;
+        const uint8_t *costs = blockCosts[block];
+        return costs != 0 ? costs[index & (squaresPerBlock - 1)] : uniformCosts[block];
+    }
+
+    unsigned char &state(int index) { return states[index]; }
+    Cost &gvalue(int index) { return gvalues[index]; }
+    int &parent(int index) { return parents[index]; }
+
+    Cost gvalue(int index) const { return gvalues[index]; }
+    int parent(int index) const { return parents[index]; }
+
+ private:
+    static const int squaresPerBlock = ChunkedGrid::chunkSize * ChunkedGrid::chunkSize;
+    static const int mask = ChunkedGrid::chunkSize - 1;
+
+    const ChunkedGrid *grid;
+
+    /* Chunk coordinates to block number, and back */
+    ChunkIndex blocks;
+    std::vector<int> blockX;
+    std::vector<int> blockY;
+
+    /* Cost multipliers of each block's chunk, or 0 and the one they all have */
+    std::vector<const uint8_t*> blockCosts;
+    std::vector<uint8_t> uniformCosts;
+
+    std::vector<Cost> gvalues;
+    std::vector<int> parents;
+    std::vector<unsigned char> states;
+};
+
+template <class Cost>
+struct SearchStorage<ChunkedGrid, Cost> {
+    typedef ChunkedNodeStore<Cost> Type;
+};
+
+#endif /* CHUNKED_GRID_H_ */
@@ -0,0 +1,96 @@
+#include "Clearance.h"
+
+#include <algorithm>
+
+Clearance::Clearance(Grid *grid, int maxClearance)
+    : grid(grid), width(0), height(0),
+      maxClearance(std::max(1, std::min(maxClearance, 255))), costLevels(0), updatedSquares(0)
+{
+    rebuild();
+    grid->attach(this);
+}
+
+Clearance::~Clearance()
+{
+    grid->detach(this);
+}
+
+void Clearance::rebuild()
+{
+    width = grid->getWidth();
+    height = grid->getHeight();
+    values.assign((std::size_t)width * height, 0);
+
+    // Every square depends only on squares after it, so one backward pass
+    for (int y = height - 1; y >= 0; --y)
+        for (int x = width - 1; x >= 0; --x)
+            values[y * width + x] = compute(x, y);
+
+    costLevels = 0;
+    while (2 << costLevels <= maxClearance)
+        ++costLevels;
+
+    blockCosts.assign((std::size_t)costLevels * width * height, 1);
+
+    // Each level of blocks from the one below
+    for (int level = 1; level <= costLevels; ++level)
+        for (int y = 0; y < height; ++y)
+            for (int x = 0; x < width; ++x)
+                computeBlockCost(level, x, y);
+}
+
+void Clearance::update(const Point &p)
+{
+    // Squares of each row are worked out right to left, rows bottom to top,
+    // so the squares each depends on are done first. Those that can change
+    // in a row are the ones over or left of a change in the row below, and
+    // any left of a change in the row itself
+    int low = p.getx(), high = p.getx();
+
+    for (int y = p.gety(); y >= 0; --y) {
+        int changedLow = -1, changedHigh = -1;
+
+        for (int x = high; x >= 0; --x) {
+            if (x < low && changedLow != x + 1)
+                break;
+
+            uint8_t value = compute(x, y);
+            ++updatedSquares;
+
+            if (value != values[y * width + x]) {
+                values[y * width + x] = value;
+                changedLow = x;
+                if (changedHigh == -1)
+                    changedHigh = x;
+            }
+        }
+
+        if (changedHigh == -1)
+            break;
+
+        low = std::max(0, changedLow - 1);
+        high = changedHigh;
+    }
+}
+
+void Clearance::squareChanged(const Grid &grid, const Point &p, Square previous)
+{
+    update(p);
+}
+
+void Clearance::costChanged(const Grid &grid, const Point &p, uint8_t previous)
+{
+    // Only the blocks over p, each level after the one it is made from
+    for (int level = 1; level <= costLevels; ++level) {
+        int size = 1 << level;
+
+        for (int y = std::max(0, p.gety() - size + 1); y <= p.gety(); ++y)
+            for (int x = std::max(0, p.getx() - size + 1); x <= p.getx(); ++x)
+                computeBlockCost(level, x, y);
+    }
+}
+
+void Clearance::gridReset(const Grid &grid)
+{
+    rebuild();
+}
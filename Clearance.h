@@ -0,0 +1,211 @@
+#ifndef CLEARANCE_H_
+#define CLEARANCE_H_
+
+#include <stdint.h>
+#include <vector>
+
+#include "Grid.h"
+#include "Movement.h"
+#include "Point.h"
+
+/**
+ * Clearance of every square of a Grid, for agents bigger than one square:
+ * the size of the biggest all EMPTY square with its top-left corner there,
+ * up to a maximum. An agent `size` squares across, placed with its top-left
+ * corner at `p`, fits if the clearance of `p` is at least `size`, so a
+ * search can test a square in O(1) rather than every square under the
+ * agent.
+ *
+ * The clearance of an EMPTY square is one more than the least of those to
+ * its right, below it and diagonally below right, and 0 for FULL squares
+ * and off the grid, so it is worked out in one pass from the bottom right,
+ * the backward pass of a chessboard distance transform. A changed square
+ * only changes the clearance of squares above and left of it, within the
+ * maximum, so the watched Grid's changes are followed by working those out
+ * again, outward from the square until they stop changing.
+ *
+ * An agent is charged the most expensive cost multiplier under it. For that
+ * the most expensive square of every block of 2, 4, 8, ... squares across,
+ * up to the maximum, is kept alongside, so that of any square block is the
+ * most of four overlapping blocks, as in a sparse table. A changed cost
+ * changes only the blocks over it.
+ */
+class Clearance : public GridObserver {
+ public:
+    /**
+     * Work out the clearance of every square of `grid`, up to `maxClearance`
+     * (at most 255), and start watching it
+     */
+    explicit Clearance(Grid *grid, int maxClearance = 16);
+    ~Clearance();
+
+    /**
+     * Clearance of `p`, 0 if it is FULL or off the grid
+     */
+    int get(const Point &p) const {
+        if (p.getx() < 0 || p.gety() < 0 || p.getx() >= width || p.gety() >= height)
+            return 0;
+        return values[p.gety() * width + p.getx()];
+    }
+
+    /**
+     * Return true if an agent `size` squares across fits with its top-left
+     * corner at `p`
+     */
+    bool fits(const Point &p, int size) const { return get(p) >= size; }
+
+    /**
+     * The most expensive cost multiplier under an agent `size` squares across
+     * (no more than the maximum) with its top-left corner at `p`
+     */
+    uint8_t getCost(const Point &p, int size) const {
+        if (size <= 1)
+            return grid->getCost(p);
+
+        int level = 1;
+        while (2 << level <= size)
+            ++level;
+
+        int shift = size - (1 << level);
+        uint8_t a = blockCost(level, p.getx(), p.gety());
+        uint8_t b = blockCost(level, p.getx() + shift, p.gety());
+        uint8_t c = blockCost(level, p.getx(), p.gety() + shift);
+        uint8_t d = blockCost(level, p.getx() + shift, p.gety() + shift);
+
+        a = a > b ? a : b;
+        c = c > d ? c : d;
+        return a > c ? a : c;
+    }
+
+    int getMaxClearance() const { return maxClearance; }
+
+    /**
+     * Return true if this is the clearance of `grid`
+     */
+    bool matches(const Grid *grid) const { return grid == this->grid; }
+
+    /**
+     * Work out every square again
+     */
+    void rebuild();
+
+    /**
+     * Number of squares worked out again after changes to the grid
+     */
+    long getUpdatedSquares() const { return updatedSquares; }
+
+    /* GridObserver interface */
+    void squareChanged(const Grid &grid, const Point &p, Square previous);
+    void costChanged(const Grid &grid, const Point &p, uint8_t previous);
+    void gridReset(const Grid &grid);
+
+ private:
+    Grid *grid;
+
+    int width;
+    int height;
+    int maxClearance;
+
+    /* Clearance of (x, y) at y * width + x */
+    std::vector<uint8_t> values;
+
+    /* Most expensive square of the block 2^level squares across with its
+       top-left corner at (x, y), at ((level - 1) * height + y) * width + x,
+       for levels 1 to costLevels */
+    std::vector<uint8_t> blockCosts;
+    int costLevels;
+
+    long updatedSquares;
+
+    /**
+     * Clearance of (x, y) from the grid and the clearance of the squares to
+     * its right and below
+     */
+    uint8_t compute(int x, int y) const {
+        if (grid->getSquare(Point(x, y)) == FULL)
+            return 0;
+
+        int right = get(Point(x + 1, y)), below = get(Point(x, y + 1));
+        int diagonal = get(Point(x + 1, y + 1));
+        int least = right < below ? right : below;
+        least = least < diagonal ? least : diagonal;
+
+        return least < maxClearance ? least + 1 : maxClearance;
+    }
+
+    /**
+     * Work out the squares whose clearance depends on `p` again
+     */
+    void update(const Point &p);
+
+    /**
+     * Most expensive square of the block 2^level squares across at (x, y),
+     * where off the grid costs 1 as it does on Grid
+     */
+    uint8_t blockCost(int level, int x, int y) const {
+        if (x < 0 || y < 0 || x >= width || y >= height)
+            return 1;
+        return blockCosts[((level - 1) * height + y) * width + x];
+    }
+
+    /**
+     * Work out the block at (x, y) of `level` from the four half as big
+     */
+    void computeBlockCost(int level, int x, int y) {
+        int half = 1 << (level - 1);
+        uint8_t most = 0;
+
+        for (int i = 0; i < 4; ++i) {
+            int bx = x + (i & 1) * half, by = y + (i >> 1) * half;
+            uint8_t cost = level == 1 ? grid->getCost(Point(bx, by)) :
+                blockCost(level - 1, bx, by);
+            most = cost > most ? cost : most;
+        }
+
+        blockCosts[((level - 1) * height + y) * width + x] = most;
+    }
+};
+
+/**
+ * A Grid as seen by an agent `size` squares across, for BasicAStar: a square
+ * is EMPTY if the agent fits with its top-left corner there. Moves follow
+ * the movement rule as for one-square agents, and a square costs as the most
+ * expensive square under the agent there. `size` must be no more than the
+ * clearance's maximum
+ */
+class ClearanceGrid {
+ public:
+    ClearanceGrid(const Grid *grid, const Clearance *clearance, int size)
+        : grid(grid), clearance(clearance), size(size) { }
+
+    Square getSquare(const Point &p) const {
+        return clearance->fits(p, size) ? EMPTY : FULL;
+    }
+
+    uint8_t getCost(const Point &p) const { return clearance->getCost(p, size); }
+    int getMinCost() const { return grid->getMinCost(); }
+
+    unsigned getEmptyMask(const Point &p) const {
+        unsigned mask = 0;
+        for (int i = 0; i < 8; ++i) {
+            Point q(p.getx() + moveDx[i], p.gety() + moveDy[i]);
+            mask |= (unsigned)clearance->fits(q, size) << i;
+        }
+        return mask;
+    }
+
+    template <Movement M>
+    unsigned getMoves(const Point &p) const { return allowedMoves<M>(getEmptyMask(p)); }
+
+    int getWidth() const { return grid->getWidth(); }
+    int getHeight() const { return grid->getHeight(); }
+
+    int getSize() const { return size; }
+
+ private:
+    const Grid *grid;
+    const Clearance *clearance;
+    int size;
+};
+
+#endif /* CLEARANCE_H_ */
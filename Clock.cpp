@@ -0,0 +1,25 @@
+#include "Clock.h"
+
+#if __cplusplus >= 201103L
+#include <chrono>
+#else
+#include <sys/time.h>
+#include <time.h>
+#endif
+
+double wallSeconds()
+{
+#if __cplusplus >= 201103L
+    return std::chrono::duration<double>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#elif defined(CLOCK_MONOTONIC)
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+#else
+    // Can go backwards if the system time is set, but is still wall time
+    timeval tv;
+    gettimeofday(&tv, 0);
+    return tv.tv_sec + tv.tv_usec * 1e-6;
+#endif
+}
@@ -0,0 +1,11 @@
+#ifndef CLOCK_H_
+#define CLOCK_H_
+
+/**
+ * Seconds of wall time since some fixed point, on a clock that only goes
+ * forwards, for timing searches and frame budgets. Unlike std::clock() it
+ * counts time spent waiting and isn't shared out between threads
+ */
+double wallSeconds();
+
+#endif /* CLOCK_H_ */
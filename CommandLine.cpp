@@ -0,0 +1,60 @@
+#include "CommandLine.h"
+
+#include <cstdio>
+#include <sstream>
+
+bool parseMovement(const std::string &name, Movement &movement)
+{
+    if (name == "eight")
+        movement = EIGHT_CONNECTED;
+    else if (name == "four")
+        movement = FOUR_CONNECTED;
+    else if (name == "no-corner-cutting")
+        movement = NO_CORNER_CUTTING;
+    else if (name == "no-squeezing")
+        movement = NO_SQUEEZING;
+    else
+        return false;
+
+    return true;
+}
+
+bool parseMoveCosts(const std::string &value, int &cardinalCost, int &diagonalCost)
+{
+    int cardinal, diagonal;
+    if (std::sscanf(value.c_str(), "%d,%d", &cardinal, &diagonal) != 2 ||
+        cardinal <= 0 || diagonal <= 0)
+        return false;
+
+    cardinalCost = cardinal;
+    diagonalCost = diagonal;
+    return true;
+}
+
+bool parseQuery(const std::string &line, const Grid &grid, std::vector<Point> &points,
+                bool &valid)
+{
+    std::istringstream in(line);
+    std::string first;
+    if (!(in >> first) || first[0] == '#')
+        return false;
+
+    in.clear();
+    in.seekg(0);
+
+    points.clear();
+    valid = true;
+
+    int x, y;
+    while (in >> x) {
+        if (!(in >> y) || x < 0 || y < 0 || x >= grid.getWidth() || y >= grid.getHeight())
+            valid = false;
+        else
+            points.push_back(Point(x, y));
+    }
+
+    if (!in.eof() || points.size() < 2)
+        valid = false;
+
+    return true;
+}
@@ -0,0 +1,37 @@
+#ifndef COMMAND_LINE_H_
+#define COMMAND_LINE_H_
+
+#include <string>
+#include <vector>
+
+#include "Grid.h"
+#include "Movement.h"
+#include "Point.h"
+
+/*
+ * Parsing of the option values the command-line tools share.
+ */
+
+/**
+ * Set `movement` from its name: "eight", "four", "no-corner-cutting" or
+ * "no-squeezing". Return false, leaving it alone, for any other name
+ */
+bool parseMovement(const std::string &name, Movement &movement);
+
+/**
+ * Set the cardinal and diagonal move costs from "CARDINAL,DIAGONAL". Return
+ * false, leaving them alone, unless both are there and positive
+ */
+bool parseMoveCosts(const std::string &value, int &cardinalCost, int &diagonalCost);
+
+/**
+ * Parse a query line of main's input, the x and y of a start, any waypoints
+ * and an end, into `points`. Return false for a blank line or a comment,
+ * starting with #, which aren't queries. Otherwise return true, with `valid`
+ * false if the line is malformed, a point is off `grid` or there are fewer
+ * than two points
+ */
+bool parseQuery(const std::string &line, const Grid &grid, std::vector<Point> &points,
+                bool &valid);
+
+#endif /* COMMAND_LINE_H_ */
@@ -0,0 +1,242 @@
+#include "Components.h"
+
+Components::Components(Grid *grid) : grid(grid) {
+    rebuild(*grid);
+    grid->attach(this);
+}
+
+Components::~Components() {
+    grid->detach(this);
+}
+
+bool Components::connected(const Point &p1, const Point &p2) const {
+    int label = getLabel(p1);
+    return label != -1 && label == getLabel(p2);
+}
+
+int Components::getLabel(const Point &p) const {
+    if (p.getx() < 0 || p.gety() < 0 || p.getx() >= width || p.gety() >= height)
+        return -1;
+
+    return labels[index(p.getx(), p.gety())];
+}
+
+int Components::getSize(int label) const {
+    if (label < 0 || label >= (int)sizes.size())
+        return 0;
+
+    return sizes[label];
+}
+
+void Components::squareChanged(const Grid &grid, const Point &p, Square previous) {
+    // Missed a change somewhere, so the labels can't be patched up
+    if (&grid != this->grid || version + 1 != grid.getVersion()) {
+        rebuild(grid);
+        return;
+    }
+
+    if (previous == FULL)
+        addSquare(p);
+    else
+        removeSquare(p);
+
+    version = grid.getVersion();
+}
+
+void Components::costChanged(const Grid &grid, const Point &p, uint8_t previous) {
+    // Costs don't change what is connected, just keep up with the version
+    if (&grid != this->grid || version + 1 != grid.getVersion())
+        rebuild(grid);
+    else
+        version = grid.getVersion();
+}
+
+void Components::gridReset(const Grid &grid) {
+    rebuild(grid);
+}
+
+void Components::rebuild(const Grid &grid) {
+    width = grid.getWidth();
+    height = grid.getHeight();
+    version = grid.getVersion();
+
+    sizes.clear();
+    freeLabels.clear();
+    nComponents = 0;
+
+    // Mark EMPTY Squares as unlabelled with -2
+    labels.assign(width * height, -1);
+    for (int y = 0; y < height; ++y)
+        for (int x = 0; x < width; ++x)
+            if (grid.getSquare(Point(x, y)) == EMPTY)
+                labels[index(x, y)] = -2;
+
+    // Flood each unlabelled Square with a new label
+    for (int y = 0; y < height; ++y)
+        for (int x = 0; x < width; ++x) {
+            if (labels[index(x, y)] != -2)
+                continue;
+
+            int label = newLabel();
+            sizes[label] = flood(Point(x, y), label);
+            ++nComponents;
+        }
+}
+
+int Components::newLabel() {
+    if (freeLabels.empty()) {
+        sizes.push_back(0);
+        return sizes.size() - 1;
+    }
+
+    int label = freeLabels.back();
+    freeLabels.pop_back();
+    return label;
+}
+
+void Components::freeLabel(int label) {
+    sizes[label] = 0;
+    freeLabels.push_back(label);
+}
+
+int Components::flood(const Point &p, int label) {
+    int from = labels[index(p.getx(), p.gety())];
+    if (from == label)
+        return 0;
+
+    std::vector<int> stack;
+    stack.push_back(index(p.getx(), p.gety()));
+    labels[stack.back()] = label;
+
+    int count = 0;
+    while (!stack.empty()) {
+        int i = stack.back();
+        stack.pop_back();
+        ++count;
+
+        int x = i % width;
+        int y = i / width;
+
+        // Push every 8-connected neighbour still carrying the old label
+        for (int ny = y - 1; ny <= y + 1; ++ny)
+            for (int nx = x - 1; nx <= x + 1; ++nx) {
+                if (nx < 0 || ny < 0 || nx >= width || ny >= height)
+                    continue;
+
+                int n = index(nx, ny);
+                if (labels[n] == from) {
+                    labels[n] = label;
+                    stack.push_back(n);
+                }
+            }
+    }
+
+    return count;
+}
+
+void Components::addSquare(const Point &p) {
+    int x = p.getx();
+    int y = p.gety();
+
+    // Collect the labels of the components around the new Square, keeping the
+    // largest one as the label of the merged component
+    std::vector<Point> around;
+    int target = -1;
+
+    for (int ny = y - 1; ny <= y + 1; ++ny)
+        for (int nx = x - 1; nx <= x + 1; ++nx) {
+            if (nx < 0 || ny < 0 || nx >= width || ny >= height)
+                continue;
+
+            int label = labels[index(nx, ny)];
+            if (label < 0)
+                continue;
+
+            around.push_back(Point(nx, ny));
+            if (target == -1 || sizes[label] > sizes[target])
+                target = label;
+        }
+
+    // Isolated Square, so it is a component on its own
+    if (target == -1) {
+        target = newLabel();
+        ++nComponents;
+    }
+
+    labels[index(x, y)] = target;
+    ++sizes[target];
+
+    // Relabel the smaller components into the largest one
+    for (std::vector<Point>::const_iterator it = around.begin(); it != around.end(); ++it) {
+        int label = labels[index(it->getx(), it->gety())];
+        if (label == target)
+            continue;
+
+        sizes[target] += flood(*it, target);
+        freeLabel(label);
+        --nComponents;
+    }
+}
+
+void Components::removeSquare(const Point &p) {
+    int x = p.getx();
+    int y = p.gety();
+
+    int old = labels[index(x, y)];
+    labels[index(x, y)] = -1;
+
+    if (--sizes[old] == 0) {
+        freeLabel(old);
+        --nComponents;
+        return;
+    }
+
+    // Collect the EMPTY Squares around the removed one
+    std::vector<Point> around;
+    for (int ny = y - 1; ny <= y + 1; ++ny)
+        for (int nx = x - 1; nx <= x + 1; ++nx)
+            if (nx >= 0 && ny >= 0 && nx < width && ny < height &&
+                labels[index(nx, ny)] >= 0)
+                around.push_back(Point(nx, ny));
+
+    /* Group them by adjacency to each other. If they still form a single
+       group, the component can't have been split */
+    std::vector<int> group(around.size());
+    for (std::size_t i = 0; i < around.size(); ++i)
+        group[i] = i;
+
+    for (std::size_t i = 0; i < around.size(); ++i)
+        for (std::size_t j = i + 1; j < around.size(); ++j) {
+            Point d = around[i] - around[j];
+            if (d.getx() < -1 || d.getx() > 1 || d.gety() < -1 || d.gety() > 1)
+                continue;
+
+            // Merge the group of j into the group of i
+            int from = group[j];
+            for (std::size_t k = 0; k < around.size(); ++k)
+                if (group[k] == from)
+                    group[k] = group[i];
+        }
+
+    bool split = false;
+    for (std::size_t i = 1; i < around.size(); ++i)
+        if (group[i] != group[0])
+            split = true;
+
+    if (!split)
+        return;
+
+    /* The groups might still be joined further away, so flood from each one
+       that hasn't been reached yet, giving every piece a new label */
+    for (std::size_t i = 0; i < around.size(); ++i) {
+        if (labels[index(around[i].getx(), around[i].gety())] != old)
+            continue;
+
+        int label = newLabel();
+        sizes[label] = flood(around[i], label);
+        ++nComponents;
+    }
+
+    freeLabel(old);
+    --nComponents;
+}
@@ -0,0 +1,97 @@
+#ifndef COMPONENTS_H_
+#define COMPONENTS_H_
+
+#include <vector>
+
+#include "Grid.h"
+#include "Point.h"
+
+/**
+ * Connected-component labelling of the EMPTY Squares of a Grid, using the same
+ * 8-connectivity as Grid::getEmptyNeighbours, so that two points can only be
+ * joined by a path if they have the same label.
+ *
+ * The labels are kept up to date as the watched Grid changes: opening a
+ * Square merges the components around it, and filling one only relabels its
+ * component when the Squares around it are no longer joined locally.
+ */
+class Components : public GridObserver {
+ public:
+    /**
+     * Label `grid` and start watching it
+     */
+    Components(Grid *grid);
+    ~Components();
+
+    /**
+     * Return true if there is a path between `p1` and `p2`, i.e. both are
+     * EMPTY Squares in the same component
+     */
+    bool connected(const Point &p1, const Point &p2) const;
+
+    /**
+     * Return the label of the component containing `p`, or -1 if `p` is FULL
+     * or off the grid
+     */
+    int getLabel(const Point &p) const;
+
+    /**
+     * Return the number of EMPTY Squares in the component labelled `label`
+     */
+    int getSize(int label) const;
+
+    /**
+     * Return the number of components
+     */
+    int count() const { return nComponents; }
+
+    /* GridObserver interface */
+    void squareChanged(const Grid &grid, const Point &p, Square previous);
+    void costChanged(const Grid &grid, const Point &p, uint8_t previous);
+    void gridReset(const Grid &grid);
+
+ private:
+    Grid *grid;
+
+    int width;
+    int height;
+
+    /* Version of the grid the labels are valid for */
+    unsigned long version;
+
+    /* Label of each Square indexed by y * width + x, -1 for FULL */
+    std::vector<int> labels;
+
+    /* Size of each component indexed by label, 0 for unused labels */
+    std::vector<int> sizes;
+
+    /* Unused labels to hand out before growing `sizes` */
+    std::vector<int> freeLabels;
+
+    int nComponents;
+
+    /**
+     * Relabel every Square from scratch
+     */
+    void rebuild(const Grid &grid);
+
+    int index(int x, int y) const { return y * width + x; }
+
+    int newLabel();
+    void freeLabel(int label);
+
+    /**
+     * Give the component containing `p` the label `label`, returning the
+     * number of Squares relabelled
+     */
+    int flood(const Point &p, int label);
+
+    void addSquare(const Point &p);
+    void removeSquare(const Point &p);
+
+    /* Not copyable as it watches `grid` */
+    Components(const Components &);
+    Components &operator=(const Components &);
+};
+
+#endif /* COMPONENTS_H_ */
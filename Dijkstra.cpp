@@ -0,0 +1,130 @@
+#include "Dijkstra.h"
+
+#include <functional>
+#include <queue>
+#include <utility>
+
+/**
+ * Return true if moving from `p` by (`dx`, `dy`) is allowed under `movement`,
+ * checked the long way rather than with the masks of Movement.h
+ */
+static bool canMove(const Grid &grid, const Point &p, int dx, int dy, Movement movement)
+{
+    if (grid.getSquare(Point(p.getx() + dx, p.gety() + dy)) == FULL)
+        return false;
+
+    if (dx == 0 || dy == 0)
+        return true;
+
+    if (movement == FOUR_CONNECTED)
+        return false;
+
+    // The two squares beside a diagonal move
+    bool side1 = grid.getSquare(Point(p.getx() + dx, p.gety())) == EMPTY;
+    bool side2 = grid.getSquare(Point(p.getx(), p.gety() + dy)) == EMPTY;
+
+    if (movement == NO_CORNER_CUTTING)
+        return side1 && side2;
+
+    if (movement == NO_SQUEEZING)
+        return side1 || side2;
+
+    return true;
+}
+
+/* Build path from `start` to `end` */
+Path Dijkstra::build(const Point &start, const Point &end)
+{
+    int cost;
+    return this->build(start, end, cost);
+}
+
+Path Dijkstra::build(const Point &start, const Point &end, int &cost)
+{
+    int width = this->grid.getWidth();
+    int height = this->grid.getHeight();
+
+    expansions = 0;
+    cost = -1;
+
+    if (this->grid.getSquare(start) == FULL || this->grid.getSquare(end) == FULL)
+        return Path();
+
+    // Cheapest known cost and previous square of each square, by y * width + x
+    std::vector<int> distance((std::size_t)width * height, -1);
+    std::vector<int> previous((std::size_t)width * height, -1);
+    std::vector<bool> settled((std::size_t)width * height, false);
+
+    // Queue of (cost, square), where stale entries are skipped when popped
+    typedef std::pair<int, int> Entry;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry> > queue;
+
+    int target = end.gety() * width + end.getx();
+
+    distance[start.gety() * width + start.getx()] = 0;
+    queue.push(Entry(0, start.gety() * width + start.getx()));
+
+    while (!queue.empty()) {
+        Entry entry = queue.top();
+        queue.pop();
+
+        int square = entry.second;
+        if (settled[square])
+            continue;
+
+        settled[square] = true;
+        ++expansions;
+
+        if (square == target)
+            break;
+
+        Point p(square % width, square / width);
+
+        for (int dx = -1; dx <= 1; ++dx)
+            for (int dy = -1; dy <= 1; ++dy) {
+                if ((dx == 0 && dy == 0) || !canMove(this->grid, p, dx, dy, movement))
+                    continue;
+
+                Point q(p.getx() + dx, p.gety() + dy);
+
+                // Same weighting as AStar: the move's cost times the average
+                // multiplier of the squares at either end
+                int base = (dx != 0 && dy != 0) ? this->diagonalCost : this->cardinalCost;
+                int move = base * (this->grid.getCost(p) + this->grid.getCost(q)) / 2;
+
+                int next = q.gety() * width + q.getx();
+                if (distance[next] == -1 || entry.first + move < distance[next]) {
+                    distance[next] = entry.first + move;
+                    previous[next] = square;
+                    queue.push(Entry(distance[next], next));
+                }
+            }
+    }
+
+    if (!settled[target])
+        return Path();
+
+    cost = distance[target];
+
+    // Walk back from the end to the start
+    Path reversed;
+    for (int square = target; square != -1; square = previous[square])
+        reversed.push_back(Point(square % width, square / width));
+
+    return reversed;
+}
+
+/* Key paths cached for this pathfinder by its movement costs */
+std::vector<int> Dijkstra::getCostParameters() const
+{
+    std::vector<int> costs;
+    costs.push_back(cardinalCost);
+    costs.push_back(diagonalCost);
+    costs.push_back(movement);
+    return costs;
+}
+
+bool Dijkstra::diagonalsNeedSides() const
+{
+    return movement == NO_CORNER_CUTTING || movement == NO_SQUEEZING;
+}
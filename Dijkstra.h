@@ -0,0 +1,76 @@
+#ifndef DIJKSTRA_H_
+#define DIJKSTRA_H_
+
+#include <vector>
+
+#include "Movement.h"
+#include "PathFinder.h"
+#include "Point.h"
+
+/**
+ * Class to find a cheapest path between a start and end point on a Grid with
+ * plain Dijkstra search, using the same moves and costs as AStar but no
+ * heuristic and none of its bookkeeping.
+ *
+ * It is kept deliberately simple so that it can serve as an oracle: any path
+ * AStar returns must cost exactly what this one's does.
+ */
+class Dijkstra : public PathFinder {
+ public:
+ Dijkstra(Grid grid) : PathFinder(grid), cardinalCost(10), diagonalCost(14),
+	movement(EIGHT_CONNECTED), expansions(0) { }
+
+    /**
+     * Build and return a cheapest Path between the start and end points,
+     * returning an empty path on failure, or on success the path in reverse
+     * order
+     */
+    Path build(const Point &start, const Point &end);
+
+    /**
+     * Same as above, also setting `cost` to the cost of the path, or to -1 if
+     * there is none
+     */
+    Path build(const Point &start, const Point &end, int &cost);
+
+    /**
+     * The cardinal and diagonal costs and the movement rule, which change the
+     * paths returned
+     */
+    std::vector<int> getCostParameters() const;
+
+    /**
+     * True under NO_CORNER_CUTTING and NO_SQUEEZING
+     */
+    bool diagonalsNeedSides() const;
+
+    /**
+     * Get and set the cardinal and diagonal movement costs
+     */
+    int getCardinalCost() const { return cardinalCost; }
+    void setCardinalCost(int cardinalCost) { this->cardinalCost = cardinalCost; }
+
+    int getDiagonalCost() const { return diagonalCost; }
+    void setDiagonalCost(int diagonalCost) { this->diagonalCost = diagonalCost; }
+
+    /**
+     * Get and set which moves are allowed, EIGHT_CONNECTED by default
+     */
+    Movement getMovement() const { return movement; }
+    void setMovement(Movement movement) { this->movement = movement; }
+
+    /**
+     * Number of squares settled by the last call to build()
+     */
+    int getExpansions() const { return expansions; }
+
+ private:
+    int cardinalCost; /* Cost of moving north/south/east/west */
+    int diagonalCost; /* Cost of moving north-east/north-west/south-east/south-west */
+
+    Movement movement;
+
+    int expansions;
+};
+
+#endif /* DIJKSTRA_H_ */
@@ -4,6 +4,9 @@
 
 int main(int argc, char **argv)
 {
+    // Enable FLTK's locking so the pathfinding thread can wake the GUI
+    Fl::lock();
+
     // Generate a new grid
     Grid grid(20, 20);
     grid.populate(200);
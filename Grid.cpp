@@ -6,52 +6,131 @@
 #include <sstream>
 
 #include "Grid.h"
+#include "GridKernels.h"
+
+Grid::Grid(int width, int height)
+    : width(width), height(height),
+      rowWords(((width + rowAlignmentBits - 1) / rowAlignmentBits) * (rowAlignmentBits / 64)),
+      bits((std::size_t)rowWords * height, 0), version(0) {
+    indexAll();
+}
+
+Grid::Grid(const Grid &other)
+    : width(other.width), height(other.height), rowWords(other.rowWords),
+      bits(other.bits), costs(other.costs), costCounts(other.costCounts),
+      version(other.version), emptySquares(other.emptySquares),
+      emptyPlaces(other.emptyPlaces) { }
+
+Grid &Grid::operator=(const Grid &other) {
+    if (this == &other)
+        return *this;
+
+    width = other.width;
+    height = other.height;
+    rowWords = other.rowWords;
+    bits = other.bits;
+    costs = other.costs;
+    costCounts = other.costCounts;
+    version = other.version;
+    emptySquares = other.emptySquares;
+    emptyPlaces = other.emptyPlaces;
+
+    // Observers were watching our old contents, so everything has changed
+    notifyReset();
+
+    return *this;
+}
+
+void Grid::swap(Grid &other) {
+    if (this == &other)
+        return;
+
+    std::swap(width, other.width);
+    std::swap(height, other.height);
+    std::swap(rowWords, other.rowWords);
+    bits.swap(other.bits);
+    costs.swap(other.costs);
+    costCounts.swap(other.costCounts);
+    std::swap(version, other.version);
+    emptySquares.swap(other.emptySquares);
+    emptyPlaces.swap(other.emptyPlaces);
+
+    notifyReset();
+    other.notifyReset();
+}
+
+Grid::gridMap Grid::getGrid() const {
+    gridMap grid;
 
-Grid::Grid(int width, int height) {
-    std::srand(std::time(0));
-        
     for (int x = 0; x < width; ++x)
         for (int y = 0; y < height; ++y)
-            grid[Point(x, y)] = EMPTY;
+            grid[Point(x, y)] = getSquare(Point(x, y));
+
+    return grid;
 }
 
 void Grid::setSquare(Point p, Square s) {
-    grid[p] = s;
-}
+    if (p.getx() < 0 || p.gety() < 0 || p.getx() >= width || p.gety() >= height)
+        return;
+
+    Square previous = getSquare(p);
+
+    // Nothing to do, so don't invalidate anything
+    if (previous == s)
+        return;
 
-Square Grid::getSquare(Point p) const {
-    return grid.find(p)->second;
+    row(p.gety())[p.getx() >> 6] ^= (uint64_t)1 << (p.getx() & 63);
+
+    if (s == FULL)
+        removeEmpty(p.gety() * width + p.getx());
+    else
+        addEmpty(p.gety() * width + p.getx());
+
+    notifySquareChanged(p, previous);
 }
 
-Point Grid::getDimensions() const {
-    Point max;
-        
-    // Iterate through each grid point, getting the maximum point
-    for (gridMap::const_iterator it = grid.begin(); it != grid.end(); ++it) {
-        int newMax;
-                
-	// If the new max has a greater x-component, set the current max's
-	// x-component to it
-        if ((newMax = it->first.getx()) > max.getx())
-            max.setx(newMax);
-                
-	// Same for y-component
-        if ((newMax = it->first.gety()) > max.gety())
-            max.sety(newMax);
+void Grid::setCost(Point p, uint8_t cost) {
+    if (p.getx() < 0 || p.gety() < 0 || p.getx() >= width || p.gety() >= height)
+        return;
+
+    if (cost == 0)
+        cost = 1;
+
+    uint8_t previous = getCost(p);
+    if (previous == cost)
+        return;
+
+    // First multiplier other than 1, so the layer is needed now
+    if (costs.empty()) {
+        costs.assign((std::size_t)width * height, 1);
+        costCounts.assign(256, 0);
+        costCounts[1] = width * height;
     }
-        
-    // Add one to the max, so that max is equal to the width and height
-    return max + Point(1, 1);
+
+    costs[p.gety() * width + p.getx()] = cost;
+    --costCounts[previous];
+    ++costCounts[cost];
+
+    notifyCostChanged(p, previous);
 }
 
-int Grid::getWidth() const
-{
-    return getDimensions().getx();
+int Grid::getMinCost() const {
+    if (costs.empty())
+        return 1;
+
+    for (int cost = 1; cost < 256; ++cost) {
+        if (costCounts[cost] != 0)
+            return cost;
+    }
+
+    return 1;
 }
 
-int Grid::getHeight() const
-{
-    return getDimensions().gety();
+void Grid::clearCosts() {
+    costs.clear();
+    costCounts.clear();
+
+    notifyReset();
 }
 
 std::set<Point> Grid::getNeighbours(const Point &p) const {
@@ -70,10 +149,8 @@ std::set<Point> Grid::getNeighbours(const Point &p) const {
                 continue;
             }
                         
-	    // If the point is on the grid, add to the list of points to return
-            if (grid.find(Point(x, y)) != grid.end()) {
-                points.insert(Point(x, y));
-            }
+	    // The point is on the grid, so add to the list of points to return
+            points.insert(Point(x, y));
         }
                 
     return points;
@@ -95,9 +172,8 @@ std::set<Point> Grid::getEmptyNeighbours(const Point &p) const {
                 continue;
             }
                         
-	    /* If the point is on the grid and it is empty, add to the list of
-	       points to return */
-            if (grid.find(Point(x, y)) != grid.end() && getSquare(Point(x, y)) == EMPTY) {
+	    // If the point is empty, add to the list of points to return
+            if (getSquare(Point(x, y)) == EMPTY) {
                 points.insert(Point(x, y));
             }
         }
@@ -106,46 +182,199 @@ std::set<Point> Grid::getEmptyNeighbours(const Point &p) const {
 }
 
 Point Grid::getEmptyPoint() const {
-    Point dim = getDimensions();
-    int x, y;
+    if (emptySquares.empty())
+        return Point(-1, -1);
+
+    // Scaled rather than taken modulo the count, as RAND_MAX may be small
+    int i = emptySquares[(std::size_t)(std::rand() / (RAND_MAX + 1.0) * emptySquares.size())];
+    return Point(i % width, i / width);
+}
+
+Point Grid::getEmptyPoint(Random &random) const {
+    if (emptySquares.empty())
+        return Point(-1, -1);
+
+    int i = emptySquares[random.nextBelow(emptySquares.size())];
+    return Point(i % width, i / width);
+}
+
+Point Grid::getNearestEmpty(const Point &p) const {
+    Point nearest(-1, -1);
+    long nearestDistance = -1;
+
+    // Past this ring every square of the grid has been looked at
+    int furthest = std::max(std::max(p.getx(), width - 1 - p.getx()),
+                            std::max(p.gety(), height - 1 - p.gety()));
+
+    // Look in growing rings of squares around `p`. Every square of ring r is
+    // at least r away, so stop at the first ring no nearer than the nearest
+    for (long r = 0; r <= furthest && (nearestDistance == -1 || r * r < nearestDistance); ++r) {
+        int x0 = p.getx() - r, x1 = p.getx() + r;
+        int y0 = p.gety() - r, y1 = p.gety() + r;
+
+        for (int y = std::max(y0, 0); y <= std::min(y1, height - 1); ++y) {
+            // The whole of the ring's top and bottom rows, and only the two
+            // ends of the others
+            bool edge = y == y0 || y == y1;
+            int step = edge || x1 == x0 ? 1 : x1 - x0;
+            int x = edge ? std::max(x0, 0) : x0;
 
-    // Generate random points until we generate an empty point
-    do {
-        x = std::rand() % dim.getx();
-        y = std::rand() % dim.gety();
-    } while (getSquare(Point(x, y)) == FULL);
+            for (; x <= x1 && x < width; x += step) {
+                if (x < 0 || getSquare(Point(x, y)) == FULL)
+                    continue;
 
-    return Point(x, y);
+                long dx = x - p.getx(), dy = y - p.gety();
+                long distance = dx * dx + dy * dy;
+                if (nearestDistance == -1 || distance < nearestDistance) {
+                    nearest = Point(x, y);
+                    nearestDistance = distance;
+                }
+            }
+        }
+    }
+
+    return nearest;
+}
+
+int Grid::countEmpty() const {
+    return (int)emptySquares.size();
 }
 
 Grid &Grid::populate(int nFull) {
-    // If greater than size of grid, set every square to full (for speed)
-    if (nFull > (getWidth() * getHeight())) {
-        for (int x = 0; x < getWidth(); ++x)
-            for (int y = 0; y < getHeight(); ++y)
-                grid[Point(x, y)] = FULL;
-        
+    Random random(std::time(0));
+    return populate(nFull, random);
+}
+
+Grid &Grid::populate(int nFull, Random &random) {
+    int nEmpty = (int)emptySquares.size();
+
+    // If more than the empty squares, set every square to full (for speed)
+    if (nFull >= nEmpty) {
+        fillRect(0, 0, width, height, FULL);
         return *this;
     }
-        
-    // Else randomly set points
-    for (int i = 0; i < nFull; ++i) {
-        Point dim = getDimensions();
-                
-        int x = std::rand() % dim.getx();
-        int y = std::rand() % dim.gety();
-                
-        grid[Point(x, y)] = FULL;
+
+    if (nFull <= 0)
+        return *this;
+
+    if (nFull < nEmpty / 16) {
+        // Few enough that random picks rarely land on a full square, so just
+        // retry those until we have added enough
+        for (int added = 0; added < nFull; ) {
+            int x = random.nextBelow(width);
+            int y = random.nextBelow(height);
+
+            uint64_t &word = row(y)[x >> 6];
+            uint64_t bit = (uint64_t)1 << (x & 63);
+
+            if (!(word & bit)) {
+                word |= bit;
+                ++added;
+                removeEmpty(y * width + x);
+            }
+        }
+    } else {
+        // Otherwise pick from the empty squares in order, choosing each with
+        // probability needed/remaining, which gives exactly nFull of them
+        int needed = nFull;
+        int remaining = nEmpty;
+
+        for (int y = 0; y < height && needed > 0; ++y) {
+            uint64_t *r = row(y);
+
+            for (int x = 0; x < width && needed > 0; ++x) {
+                uint64_t bit = (uint64_t)1 << (x & 63);
+                if (r[x >> 6] & bit)
+                    continue;
+
+                if ((int)random.nextBelow(remaining) < needed) {
+                    r[x >> 6] |= bit;
+                    --needed;
+                    removeEmpty(y * width + x);
+                }
+
+                --remaining;
+            }
+        }
     }
 
+    notifyReset();
     return *this;
 }
 
 void Grid::clear() {
-    for (int y = 0; y < getHeight(); ++y)
-        for (int x = 0; x < getWidth(); ++x)
-            grid[Point(x, y)] = EMPTY;
+    if (!bits.empty())
+        fillWords(&bits[0], bits.size(), 0);
+
+    indexAll();
+    notifyReset();
+}
+
+void Grid::fillRect(int x, int y, int w, int h, Square s) {
+    // Clip to the grid
+    int x1 = std::min(x + w, width);
+    int y1 = std::min(y + h, height);
+    x = std::max(x, 0);
+    y = std::max(y, 0);
+
+    if (x >= x1 || y >= y1)
+        return;
+
+    for (int j = y; j < y1; ++j)
+        fillBits(row(j), x, x1, s == FULL);
+
+    indexRect(x, y, x1, y1);
+    notifyReset();
+}
+
+void Grid::copyRegion(const Grid &src, int srcx, int srcy, int w, int h,
+                      int dstx, int dsty) {
+    // Clip the source rectangle to the source grid, moving the destination too
+    if (srcx < 0) { w += srcx; dstx -= srcx; srcx = 0; }
+    if (srcy < 0) { h += srcy; dsty -= srcy; srcy = 0; }
+
+    // And the destination rectangle to this grid
+    if (dstx < 0) { w += dstx; srcx -= dstx; dstx = 0; }
+    if (dsty < 0) { h += dsty; srcy -= dsty; dsty = 0; }
+
+    w = std::min(w, std::min(src.width - srcx, width - dstx));
+    h = std::min(h, std::min(src.height - srcy, height - dsty));
+
+    if (w <= 0 || h <= 0)
+        return;
+
+    for (int j = 0; j < h; ++j)
+        copyBits(src.row(srcy + j), srcx, row(dsty + j), dstx, w);
+
+    indexRect(dstx, dsty, dstx + w, dsty + h);
+    notifyReset();
+}
+
+bool Grid::sameSquares(const Grid &other) const {
+    if (width != other.width || height != other.height || bits != other.bits)
+        return false;
+
+    // A grid without the cost layer has every multiplier 1, as one with it
+    // might too
+    if (costs.empty() != other.costs.empty()) {
+        const Grid &layered = costs.empty() ? other : *this;
+        return layered.costCounts[1] == width * height;
+    }
+
+    return costs == other.costs;
+}
 
+int Grid::countFull() const {
+    // Padding bits are always zero, so the whole buffer can be counted at once
+    return bits.empty() ? 0 : (int)countWords(&bits[0], bits.size());
+}
+
+void Grid::invert() {
+    for (int y = 0; y < height; ++y)
+        invertBits(row(y), 0, width);
+
+    indexRect(0, 0, width, height);
+    notifyReset();
 }
 
 std::string Grid::toString() const {
@@ -183,6 +412,76 @@ std::string Grid::toStringWithPath(Path path) const {
     return ss.str();
 }
 
+void Grid::attach(GridObserver *observer) {
+    if (std::find(observers.begin(), observers.end(), observer) == observers.end())
+        observers.push_back(observer);
+}
+
+void Grid::detach(GridObserver *observer) {
+    observers.erase(std::remove(observers.begin(), observers.end(), observer),
+                    observers.end());
+}
+
+void Grid::notifySquareChanged(const Point &p, Square previous) {
+    ++version;
+
+    for (std::size_t i = 0; i < observers.size(); ++i)
+        observers[i]->squareChanged(*this, p, previous);
+}
+
+void Grid::notifyCostChanged(const Point &p, uint8_t previous) {
+    ++version;
+
+    for (std::size_t i = 0; i < observers.size(); ++i)
+        observers[i]->costChanged(*this, p, previous);
+}
+
+void Grid::notifyReset() {
+    ++version;
+
+    for (std::size_t i = 0; i < observers.size(); ++i)
+        observers[i]->gridReset(*this);
+}
+
+void Grid::indexAll() {
+    emptySquares.resize((std::size_t)width * height);
+    emptyPlaces.resize((std::size_t)width * height);
+
+    for (int i = 0; i < width * height; ++i)
+        emptySquares[i] = emptyPlaces[i] = i;
+}
+
+void Grid::indexRect(int x0, int y0, int x1, int y1) {
+    for (int y = y0; y < y1; ++y) {
+        const uint64_t *r = row(y);
+
+        for (int x = x0; x < x1; ++x) {
+            int i = y * width + x;
+            bool full = (r[x >> 6] >> (x & 63)) & 1;
+
+            if (full && emptyPlaces[i] != -1)
+                removeEmpty(i);
+            else if (!full && emptyPlaces[i] == -1)
+                addEmpty(i);
+        }
+    }
+}
+
+void Grid::addEmpty(int i) {
+    emptyPlaces[i] = (int)emptySquares.size();
+    emptySquares.push_back(i);
+}
+
+void Grid::removeEmpty(int i) {
+    int place = emptyPlaces[i];
+    int last = emptySquares.back();
+
+    emptySquares[place] = last;
+    emptyPlaces[last] = place;
+    emptySquares.pop_back();
+    emptyPlaces[i] = -1;
+}
+
 std::ostream& operator<<(std::ostream &os, const Grid &grid) {
     return os << grid.toString();
 }
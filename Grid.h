@@ -3,51 +3,142 @@
 
 #include <map>
 #include <set>
+#include <stdint.h>
 #include <string>
 #include <vector>
 
+#include "Movement.h"
 #include "Point.h"
+#include "Random.h"
 #include "Square.h"
 
 typedef std::vector<Point> Path;
 
+class Grid;
+
 /**
- * Class that represents a Grid of Squares as an interface to a map from Point
- * to Square
+ * Interface for objects that keep state derived from a Grid (caches, labels,
+ * etc.) and need to be told when it changes. Attach with Grid::attach().
+ */
+class GridObserver {
+ public:
+    virtual ~GridObserver() { }
+
+    /**
+     * Called after the Square at `p` has changed from `previous` to its
+     * current value in `grid`
+     */
+    virtual void squareChanged(const Grid &grid, const Point &p, Square previous) = 0;
+
+    /**
+     * Called after the cost multiplier of `p` has changed from `previous` to
+     * its current value in `grid`
+     */
+    virtual void costChanged(const Grid &grid, const Point &p, uint8_t previous) = 0;
+
+    /**
+     * Called after a bulk change (clear, populate, ...) that may have touched
+     * any Square of `grid`
+     */
+    virtual void gridReset(const Grid &grid) = 0;
+};
+
+/**
+ * Class that represents a rectangular Grid of Squares with the first Point at
+ * (0, 0). Squares are stored one bit each (set for FULL) in rows padded to
+ * rowAlignmentBits, so bulk operations work on whole words at a time.
+ *
+ * Each Square also has a traversal cost multiplier from 1 to 255 (slow
+ * terrain), stored a byte each. Grids where every multiplier is 1 don't
+ * allocate the cost layer at all.
+ *
+ * Random EMPTY squares are picked from an index of them that every change
+ * keeps up to date, so picking one only reads the grid, and several threads
+ * can do so at once, each with its own Random.
  */
 class Grid {
  public:
     Grid(int width, int height);
+
+    /**
+     * Copies take the squares, costs and version of `other` but not its
+     * observers. Assigning then tells this grid's observers of a reset,
+     * which counts as a change, so its version ends up one past `other`'s.
+     * Versions only tell apart states of the same Grid
+     */
+    Grid(const Grid &other);
+    Grid &operator=(const Grid &other);
+
+    /**
+     * Exchange the squares, costs and version with `other` without copying
+     * them, but not the observers, which on both sides are told of a reset
+     * as for assignment
+     */
+    void swap(Grid &other);
 	
     typedef std::map<Point, Square> gridMap;
 
     /**
-     * Return the grid map
+     * Return the grid as a map from Point to Square. This is built on every
+     * call, so avoid it on anything but small grids
      */
-    gridMap getGrid() const { return grid; }
+    gridMap getGrid() const;
 
     /**
-     * Set the Square at point `p` to `s`
+     * Set the Square at point `p` to `s`. Points outside the grid are ignored
      */
     void setSquare(Point p, Square s);
 
     /**
-     * Return the square at point `p`
+     * Return the square at point `p`, treating points outside the grid as FULL
      */
-    Square getSquare(Point p) const;
+    Square getSquare(Point p) const {
+        if (p.getx() < 0 || p.gety() < 0 || p.getx() >= width || p.gety() >= height)
+            return FULL;
+
+        return ((row(p.gety())[p.getx() >> 6] >> (p.getx() & 63)) & 1) ? FULL : EMPTY;
+    }
 	
+    /**
+     * Set the cost multiplier of the Square at `p` to `cost`, treating 0 as 1.
+     * Points outside the grid are ignored
+     */
+    void setCost(Point p, uint8_t cost);
+
+    /**
+     * Return the cost multiplier of the Square at `p`, 1 outside the grid
+     */
+    uint8_t getCost(Point p) const {
+        if (costs.empty() || p.getx() < 0 || p.gety() < 0 ||
+            p.getx() >= width || p.gety() >= height)
+            return 1;
+
+        return costs[p.gety() * width + p.getx()];
+    }
+
+    /**
+     * Return the smallest cost multiplier of any Square, for scaling
+     * heuristics so that they stay admissible
+     */
+    int getMinCost() const;
+
+    /**
+     * Reset every cost multiplier to 1
+     */
+    void clearCosts();
+
     /**
      * Return a Point representing the maximum x and y value _plus one_ of the
      * grid which is equal to the width and height assuming that the first grid
      * Point is at (0, 0)
      */
-    Point getDimensions() const;
+    Point getDimensions() const { return Point(width, height); }
 
     /**
      * Return the x or y coordinate of the above
      */
-    int getWidth() const;
-    int getHeight() const;
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
 	
     /**
      * Return a set of points that are adjacent either cardinally or diagonally
@@ -61,22 +152,95 @@ class Grid {
      * Same as above but only returns neighbours that are EMPTY Squares
      */
     std::set<Point> getEmptyNeighbours(const Point &p) const;
+
+    /**
+     * Return a mask with bit i set if the neighbour (moveDx[i], moveDy[i])
+     * away from `p` is EMPTY (see Movement.h)
+     */
+    unsigned getEmptyMask(const Point &p) const {
+        unsigned mask = 0;
+        for (int i = 0; i < 8; ++i) {
+            Point q(p.getx() + moveDx[i], p.gety() + moveDy[i]);
+            mask |= (unsigned)(getSquare(q) == EMPTY) << i;
+        }
+
+        return mask;
+    }
+
+    /**
+     * Return the mask of the moves from `p` allowed under `M`, without
+     * building a set of Points like getEmptyNeighbours()
+     */
+    template <Movement M>
+    unsigned getMoves(const Point &p) const { return allowedMoves<M>(getEmptyMask(p)); }
+
+    unsigned getMoves(const Point &p, Movement movement) const {
+        return allowedMoves(getEmptyMask(p), movement);
+    }
 	
     /**
-     * Get Point corresponding to a random EMPTY Square on the grid.
-     * Can be slow if on a well-populated grid.
+     * Return a random EMPTY Square, each as likely as any other, in constant
+     * time however full the grid is, or (-1, -1) if every Square is FULL.
+     * Without `random`, uses std::rand()
      */
     Point getEmptyPoint() const;
+    Point getEmptyPoint(Random &random) const;
+
+    /**
+     * Return the EMPTY Square nearest `p` in a straight line, `p` itself if
+     * it is EMPTY, or (-1, -1) if every Square is FULL. `p` may be off the
+     * grid. Takes time in proportion to the square of the distance
+     */
+    Point getNearestEmpty(const Point &p) const;
+
+    /**
+     * Return the number of EMPTY Squares
+     */
+    int countEmpty() const;
 
     /**
-     * Add `nFull` random FULL squares to the grid, returning the grid
+     * Turn exactly `nFull` random EMPTY squares FULL (or all of them if there
+     * are fewer), returning the grid. Without `random`, uses a generator
+     * seeded from the time
      */
     Grid &populate(int nFull);
+    Grid &populate(int nFull, Random &random);
 	
     /**
      * Reset current grid so that all squares are EMPTY
      */
     void clear();
+
+    /**
+     * Set every Square in the `w` by `h` rectangle with top-left corner (x, y)
+     * to `s`, clipping the rectangle to the grid
+     */
+    void fillRect(int x, int y, int w, int h, Square s);
+
+    /**
+     * Copy the `w` by `h` rectangle of `src` with top-left corner (srcx, srcy)
+     * to the rectangle of this grid with top-left corner (dstx, dsty),
+     * clipping it to both grids. `src` may be this grid as long as the two
+     * rectangles don't overlap
+     */
+    void copyRegion(const Grid &src, int srcx, int srcy, int w, int h,
+                    int dstx, int dsty);
+
+    /**
+     * Return true if `other` is the same size with the same Squares and cost
+     * multipliers, comparing the Squares a word at a time
+     */
+    bool sameSquares(const Grid &other) const;
+
+    /**
+     * Return the number of FULL Squares
+     */
+    int countFull() const;
+
+    /**
+     * Swap every EMPTY Square for FULL and vice versa
+     */
+    void invert();
 	
     /**
      * Render the grid as a string using toCharRep(Square) to render the Squares
@@ -87,8 +251,71 @@ class Grid {
      * Same as above but overlaying `path` over the top represented by '.'
      */
     std::string toStringWithPath(Path path) const;
+
+    /**
+     * Mutation counter, incremented every time a Square or cost is changed. Two equal
+     * versions of the same Grid object are guaranteed to have equal contents
+     */
+    unsigned long getVersion() const { return version; }
+
+    /**
+     * Register or unregister `observer` to be notified of changes. The
+     * observer must detach itself before it is destroyed
+     */
+    void attach(GridObserver *observer);
+    void detach(GridObserver *observer);
  private:
-    gridMap grid;
+    int width;
+    int height;
+
+    /* 64-bit words in each padded row */
+    int rowWords;
+
+    /* Bit x % 64 of word y * rowWords + x / 64 is set if (x, y) is FULL */
+    std::vector<uint64_t> bits;
+
+    uint64_t *row(int y) { return &bits[y * rowWords]; }
+    const uint64_t *row(int y) const { return &bits[y * rowWords]; }
+
+    /* Cost multiplier of (x, y) at y * width + x, or empty if all are 1 */
+    std::vector<uint8_t> costs;
+
+    /* Number of Squares with each cost multiplier, if `costs` isn't empty */
+    std::vector<int> costCounts;
+
+    unsigned long version;
+
+    /* Every EMPTY Square (y * width + x) in no particular order, and each
+       Square's place in it, or -1 if FULL */
+    std::vector<int> emptySquares;
+    std::vector<int> emptyPlaces;
+
+    std::vector<GridObserver*> observers;
+
+    /**
+     * Index every Square, in order, for a grid that is all EMPTY
+     */
+    void indexAll();
+
+    /**
+     * Bring the index up to date with the Squares of the rectangle from
+     * (x0, y0) up to but not including (x1, y1), after a bulk change to them
+     */
+    void indexRect(int x0, int y0, int x1, int y1);
+
+    /**
+     * Add Square `i` to the index, or take it out with the last one
+     * moved into its place
+     */
+    void addEmpty(int i);
+    void removeEmpty(int i);
+
+    /**
+     * Bump the version and tell every observer about the change
+     */
+    void notifySquareChanged(const Point &p, Square previous);
+    void notifyCostChanged(const Point &p, uint8_t previous);
+    void notifyReset();
 };
 
 /**
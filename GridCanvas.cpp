@@ -0,0 +1,357 @@
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <FL/Fl.H>
+#include <FL/fl_draw.H>
+
+#include "GridCanvas.h"
+
+/* Limits on the zoom, in pixels per Square */
+static const double minScale = 1.0 / 64;
+static const double maxScale = 64;
+
+/* Cost multiplier at which EMPTY Squares are drawn fully in costColor */
+static const int maxShadedCost = 9;
+
+/* Smallest scale at which gaps are left between Squares, and labels drawn */
+static const double gapScale = 6;
+static const double labelScale = 12;
+
+GridCanvas::GridCanvas(int x, int y, int w, int h, Grid *grid)
+    : Fl_Widget(x, y, w, h), emptyColor(FL_WHITE), fullColor(FL_RED),
+      costColor(fl_rgb_color(150, 100, 40)), backgroundColor(FL_GRAY), grid(grid), scale(20), originx(0), originy(0),
+      panx(0), pany(0), panOriginx(0), panOriginy(0), panning(false)
+{
+    grid->attach(this);
+    fit();
+}
+
+GridCanvas::~GridCanvas()
+{
+    grid->detach(this);
+}
+
+void GridCanvas::setOverlay(const Point &p, Fl_Color color)
+{
+    std::map<Point, Fl_Color>::iterator it = overlays.find(p);
+    if (it != overlays.end() && it->second == color)
+        return;
+
+    overlays[p] = color;
+    damageCell(p);
+}
+
+void GridCanvas::clearOverlay(const Point &p)
+{
+    if (overlays.erase(p) != 0)
+        damageCell(p);
+}
+
+void GridCanvas::clearOverlays()
+{
+    for (std::map<Point, Fl_Color>::const_iterator it = overlays.begin();
+         it != overlays.end(); ++it)
+        damageCell(it->first);
+
+    overlays.clear();
+}
+
+void GridCanvas::setLabel(const Point &p, const std::string &label)
+{
+    labels[p] = label;
+    damageCell(p);
+}
+
+void GridCanvas::clearLabel(const Point &p)
+{
+    if (labels.erase(p) != 0)
+        damageCell(p);
+}
+
+void GridCanvas::clearLabels()
+{
+    for (std::map<Point, std::string>::const_iterator it = labels.begin();
+         it != labels.end(); ++it)
+        damageCell(it->first);
+
+    labels.clear();
+}
+
+void GridCanvas::squareChanged(const Grid &grid, const Point &p, Square previous)
+{
+    damageCell(p);
+}
+
+void GridCanvas::costChanged(const Grid &grid, const Point &p, uint8_t previous)
+{
+    damageCell(p);
+}
+
+void GridCanvas::gridReset(const Grid &grid)
+{
+    redraw();
+}
+
+Point GridCanvas::cellAt(int px, int py) const
+{
+    return Point((int)std::floor(originx + (px - x()) / scale),
+                 (int)std::floor(originy + (py - y()) / scale));
+}
+
+void GridCanvas::fit(double maxScale)
+{
+    originx = 0;
+    originy = 0;
+    scale = maxScale;
+
+    if (grid->getWidth() > 0 && grid->getHeight() > 0)
+        scale = std::min(maxScale, std::min((double)w() / grid->getWidth(),
+                                            (double)h() / grid->getHeight()));
+
+    scale = std::max(scale, minScale);
+    redraw();
+}
+
+int GridCanvas::left(int cx) const
+{
+    return x() + (int)std::floor((cx - originx) * scale);
+}
+
+int GridCanvas::top(int cy) const
+{
+    return y() + (int)std::floor((cy - originy) * scale);
+}
+
+void GridCanvas::damageCell(const Point &p)
+{
+    int l = left(p.getx());
+    int t = top(p.gety());
+
+    // At least a pixel, as zoomed out Squares share pixels
+    int cw = std::max(left(p.getx() + 1) - l, 1);
+    int ch = std::max(top(p.gety() + 1) - t, 1);
+
+    // Off screen, so nothing to redraw
+    if (l + cw <= x() || t + ch <= y() || l >= x() + w() || t >= y() + h())
+        return;
+
+    damage(FL_DAMAGE_USER1, l, t, cw, ch);
+}
+
+Fl_Color GridCanvas::colorOf(const Point &p) const
+{
+    std::map<Point, Fl_Color>::const_iterator it = overlays.find(p);
+    if (it != overlays.end())
+        return it->second;
+
+    return squareColor(p);
+}
+
+Fl_Color GridCanvas::squareColor(const Point &p) const
+{
+    if (grid->getSquare(p) == FULL)
+        return fullColor;
+
+    int cost = std::min((int)grid->getCost(p), maxShadedCost);
+    if (cost == 1)
+        return emptyColor;
+
+    return fl_color_average(costColor, emptyColor,
+                            (float)(cost - 1) / (maxShadedCost - 1));
+}
+
+void GridCanvas::draw()
+{
+    // Only draw what was damaged, which is all of it after a full redraw
+    int cx, cy, cw, ch;
+    fl_clip_box(x(), y(), w(), h(), cx, cy, cw, ch);
+
+    if (cw <= 0 || ch <= 0)
+        return;
+
+    fl_push_clip(cx, cy, cw, ch);
+
+    fl_color(backgroundColor);
+    fl_rectf(cx, cy, cw, ch);
+
+    if (scale >= 1)
+        drawCells(cx, cy, cw, ch);
+    else
+        drawSampled(cx, cy, cw, ch);
+
+    fl_pop_clip();
+}
+
+void GridCanvas::drawCells(int cx, int cy, int cw, int ch)
+{
+    // Range of Squares covering the clip rectangle, limited to the grid
+    Point first = cellAt(cx, cy);
+    Point last = cellAt(cx + cw - 1, cy + ch - 1);
+
+    int x0 = std::max(first.getx(), 0);
+    int y0 = std::max(first.gety(), 0);
+    int x1 = std::min(last.getx(), grid->getWidth() - 1);
+    int y1 = std::min(last.gety(), grid->getHeight() - 1);
+
+    int gap = scale >= gapScale ? 1 : 0;
+
+    for (int j = y0; j <= y1; ++j) {
+        int t = top(j);
+        int b = top(j + 1);
+
+        for (int i = x0; i <= x1; ++i) {
+            int l = left(i);
+            int r = left(i + 1);
+
+            fl_color(colorOf(Point(i, j)));
+            fl_rectf(l, t, r - l - gap, b - t - gap);
+        }
+    }
+
+    if (scale < labelScale)
+        return;
+
+    fl_color(FL_BLACK);
+    fl_font(FL_HELVETICA, (int)std::min(scale * 0.6, 24.0));
+
+    for (std::map<Point, std::string>::const_iterator it = labels.begin();
+         it != labels.end(); ++it) {
+        int i = it->first.getx();
+        int j = it->first.gety();
+
+        if (i < x0 || i > x1 || j < y0 || j > y1)
+            continue;
+
+        fl_draw(it->second.c_str(), left(i), top(j), left(i + 1) - left(i),
+                top(j + 1) - top(j), FL_ALIGN_CENTER);
+    }
+}
+
+/* Split `color` into its red, green and blue parts */
+static void toRGB(Fl_Color color, unsigned char *rgb)
+{
+    Fl::get_color(color, rgb[0], rgb[1], rgb[2]);
+}
+
+void GridCanvas::drawSampled(int cx, int cy, int cw, int ch)
+{
+    // Colours of FULL Squares then EMPTY Squares of each shaded cost
+    unsigned char palette[maxShadedCost + 1][3], background[3];
+    toRGB(fullColor, palette[0]);
+    toRGB(backgroundColor, background);
+
+    for (int cost = 1; cost <= maxShadedCost; ++cost) {
+        toRGB(fl_color_average(costColor, emptyColor,
+                               (float)(cost - 1) / (maxShadedCost - 1)),
+              palette[cost]);
+    }
+
+    // One pixel per sampled Square, taken at the centre of the pixel
+    std::vector<unsigned char> image(cw * ch * 3);
+
+    for (int py = 0; py < ch; ++py) {
+        int j = (int)std::floor(originy + (cy - y() + py + 0.5) / scale);
+
+        for (int px = 0; px < cw; ++px) {
+            int i = (int)std::floor(originx + (cx - x() + px + 0.5) / scale);
+
+            Point p(i, j);
+
+            const unsigned char *rgb;
+            if (i < 0 || j < 0 || i >= grid->getWidth() || j >= grid->getHeight())
+                rgb = background;
+            else if (grid->getSquare(p) == FULL)
+                rgb = palette[0];
+            else
+                rgb = palette[std::min((int)grid->getCost(p), maxShadedCost)];
+
+            std::copy(rgb, rgb + 3, &image[(py * cw + px) * 3]);
+        }
+    }
+
+    fl_draw_image(&image[0], cx, cy, cw, ch);
+
+    // Overlays are sparse, so draw each one as a pixel on top rather than
+    // looking them up for every pixel
+    for (std::map<Point, Fl_Color>::const_iterator it = overlays.begin();
+         it != overlays.end(); ++it) {
+        int l = left(it->first.getx());
+        int t = top(it->first.gety());
+
+        if (l < cx || t < cy || l >= cx + cw || t >= cy + ch)
+            continue;
+
+        fl_color(it->second);
+        fl_rectf(l, t, 1, 1);
+    }
+}
+
+int GridCanvas::handle(int event)
+{
+    switch (event) {
+    case FL_PUSH:
+        // Left clicks on the grid edit it, other buttons pan
+        if (Fl::event_button() == FL_LEFT_MOUSE) {
+            Point p = cellAt(Fl::event_x(), Fl::event_y());
+
+            if (p.getx() >= 0 && p.gety() >= 0 &&
+                p.getx() < grid->getWidth() && p.gety() < grid->getHeight()) {
+                clickedCell = p;
+                do_callback();
+            }
+
+            return 1;
+        }
+
+        panning = true;
+        panx = Fl::event_x();
+        pany = Fl::event_y();
+        panOriginx = originx;
+        panOriginy = originy;
+        return 1;
+
+    case FL_DRAG:
+        // Dragging the left button paints over the Squares it passes
+        if (!panning) {
+            Point p = cellAt(Fl::event_x(), Fl::event_y());
+
+            if (p != clickedCell && p.getx() >= 0 && p.gety() >= 0 &&
+                p.getx() < grid->getWidth() && p.gety() < grid->getHeight()) {
+                clickedCell = p;
+                do_callback();
+            }
+
+            return 1;
+        }
+
+        originx = panOriginx - (Fl::event_x() - panx) / scale;
+        originy = panOriginy - (Fl::event_y() - pany) / scale;
+        redraw();
+        return 1;
+
+    case FL_RELEASE:
+        panning = false;
+        return 1;
+
+    case FL_MOUSEWHEEL: {
+        // Zoom keeping the point under the mouse still
+        double mx = (Fl::event_x() - x()) / scale + originx;
+        double my = (Fl::event_y() - y()) / scale + originy;
+
+        double factor = Fl::event_dy() < 0 ? 1.25 : 0.8;
+        scale = std::max(minScale, std::min(maxScale, scale * factor));
+
+        originx = mx - (Fl::event_x() - x()) / scale;
+        originy = my - (Fl::event_y() - y()) / scale;
+        redraw();
+        return 1;
+    }
+
+    case FL_ENTER:
+        // Ask for the mouse wheel events that follow
+        return 1;
+    }
+
+    return Fl_Widget::handle(event);
+}
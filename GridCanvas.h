@@ -0,0 +1,138 @@
+#ifndef GRID_CANVAS_H_
+#define GRID_CANVAS_H_
+
+#include <FL/Fl_Widget.H>
+#include <map>
+#include <string>
+
+#include "Grid.h"
+#include "Point.h"
+
+/**
+ * Widget drawing a whole Grid itself, instead of using one button per Square.
+ *
+ * Squares are drawn straight from the Grid, in `emptyColor` or `fullColor`,
+ * with sparse overlays (waypoints, paths) and labels drawn on top. The canvas
+ * observes its Grid, so changing a Square or overlay only damages the
+ * rectangle of that Square, and drawing only visits the Squares inside the
+ * damaged area. Bulk changes to the Grid redraw everything.
+ *
+ * EMPTY Squares with a cost multiplier above 1 are shaded towards
+ * `costColor`, reaching it at a multiplier of 9.
+ *
+ * The mouse wheel zooms around the pointer and dragging with the right or
+ * middle button pans. Left clicks call the widget's callback, with the clicked
+ * Square available from getClickedCell(), as does dragging the left button
+ * onto another Square (Fl::event() is then FL_DRAG). When zoomed out below one pixel per
+ * Square, each pixel shows a single sampled Square instead.
+ */
+class GridCanvas : public Fl_Widget, public GridObserver {
+ public:
+    GridCanvas(int x, int y, int w, int h, Grid *grid);
+    ~GridCanvas();
+
+    /**
+     * Draw `p` in `color` instead of the colour of its Square, or go back to
+     * the colour of its Square
+     */
+    void setOverlay(const Point &p, Fl_Color color);
+    void clearOverlay(const Point &p);
+    void clearOverlays();
+
+    /**
+     * Draw `label` over `p`, or remove the labels
+     */
+    void setLabel(const Point &p, const std::string &label);
+    void clearLabel(const Point &p);
+    void clearLabels();
+
+    /**
+     * GridObserver implementation, redrawing changed Squares
+     */
+    void squareChanged(const Grid &grid, const Point &p, Square previous);
+    void costChanged(const Grid &grid, const Point &p, uint8_t previous);
+    void gridReset(const Grid &grid);
+
+    /**
+     * Square under the last left click
+     */
+    Point getClickedCell() const { return clickedCell; }
+
+    /**
+     * Return the Square under the window coordinates (`px`, `py`), which may
+     * be off the grid
+     */
+    Point cellAt(int px, int py) const;
+
+    /**
+     * Zoom so that the whole grid fits, at most `maxScale` pixels per Square
+     */
+    void fit(double maxScale = 20);
+
+    /**
+     * Pixels per Square
+     */
+    double getScale() const { return scale; }
+
+    /**
+     * Colours of EMPTY and FULL Squares, of the most expensive EMPTY
+     * Squares, and of the background off the grid
+     */
+    Fl_Color emptyColor;
+    Fl_Color fullColor;
+    Fl_Color costColor;
+    Fl_Color backgroundColor;
+
+ protected:
+    void draw();
+    int handle(int event);
+
+ private:
+    Grid *grid;
+
+    /* Pixels per Square, and the Square coordinates of the top-left corner */
+    double scale;
+    double originx;
+    double originy;
+
+    std::map<Point, Fl_Color> overlays;
+    std::map<Point, std::string> labels;
+
+    Point clickedCell;
+
+    /**
+     * Colour of the Square at `p` itself, ignoring overlays
+     */
+    Fl_Color squareColor(const Point &p) const;
+
+    /* Mouse position and origin when a pan started */
+    int panx, pany;
+    double panOriginx, panOriginy;
+    bool panning;
+
+    /**
+     * Window x coordinate of the left edge of column `cx`, or the y
+     * coordinate of the top edge of row `cy`
+     */
+    int left(int cx) const;
+    int top(int cy) const;
+
+    /**
+     * Damage just the rectangle of `p`
+     */
+    void damageCell(const Point &p);
+
+    /**
+     * Colour `p` is drawn in, taking overlays into account
+     */
+    Fl_Color colorOf(const Point &p) const;
+
+    /**
+     * Draw the Squares in the clip rectangle one rectangle each, or sampled
+     * one per pixel when zoomed out
+     */
+    void drawCells(int cx, int cy, int cw, int ch);
+    void drawSampled(int cx, int cy, int cw, int ch);
+};
+
+#endif /* GRID_CANVAS_H_ */
@@ -0,0 +1,213 @@
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "GridKernels.h"
+
+/* Words of 64 bits per vector register */
+#if defined(__AVX2__)
+static const std::size_t vectorWords = 4;
+#elif defined(__SSE2__)
+static const std::size_t vectorWords = 2;
+#endif
+
+/* Mask with bits [from, to) set, where 0 <= from < to <= 64 */
+static inline uint64_t rangeMask(int from, int to) {
+    uint64_t upper = (to == 64) ? ~(uint64_t)0 : (((uint64_t)1 << to) - 1);
+    return upper & ~(((uint64_t)1 << from) - 1);
+}
+
+static inline int popcount(uint64_t word) {
+#if defined(__GNUC__)
+    return __builtin_popcountll(word);
+#else
+    // Parallel bit count for compilers without the builtin
+    word = word - ((word >> 1) & 0x5555555555555555ULL);
+    word = (word & 0x3333333333333333ULL) + ((word >> 2) & 0x3333333333333333ULL);
+    word = (word + (word >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+    return (int)((word * 0x0101010101010101ULL) >> 56);
+#endif
+}
+
+void fillWords(uint64_t *words, std::size_t n, uint64_t value) {
+    std::size_t i = 0;
+
+#if defined(__AVX2__)
+    __m256i v = _mm256_set1_epi64x((long long)value);
+    for (; i + vectorWords <= n; i += vectorWords)
+        _mm256_storeu_si256((__m256i*)(words + i), v);
+#elif defined(__SSE2__)
+    __m128i v = _mm_set1_epi64x((long long)value);
+    for (; i + vectorWords <= n; i += vectorWords)
+        _mm_storeu_si128((__m128i*)(words + i), v);
+#endif
+
+    for (; i < n; ++i)
+        words[i] = value;
+}
+
+/* XOR `n` words starting at `words` with `value` */
+static void xorWords(uint64_t *words, std::size_t n, uint64_t value) {
+    std::size_t i = 0;
+
+#if defined(__AVX2__)
+    __m256i v = _mm256_set1_epi64x((long long)value);
+    for (; i + vectorWords <= n; i += vectorWords) {
+        __m256i *p = (__m256i*)(words + i);
+        _mm256_storeu_si256(p, _mm256_xor_si256(_mm256_loadu_si256(p), v));
+    }
+#elif defined(__SSE2__)
+    __m128i v = _mm_set1_epi64x((long long)value);
+    for (; i + vectorWords <= n; i += vectorWords) {
+        __m128i *p = (__m128i*)(words + i);
+        _mm_storeu_si128(p, _mm_xor_si128(_mm_loadu_si128(p), v));
+    }
+#endif
+
+    for (; i < n; ++i)
+        words[i] ^= value;
+}
+
+void fillBits(uint64_t *row, int from, int to, bool value) {
+    if (from >= to)
+        return;
+
+    int first = from >> 6;
+    int last = (to - 1) >> 6;
+
+    // Whole range inside one word
+    if (first == last) {
+        uint64_t mask = rangeMask(from & 63, ((to - 1) & 63) + 1);
+        row[first] = value ? (row[first] | mask) : (row[first] & ~mask);
+        return;
+    }
+
+    // Partial words at either end, whole words in between
+    uint64_t head = rangeMask(from & 63, 64);
+    uint64_t tail = rangeMask(0, ((to - 1) & 63) + 1);
+
+    row[first] = value ? (row[first] | head) : (row[first] & ~head);
+    fillWords(row + first + 1, last - first - 1, value ? ~(uint64_t)0 : 0);
+    row[last] = value ? (row[last] | tail) : (row[last] & ~tail);
+}
+
+void invertBits(uint64_t *row, int from, int to) {
+    if (from >= to)
+        return;
+
+    int first = from >> 6;
+    int last = (to - 1) >> 6;
+
+    if (first == last) {
+        row[first] ^= rangeMask(from & 63, ((to - 1) & 63) + 1);
+        return;
+    }
+
+    row[first] ^= rangeMask(from & 63, 64);
+    xorWords(row + first + 1, last - first - 1, ~(uint64_t)0);
+    row[last] ^= rangeMask(0, ((to - 1) & 63) + 1);
+}
+
+/* Read `n` <= 64 bits of `row` starting at bit `from` */
+static inline uint64_t extractBits(const uint64_t *row, int from, int n) {
+    int word = from >> 6;
+    int offset = from & 63;
+
+    uint64_t bits = row[word] >> offset;
+
+    // Only touch the next word when the bits straddle it
+    if (offset != 0 && offset + n > 64)
+        bits |= row[word + 1] << (64 - offset);
+
+    return bits;
+}
+
+void copyBits(const uint64_t *src, int srcFrom, uint64_t *dst, int dstFrom, int n) {
+    /* Same alignment within a word, so the middle of the range is a straight
+       copy of whole words */
+    if ((srcFrom & 63) == (dstFrom & 63) && n > 64) {
+        int offset = srcFrom & 63;
+
+        if (offset != 0) {
+            int head = 64 - offset;
+            uint64_t mask = rangeMask(offset, 64);
+            uint64_t &word = dst[dstFrom >> 6];
+            word = (word & ~mask) | (src[srcFrom >> 6] & mask);
+
+            srcFrom += head;
+            dstFrom += head;
+            n -= head;
+        }
+
+        std::size_t words = n >> 6;
+        std::memcpy(dst + (dstFrom >> 6), src + (srcFrom >> 6), words * sizeof(uint64_t));
+
+        srcFrom += words * 64;
+        dstFrom += words * 64;
+        n -= words * 64;
+    }
+
+    // Otherwise shift the source bits into place one destination word at a time
+    while (n > 0) {
+        int offset = dstFrom & 63;
+        int chunk = (64 - offset < n) ? 64 - offset : n;
+
+        uint64_t mask = rangeMask(offset, offset + chunk);
+        uint64_t &word = dst[dstFrom >> 6];
+        word = (word & ~mask) | ((extractBits(src, srcFrom, chunk) << offset) & mask);
+
+        srcFrom += chunk;
+        dstFrom += chunk;
+        n -= chunk;
+    }
+}
+
+std::size_t countWords(const uint64_t *words, std::size_t n) {
+    std::size_t i = 0;
+    std::size_t count = 0;
+
+#if defined(__AVX2__)
+    /* Count bits per nibble with a shuffle lookup table, then sum the bytes
+       of each 64-bit lane with a SAD against zero */
+    const __m256i table = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                           0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i low = _mm256_set1_epi8(0x0f);
+    __m256i total = _mm256_setzero_si256();
+
+    for (; i + vectorWords <= n; i += vectorWords) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(words + i));
+        __m256i lo = _mm256_shuffle_epi8(table, _mm256_and_si256(v, low));
+        __m256i hi = _mm256_shuffle_epi8(table, _mm256_and_si256(_mm256_srli_epi16(v, 4), low));
+        total = _mm256_add_epi64(total, _mm256_sad_epu8(_mm256_add_epi8(lo, hi),
+                                                        _mm256_setzero_si256()));
+    }
+
+    uint64_t lanes[4];
+    _mm256_storeu_si256((__m256i*)lanes, total);
+    count = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#endif
+
+    for (; i < n; ++i)
+        count += popcount(words[i]);
+
+    return count;
+}
+
+std::size_t countBits(const uint64_t *row, int from, int to) {
+    if (from >= to)
+        return 0;
+
+    int first = from >> 6;
+    int last = (to - 1) >> 6;
+
+    if (first == last)
+        return popcount(row[first] & rangeMask(from & 63, ((to - 1) & 63) + 1));
+
+    return popcount(row[first] & rangeMask(from & 63, 64))
+        + countWords(row + first + 1, last - first - 1)
+        + popcount(row[last] & rangeMask(0, ((to - 1) & 63) + 1));
+}
@@ -0,0 +1,53 @@
+#ifndef GRID_KERNELS_H_
+#define GRID_KERNELS_H_
+
+#include <cstddef>
+#include <stdint.h>
+
+/**
+ * Whole-row kernels over bit-packed cells, used by Grid for its bulk
+ * operations. A row of cells is stored as consecutive 64-bit words with cell
+ * x in bit (x % 64) of word (x / 64).
+ *
+ * The word loops use AVX2 when compiled with it enabled (e.g. -mavx2), SSE2
+ * on other x86 targets, and plain 64-bit operations everywhere else.
+ */
+
+/**
+ * Number of bits each row is padded to, so that rows start on a whole number
+ * of vector registers
+ */
+const int rowAlignmentBits = 256;
+
+/**
+ * Set `n` words starting at `words` to `value`
+ */
+void fillWords(uint64_t *words, std::size_t n, uint64_t value);
+
+/**
+ * Set bits [from, to) of the row at `row` to 1 if `value` else 0
+ */
+void fillBits(uint64_t *row, int from, int to, bool value);
+
+/**
+ * Flip bits [from, to) of the row at `row`
+ */
+void invertBits(uint64_t *row, int from, int to);
+
+/**
+ * Copy bits [srcFrom, srcFrom + n) of `src` to [dstFrom, dstFrom + n) of `dst`.
+ * The rows must not overlap
+ */
+void copyBits(const uint64_t *src, int srcFrom, uint64_t *dst, int dstFrom, int n);
+
+/**
+ * Return the number of set bits in `n` words starting at `words`
+ */
+std::size_t countWords(const uint64_t *words, std::size_t n);
+
+/**
+ * Return the number of set bits in bits [from, to) of the row at `row`
+ */
+std::size_t countBits(const uint64_t *row, int from, int to);
+
+#endif /* GRID_KERNELS_H_ */
@@ -1,5 +1,4 @@
 
-#include <cstdlib>
 #include <cstring>
 
 #include <algorithm>
@@ -9,11 +8,16 @@
 #include <FL/Fl.H>
 
 #include "AStar.h"
+#include "Clock.h"
 #include "Square.h"
 #include "GridView.h"
 
+/* Seconds between frames of an animated search */
+static const double frameInterval = 1.0 / 30;
+
 GridView::GridView(Grid *grid, const char* title)
-    : Fl_Double_Window(650, 450, title), grid(grid)
+    : Fl_Double_Window(650, 450, title), grid(grid), pathfind_id(0),
+      feed_expanded(0), search_start(0)
 {
     // Set color of window to white
     color(FL_WHITE);
@@ -23,28 +27,30 @@ GridView::GridView(Grid *grid, const char* title)
     // Set default state
     state.state = NORMAL;
     
-    // Button dimensions for grid
-    const int buttonXOffset = 10;
-    const int buttonYOffset = 10;
-    const int buttonHeight = 20;
-    const int buttonWidth = 20;
+    // Position of the grid canvas
+    const int canvasXOffset = 10;
+    const int canvasYOffset = 10;
+
+    // Pixels per square the grid is shown at if it fits
+    const int squareSize = 20;
+
+    // Largest canvas, beyond which the grid is zoomed out to fit
+    const int maxCanvasSize = 800;
     
     // Width of inputs
     const int input_width = 120;
 
-    // Minimum width and height are as if the grid is (20, 20)
-    int winWidth;
-    int winHeight;
-
     // Get grid dimensions
     int gridWidth = grid->getWidth();
     int gridHeight = grid->getHeight();
 
-    winWidth = (gridWidth < 20) ? buttonWidth * 20 + buttonXOffset * 2 + 220
-    : buttonWidth * gridWidth + buttonXOffset * 2 + 120 + input_width;
-    
-    winHeight = (gridHeight < 20) ? buttonHeight * 20 + buttonYOffset * 2
-    : buttonHeight * gridHeight + buttonYOffset * 2;
+    // Minimum width and height are as if the grid is (20, 20)
+    int canvasWidth = std::min(squareSize * std::max(gridWidth, 20), maxCanvasSize);
+    int canvasHeight = std::min(squareSize * std::max(gridHeight, 20), maxCanvasSize);
+
+    int winWidth = canvasWidth + canvasXOffset * 2 + 120 + input_width;
+    // Tall enough for all of the inputs
+    int winHeight = std::max(canvasHeight + canvasYOffset * 2, 600);
 
     // x offset for the other inputs
     const int x_offset = winWidth - input_width - 20;
@@ -52,23 +58,9 @@ GridView::GridView(Grid *grid, const char* title)
     // Set size so that the new grid fits
     size(winWidth, winHeight);
     
-    // Generate all of the grid view buttons
-    for (int x = 0; x < gridWidth; ++x)
-    for (int y = 0; y < gridHeight; ++y) {
-        Fl_Button *button = new Fl_Button(buttonXOffset + x * buttonWidth,
-            buttonYOffset + y * buttonHeight,
-            buttonWidth - 2, buttonHeight - 2);
-            
-        if (grid->getSquare(Point(x, y)) == EMPTY)
-            button->color(FL_WHITE);
-        else
-            button->color(FL_RED);
-            
-        button->callback(GridView::StaticToggleGridSquare, this);
-            
-        squares[Point(x, y)] = button;
-    }
-    
+    // Add the canvas showing the grid, which calls back when clicked
+    canvas = new GridCanvas(canvasXOffset, canvasYOffset, canvasWidth, canvasHeight, grid);
+    canvas->callback(GridView::StaticToggleGridSquare, this);
     
     // Add button to trigger pathfinding
     Fl_Button *pathfindButton = new Fl_Button(x_offset, 20, input_width, 20, "Pathfind!");
@@ -136,120 +128,149 @@ GridView::GridView(Grid *grid, const char* title)
 						    20, "Delete Waypoint");
     deleteWaypointButton->callback(GridView::StaticDeleteWaypoint, this);
 
+    // Add check box and speed slider for animating searches
+    animate_button = new Fl_Check_Button(x_offset, 420, input_width, 20, "Animate");
+
+    speed_slider = new Fl_Value_Slider(x_offset, 450, input_width, 20);
+    speed_slider->type(FL_HOR_NICE_SLIDER);
+    speed_slider->bounds(0, 500);
+    speed_slider->step(1);
+    speed_slider->value(10);
+    speed_slider->tooltip("Expansions shown a frame, 0 to pause");
+
+    // Add button to step through a paused search
+    Fl_Button *stepButton = new Fl_Button(x_offset, 480, input_width, 20, "Step");
+    stepButton->callback(GridView::StaticStep, this);
+
+    // Add expansions/cost/time readout
+    search_output = new Fl_Output(x_offset - 10, 510, input_width + 20, 20);
+
+    // Add check box and slider for painting terrain costs
+    cost_button = new Fl_Check_Button(x_offset, 540, input_width, 20, "Paint cost");
+
+    cost_slider = new Fl_Value_Slider(x_offset, 570, input_width, 20);
+    cost_slider->type(FL_HOR_NICE_SLIDER);
+    cost_slider->bounds(1, 9);
+    cost_slider->step(1);
+    cost_slider->value(5);
+    cost_slider->tooltip("Cost multiplier to paint, 1 for normal ground");
+
     // Stop adding children to this window
     end();
     
     RefreshGrid();
     
-    // Generate a timeout of 0.1s to redraw the window
-    Fl::add_timeout(0.1, GridView::Redraw, this);
+    // Start the pathfinding thread
+    worker = new PathWorker(GridView::StaticPathFound, GridView::StaticPathProgress, this);
+}
+
+GridView::~GridView()
+{
+    // Release an animated search, so that the worker can stop
+    StopAnimation();
+
+    // Stops and joins the worker thread
+    delete worker;
 }
 
-/* Refresh the grid display with a given grid; resets button color state */
+/* Refresh the grid display with a given grid; resets the colors drawn over it */
 void GridView::RefreshGrid()
 {
-    for (int x = 0; x < grid->getWidth(); ++x)
-    for (int y = 0; y < grid->getHeight(); ++y) {
-
-        Point p(x, y);
-            
-        // Set color depending on type of square 
-        if (p == waypoints.front())
-            squares.at(p)->color(FL_BLUE);
-        else if (p == waypoints.back())
-            squares.at(p)->color(FL_MAGENTA);
-        else if (std::find(waypoints.begin(), waypoints.end(), p) != waypoints.end())
-            squares.at(p)->color(FL_YELLOW);
-        else if (grid->getSquare(p) == EMPTY)
-            squares.at(p)->color(FL_WHITE);
-        else if (grid->getSquare(p) == FULL)
-            squares.at(p)->color(FL_RED);
-
-        // Clear button's label
-        squares.at(p)->label("");
-    }
+    // Go back to the colors of the squares themselves
+    canvas->clearOverlays();
+    canvas->clearLabels();
+    path_shown.clear();
 
-    // Add numbers to waypoints (except for start and end)
-    for (int i = 1; i < waypoints.size() - 1; ++i) {
-        // Convert the index to a const char*
-        std::stringstream strs;
-        strs << i;
-        std::string str = strs.str();
+    for (std::vector<Point>::const_iterator it = waypoints.begin(); it != waypoints.end(); ++it)
+        ColorSquare(*it);
+}
 
-        // Make non-vanishing copy
-        char* temp = (char*)str.c_str();
-        char* label = (char*)std::malloc(1 + std::strlen(temp));
-        std::strcpy(label, temp);
+/* Recolor a single square, after a waypoint or path on it has changed */
+void GridView::ColorSquare(const Point &p)
+{
+    // Set color depending on type of square
+    if (p == waypoints.front())
+        canvas->setOverlay(p, FL_BLUE);
+    else if (p == waypoints.back())
+        canvas->setOverlay(p, FL_MAGENTA);
+    else if (std::find(waypoints.begin(), waypoints.end(), p) != waypoints.end())
+        canvas->setOverlay(p, FL_YELLOW);
+    else
+        canvas->clearOverlay(p);
 
-        // Set the waypoint's square's label
-        squares.at(waypoints.at(i))->label((const char*)label);
+    // Number waypoints (except for start and end), the last one on `p` wins
+    for (std::size_t i = waypoints.size() - 1; i-- > 1; ) {
+        if (waypoints[i] == p) {
+            std::stringstream strs;
+            strs << i;
+
+            canvas->setLabel(p, strs.str());
+            return;
+        }
     }
+
+    canvas->clearLabel(p);
 }
 
-/* Callback for clicking a grid button to toggle it */
-void GridView::ToggleGridSquare(Fl_Widget *pButton)
+/* Recolor only the squares of the path currently shown */
+void GridView::ClearPath()
 {
-    // Iterate through each point/button pair
-    for (std::map<Point, Fl_Button*>::iterator it = squares.begin(); it != squares.end();
-	 ++it) {
-
-        /* Reset all green buttons (from pathfinding) back to white, except for
-	   start and end, which we color blue and magenta respectively, and
-	   waypoints, which we color yellow */
-        if (it->first == waypoints.front())
-            it->second->color(FL_BLUE);
-        
-        else if (it->first == waypoints.back())
-            it->second->color(FL_MAGENTA);
-
-        else if (std::find(waypoints.begin(), waypoints.end(), it->first)
-		 != waypoints.end())
-            it->second->color(FL_YELLOW);
-           
-        else if (it->second->color() == FL_GREEN)
-            it->second->color(FL_WHITE);
-        
-        // If it->second is the just pressed button
-        if (it->second == pButton) {
-            // We are just clicking a button fill it in/empty it
-            if (state.state == NORMAL) {
-                // Don't allow setting the start/end/waypoint points
-                if (it->second->color() == FL_BLUE ||
-                    it->second->color() == FL_MAGENTA ||
-                    it->second->color() == FL_YELLOW)
-                    return;
-                        
-                // Turn grid point to FULL
-                if (it->second->color() == FL_WHITE) {
-                    grid->setSquare(it->first, FULL);
-                    it->second->color(FL_RED);
-                }
-                        
-                // Turn grid point to EMPTY
-                else if (it->second->color() == FL_RED) {
-                    grid->setSquare(it->first, EMPTY);
-                    it->second->color(FL_WHITE);
-                }
-            }
-            
-            // We are setting a waypoint
-            else if (state.state == SETTING_WAYPOINT) {
-                grid->setSquare(it->first, EMPTY);
-
-                if (state.index == 0)
-                    it->second->color(FL_BLUE);
-                else if (state.index == waypoints.size() - 1)
-                    it->second->color(FL_MAGENTA);
-                else
-                    it->second->color(FL_YELLOW);
-
-                waypoints.at(state.index) = it->first;
-            }
-                
-            RefreshGrid();
-        }
+    Path path;
+    path.swap(path_shown);
+
+    Path search;
+    search.swap(search_shown);
+
+    for (Path::const_iterator it = path.begin(); it != path.end(); ++it)
+        ColorSquare(*it);
+
+    for (Path::const_iterator it = search.begin(); it != search.end(); ++it)
+        ColorSquare(*it);
+}
+
+/* Callback for clicking the grid canvas to toggle a square */
+void GridView::ToggleGridSquare(Fl_Widget *pCanvas)
+{
+    bool painting = cost_button->value() && state.state == NORMAL;
+
+    // Only the cost brush paints when dragged
+    if (Fl::event() == FL_DRAG && !painting)
+        return;
+
+    CancelPathfind();
+    ClearPath();
+
+    Point p = canvas->getClickedCell();
+
+    // Paint the cost, which the canvas redraws
+    if (painting) {
+        grid->setCost(p, (uint8_t)cost_slider->value());
+
+        result_output->value("");
+        result_output->color(FL_WHITE);
+        return;
     }
-    
+
+    // We are just clicking a square fill it in/empty it, the canvas redraws it
+    if (state.state == NORMAL) {
+        // Don't allow setting the start/end/waypoint points
+        if (std::find(waypoints.begin(), waypoints.end(), p) != waypoints.end())
+            return;
+
+        grid->setSquare(p, grid->getSquare(p) == EMPTY ? FULL : EMPTY);
+    }
+
+    // We are setting a waypoint, so only its old and new squares change
+    else if (state.state == SETTING_WAYPOINT) {
+        Point previous = waypoints.at(state.index);
+
+        grid->setSquare(p, EMPTY);
+        waypoints.at(state.index) = p;
+
+        ColorSquare(previous);
+        ColorSquare(p);
+    }
+
     // Reset the gameview state to normal editing
     state.state = NORMAL;
     result_output->value("");
@@ -259,41 +280,203 @@ void GridView::ToggleGridSquare(Fl_Widget *pButton)
 /* Callback to execute the pathfinder */
 void GridView::DoPathfind(Fl_Widget *pButton)
 {
-    // Refresh the grid first
-    RefreshGrid();
-    
-    AStar pathfinder(*grid);
-    
-    Path path;
+    // Remove the last path first
+    ClearPath();
 
     // Depending on which button was pressed to trigger this, call either with
-    // or without using heuristic
-    if (!std::strcmp(pButton->label(), "Pathfind!"))
-        path = pathfinder.buildFromWaypoints(waypoints);
-    else
-        path = pathfinder.buildWithHeuristic(waypoints);
-
-    for (int y = 0; y < grid->getHeight(); ++y)
-        for (int x = 0; x < grid->getWidth(); ++x) {
-            // If this point is on the path, set the button's color to green
-            if (std::find(path.begin(), path.end(), Point(x, y)) != path.end()) {
-                squares[Point(x, y)]->color(FL_GREEN);
-            }
-        }
+    // or without using heuristic. This supersedes any earlier request
+    bool heuristic = std::strcmp(pButton->label(), "Pathfind!") != 0;
+
+    // Watch the search through a paced feed, which Animate() lets run a
+    // frame at a time
+    StopAnimation();
+    if (animate_button->value()) {
+        feed.reset(new SearchFeed(0));
+        feed_expanded = 0;
+        Fl::add_timeout(frameInterval, GridView::StaticAnimate, this);
+    }
+
+    search_start = wallSeconds();
+    search_output->value("");
+    pathfind_id = worker->submit(*grid, waypoints, heuristic, feed);
+
+    result_output->value("Searching...");
+    result_output->color(FL_YELLOW);
+}
+
+/* Show the path found by the worker */
+void GridView::ShowPath(const PathResult &result)
+{
+    // Superseded, cancelled, or for a grid that has been edited since
+    if (result.id != pathfind_id || result.version != grid->getVersion())
+        return;
+
+    pathfind_id = 0;
+
+    // Show what the animated search did since the last frame
+    if (feed) {
+        feed->drain(feed_events);
+        ShowFeedEvents();
+        StopAnimation();
+    }
+
+    path_shown = result.path;
+
+    for (Path::const_iterator it = result.path.begin(); it != result.path.end(); ++it) {
+        // Set each point on the path to green
+        canvas->setOverlay(*it, FL_GREEN);
+    }
         
     // Set result label
-    if (path.size() == 0) {
+    if (result.path.size() == 0) {
         result_output->value("Couldn't find path");
         result_output->color(FL_RED);
     } else {
         result_output->value("Success!");
         result_output->color(FL_GREEN);
     }
+
+    std::stringstream strs;
+    if (animate_button->value())
+        strs << feed_expanded << " exp, ";
+    if (result.path.size() != 0)
+        strs << "cost " << result.cost << ", ";
+    strs << wallSeconds() - search_start << " s";
+    search_output->value(strs.str().c_str());
+}
+
+/* Draw a frame of the animated search */
+void GridView::Animate()
+{
+    if (!feed)
+        return;
+
+    feed->drain(feed_events);
+    ShowFeedEvents();
+
+    std::stringstream strs;
+    strs << feed_expanded << " exp, " << wallSeconds() - search_start << " s";
+    search_output->value(strs.str().c_str());
+
+    // Let the search run for the next frame
+    feed->grant((long)speed_slider->value());
+
+    Fl::repeat_timeout(frameInterval, GridView::StaticAnimate, this);
+}
+
+/* Run one more expansion of the animated search */
+void GridView::Step(Fl_Widget *pButton)
+{
+    if (feed)
+        feed->grant(1);
+}
+
+/* Color the open and closed squares of the animated search */
+void GridView::ShowFeedEvents()
+{
+    for (std::vector<SearchEvent>::const_iterator it = feed_events.begin();
+         it != feed_events.end(); ++it) {
+        if (it->type == SearchEvent::EXPANDED)
+            ++feed_expanded;
+
+        // Waypoints keep their colors
+        if (std::find(waypoints.begin(), waypoints.end(), it->position) != waypoints.end())
+            continue;
+
+        if (it->type == SearchEvent::GENERATED) {
+            canvas->setOverlay(it->position, FL_CYAN);
+            search_shown.push_back(it->position);
+        } else {
+            canvas->setOverlay(it->position, FL_DARK_CYAN);
+        }
+    }
+}
+
+/* Stop drawing frames, and let the search finish without pacing */
+void GridView::StopAnimation()
+{
+    if (!feed)
+        return;
+
+    Fl::remove_timeout(GridView::StaticAnimate, this);
+    feed->stop();
+    feed.reset();
+}
+
+/* Show how far the worker has got */
+void GridView::ShowProgress(unsigned long id, long expanded)
+{
+    if (id != pathfind_id)
+        return;
+
+    std::stringstream strs;
+    strs << "Searching... " << expanded;
+    result_output->value(strs.str().c_str());
+}
+
+/* Stop the worker and forget any result it has already sent */
+void GridView::CancelPathfind()
+{
+    StopAnimation();
+    worker->cancel();
+    pathfind_id = 0;
+}
+
+/**
+ * Messages passed from the worker thread to the GUI thread through Fl::awake,
+ * deleted by their handlers
+ */
+struct PathFoundMessage {
+    GridView *view;
+    PathResult result;
+};
+
+struct PathProgressMessage {
+    GridView *view;
+    unsigned long id;
+    long expanded;
+};
+
+static void HandlePathFound(void *data)
+{
+    PathFoundMessage *message = (PathFoundMessage*)data;
+    message->view->ShowPath(message->result);
+    delete message;
+}
+
+static void HandlePathProgress(void *data)
+{
+    PathProgressMessage *message = (PathProgressMessage*)data;
+    message->view->ShowProgress(message->id, message->expanded);
+    delete message;
+}
+
+void GridView::StaticPathFound(const PathResult &result, void *data)
+{
+    PathFoundMessage *message = new PathFoundMessage;
+    message->view = (GridView*)data;
+    message->result = result;
+
+    Fl::awake(HandlePathFound, message);
+}
+
+void GridView::StaticPathProgress(unsigned long id, long expanded, void *data)
+{
+    PathProgressMessage *message = new PathProgressMessage;
+    message->view = (GridView*)data;
+    message->id = id;
+    message->expanded = expanded;
+
+    Fl::awake(HandlePathProgress, message);
 }
 
 /* Randomly populate the grid again depending on the input box */
 void GridView::Repopulate(Fl_Widget *pButton)
 {
+    CancelPathfind();
+    ClearPath();
+
+    // The canvas redraws everything after these
     grid->clear();
     
     // Get the repopulation amount from the text input
@@ -309,16 +492,17 @@ void GridView::Repopulate(Fl_Widget *pButton)
     for (std::vector<Point>::const_iterator it = waypoints.begin(); it != waypoints.end(); ++it) {
         grid->setSquare(*it, EMPTY);
     }
-    
-    // Refresh everything
-    RefreshGrid();
 }
 
 /* Clear the grid and refresh the grid buttons */
 void GridView::Clear(Fl_Widget *pButton)
 {
+    CancelPathfind();
+    ClearPath();
+
+    // The canvas redraws everything after this
     grid->clear();
-    RefreshGrid();
+    grid->clearCosts();
 }
 
 /* Generate new grid of width/height in new window */
@@ -361,6 +545,9 @@ void GridView::SetWaypoint(Fl_Widget *pButton)
 /* Add a new waypoint at (0, 0) to `waypoints` and `waypoints_selection` */
 void GridView::AddWaypoint(Fl_Widget *pButton)
 {
+    CancelPathfind();
+    ClearPath();
+
     // Get next available index in the waypoints
     int index = waypoints.size() - 1;
 
@@ -380,7 +567,7 @@ void GridView::AddWaypoint(Fl_Widget *pButton)
     // Add new waypoint at (0, 0) to the list
     waypoints.insert(waypoints.begin() + index, Point(0, 0));
 
-    RefreshGrid();
+    ColorSquare(Point(0, 0));
 }
 
 /* Deleted the waypoint selected from `waypoints_selection` and `waypoints` */
@@ -417,19 +604,16 @@ void GridView::DeleteWaypoint(Fl_Widget *pButton)
         waypoints_selection->replace(i, newStr.c_str());
     }
 
+    CancelPathfind();
+    ClearPath();
+
     // Remove the waypoint from the drop down box and the vector
+    Point removed = waypoints.at(index);
     waypoints_selection->remove(index);
     waypoints.erase(waypoints.begin() + index);
 
-    RefreshGrid();
-}
-
-// Redraw window to refresh the draw state
-void GridView::Redraw(void* pWindow)
-{
-    //Redrawing the window; notice the casting
-    ((Fl_Window*)pWindow)->redraw();
-    //Regenerate the timeout, passing again the pointer
-    Fl::repeat_timeout(0.1, GridView::Redraw, pWindow);
+    // The removed square, and the waypoints renumbered after it
+    ColorSquare(removed);
+    for (std::size_t i = index; i < waypoints.size(); ++i)
+        ColorSquare(waypoints[i]);
 }
-
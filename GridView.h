@@ -2,15 +2,21 @@
 #define GRIDWINDOW_H_
 
 #include <FL/Fl_Button.H>
+#include <FL/Fl_Check_Button.H>
 #include <FL/Fl_Double_Window.H>
 #include <FL/Fl_Int_Input.H>
 #include <FL/Fl_Output.H>
 #include <FL/Fl_Widget.H>
 #include <FL/Fl_Choice.H>
+#include <FL/Fl_Value_Slider.H>
+#include <memory>
 #include <vector>
 
 #include "Point.h"
 #include "Grid.h"
+#include "GridCanvas.h"
+#include "PathWorker.h"
+#include "SearchFeed.h"
 
 /**
  * Set of possible states for editing the grid NORMAL corresponds to regular
@@ -34,47 +40,81 @@ struct GridViewState {
 class GridView : public Fl_Double_Window {
  public:
     GridView(Grid *grid, const char* title = 0);
+    ~GridView();
 	
     /**
-     * Reset all the grid buttons to their original colors based upon whether
-     * they are full, empty, start, end, or other waypoints, clearing any path
-     * that is currently displayed on the grid. Also sets the numbers on the
-     * waypoints (apart from start and end which have special colors)
+     * Reset the grid canvas to the colors of its squares, clearing any path
+     * that is currently displayed on the grid, then color the start, end and
+     * other waypoints. Also sets the numbers on the waypoints (apart from
+     * start and end which have special colors)
+     *
+     * Edits after this only recolor the squares they change, with the canvas
+     * redrawing squares changed in the grid itself.
      */
     void RefreshGrid();
 	
     /**
-     * Toggle the clicked grid square by comparing `pButton` with the elements
-     * of this->squares to find out which grid point was clicked.
+     * Toggle the grid square clicked on the canvas `pCanvas`, or with
+     * `cost_button` checked, paint the cost from `cost_slider` onto it and
+     * any squares dragged over.
      *
      * If this->state.state == NORMAL, just toggle the square between FULL and
      * EMPTY. If this->state.state == SETTING_WAYPOINT, then set the waypoint
      * indexed by this->state.index to the selected Point.
      */
-    void ToggleGridSquare(Fl_Widget *pButton);
+    void ToggleGridSquare(Fl_Widget *pCanvas);
 
     /**
-     * Pathfind on the grid, setting the buttons in the path to green. If the
-     * "Pathfind!" button was pressed, just pathfind the waypoints _in order of
+     * Start pathfinding on the grid in the background. If the "Pathfind!"
+     * button was pressed, just pathfind the waypoints _in order of
      * creation_, else if the "w/ Heuristics" button is pressed, pathfind the
      * waypoints in order of their Manhattan heuristic with respect to the end
      * point, i.e. in order of distance from the end point (the furthest
      * waypoint is visited first)
      *
-     * Displays a message in `result_output` depending on whether the
-     * pathfinding was successful or not.
+     * Any search still running is cancelled, and `result_output` shows the
+     * progress until ShowPath() is called with the result.
+     *
+     * If `animate_button` is checked, the search is paced by a SearchFeed
+     * and drawn as it runs by Animate(), `speed_slider` expansions a frame.
      */
     void DoPathfind(Fl_Widget *pButton);
 
+    /**
+     * Color the squares in `result.path` green and display a message in
+     * `result_output` depending on whether the pathfinding was successful or
+     * not. Results for a grid that has been edited since are dropped.
+     */
+    void ShowPath(const PathResult &result);
+
+    /**
+     * Draw the events of the animated search since the last frame, coloring
+     * open squares cyan and closed squares dark cyan, let it run for another
+     * frame, and show its expansions and elapsed time in `search_output`
+     */
+    void Animate();
+
+    /**
+     * Let the animated search run one more expansion, for stepping through it
+     * with the speed set to 0
+     */
+    void Step(Fl_Widget *pButton);
+
+    /**
+     * Show the number of nodes expanded so far by the request `id` in
+     * `result_output`, if it is still the latest request
+     */
+    void ShowProgress(unsigned long id, long expanded);
+
     /**
      * Clear the grid, then randomly populate the grid with the number to fill
      * in given by `repopulation_input`'s text label. If the start or end points
-     * are filled in, make them empty again, then refresh the grid.
+     * are filled in, make them empty again. The canvas redraws the grid.
      */
     void Repopulate(Fl_Widget *pButton);
 
     /**
-     * Clear the grid, then refresh it.
+     * Clear the grid and its costs, which the canvas then redraws.
      */
     void Clear(Fl_Widget *pButton);
 
@@ -93,7 +133,7 @@ class GridView : public Fl_Double_Window {
 
     /**
      * Add a new waypoint at (0, 0) to `waypoints` and add a new entry to
-     * `waypoints_selection`, then refresh the grid.
+     * `waypoints_selection`, then color its square.
      */
     void AddWaypoint(Fl_Widget *pButton);
 
@@ -108,8 +148,8 @@ class GridView : public Fl_Double_Window {
     /**
      * Static versions of the member functions to be used as callbacks
      */
-    static void StaticToggleGridSquare(Fl_Widget *pButton, void *data) {
-	((GridView*)data)->ToggleGridSquare(pButton);
+    static void StaticToggleGridSquare(Fl_Widget *pCanvas, void *data) {
+	((GridView*)data)->ToggleGridSquare(pCanvas);
     }
 	
     static void StaticDoPathfind(Fl_Widget *pButton, void *data) {
@@ -120,6 +160,14 @@ class GridView : public Fl_Double_Window {
 	((GridView*)data)->Repopulate(pButton);
     }
 	
+    static void StaticStep(Fl_Widget *pButton, void *data) {
+	((GridView*)data)->Step(pButton);
+    }
+
+    static void StaticAnimate(void *data) {
+	((GridView*)data)->Animate();
+    }
+	
     static void StaticClear(Fl_Widget *pButton, void *data) {
 	((GridView*)data)->Clear(pButton);
     }
@@ -140,8 +188,12 @@ class GridView : public Fl_Double_Window {
 	((GridView*)data)->DeleteWaypoint(pButton);
     }
 	
-    /* Refresh draw state */
-    static void Redraw(void* pWindow);
+    /**
+     * PathWorker callbacks, run on the worker thread, which hand the result
+     * or progress over to the GUI thread with Fl::awake
+     */
+    static void StaticPathFound(const PathResult &result, void *data);
+    static void StaticPathProgress(unsigned long id, long expanded, void *data);
 	
  private:
     // Current grid being used
@@ -153,8 +205,8 @@ class GridView : public Fl_Double_Window {
     // Waypoint drop-down selection
     Fl_Choice *waypoints_selection;
 
-    // map of points on the grid to their relevant buttons
-    std::map<Point, Fl_Button*> squares;
+    // Widget drawing the grid
+    GridCanvas *canvas;
 	
     // Input field for the number of squares to fill on repopulation
     Fl_Int_Input *repopulation_input;
@@ -168,6 +220,50 @@ class GridView : public Fl_Double_Window {
 	
     // Current state of the app
     GridViewState state;
+
+    // Background thread doing the pathfinding
+    PathWorker *worker;
+
+    // Id of the latest pathfinding request, to ignore progress of older ones
+    unsigned long pathfind_id;
+
+    // Whether to animate searches, and how many expansions to show a frame
+    Fl_Check_Button *animate_button;
+    Fl_Value_Slider *speed_slider;
+
+    // Whether clicks paint costs instead of toggling squares, and the cost
+    Fl_Check_Button *cost_button;
+    Fl_Value_Slider *cost_slider;
+
+    // Shows the expansions, path cost and time of the last search
+    Fl_Output *search_output;
+
+    // Events of the animated search, or null if not animating
+    std::shared_ptr<SearchFeed> feed;
+    std::vector<SearchEvent> feed_events;
+    long feed_expanded;
+
+    // When the latest search was started, in seconds
+    double search_start;
+
+    // Squares currently colored as the found path, or by the animated search
+    Path path_shown;
+    Path search_shown;
+
+    // Cancel pathfinding as the grid or waypoints are about to change
+    void CancelPathfind();
+
+    // Recolor `p` as a start, end or numbered waypoint, or as its square
+    void ColorSquare(const Point &p);
+
+    // Recolor the squares of `path_shown` and `search_shown` and forget them
+    void ClearPath();
+
+    // Color the squares in `feed_events`, leaving waypoints alone
+    void ShowFeedEvents();
+
+    // Stop animating the search, releasing it if it is still running
+    void StopAnimation();
 };
 
 #endif /* GRIDWINDOW_H_ */
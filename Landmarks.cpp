@@ -0,0 +1,334 @@
+#include "Landmarks.h"
+
+#include <climits>
+#include <fstream>
+#include <functional>
+#include <queue>
+#include <utility>
+
+#include "Components.h"
+
+const uint16_t Landmarks::unreachable;
+
+/* Start of every landmarks file, ending in the format version */
+static const char magic[4] = {'A', 'L', 'T', '1'};
+
+typedef std::pair<int, int> Entry;
+typedef std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry> > Queue;
+
+Landmarks::Landmarks(Grid *grid, int count, int cardinalCost, int diagonalCost, Movement movement)
+    : grid(grid), width(grid->getWidth()), height(grid->getHeight()),
+      cardinalCost(cardinalCost), diagonalCost(diagonalCost), movement(movement),
+      wanted(count), repairedSquares(0)
+{
+    rebuild();
+    grid->attach(this);
+}
+
+Landmarks::~Landmarks()
+{
+    grid->detach(this);
+}
+
+void Landmarks::rebuild()
+{
+    width = grid->getWidth();
+    height = grid->getHeight();
+    int squares = width * height;
+
+    landmarks.clear();
+    scales.clear();
+    table.clear();
+    repairedSquares = 0;
+
+    // Start from any square of the largest component, so the landmarks
+    // cover where most queries will be
+    int seed = -1;
+    {
+        Components components(grid);
+        int best = 0;
+        for (int i = 0; i < squares; ++i) {
+            int label = components.getLabel(Point(i % width, i / width));
+            if (label != -1 && components.getSize(label) > best) {
+                best = components.getSize(label);
+                seed = i;
+            }
+        }
+    }
+
+    if (seed == -1)
+        return;
+
+    // Farthest-point selection: the first landmark is the square farthest
+    // from the seed, and each after that the one farthest from all picked
+    std::vector<int> distance;
+    distancesFrom(seed, distance);
+
+    std::vector<int> nearest(distance);
+    std::vector<std::vector<int> > tables;
+
+    while ((int)tables.size() < wanted) {
+        int next = -1;
+        for (int i = 0; i < squares; ++i)
+            if (nearest[i] > 0 && (next == -1 || nearest[i] > nearest[next]))
+                next = i;
+
+        // Every reachable square is a landmark already
+        if (next == -1)
+            break;
+
+        landmarks.push_back(Point(next % width, next / width));
+        tables.push_back(std::vector<int>());
+        distancesFrom(next, tables.back());
+
+        for (int i = 0; i < squares; ++i)
+            if (tables.back()[i] != -1 && tables.back()[i] < nearest[i])
+                nearest[i] = tables.back()[i];
+    }
+
+    table.assign((std::size_t)squares * landmarks.size(), unreachable);
+    scales.assign(landmarks.size(), 1);
+
+    for (std::size_t i = 0; i < tables.size(); ++i)
+        storeTable(i, tables[i]);
+}
+
+bool Landmarks::save(const std::string &path) const
+{
+    std::ofstream file(path.c_str(), std::ios::binary | std::ios::trunc);
+    if (!file)
+        return false;
+
+    int32_t header[6] = {width, height, cardinalCost, diagonalCost, movement,
+                         (int32_t)landmarks.size()};
+
+    file.write(magic, sizeof(magic));
+    file.write((const char *)header, sizeof(header));
+
+    for (std::size_t i = 0; i < landmarks.size(); ++i) {
+        int32_t entry[3] = {landmarks[i].getx(), landmarks[i].gety(), scales[i]};
+        file.write((const char *)entry, sizeof(entry));
+    }
+
+    if (!table.empty())
+        file.write((const char *)&table[0], table.size() * sizeof(uint16_t));
+
+    return file.good();
+}
+
+bool Landmarks::load(const std::string &path)
+{
+    std::ifstream file(path.c_str(), std::ios::binary);
+    if (!file)
+        return false;
+
+    char fileMagic[sizeof(magic)];
+    int32_t header[6];
+
+    file.read(fileMagic, sizeof(fileMagic));
+    file.read((char *)header, sizeof(header));
+
+    if (!file || !std::equal(magic, magic + sizeof(magic), fileMagic) ||
+        header[0] != grid->getWidth() || header[1] != grid->getHeight() ||
+        header[2] != cardinalCost || header[3] != diagonalCost ||
+        header[4] != movement || header[5] < 0 || header[5] > wanted)
+        return false;
+
+    std::vector<Point> newLandmarks;
+    std::vector<int> newScales;
+    for (int i = 0; i < header[5]; ++i) {
+        int32_t entry[3];
+        file.read((char *)entry, sizeof(entry));
+
+        if (!file || entry[0] < 0 || entry[0] >= header[0] || entry[1] < 0 ||
+            entry[1] >= header[1] || entry[2] < 1)
+            return false;
+
+        newLandmarks.push_back(Point(entry[0], entry[1]));
+        newScales.push_back(entry[2]);
+    }
+
+    std::vector<uint16_t> newTable((std::size_t)header[0] * header[1] * header[5]);
+    if (!newTable.empty())
+        file.read((char *)&newTable[0], newTable.size() * sizeof(uint16_t));
+
+    // Anything left over means it isn't a file this wrote
+    if (!file || file.peek() != EOF)
+        return false;
+
+    width = header[0];
+    height = header[1];
+    landmarks.swap(newLandmarks);
+    scales.swap(newScales);
+    table.swap(newTable);
+    repairedSquares = 0;
+
+    return true;
+}
+
+void Landmarks::squareChanged(const Grid &grid, const Point &p, Square previous)
+{
+    // A new wall only makes paths dearer, leaving the tables lower bounds
+    if (grid.getSquare(p) == EMPTY)
+        repair(p.gety() * width + p.getx());
+}
+
+void Landmarks::costChanged(const Grid &grid, const Point &p, uint8_t previous)
+{
+    if (grid.getCost(p) < previous)
+        repair(p.gety() * width + p.getx());
+}
+
+void Landmarks::gridReset(const Grid &grid)
+{
+    rebuild();
+}
+
+int Landmarks::moveCost(int a, int b) const
+{
+    Point p(a % width, a / width), q(b % width, b / width);
+    int base = (p.getx() != q.getx() && p.gety() != q.gety()) ? diagonalCost : cardinalCost;
+
+    return base * (grid->getCost(p) + grid->getCost(q)) / 2;
+}
+
+void Landmarks::distancesFrom(int source, std::vector<int> &distance) const
+{
+    distance.assign(width * height, -1);
+
+    Queue queue;
+    distance[source] = 0;
+    queue.push(Entry(0, source));
+
+    while (!queue.empty()) {
+        Entry entry = queue.top();
+        queue.pop();
+
+        int square = entry.second;
+        if (entry.first != distance[square])
+            continue;
+
+        unsigned moves = grid->getMoves(Point(square % width, square / width), movement);
+        for (int i = 0; i < 8; ++i) {
+            if ((moves & (1u << i)) == 0)
+                continue;
+
+            int next = square + moveDy[i] * width + moveDx[i];
+            int cost = entry.first + moveCost(square, next);
+
+            if (distance[next] == -1 || cost < distance[next]) {
+                distance[next] = cost;
+                queue.push(Entry(cost, next));
+            }
+        }
+    }
+}
+
+void Landmarks::storeTable(int i, const std::vector<int> &distance)
+{
+    int farthest = 0;
+    for (std::size_t square = 0; square < distance.size(); ++square)
+        farthest = std::max(farthest, distance[square]);
+
+    // Smallest scale that fits every cost below the unreachable marker
+    int scale = std::max(1, (farthest + unreachable - 2) / (unreachable - 1));
+    scales[i] = scale;
+
+    std::size_t k = landmarks.size();
+    for (std::size_t square = 0; square < distance.size(); ++square)
+        table[square * k + i] = distance[square] == -1 ? unreachable : distance[square] / scale;
+}
+
+void Landmarks::repair(int square)
+{
+    std::size_t k = landmarks.size();
+    Point p(square % width, square / width);
+
+    for (std::size_t i = 0; i < k; ++i) {
+        std::vector<int> distance;
+
+        if (scales[i] != 1) {
+            // Scaled costs can't be compared exactly, so start again
+            distancesFrom(landmarks[i].gety() * width + landmarks[i].getx(), distance);
+            storeTable(i, distance);
+            repairedSquares += width * height;
+            continue;
+        }
+
+        // Lower the costs of the square and its neighbours to what the moves
+        // through the square now give, then carry that outward as Dijkstra
+        // does. Costs only go down, so only squares that change are visited
+        Queue queue;
+        bool overflow = false;
+
+        for (int j = -1; j < 8 && !overflow; ++j) {
+            Point q = j == -1 ? p : Point(p.getx() + moveDx[j], p.gety() + moveDy[j]);
+            if (q.getx() < 0 || q.gety() < 0 || q.getx() >= width ||
+                q.gety() >= height || grid->getSquare(q) != EMPTY)
+                continue;
+
+            int to = q.gety() * width + q.getx();
+            uint16_t &entry = table[to * k + i];
+            int best = entry == unreachable ? INT_MAX : entry;
+
+            // Moves are the same both ways, so the moves out of q are the
+            // moves into it
+            unsigned moves = grid->getMoves(q, movement);
+            for (int m = 0; m < 8; ++m) {
+                int from = to + moveDy[m] * width + moveDx[m];
+                if ((moves & (1u << m)) != 0 && table[from * k + i] != unreachable)
+                    best = std::min(best, table[from * k + i] + moveCost(from, to));
+            }
+
+            if (best >= (entry == unreachable ? INT_MAX : entry))
+                continue;
+
+            if (best >= unreachable) {
+                overflow = true;
+                break;
+            }
+
+            entry = best;
+            ++repairedSquares;
+            queue.push(Entry(best, to));
+        }
+
+        while (!queue.empty() && !overflow) {
+            Entry top = queue.top();
+            queue.pop();
+
+            int from = top.second;
+            if (top.first != table[from * k + i])
+                continue;
+
+            unsigned moves = grid->getMoves(Point(from % width, from / width), movement);
+            for (int m = 0; m < 8; ++m) {
+                if ((moves & (1u << m)) == 0)
+                    continue;
+
+                int to = from + moveDy[m] * width + moveDx[m];
+                int cost = top.first + moveCost(from, to);
+                uint16_t &entry = table[to * k + i];
+
+                if (entry != unreachable && cost >= entry)
+                    continue;
+
+                if (cost >= unreachable) {
+                    overflow = true;
+                    break;
+                }
+
+                entry = cost;
+                ++repairedSquares;
+                queue.push(Entry(cost, to));
+            }
+        }
+
+        // Costs grew past what fits unscaled
+        if (overflow) {
+            distancesFrom(landmarks[i].gety() * width + landmarks[i].getx(), distance);
+            storeTable(i, distance);
+            repairedSquares += width * height;
+        }
+    }
+}
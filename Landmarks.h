@@ -0,0 +1,188 @@
+#ifndef LANDMARKS_H_
+#define LANDMARKS_H_
+
+#include <algorithm>
+#include <cstdlib>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "Grid.h"
+#include "Movement.h"
+#include "Point.h"
+
+/**
+ * Landmarks for the ALT (A*, landmarks, triangle inequality) heuristic on a
+ * Grid: a few squares spread far apart, with the cost of the cheapest path
+ * from each to every square. By the triangle inequality the cost from p to
+ * end is at least |d(L, end) - d(L, p)| for every landmark L, which follows
+ * walls that octile distance walks straight through.
+ *
+ * Landmarks are picked by farthest-point selection in the largest component:
+ * each is the square farthest from those already picked. Costs are those of
+ * AStar with the given move costs and movement rule, stored as uint16_t per
+ * square and landmark, divided by a per-landmark scale where they wouldn't
+ * fit. The tables for one square are stored together, so a lookup is one
+ * cache line.
+ *
+ * The tables follow changes to the watched Grid. Squares opening or getting
+ * cheaper can make paths cheaper, so the tables are repaired outward from
+ * them, or rebuilt where scaled. Squares filling or getting dearer only make
+ * paths dearer, which leaves the tables valid lower bounds, so they are left
+ * alone; rebuild() tightens them again.
+ *
+ * Lower bounds from scaled tables can be inconsistent, which BasicAStar
+ * allows for.
+ */
+class Landmarks : public GridObserver {
+ public:
+    /**
+     * Pick `count` landmarks on `grid`, work out their tables and start
+     * watching it
+     */
+    Landmarks(Grid *grid, int count = 8, int cardinalCost = 10, int diagonalCost = 14,
+              Movement movement = EIGHT_CONNECTED);
+    ~Landmarks();
+
+    /**
+     * Lower bound on the cost of a path from `p` to `end`, or 0 if no
+     * landmark reaches both
+     */
+    int lowerBound(const Point &p, const Point &end) const {
+        if (landmarks.empty())
+            return 0;
+
+        const uint16_t *from = &table[(p.gety() * width + p.getx()) * landmarks.size()];
+        const uint16_t *to = &table[(end.gety() * width + end.getx()) * landmarks.size()];
+
+        int bound = 0;
+        for (std::size_t i = 0; i < landmarks.size(); ++i) {
+            if (from[i] == unreachable || to[i] == unreachable)
+                continue;
+
+            // Each side is up to scale - 1 below the real cost
+            int difference = std::abs((int)from[i] - (int)to[i]) * scales[i] - (scales[i] - 1);
+            if (difference > bound)
+                bound = difference;
+        }
+
+        return bound;
+    }
+
+    /**
+     * Return true if these tables are for `grid`, with these move costs and
+     * movement rule
+     */
+    bool matches(const Grid *grid, int cardinalCost, int diagonalCost, Movement movement) const {
+        return grid == this->grid && cardinalCost == this->cardinalCost &&
+            diagonalCost == this->diagonalCost && movement == this->movement;
+    }
+
+    /**
+     * The grid the tables are for
+     */
+    const Grid *getGrid() const { return grid; }
+
+    int count() const { return landmarks.size(); }
+    Point getLandmark(int i) const { return landmarks[i]; }
+
+    /**
+     * Pick the landmarks again and work out all the tables from scratch
+     */
+    void rebuild();
+
+    /**
+     * Write the landmarks and tables to the file at `path`, or read them back
+     * in from one written for a grid of the same size with the same costs and
+     * movement rule. The squares must be the same as when written, which
+     * isn't checked. Return false on failure, leaving the tables as they were
+     * on a failed load
+     */
+    bool save(const std::string &path) const;
+    bool load(const std::string &path);
+
+    /**
+     * Number of squares whose costs were updated since the tables were last
+     * built, by repairs and rebuilds of single tables
+     */
+    long getRepairedSquares() const { return repairedSquares; }
+
+    /* GridObserver interface */
+    void squareChanged(const Grid &grid, const Point &p, Square previous);
+    void costChanged(const Grid &grid, const Point &p, uint8_t previous);
+    void gridReset(const Grid &grid);
+
+ private:
+    /* Table entry for squares a landmark can't reach */
+    static const uint16_t unreachable = 0xFFFF;
+
+    Grid *grid;
+
+    int width;
+    int height;
+
+    int cardinalCost;
+    int diagonalCost;
+    Movement movement;
+
+    /* Number of landmarks asked for */
+    int wanted;
+
+    std::vector<Point> landmarks;
+
+    /* Each landmark's table holds costs divided by its scale, rounded down */
+    std::vector<int> scales;
+
+    /* Table of landmark i for square (x, y) at (y * width + x) * count() + i */
+    std::vector<uint16_t> table;
+
+    long repairedSquares;
+
+    /**
+     * Cost of moving between neighbouring squares `a` and `b`, as AStar's
+     */
+    int moveCost(int a, int b) const;
+
+    /**
+     * Set `distance` to the cost from `source` to every square, -1 where
+     * unreachable
+     */
+    void distancesFrom(int source, std::vector<int> &distance) const;
+
+    /**
+     * Store `distance` as the table of landmark `i`
+     */
+    void storeTable(int i, const std::vector<int> &distance);
+
+    /**
+     * Update the tables for paths through square `square` having got
+     * cheaper
+     */
+    void repair(int square);
+};
+
+/**
+ * Heuristic for BasicAStar taking the larger of `Base` and the lower bound
+ * from `landmarks`, or just `Base` without landmarks
+ */
+template <class Base>
+class LandmarkHeuristic {
+ public:
+    typedef Base BaseType;
+
+    LandmarkHeuristic(int cardinal = 10, int diagonal = 14)
+        : base(cardinal, diagonal), landmarks(0) { }
+    LandmarkHeuristic(const Base &base, const Landmarks *landmarks)
+        : base(base), landmarks(landmarks) { }
+
+    int operator()(const Point &p, const Point &end) const {
+        int estimate = base(p, end);
+        return landmarks ? std::max(estimate, landmarks->lowerBound(p, end)) : estimate;
+    }
+
+ private:
+    Base base;
+    const Landmarks *landmarks;
+};
+
+#endif /* LANDMARKS_H_ */
@@ -0,0 +1,350 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "Clock.h"
+#include "Grid.h"
+#include "MapFile.h"
+#include "QueryProtocol.h"
+#include "Random.h"
+
+/*
+ * Load generator for the query server: sends random queries on a map from
+ * several connections, each keeping a number of queries in flight, and
+ * reports the throughput and the spread of latencies seen by the clients.
+ */
+
+static const char usage[] =
+    "Usage: loadgen [options] MAP\n"
+    "\n"
+    "Sends queries between random empty squares of MAP, which must be the map\n"
+    "the server loaded as number INDEX, and reports queries per second and\n"
+    "the latency percentiles.\n"
+    "\n"
+    "Options:\n"
+    "  -s SOCKET       path of the server's socket, /tmp/pathfinder.sock by default\n"
+    "  -n QUERIES      queries to send in all, 100000 by default\n"
+    "  -c CONNECTIONS  connections to send them on, each from its own thread,\n"
+    "                  4 by default\n"
+    "  -d DEPTH        queries each connection keeps in flight, 16 by default\n"
+    "  -i INDEX        index of the map on the server, 0 by default\n"
+    "  -r SEED         seed for the random queries, 1 by default\n"
+    "  -p              ask for the paths, not just their costs\n";
+
+struct Options {
+    Options() : socket("/tmp/pathfinder.sock"), queries(100000), connections(4), depth(16),
+                index(0), seed(1), paths(false) { }
+
+    std::string mapFile;
+    std::string socket;
+    long queries;
+    int connections;
+    int depth;
+    int index;
+    unsigned long seed;
+    bool paths;
+};
+
+/* What one connection saw */
+struct Results {
+    Results() : found(0), noPath(0), invalid(0), failed(false) { }
+
+    std::vector<double> latencies;
+    long found;
+    long noPath;
+    long invalid;
+    bool failed;
+};
+
+/**
+ * Buffers reads from a socket, so replies can be taken a field at a time
+ * without a system call each
+ */
+class Reader {
+ public:
+    explicit Reader(int fd) : fd(fd), start(0), end(0) { }
+
+    /**
+     * Read `n` bytes into `data`, waiting for them, returning false if the
+     * socket closes first
+     */
+    bool read(void *data, std::size_t n) {
+        char *to = (char *)data;
+        while (n > 0) {
+            if (start == end) {
+                ssize_t got = ::read(fd, buffer, sizeof(buffer));
+                if (got <= 0)
+                    return false;
+                start = 0;
+                end = got;
+            }
+
+            std::size_t taken = std::min(n, end - start);
+            std::memcpy(to, buffer + start, taken);
+            start += taken;
+            to += taken;
+            n -= taken;
+        }
+
+        return true;
+    }
+
+    /**
+     * Number of bytes that can be read without waiting
+     */
+    std::size_t buffered() const { return end - start; }
+
+ private:
+    int fd;
+    char buffer[65536];
+    std::size_t start, end;
+};
+
+static bool writeAll(int fd, const std::string &data)
+{
+    std::size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t n = write(fd, data.data() + sent, data.size() - sent);
+        if (n <= 0)
+            return false;
+        sent += n;
+    }
+
+    return true;
+}
+
+static int connectTo(const std::string &path)
+{
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+
+    if (path.size() >= sizeof(address.sun_path))
+        return -1;
+    std::strcpy(address.sun_path, path.c_str());
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd != -1 && connect(fd, (sockaddr *)&address, sizeof(address)) == -1) {
+        close(fd);
+        fd = -1;
+    }
+
+    return fd;
+}
+
+static Point randomEmptyPoint(const Grid &grid, Random &random)
+{
+    Point p;
+    do {
+        p = Point(random.nextBelow(grid.getWidth()), random.nextBelow(grid.getHeight()));
+    } while (grid.getSquare(p) == FULL);
+
+    return p;
+}
+
+/**
+ * Send `queries` queries on one connection, `options.depth` at a time,
+ * timing each from when it's sent to when its reply has been read
+ */
+static void drive(const Options &options, const Grid &grid, long queries, Random random,
+                  Results &results)
+{
+    int fd = connectTo(options.socket);
+    if (fd == -1) {
+        results.failed = true;
+        return;
+    }
+
+    Reader reader(fd);
+    std::vector<double> sent(queries, -1.0);
+    std::vector<QueryPoint> path;
+    std::string out;
+    long next = 0, received = 0;
+
+    results.latencies.reserve(queries);
+
+    while (received < queries) {
+        // Top up the queries in flight, in one write
+        out.clear();
+        double time = wallSeconds();
+        for (; next < queries && next - received < options.depth; ++next) {
+            Point start = randomEmptyPoint(grid, random), end = randomEmptyPoint(grid, random);
+
+            QueryRequest request;
+            request.id = next;
+            request.map = options.index;
+            request.flags = options.paths ? QUERY_WANT_PATH : 0;
+            request.startX = start.getx();
+            request.startY = start.gety();
+            request.endX = end.getx();
+            request.endY = end.gety();
+
+            out.append((const char *)&request, sizeof(request));
+            sent[next] = time;
+        }
+
+        if (!out.empty() && !writeAll(fd, out)) {
+            results.failed = true;
+            break;
+        }
+
+        // Wait for a reply, then take any others already here
+        do {
+            QueryReply reply;
+            if (!reader.read(&reply, sizeof(reply)) || reply.id >= (uint32_t)queries ||
+                sent[reply.id] < 0) {
+                results.failed = true;
+                break;
+            }
+
+            if (reply.flags & QUERY_WANT_PATH) {
+                path.resize(reply.length);
+                if (reply.length && !reader.read(&path[0], reply.length * sizeof(QueryPoint))) {
+                    results.failed = true;
+                    break;
+                }
+            }
+
+            results.latencies.push_back(wallSeconds() - sent[reply.id]);
+            sent[reply.id] = -1.0;
+            ++received;
+
+            if (reply.status == QUERY_FOUND)
+                ++results.found;
+            else if (reply.status == QUERY_NO_PATH)
+                ++results.noPath;
+            else
+                ++results.invalid;
+        } while (reader.buffered() >= sizeof(QueryReply));
+
+        if (results.failed)
+            break;
+    }
+
+    close(fd);
+}
+
+static bool parseOptions(int argc, char **argv, Options &options)
+{
+    int i = 1;
+    for (; i < argc && argv[i][0] == '-'; ++i) {
+        std::string option = argv[i];
+
+        if (option == "-p") {
+            options.paths = true;
+            continue;
+        }
+
+        if (i + 1 == argc)
+            return false;
+
+        const char *value = argv[++i];
+
+        if (option == "-s")
+            options.socket = value;
+        else if (option == "-n")
+            options.queries = std::atol(value);
+        else if (option == "-c")
+            options.connections = std::atoi(value);
+        else if (option == "-d")
+            options.depth = std::atoi(value);
+        else if (option == "-i")
+            options.index = std::atoi(value);
+        else if (option == "-r")
+            options.seed = std::strtoul(value, 0, 10);
+        else
+            return false;
+    }
+
+    if (i + 1 != argc || options.queries <= 0 || options.connections <= 0 ||
+        options.depth <= 0 || options.index < 0 || options.index > 65535)
+        return false;
+
+    options.mapFile = argv[i];
+    return true;
+}
+
+/* The latency at fraction `f` of the way through the sorted `latencies` */
+static double percentile(const std::vector<double> &latencies, double f)
+{
+    std::size_t i = std::min(latencies.size() - 1, (std::size_t)(f * latencies.size()));
+    return latencies[i];
+}
+
+int main(int argc, char **argv)
+{
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        std::cerr << usage;
+        return 2;
+    }
+
+    Grid grid(1, 1);
+    std::string error;
+    if (!loadMap(options.mapFile, grid, error)) {
+        std::cerr << options.mapFile << ": " << error << std::endl;
+        return 1;
+    }
+    if (grid.countFull() == grid.getWidth() * grid.getHeight()) {
+        std::cerr << options.mapFile << ": no empty squares" << std::endl;
+        return 1;
+    }
+
+    std::vector<Results> results(options.connections);
+    std::vector<std::thread> threads;
+    Random seeds(options.seed);
+
+    double start = wallSeconds();
+    for (int c = 0; c < options.connections; ++c) {
+        // Share the queries out, the first connections taking any left over
+        long queries = options.queries / options.connections +
+            (c < options.queries % options.connections);
+        threads.push_back(std::thread(drive, std::cref(options), std::cref(grid), queries,
+                                      Random(seeds.next()), std::ref(results[c])));
+    }
+    for (std::size_t c = 0; c < threads.size(); ++c)
+        threads[c].join();
+    double elapsed = wallSeconds() - start;
+
+    Results total;
+    for (std::size_t c = 0; c < results.size(); ++c) {
+        total.latencies.insert(total.latencies.end(), results[c].latencies.begin(),
+                               results[c].latencies.end());
+        total.found += results[c].found;
+        total.noPath += results[c].noPath;
+        total.invalid += results[c].invalid;
+        total.failed = total.failed || results[c].failed;
+    }
+
+    if (total.failed)
+        std::cerr << "Lost the connection to " << options.socket << std::endl;
+    if (total.latencies.empty())
+        return 1;
+
+    std::sort(total.latencies.begin(), total.latencies.end());
+
+    double sum = 0;
+    for (std::size_t i = 0; i < total.latencies.size(); ++i)
+        sum += total.latencies[i];
+
+    std::printf("%lu queries on %d connections, %d in flight each, in %.3f s: %.0f queries/s\n",
+                (unsigned long)total.latencies.size(), options.connections, options.depth,
+                elapsed, total.latencies.size() / elapsed);
+    std::printf("latency us: mean %.1f, p50 %.1f, p90 %.1f, p99 %.1f, max %.1f\n",
+                sum / total.latencies.size() * 1e6, percentile(total.latencies, 0.5) * 1e6,
+                percentile(total.latencies, 0.9) * 1e6, percentile(total.latencies, 0.99) * 1e6,
+                total.latencies.back() * 1e6);
+    std::printf("%ld found, %ld with no path, %ld invalid\n", total.found, total.noPath,
+                total.invalid);
+
+    return total.failed ? 1 : 0;
+}
@@ -0,0 +1,105 @@
+#include "MapFile.h"
+
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+/* Strip the carriage return of files written on Windows */
+static void chomp(std::string &line)
+{
+    if (!line.empty() && line[line.size() - 1] == '\r')
+        line.erase(line.size() - 1);
+}
+
+bool readMap(std::istream &in, Grid &grid, std::string &error)
+{
+    std::vector<std::string> rows;
+    std::string line;
+    int width = -1, height = -1;
+
+    if (!std::getline(in, line)) {
+        error = "empty map";
+        return false;
+    }
+    chomp(line);
+
+    if (line.compare(0, 5, "type ") == 0) {
+        // Moving AI header: height, width, then "map" before the rows
+        while (std::getline(in, line)) {
+            chomp(line);
+            std::istringstream fields(line);
+            std::string key;
+            fields >> key;
+
+            if (key == "height")
+                fields >> height;
+            else if (key == "width")
+                fields >> width;
+            else if (key == "map")
+                break;
+        }
+
+        if (line != "map" || width <= 0 || height <= 0) {
+            error = "bad map header";
+            return false;
+        }
+    } else {
+        rows.push_back(line);
+    }
+
+    while (std::getline(in, line)) {
+        chomp(line);
+        if (!line.empty())
+            rows.push_back(line);
+    }
+
+    if (width == -1) {
+        width = rows.empty() ? 0 : rows[0].size();
+        height = rows.size();
+    }
+
+    if (width == 0 || height == 0 || (int)rows.size() != height) {
+        error = "map has the wrong number of rows";
+        return false;
+    }
+
+    Grid loaded(width, height);
+    for (int y = 0; y < height; ++y) {
+        if ((int)rows[y].size() != width) {
+            std::ostringstream ss;
+            ss << "row " << y << " is not " << width << " squares wide";
+            error = ss.str();
+            return false;
+        }
+
+        for (int x = 0; x < width; ++x) {
+            char c = rows[y][x];
+            Point p(x, y);
+
+            if (c == 'x' || c == '@' || c == 'O' || c == 'T' || c == 'W') {
+                loaded.setSquare(p, FULL);
+            } else if (c >= '1' && c <= '9') {
+                loaded.setCost(p, c - '0');
+            } else if (c != 'o' && c != '.' && c != 'G' && c != 'S') {
+                std::ostringstream ss;
+                ss << "unknown square '" << c << "' at " << p;
+                error = ss.str();
+                return false;
+            }
+        }
+    }
+
+    grid = loaded;
+    return true;
+}
+
+bool loadMap(const std::string &path, Grid &grid, std::string &error)
+{
+    std::ifstream file(path.c_str());
+    if (!file) {
+        error = "can't open " + path;
+        return false;
+    }
+
+    return readMap(file, grid, error);
+}
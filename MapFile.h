@@ -0,0 +1,24 @@
+#ifndef MAP_FILE_H_
+#define MAP_FILE_H_
+
+#include <iostream>
+#include <string>
+
+#include "Grid.h"
+
+/**
+ * Read a map into `grid`, replacing it, from `in` or the file at `path`.
+ *
+ * Two formats are read. Maps in the Moving AI benchmark format start with
+ * "type", "height", "width" and "map" lines. Otherwise every line is a row,
+ * all the same length, as Grid::toString() writes them. In rows, 'o', '.',
+ * 'G' and 'S' are EMPTY, 'x', '@', 'O', 'T' and 'W' are FULL, and the digits
+ * 1 to 9 are EMPTY with that cost multiplier.
+ *
+ * Return false, setting `error` and leaving `grid` alone, if the map can't
+ * be read.
+ */
+bool readMap(std::istream &in, Grid &grid, std::string &error);
+bool loadMap(const std::string &path, Grid &grid, std::string &error);
+
+#endif /* MAP_FILE_H_ */
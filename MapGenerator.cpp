@@ -0,0 +1,324 @@
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+#include "MapGenerator.h"
+
+void generateRandomFill(Grid &grid, double density, Random &random)
+{
+    Grid map(grid.getWidth(), grid.getHeight());
+    map.populate((int)(density * grid.getWidth() * grid.getHeight() + 0.5), random);
+
+    grid = map;
+}
+
+/**
+ * Chamber of a division maze, with inclusive bounds
+ */
+struct Chamber {
+    int x0, y0, x1, y1;
+};
+
+void generateDivisionMaze(Grid &grid, Random &random)
+{
+    Grid map(grid.getWidth(), grid.getHeight());
+
+    if (map.getWidth() == 0 || map.getHeight() == 0) {
+        grid = map;
+        return;
+    }
+
+    // Divide chambers using a stack instead of recursion, so big maps can't
+    // overflow the call stack
+    std::vector<Chamber> chambers;
+    Chamber all = { 0, 0, map.getWidth() - 1, map.getHeight() - 1 };
+    chambers.push_back(all);
+
+    while (!chambers.empty()) {
+        Chamber c = chambers.back();
+        chambers.pop_back();
+
+        // Chambers start on even coordinates, so a wall fits on the odd
+        // coordinates strictly inside them
+        int nRows = (c.y1 - c.y0) / 2;
+        int nColumns = (c.x1 - c.x0) / 2;
+
+        if (nRows == 0 && nColumns == 0)
+            continue;
+
+        // Cut across the longer side, or randomly if square
+        bool horizontal;
+        if (nRows == 0 || nColumns == 0)
+            horizontal = nRows > 0;
+        else if (c.y1 - c.y0 != c.x1 - c.x0)
+            horizontal = c.y1 - c.y0 > c.x1 - c.x0;
+        else
+            horizontal = random.nextBelow(2) == 0;
+
+        if (horizontal) {
+            int wall = c.y0 + 1 + 2 * random.nextBelow(nRows);
+            int gap = c.x0 + 2 * random.nextBelow((c.x1 - c.x0) / 2 + 1);
+
+            map.fillRect(c.x0, wall, c.x1 - c.x0 + 1, 1, FULL);
+            map.setSquare(Point(gap, wall), EMPTY);
+
+            Chamber above = { c.x0, c.y0, c.x1, wall - 1 };
+            Chamber below = { c.x0, wall + 1, c.x1, c.y1 };
+            chambers.push_back(above);
+            chambers.push_back(below);
+        } else {
+            int wall = c.x0 + 1 + 2 * random.nextBelow(nColumns);
+            int gap = c.y0 + 2 * random.nextBelow((c.y1 - c.y0) / 2 + 1);
+
+            map.fillRect(wall, c.y0, 1, c.y1 - c.y0 + 1, FULL);
+            map.setSquare(Point(wall, gap), EMPTY);
+
+            Chamber left = { c.x0, c.y0, wall - 1, c.y1 };
+            Chamber right = { wall + 1, c.y0, c.x1, c.y1 };
+            chambers.push_back(left);
+            chambers.push_back(right);
+        }
+    }
+
+    grid = map;
+}
+
+void generatePrimMaze(Grid &grid, Random &random)
+{
+    Grid map(grid.getWidth(), grid.getHeight());
+    map.fillRect(0, 0, map.getWidth(), map.getHeight(), FULL);
+
+    int nx = (map.getWidth() + 1) / 2;
+    int ny = (map.getHeight() + 1) / 2;
+
+    if (nx == 0 || ny == 0) {
+        grid = map;
+        return;
+    }
+
+    static const int dx[] = { 1, -1, 0, 0 };
+    static const int dy[] = { 0, 0, 1, -1 };
+
+    // Frontier of (wall, cell beyond it) pairs
+    std::vector<std::pair<Point, Point> > frontier;
+
+    Point start(2 * random.nextBelow(nx), 2 * random.nextBelow(ny));
+    map.setSquare(start, EMPTY);
+
+    for (int d = 0; d < 4; ++d)
+        frontier.push_back(std::make_pair(start + Point(dx[d], dy[d]),
+                                          start + Point(2 * dx[d], 2 * dy[d])));
+
+    while (!frontier.empty()) {
+        // Take a random frontier entry by swapping it to the back
+        std::size_t i = random.nextBelow(frontier.size());
+        std::swap(frontier[i], frontier.back());
+        std::pair<Point, Point> next = frontier.back();
+        frontier.pop_back();
+
+        Point cell = next.second;
+
+        // Off the grid squares read as FULL, so check bounds explicitly
+        if (cell.getx() < 0 || cell.gety() < 0 ||
+            cell.getx() >= map.getWidth() || cell.gety() >= map.getHeight() ||
+            map.getSquare(cell) == EMPTY)
+            continue;
+
+        map.setSquare(next.first, EMPTY);
+        map.setSquare(cell, EMPTY);
+
+        for (int d = 0; d < 4; ++d)
+            frontier.push_back(std::make_pair(cell + Point(dx[d], dy[d]),
+                                              cell + Point(2 * dx[d], 2 * dy[d])));
+    }
+
+    grid = map;
+}
+
+/**
+ * Room of a rooms-and-corridors map, with its top-left corner and size
+ */
+struct Room {
+    int x, y, w, h;
+
+    Point centre() const { return Point(x + w / 2, y + h / 2); }
+
+    /* True if the rooms overlap or touch */
+    bool touches(const Room &r) const {
+        return x <= r.x + r.w && r.x <= x + w && y <= r.y + r.h && r.y <= y + h;
+    }
+};
+
+void generateRooms(Grid &grid, int nRooms, int minSize, int maxSize, Random &random)
+{
+    Grid map(grid.getWidth(), grid.getHeight());
+    map.fillRect(0, 0, map.getWidth(), map.getHeight(), FULL);
+
+    minSize = std::max(minSize, 1);
+    maxSize = std::max(maxSize, minSize);
+
+    std::vector<Room> rooms;
+
+    // Give up on a room after a few failed placements
+    for (int attempt = 0; attempt < nRooms * 8 && (int)rooms.size() < nRooms; ++attempt) {
+        Room room;
+        room.w = minSize + random.nextBelow(maxSize - minSize + 1);
+        room.h = minSize + random.nextBelow(maxSize - minSize + 1);
+
+        if (room.w + 2 > map.getWidth() || room.h + 2 > map.getHeight())
+            continue;
+
+        // Keep a FULL border around the edge of the map
+        room.x = 1 + random.nextBelow(map.getWidth() - room.w - 1);
+        room.y = 1 + random.nextBelow(map.getHeight() - room.h - 1);
+
+        bool free = true;
+        for (std::size_t i = 0; i < rooms.size() && free; ++i)
+            free = !room.touches(rooms[i]);
+
+        if (!free)
+            continue;
+
+        map.fillRect(room.x, room.y, room.w, room.h, EMPTY);
+
+        // Join to the previous room, going either way round the corner
+        if (!rooms.empty()) {
+            Point from = rooms.back().centre();
+            Point to = room.centre();
+
+            int left = std::min(from.getx(), to.getx());
+            int right = std::max(from.getx(), to.getx());
+            int top = std::min(from.gety(), to.gety());
+            int bottom = std::max(from.gety(), to.gety());
+
+            int cornerx, cornery;
+            if (random.nextBelow(2) == 0) {
+                cornerx = to.getx();
+                cornery = from.gety();
+            } else {
+                cornerx = from.getx();
+                cornery = to.gety();
+            }
+
+            map.fillRect(left, cornery, right - left + 1, 1, EMPTY);
+            map.fillRect(cornerx, top, 1, bottom - top + 1, EMPTY);
+        }
+
+        rooms.push_back(room);
+    }
+
+    grid = map;
+}
+
+/**
+ * Perlin-style gradient noise over a 256-entry permutation table
+ */
+class GradientNoise {
+ public:
+    GradientNoise(Random &random) {
+        for (int i = 0; i < 256; ++i)
+            perm[i] = i;
+
+        // Fisher-Yates shuffle
+        for (int i = 255; i > 0; --i)
+            std::swap(perm[i], perm[random.nextBelow(i + 1)]);
+
+        for (int i = 0; i < 256; ++i)
+            perm[256 + i] = perm[i];
+    }
+
+    /**
+     * Noise at (x, y), roughly in [-1, 1]
+     */
+    double at(double x, double y) const {
+        double fx = std::floor(x);
+        double fy = std::floor(y);
+
+        int xi = (int)fx & 255;
+        int yi = (int)fy & 255;
+        double xf = x - fx;
+        double yf = y - fy;
+
+        double u = fade(xf);
+        double v = fade(yf);
+
+        double n00 = gradient(perm[perm[xi] + yi], xf, yf);
+        double n10 = gradient(perm[perm[xi + 1] + yi], xf - 1, yf);
+        double n01 = gradient(perm[perm[xi] + yi + 1], xf, yf - 1);
+        double n11 = gradient(perm[perm[xi + 1] + yi + 1], xf - 1, yf - 1);
+
+        double top = n00 + u * (n10 - n00);
+        double bottom = n01 + u * (n11 - n01);
+
+        return top + v * (bottom - top);
+    }
+
+ private:
+    int perm[512];
+
+    static double fade(double t) {
+        return t * t * t * (t * (t * 6 - 15) + 10);
+    }
+
+    /* Dot product with one of eight gradient directions */
+    static double gradient(int hash, double x, double y) {
+        switch (hash & 7) {
+        case 0: return x + y;
+        case 1: return x - y;
+        case 2: return -x + y;
+        case 3: return -x - y;
+        case 4: return x;
+        case 5: return -x;
+        case 6: return y;
+        default: return -y;
+        }
+    }
+};
+
+/**
+ * Compare (noise, index) pairs by noise only
+ */
+static bool compareByNoise(const std::pair<float, int> &p1, const std::pair<float, int> &p2)
+{
+    return p1.first < p2.first;
+}
+
+void generateCaves(Grid &grid, double density, double scale, Random &random)
+{
+    int width = grid.getWidth();
+    int height = grid.getHeight();
+    int nCells = width * height;
+
+    Grid map(width, height);
+    GradientNoise noise(random);
+
+    const int octaves = 4;
+    double frequency = 1.0 / std::max(scale, 1.0);
+
+    // Sum octaves of noise at each Square
+    std::vector<std::pair<float, int> > values(nCells);
+    for (int y = 0; y < height; ++y)
+        for (int x = 0; x < width; ++x) {
+            double sum = 0;
+            double f = frequency;
+            double amplitude = 1;
+
+            for (int o = 0; o < octaves; ++o) {
+                sum += amplitude * noise.at(x * f, y * f);
+                f *= 2;
+                amplitude *= 0.5;
+            }
+
+            values[y * width + x] = std::make_pair((float)sum, y * width + x);
+        }
+
+    // The lowest nFull values become walls, giving the exact density
+    int nFull = std::min(nCells, std::max(0, (int)(density * nCells + 0.5)));
+    std::nth_element(values.begin(), values.begin() + nFull, values.end(), compareByNoise);
+
+    for (int i = 0; i < nFull; ++i)
+        map.setSquare(Point(values[i].second % width, values[i].second / width), FULL);
+
+    grid = map;
+}
@@ -0,0 +1,45 @@
+#ifndef MAP_GENERATOR_H_
+#define MAP_GENERATOR_H_
+
+#include "Grid.h"
+#include "Random.h"
+
+/**
+ * Procedural generators that overwrite every Square of a Grid with
+ * representative terrain for benchmarks and tests. Each one is deterministic
+ * given the state of `random`, and builds the map off to the side before
+ * assigning it, so observers of `grid` see a single reset.
+ */
+
+/**
+ * Make exactly round(`density` * width * height) random Squares FULL
+ */
+void generateRandomFill(Grid &grid, double density, Random &random);
+
+/**
+ * Perfect maze made by recursive division: walls lie on odd rows/columns and
+ * passages on even ones, so every EMPTY Square is reachable from every other
+ */
+void generateDivisionMaze(Grid &grid, Random &random);
+
+/**
+ * Perfect maze grown with randomised Prim's algorithm from a random cell.
+ * Cells lie on even rows/columns, with the Squares between them as walls
+ */
+void generatePrimMaze(Grid &grid, Random &random);
+
+/**
+ * Up to `nRooms` non-overlapping rectangular rooms with sides between
+ * `minSize` and `maxSize`, each joined to the previous one by an L-shaped
+ * corridor, carved out of a FULL grid
+ */
+void generateRooms(Grid &grid, int nRooms, int minSize, int maxSize, Random &random);
+
+/**
+ * Cave-like map from a few octaves of Perlin-style gradient noise, with
+ * features roughly `scale` Squares across, thresholded so that exactly
+ * round(`density` * width * height) Squares are FULL
+ */
+void generateCaves(Grid &grid, double density, double scale, Random &random);
+
+#endif /* MAP_GENERATOR_H_ */
@@ -0,0 +1,83 @@
+#ifndef MOVEMENT_H_
+#define MOVEMENT_H_
+
+/**
+ * Rules for which neighbours of a Square can be moved to.
+ *
+ * Corner cutting is moving diagonally past a FULL Square beside the move, and
+ * squeezing is moving diagonally between two FULL Squares, which something
+ * with any width can't do.
+ */
+enum Movement {
+    FOUR_CONNECTED,     /* Only north, east, south and west */
+    EIGHT_CONNECTED,    /* Diagonals too, squeezing and cutting corners */
+    NO_CORNER_CUTTING,  /* Diagonals only if both Squares beside them are EMPTY */
+    NO_SQUEEZING        /* Diagonals unless both Squares beside them are FULL */
+};
+
+/**
+ * Offsets of the eight moves, indexed by bit number in a move mask: north,
+ * east, south and west in bits 0-3, then north-east, south-east, south-west
+ * and north-west in bits 4-7, so that diagonal 4 + i lies between cardinals i
+ * and (i + 1) % 4
+ */
+static const int moveDx[8] = { 0, 1, 0, -1, 1, 1, -1, -1 };
+static const int moveDy[8] = { -1, 0, 1, 0, -1, 1, 1, -1 };
+
+/**
+ * Given the mask of EMPTY neighbours of a Square (see Grid::getEmptyMask()),
+ * return the mask of moves allowed under `M`. Each rule is a few bitwise
+ * operations, so searches specialised on `M` don't branch on it
+ */
+template <Movement M>
+inline unsigned allowedMoves(unsigned empty);
+
+template <>
+inline unsigned allowedMoves<FOUR_CONNECTED>(unsigned empty)
+{
+    return empty & 0xF;
+}
+
+template <>
+inline unsigned allowedMoves<EIGHT_CONNECTED>(unsigned empty)
+{
+    return empty;
+}
+
+template <>
+inline unsigned allowedMoves<NO_CORNER_CUTTING>(unsigned empty)
+{
+    // Bit i of `next` is cardinal (i + 1) % 4, the other side of diagonal 4 + i
+    unsigned cardinal = empty & 0xF;
+    unsigned next = ((cardinal >> 1) | (cardinal << 3)) & 0xF;
+
+    return cardinal | (((cardinal & next) << 4) & empty);
+}
+
+template <>
+inline unsigned allowedMoves<NO_SQUEEZING>(unsigned empty)
+{
+    unsigned cardinal = empty & 0xF;
+    unsigned next = ((cardinal >> 1) | (cardinal << 3)) & 0xF;
+
+    return cardinal | (((cardinal | next) << 4) & empty);
+}
+
+/**
+ * Same as above for a rule only known at run time
+ */
+inline unsigned allowedMoves(unsigned empty, Movement movement)
+{
+    switch (movement) {
+    case FOUR_CONNECTED:
+        return allowedMoves<FOUR_CONNECTED>(empty);
+    case NO_CORNER_CUTTING:
+        return allowedMoves<NO_CORNER_CUTTING>(empty);
+    case NO_SQUEEZING:
+        return allowedMoves<NO_SQUEEZING>(empty);
+    default:
+        return allowedMoves<EIGHT_CONNECTED>(empty);
+    }
+}
+
+#endif /* MOVEMENT_H_ */
@@ -0,0 +1,388 @@
+#include "MultiAgentPlanner.h"
+
+#include <algorithm>
+#include <climits>
+#include <functional>
+#include <queue>
+#include <utility>
+
+/**
+ * Number of the move from `a` to `b` (see Movement.h), or -1 if they are the
+ * same square
+ */
+static int moveBetween(const Point &a, const Point &b)
+{
+    for (int i = 0; i < 8; ++i)
+        if (a.getx() + moveDx[i] == b.getx() && a.gety() + moveDy[i] == b.gety())
+            return i;
+
+    return -1;
+}
+
+/**
+ * Position on `path` at timestep `time`, staying at the end once there
+ */
+static const Point &positionAt(const TimedPath &path, std::size_t time)
+{
+    return path[std::min(time, path.size() - 1)];
+}
+
+MultiAgentPlanner::MultiAgentPlanner(const Grid *grid)
+    : grid(grid), movement(EIGHT_CONNECTED), maxTime(1024), window(8), expansions(0),
+      firstAgent(0), quietFrom(0), distancesVersion(grid->getVersion())
+{
+}
+
+bool MultiAgentPlanner::plan(const std::vector<Agent> &agents, std::vector<TimedPath> &paths)
+{
+    clearReservations();
+    expansions = 0;
+    paths.assign(agents.size(), TimedPath());
+
+    bool planned = true;
+    for (std::size_t i = 0; i < agents.size(); ++i) {
+        if (search(agents[i].start, agents[i].goal, maxTime, goalFreeFrom(agents[i].goal),
+                   true, false, paths[i])) {
+            reservePath(paths[i], i, true);
+        } else {
+            // Leave it where it is, in everyone else's way
+            planned = false;
+            reservePath(TimedPath(1, agents[i].start), i, true);
+        }
+    }
+
+    return planned;
+}
+
+bool MultiAgentPlanner::planConflictBased(const std::vector<Agent> &agents,
+                                          std::vector<TimedPath> &paths, int maxNodes)
+{
+    expansions = 0;
+    paths.clear();
+
+    std::vector<TreeNode> tree(1);
+    tree[0].paths.resize(agents.size());
+    tree[0].cost = 0;
+
+    for (std::size_t i = 0; i < agents.size(); ++i) {
+        if (!planConstrained(agents[i], i, tree[0].constraints, tree[0].paths[i]))
+            return false;
+
+        tree[0].cost += tree[0].paths[i].size() - 1;
+    }
+
+    // Expand the tree cheapest node first
+    typedef std::pair<int, int> Entry;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry> > open;
+    open.push(Entry(tree[0].cost, 0));
+
+    while (!open.empty()) {
+        int current = open.top().second;
+        open.pop();
+
+        Conflict conflict;
+        if (!findConflict(tree[current].paths, conflict)) {
+            paths = tree[current].paths;
+            return true;
+        }
+
+        // Split on the conflict: either agent1 or agent2 keeps out of the way
+        for (int side = 0; side < 2; ++side) {
+            if ((int)tree.size() >= maxNodes)
+                return false;
+
+            Point from = side == 0 ? conflict.position : conflict.to;
+            Point to = side == 0 ? conflict.to : conflict.position;
+
+            Constraint constraint;
+            constraint.agent = side == 0 ? conflict.agent1 : conflict.agent2;
+            constraint.square = (conflict.swap ? from : conflict.position).gety() * grid->getWidth() +
+                                (conflict.swap ? from : conflict.position).getx();
+            constraint.move = conflict.swap ? moveBetween(from, to) : -1;
+            constraint.time = conflict.time;
+
+            TreeNode child = tree[current];
+            child.constraints.push_back(constraint);
+
+            TimedPath &path = child.paths[constraint.agent];
+            int oldLength = path.size();
+            if (!planConstrained(agents[constraint.agent], constraint.agent, child.constraints, path))
+                continue;
+
+            child.cost += (int)path.size() - oldLength;
+
+            tree.push_back(child);
+            open.push(Entry(child.cost, tree.size() - 1));
+        }
+    }
+
+    return false;
+}
+
+bool MultiAgentPlanner::planWindow(const std::vector<Point> &positions,
+                                   const std::vector<Point> &goals, std::vector<TimedPath> &paths)
+{
+    int n = positions.size();
+
+    clearReservations();
+    expansions = 0;
+    paths.assign(n, TimedPath());
+
+    bool planned = true;
+    for (int k = 0; k < n; ++k) {
+        int i = (firstAgent + k) % n;
+
+        if (!search(positions[i], goals[i], window, goalFreeFrom(goals[i]), false, true, paths[i])) {
+            planned = false;
+            paths[i].assign(window + 1, positions[i]);
+        }
+
+        reservePath(paths[i], i, false);
+    }
+
+    // Take turns at going first, so that no agent is always held up
+    if (n > 0)
+        firstAgent = (firstAgent + 1) % n;
+
+    return planned;
+}
+
+bool MultiAgentPlanner::findConflict(const std::vector<TimedPath> &paths, Conflict &conflict)
+{
+    std::size_t longest = 0;
+    for (std::size_t i = 0; i < paths.size(); ++i)
+        longest = std::max(longest, paths[i].size());
+
+    for (std::size_t t = 0; t < longest; ++t)
+        for (std::size_t i = 0; i < paths.size(); ++i) {
+            if (paths[i].empty())
+                continue;
+
+            const Point &a = positionAt(paths[i], t);
+            const Point &aNext = positionAt(paths[i], t + 1);
+
+            for (std::size_t j = i + 1; j < paths.size(); ++j) {
+                if (paths[j].empty())
+                    continue;
+
+                const Point &b = positionAt(paths[j], t);
+                const Point &bNext = positionAt(paths[j], t + 1);
+
+                bool swap = a != aNext && a == bNext && b == aNext;
+                if (a == b || swap) {
+                    conflict.agent1 = i;
+                    conflict.agent2 = j;
+                    conflict.time = t;
+                    conflict.position = a;
+                    conflict.to = aNext;
+                    conflict.swap = a != b;
+                    return true;
+                }
+            }
+        }
+
+    return false;
+}
+
+const std::vector<int> &MultiAgentPlanner::distancesTo(const Point &goal)
+{
+    if (grid->getVersion() != distancesVersion) {
+        distances.clear();
+        distancesVersion = grid->getVersion();
+    }
+
+    int width = grid->getWidth();
+    int square = goal.gety() * width + goal.getx();
+
+    std::map<int, std::vector<int> >::iterator found = distances.find(square);
+    if (found != distances.end())
+        return found->second;
+
+    // Breadth-first search out from the goal. Every rule allows a move both
+    // ways, so this is also the distance to the goal
+    std::vector<int> &distance = distances[square];
+    distance.assign((std::size_t)width * grid->getHeight(), -1);
+
+    if (grid->getSquare(goal) == FULL)
+        return distance;
+
+    std::vector<int> queue(1, square);
+    distance[square] = 0;
+
+    for (std::size_t head = 0; head < queue.size(); ++head) {
+        int current = queue[head];
+        unsigned moves = grid->getMoves(Point(current % width, current / width), movement);
+
+        for (int i = 0; i < 8; ++i) {
+            int next = current + moveDy[i] * width + moveDx[i];
+            if ((moves & (1u << i)) && distance[next] == -1) {
+                distance[next] = distance[current] + 1;
+                queue.push_back(next);
+            }
+        }
+    }
+
+    return distance;
+}
+
+bool MultiAgentPlanner::search(const Point &start, const Point &goal, int horizon,
+                               int goalFreeFrom, bool parked, bool windowed, TimedPath &path)
+{
+    path.clear();
+
+    if (grid->getSquare(start) == FULL || grid->getSquare(goal) == FULL)
+        return false;
+
+    int width = grid->getWidth();
+    int goalSquare = goal.gety() * width + goal.getx();
+    const std::vector<int> &distance = distancesTo(goal);
+
+    int startSquare = start.gety() * width + start.getx();
+    if (distance[startSquare] == -1)
+        return false;
+
+    // Every move and wait costs one timestep, so a state's g-value is its
+    // time and the first route to reach a state is a cheapest one. Ties on f
+    // go to the latest state, which is nearest the goal
+    typedef std::pair<std::pair<int, int>, int> Entry;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry> > open;
+
+    nodes.clear();
+    visited.clear();
+
+    StateNode first = { startSquare, 0, -1 };
+    nodes.push_back(first);
+    visited.reserve(ReservationTable::vertexKey(startSquare, 0), 0);
+    open.push(Entry(std::make_pair(distance[startSquare], 0), 0));
+
+    while (!open.empty()) {
+        int current = open.top().second;
+        open.pop();
+
+        StateNode node = nodes[current];
+        ++expansions;
+
+        if ((node.square == goalSquare && node.time >= goalFreeFrom) ||
+            (windowed && node.time == horizon)) {
+            // Walk back to the start, then pad a windowed path with waits
+            for (int i = current; i != -1; i = nodes[i].parent)
+                path.push_back(Point(nodes[i].square % width, nodes[i].square / width));
+
+            std::reverse(path.begin(), path.end());
+
+            if (windowed)
+                path.resize(horizon + 1, path.back());
+
+            return true;
+        }
+
+        if (node.time == horizon)
+            continue;
+
+        unsigned moves = grid->getMoves(Point(node.square % width, node.square / width), movement);
+        int time = node.time + 1;
+
+        // Waiting, then each move
+        for (int i = -1; i < 8; ++i) {
+            if (i != -1 && (moves & (1u << i)) == 0)
+                continue;
+
+            int next = i == -1 ? node.square : node.square + moveDy[i] * width + moveDx[i];
+            uint64_t key = ReservationTable::vertexKey(next, time);
+
+            // Once every reservation has passed nothing changes any more, so
+            // reaching a square later is never better than reaching it first
+            uint64_t visitedKey = ReservationTable::vertexKey(next, std::min(time, quietFrom));
+
+            if (visited.find(visitedKey) != -1 || reservations.find(key) != -1)
+                continue;
+
+            if (i != -1 && reservations.find(ReservationTable::edgeKey(node.square, i, node.time)) != -1)
+                continue;
+
+            if (parked && parkedFrom[next] <= time)
+                continue;
+
+            StateNode state = { next, time, current };
+            visited.reserve(visitedKey, nodes.size());
+            open.push(Entry(std::make_pair(time + distance[next], -time), nodes.size()));
+            nodes.push_back(state);
+        }
+    }
+
+    return false;
+}
+
+bool MultiAgentPlanner::planConstrained(const Agent &agent, int id,
+                                        const std::vector<Constraint> &constraints,
+                                        TimedPath &path)
+{
+    int width = grid->getWidth();
+    int goalSquare = agent.goal.gety() * width + agent.goal.getx();
+    int goalFree = 0;
+
+    // The agent's constraints are reservations held by nobody in particular,
+    // and it can't finish while it is kept off its goal
+    reservations.clear();
+    quietFrom = 0;
+    for (std::size_t i = 0; i < constraints.size(); ++i) {
+        const Constraint &c = constraints[i];
+        if (c.agent != id)
+            continue;
+
+        quietFrom = std::max(quietFrom, c.time + 1);
+
+        if (c.move == -1) {
+            reservations.reserve(ReservationTable::vertexKey(c.square, c.time), c.agent);
+            if (c.square == goalSquare)
+                goalFree = std::max(goalFree, c.time + 1);
+        } else {
+            reservations.reserve(ReservationTable::edgeKey(c.square, c.move, c.time), c.agent);
+        }
+    }
+
+    return search(agent.start, agent.goal, maxTime, goalFree, false, false, path);
+}
+
+void MultiAgentPlanner::reservePath(const TimedPath &path, int agent, bool park)
+{
+    int width = grid->getWidth();
+
+    for (std::size_t t = 0; t < path.size(); ++t) {
+        int square = path[t].gety() * width + path[t].getx();
+
+        reservations.reserve(ReservationTable::vertexKey(square, t), agent);
+        lastReserved[square] = std::max(lastReserved[square], (int)t);
+        quietFrom = std::max(quietFrom, (int)t + 1);
+
+        // Nobody may take the opposite move at the same time
+        if (t + 1 < path.size() && path[t + 1] != path[t]) {
+            int next = path[t + 1].gety() * width + path[t + 1].getx();
+            reservations.reserve(ReservationTable::edgeKey(next, moveBetween(path[t + 1], path[t]), t),
+                                 agent);
+        }
+    }
+
+    if (park && !path.empty()) {
+        int end = path.back().gety() * width + path.back().getx();
+        parkedFrom[end] = std::min(parkedFrom[end], (int)path.size() - 1);
+    }
+}
+
+int MultiAgentPlanner::goalFreeFrom(const Point &goal) const
+{
+    if (grid->getSquare(goal) == FULL)
+        return 0;
+
+    return lastReserved[goal.gety() * grid->getWidth() + goal.getx()] + 1;
+}
+
+void MultiAgentPlanner::clearReservations()
+{
+    std::size_t squares = (std::size_t)grid->getWidth() * grid->getHeight();
+
+    reservations.clear();
+    quietFrom = 0;
+    lastReserved.assign(squares, -1);
+    parkedFrom.assign(squares, INT_MAX);
+}
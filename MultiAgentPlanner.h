@@ -0,0 +1,231 @@
+#ifndef MULTI_AGENT_PLANNER_H_
+#define MULTI_AGENT_PLANNER_H_
+
+#include <map>
+#include <vector>
+
+#include "Grid.h"
+#include "Movement.h"
+#include "Point.h"
+#include "ReservationTable.h"
+
+/**
+ * Start and goal of one agent
+ */
+struct Agent {
+    Agent() { }
+    Agent(const Point &start, const Point &goal) : start(start), goal(goal) { }
+
+    Point start;
+    Point goal;
+};
+
+/**
+ * Position of an agent at each timestep, in forward order from timestep 0.
+ * After the last timestep the agent stays where it is
+ */
+typedef std::vector<Point> TimedPath;
+
+/**
+ * Two agents colliding: both on `position` at `time`, or if `swap`, agent1
+ * moving from `position` to `to` between `time` and `time + 1` while agent2
+ * moves the other way
+ */
+struct Conflict {
+    int agent1;
+    int agent2;
+    int time;
+    Point position;
+    Point to;
+    bool swap;
+};
+
+/**
+ * Class to plan collision-free paths for many agents on one Grid, with
+ * space-time A* where every move or wait takes one timestep and terrain costs
+ * are ignored. Two agents collide if they are on the same square at the same
+ * timestep, or swap squares between two timesteps.
+ *
+ * plan() is cooperative A*: agents are planned one at a time in order, each
+ * avoiding the squares and moves reserved by those before it in a
+ * ReservationTable. It is fast, but can fail where a better order wouldn't.
+ *
+ * planConflictBased() is conflict-based search, which finds paths with the
+ * smallest sum of arrival times but can take exponential time, so is meant
+ * for small groups of agents that cooperative A* can't untangle.
+ *
+ * planWindow() is windowed cooperative A*: each agent's reservations only
+ * reach `window` timesteps ahead, so that every tick only plans a short
+ * horizon from where the agents are, and agents take turns to go first.
+ *
+ * The heuristic is the distance to each goal ignoring other agents, which is
+ * worked out once per goal and kept until the Grid changes. The Grid must
+ * outlive the planner.
+ */
+class MultiAgentPlanner {
+ public:
+    MultiAgentPlanner(const Grid *grid);
+
+    /**
+     * Plan a path for each agent with cooperative A*, setting `paths[i]` to
+     * the path of `agents[i]`, which parks at its goal once there. Returns
+     * false if some agent has no path within getMaxTime() timesteps; its path
+     * is left empty and it is treated as staying at its start
+     */
+    bool plan(const std::vector<Agent> &agents, std::vector<TimedPath> &paths);
+
+    /**
+     * Plan paths for `agents` with conflict-based search, giving the least
+     * sum of arrival times. Returns false, leaving `paths` empty, if there is
+     * no solution or none was found within `maxNodes` high-level nodes
+     */
+    bool planConflictBased(const std::vector<Agent> &agents, std::vector<TimedPath> &paths,
+                           int maxNodes = 1000);
+
+    /**
+     * Plan the next getWindow() timesteps for agents at `positions` heading
+     * for `goals`, setting `paths[i]` to getWindow() + 1 positions starting
+     * at `positions[i]`. Agents reaching their goal wait there. Each call
+     * lets the next agent go first. Returns false if some agent was boxed in,
+     * in which case it waits where it is and may collide
+     */
+    bool planWindow(const std::vector<Point> &positions, const std::vector<Point> &goals,
+                    std::vector<TimedPath> &paths);
+
+    /**
+     * Find the first collision between `paths`, returning false if there is
+     * none
+     */
+    static bool findConflict(const std::vector<TimedPath> &paths, Conflict &conflict);
+
+    /**
+     * Get and set which moves are allowed, EIGHT_CONNECTED by default
+     */
+    Movement getMovement() const { return movement; }
+    void setMovement(Movement movement) { this->movement = movement; distances.clear(); }
+
+    /**
+     * Get and set the last timestep plan() and planConflictBased() search to
+     */
+    int getMaxTime() const { return maxTime; }
+    void setMaxTime(int maxTime) { this->maxTime = maxTime; }
+
+    /**
+     * Get and set the number of timesteps planWindow() plans
+     */
+    int getWindow() const { return window; }
+    void setWindow(int window) { this->window = window; }
+
+    /**
+     * Number of space-time states expanded by the last plan
+     */
+    int getExpansions() const { return expansions; }
+
+ private:
+    const Grid *grid;
+
+    Movement movement;
+    int maxTime;
+    int window;
+    int expansions;
+
+    /* Agent planned first by the next planWindow() */
+    int firstAgent;
+
+    /* Squares and moves held by agents already planned */
+    ReservationTable reservations;
+
+    /**
+     * First timestep after every reservation, and every parked agent's
+     * arrival. From then on the reservations can't change the search
+     */
+    int quietFrom;
+
+    /**
+     * Last timestep each square (y * width + x) is reserved at, or -1, and
+     * the timestep an agent parks on it from, or INT_MAX
+     */
+    std::vector<int> lastReserved;
+    std::vector<int> parkedFrom;
+
+    /**
+     * Distance in moves to each square from a goal, indexed by goal square,
+     * or -1 where unreachable, for the Grid version `distancesVersion`
+     */
+    std::map<int, std::vector<int> > distances;
+    unsigned long distancesVersion;
+
+    /**
+     * Space-time search node, with `parent` its index in this->nodes or -1
+     */
+    struct StateNode {
+        int square;
+        int time;
+        int parent;
+    };
+
+    std::vector<StateNode> nodes;
+
+    /* Index of the node for each vertexKey() reached by the current search */
+    ReservationTable visited;
+
+    /**
+     * Square (y * width + x) conflict-based search keeps `agent` off at
+     * timestep `time`, or if `move` isn't -1, move it can't take out of the
+     * square between `time` and `time + 1`
+     */
+    struct Constraint {
+        int agent;
+        int square;
+        int move;
+        int time;
+    };
+
+    /**
+     * Node of the conflict-based search tree: its constraints, the cheapest
+     * paths keeping to them and the sum of their arrival times
+     */
+    struct TreeNode {
+        std::vector<Constraint> constraints;
+        std::vector<TimedPath> paths;
+        int cost;
+    };
+
+    const std::vector<int> &distancesTo(const Point &goal);
+
+    /**
+     * Space-time A* from `start` at timestep 0 to `goal`, avoiding this->
+     * reservations and, if `parked`, squares from their parkedFrom time. The
+     * goal only counts when reached at or after `goalFreeFrom`. If `windowed`
+     * the search also ends on reaching timestep `horizon` anywhere, and the
+     * path is padded to `horizon` + 1 positions. Returns false if no path
+     * ends by `horizon`
+     */
+    bool search(const Point &start, const Point &goal, int horizon, int goalFreeFrom,
+                bool parked, bool windowed, TimedPath &path);
+
+    /**
+     * Plan agent number `id` on its own, keeping to its `constraints`
+     */
+    bool planConstrained(const Agent &agent, int id, const std::vector<Constraint> &constraints,
+                         TimedPath &path);
+
+    /**
+     * Reserve the squares and moves of `path` for `agent`, parking it at the
+     * end of the path for good if `park`
+     */
+    void reservePath(const TimedPath &path, int agent, bool park);
+
+    /**
+     * First timestep an agent can stop at `goal` for good, after everyone
+     * reserving it so far has passed
+     */
+    int goalFreeFrom(const Point &goal) const;
+
+    /**
+     * Forget every reservation
+     */
+    void clearReservations();
+};
+
+#endif /* MULTI_AGENT_PLANNER_H_ */
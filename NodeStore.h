@@ -0,0 +1,117 @@
+#ifndef NODE_STORE_H_
+#define NODE_STORE_H_
+
+#include <cstddef>
+#include <stdint.h>
+#include <vector>
+
+#include "Movement.h"
+#include "Point.h"
+
+/**
+ * Where a square stands in a search
+ */
+enum NodeState {
+    UNSEEN = 0,
+    OPEN,
+    CLOSED
+};
+
+/**
+ * Search state of BasicAStar for a rectangular grid with its first Point at
+ * (0, 0), as separate arrays indexed by square (y * width + x), so that the
+ * position of a node is its index and the search loop only touches the
+ * arrays it needs. gvalue and parent are only meaningful where state is not
+ * UNSEEN, and squares not reached since the last reset read as UNSEEN by
+ * their generation stamp, so a new search costs the same however big the
+ * grid. Kept between searches to reuse their memory.
+ *
+ * Every node store has the same members, so BasicAStar can use any of them
+ * (see SearchStorage).
+ */
+template <class Cost>
+class DenseNodeStore {
+ public:
+    DenseNodeStore() : width(0), generation(0) { }
+
+    /**
+     * Forget the previous search, ready to search `grid`
+     */
+    template <class GridT>
+    void reset(const GridT &grid) {
+        width = grid.getWidth();
+        std::size_t squares = (std::size_t)width * grid.getHeight();
+
+        if (gvalues.size() != squares) {
+            gvalues.resize(squares);
+            parents.resize(squares);
+            states.resize(squares);
+            stamps.assign(squares, 0);
+            generation = 0;
+        }
+
+        // Only clear the stamps when the generation wraps round to them
+        if (++generation == 0) {
+            stamps.assign(squares, 0);
+            generation = 1;
+        }
+    }
+
+    /**
+     * Index of the square at `p`
+     */
+    int index(const Point &p) { return p.gety() * width + p.getx(); }
+
+    /**
+     * Index of the square move `move` (see Movement.h) away from square
+     * `index`, which is at `p`
+     */
+    int neighbour(int index, const Point &p, int move) {
+        return index + moveDy[move] * width + moveDx[move];
+    }
+
+    Point point(int index) const { return Point(index % width, index / width); }
+
+    /**
+     * Cost multiplier of square `index`, which is at `p`, on the grid searched
+     */
+    template <class GridT>
+    uint8_t cost(const GridT &grid, int index, const Point &p) const { return grid.getCost(p); }
+
+    unsigned char &state(int index) {
+        // First time this search, so whatever it holds is from an older one
+        if (stamps[index] != generation) {
+            stamps[index] = generation;
+            states[index] = UNSEEN;
+        }
+        return states[index];
+    }
+
+    Cost &gvalue(int index) { return gvalues[index]; }
+    int &parent(int index) { return parents[index]; }
+
+    Cost gvalue(int index) const { return gvalues[index]; }
+    int parent(int index) const { return parents[index]; }
+
+ private:
+    int width;
+
+    std::vector<Cost> gvalues;
+    std::vector<int> parents;
+    std::vector<unsigned char> states;
+
+    /* Search each square's state was last set in, and the current one */
+    std::vector<unsigned> stamps;
+    unsigned generation;
+};
+
+/**
+ * Node store BasicAStar uses to search a GridT: DenseNodeStore unless a grid
+ * type specialises this
+ */
+template <class GridT, class Cost>
+struct SearchStorage {
+    typedef DenseNodeStore<Cost> Type;
+};
+
+#endif /* NODE_STORE_H_ */
@@ -0,0 +1,315 @@
+#include <algorithm>
+
+#include "PathCache.h"
+
+/* Rough size of the bookkeeping of one node of a std::list/std::map */
+static const std::size_t nodeOverhead = 4 * sizeof(void*);
+
+/* Whether an agent `size` squares across with its top-left corner at `a` covers `p` */
+static bool covers(const Point &a, int size, const Point &p) {
+    return a.getx() <= p.getx() && p.getx() < a.getx() + size &&
+           a.gety() <= p.gety() && p.gety() < a.gety() + size;
+}
+
+bool PathKey::operator<(const PathKey &k2) const {
+    if (start != k2.start)
+        return start < k2.start;
+    if (end != k2.end)
+        return end < k2.end;
+    return costs < k2.costs;
+}
+
+PathCache::PathCache(std::size_t budget)
+    : budget(budget), memoryUsage(0), sidedEntries(0), maxSize(1), grid(0), attached(0),
+      version(0),
+      hits(0), subPathHits(0), misses(0) { }
+
+PathCache::~PathCache() {
+    if (attached != 0)
+        attached->detach(this);
+}
+
+bool PathCache::lookup(const Grid &grid, const Point &start, const Point &end,
+                       const std::vector<int> &costs, Path &path) {
+    sync(grid);
+
+    PathKey key;
+    key.start = start;
+    key.end = end;
+    key.costs = costs;
+
+    EntryMap::iterator it = table.find(key);
+
+    // Exact hit, so move the entry to the front and return it
+    if (it != table.end()) {
+        entries.splice(entries.begin(), entries, it->second);
+        path = it->second->path;
+        ++hits;
+        return true;
+    }
+
+    if (lookupSubPath(key, path)) {
+        ++hits;
+        ++subPathHits;
+        return true;
+    }
+
+    ++misses;
+    return false;
+}
+
+bool PathCache::lookupSubPath(const PathKey &key, Path &path) {
+    std::pair<CellIndex::iterator, CellIndex::iterator> range =
+        cells.equal_range(key.start);
+
+    for (CellIndex::iterator it = range.first; it != range.second; ++it) {
+        EntryList::iterator entry = it->second;
+
+        if (entry->key.costs != key.costs)
+            continue;
+
+        // A route from a square back to itself has no direction to slice by
+        if (entry->key.start == entry->key.end)
+            continue;
+
+        const Path &route = entry->path;
+
+        Path::const_iterator from = std::find(route.begin(), route.end(), key.start);
+        Path::const_iterator to = std::find(route.begin(), route.end(), key.end);
+
+        if (from == route.end() || to == route.end())
+            continue;
+
+        /* Routes are stored in the order build returned them, so work out
+           which way this one runs before taking the slice */
+        bool forwards = route.front() == entry->key.start;
+
+        if (forwards && from <= to)
+            path.assign(from, to + 1);
+        else if (!forwards && to <= from)
+            path.assign(to, from + 1);
+        else
+            continue;
+
+        entries.splice(entries.begin(), entries, entry);
+        return true;
+    }
+
+    return false;
+}
+
+void PathCache::insert(const Grid &grid, const Point &start, const Point &end,
+                       const std::vector<int> &costs, const Path &path, bool sides,
+                       int size) {
+    sync(grid);
+
+    PathKey key;
+    key.start = start;
+    key.end = end;
+    key.costs = costs;
+
+    EntryMap::iterator existing = table.find(key);
+    if (existing != table.end())
+        erase(existing->second);
+
+    std::size_t bytes = sizeof(Entry) + 2 * nodeOverhead
+        + costs.size() * sizeof(int)
+        + path.size() * (sizeof(Point) + sizeof(CellIndex::value_type) + nodeOverhead);
+
+    // Never going to fit
+    if (bytes > budget)
+        return;
+
+    Entry entry;
+    entry.key = key;
+    entry.path = path;
+    entry.bytes = bytes;
+    entry.sides = sides;
+    entry.size = size;
+
+    entries.push_front(entry);
+    table[key] = entries.begin();
+
+    for (Path::const_iterator it = path.begin(); it != path.end(); ++it)
+        cells.insert(std::make_pair(*it, entries.begin()));
+
+    memoryUsage += bytes;
+    sidedEntries += sides;
+    maxSize = std::max(maxSize, size);
+    evict();
+}
+
+void PathCache::invalidate(const Point &p) {
+    // Erasing an entry removes its cells from the index, so restart each time
+    CellIndex::iterator it;
+    while ((it = cells.find(p)) != cells.end())
+        erase(it->second);
+
+    if (maxSize > 1)
+        invalidateNear(p, false);
+}
+
+void PathCache::invalidateBeside(const Point &p) {
+    if (sidedEntries > 0)
+        invalidateNear(p, true);
+}
+
+void PathCache::invalidateNear(const Point &p, bool beside) {
+    // The corners of agents covering p are up to maxSize - 1 squares up and
+    // left of it, and diagonal moves beside such a corner go between squares
+    // one further out
+    int reach = beside ? 1 : 0;
+    std::vector<EntryList::iterator> blocked;
+
+    for (int y = p.gety() - maxSize + 1 - reach; y <= p.gety() + reach; ++y) {
+        for (int x = p.getx() - maxSize + 1 - reach; x <= p.getx() + reach; ++x) {
+            std::pair<CellIndex::iterator, CellIndex::iterator> range =
+                cells.equal_range(Point(x, y));
+
+            for (CellIndex::iterator it = range.first; it != range.second; ++it) {
+                EntryList::iterator entry = it->second;
+
+                if (std::find(blocked.begin(), blocked.end(), entry) != blocked.end())
+                    continue;
+
+                if (!beside) {
+                    if (covers(it->first, entry->size, p))
+                        blocked.push_back(entry);
+                    continue;
+                }
+
+                if (!entry->sides)
+                    continue;
+
+                const Path &route = entry->path;
+
+                for (std::size_t i = 1; i < route.size(); ++i) {
+                    const Point &a = route[i - 1], &b = route[i];
+
+                    if (a.getx() != b.getx() && a.gety() != b.gety() &&
+                        (covers(Point(a.getx(), b.gety()), entry->size, p) ||
+                         covers(Point(b.getx(), a.gety()), entry->size, p))) {
+                        blocked.push_back(entry);
+                        break;
+                    }
+                }
+            }
+        }
+    }
+
+    for (std::size_t i = 0; i < blocked.size(); ++i)
+        erase(blocked[i]);
+}
+
+void PathCache::clear() {
+    entries.clear();
+    table.clear();
+    cells.clear();
+    memoryUsage = 0;
+    sidedEntries = 0;
+    maxSize = 1;
+}
+
+void PathCache::attach(Grid *grid) {
+    if (attached == grid)
+        return;
+
+    if (attached != 0)
+        attached->detach(this);
+
+    attached = grid;
+
+    if (attached != 0)
+        attached->attach(this);
+}
+
+void PathCache::detach(Grid *grid) {
+    if (attached != grid || attached == 0)
+        return;
+
+    attached->detach(this);
+    attached = 0;
+}
+
+void PathCache::setBudget(std::size_t budget) {
+    this->budget = budget;
+    evict();
+}
+
+void PathCache::resetCounters() {
+    hits = 0;
+    subPathHits = 0;
+    misses = 0;
+}
+
+void PathCache::squareChanged(const Grid &grid, const Point &p, Square previous) {
+    // Changes we didn't see in between, so nothing is known to be valid
+    if (this->grid != &grid || version + 1 != grid.getVersion()) {
+        clear();
+    } else if (grid.getSquare(p) == FULL) {
+        // Only routes through the blocked square, or squeezing past it, get
+        // longer
+        invalidate(p);
+        invalidateBeside(p);
+    } else {
+        // A newly opened square may shorten any route
+        clear();
+    }
+
+    this->grid = &grid;
+    version = grid.getVersion();
+}
+
+void PathCache::costChanged(const Grid &grid, const Point &p, uint8_t previous) {
+    // Like a square being blocked, only routes through a square that got
+    // more expensive get longer, but a cheaper one may shorten any route
+    if (this->grid != &grid || version + 1 != grid.getVersion() ||
+        grid.getCost(p) < previous) {
+        clear();
+    } else {
+        invalidate(p);
+    }
+
+    this->grid = &grid;
+    version = grid.getVersion();
+}
+
+void PathCache::gridReset(const Grid &grid) {
+    clear();
+
+    this->grid = &grid;
+    version = grid.getVersion();
+}
+
+void PathCache::sync(const Grid &grid) {
+    if (this->grid == &grid && version == grid.getVersion())
+        return;
+
+    clear();
+
+    this->grid = &grid;
+    version = grid.getVersion();
+}
+
+void PathCache::erase(EntryList::iterator entry) {
+    for (Path::const_iterator p = entry->path.begin(); p != entry->path.end(); ++p) {
+        std::pair<CellIndex::iterator, CellIndex::iterator> range = cells.equal_range(*p);
+
+        for (CellIndex::iterator it = range.first; it != range.second; ++it) {
+            if (it->second == entry) {
+                cells.erase(it);
+                break;
+            }
+        }
+    }
+
+    memoryUsage -= entry->bytes;
+    sidedEntries -= entry->sides;
+    table.erase(entry->key);
+    entries.erase(entry);
+}
+
+void PathCache::evict() {
+    while (memoryUsage > budget && !entries.empty())
+        erase(--entries.end());
+}
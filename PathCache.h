@@ -0,0 +1,178 @@
+#ifndef PATH_CACHE_H_
+#define PATH_CACHE_H_
+
+#include <cstddef>
+#include <list>
+#include <map>
+#include <vector>
+
+#include "Grid.h"
+#include "Point.h"
+
+/**
+ * Key of a cached path: the query end points plus the cost parameters of the
+ * PathFinder that built it (see PathFinder::getCostParameters())
+ */
+struct PathKey {
+    Point start;
+    Point end;
+    std::vector<int> costs;
+
+    bool operator<(const PathKey &k2) const;
+};
+
+/**
+ * LRU cache of Paths built on one Grid, sitting in front of PathFinder::build.
+ *
+ * Entries are keyed by start, end and cost parameters, and the whole cache is
+ * tied to the version of the Grid it was filled from. While attached to that
+ * Grid (PathFinder::setCache does this) it invalidates selectively: a Square
+ * becoming FULL only drops the routes of agents that would cover it, and
+ * those making a diagonal move beside it if stored as needing the Squares
+ * beside diagonals, whereas a Square becoming EMPTY may open a shortcut for
+ * any route and so drops everything.
+ *
+ * Besides exact hits, a query from C to D is answered from any cached route
+ * that visits C and then D, as a sub-path of an optimal path is itself optimal.
+ */
+class PathCache : public GridObserver {
+ public:
+    /**
+     * Create a cache that holds at most roughly `budget` bytes of paths
+     */
+    PathCache(std::size_t budget = 1 << 20);
+    ~PathCache();
+
+    /**
+     * Look up the path from `start` to `end` on `grid`, copying it to `path`
+     * and returning true on a hit. Changes to `grid` that the cache was not
+     * told about empty the cache first
+     */
+    bool lookup(const Grid &grid, const Point &start, const Point &end,
+                const std::vector<int> &costs, Path &path);
+
+    /**
+     * Store `path` (which may be empty, meaning no path exists) as the result
+     * of the query, evicting least recently used entries to stay in budget.
+     * `sides` says the diagonal moves of `path` were only allowed because of
+     * the Squares beside them (see PathFinder::diagonalsNeedSides()), and
+     * `size` is how many squares across the agent following it is, the path
+     * being of its top-left corner
+     */
+    void insert(const Grid &grid, const Point &start, const Point &end,
+                const std::vector<int> &costs, const Path &path, bool sides = false,
+                int size = 1);
+
+    /**
+     * Drop every cached route whose agent covers `p` somewhere along it
+     */
+    void invalidate(const Point &p);
+
+    /**
+     * Drop every entry, keeping the counters
+     */
+    void clear();
+
+    /**
+     * Start watching `grid` (detaching from any previous Grid), or stop
+     * watching it
+     */
+    void attach(Grid *grid);
+    void detach(Grid *grid);
+
+    /**
+     * Get and set the memory budget in bytes, shrinking the cache if needed
+     */
+    std::size_t getBudget() const { return budget; }
+    void setBudget(std::size_t budget);
+
+    /**
+     * Estimated number of bytes currently used, and number of entries
+     */
+    std::size_t getMemoryUsage() const { return memoryUsage; }
+    std::size_t size() const { return entries.size(); }
+
+    /**
+     * Hit counters, where sub-path hits are also counted in getHits()
+     */
+    unsigned long getHits() const { return hits; }
+    unsigned long getSubPathHits() const { return subPathHits; }
+    unsigned long getMisses() const { return misses; }
+    void resetCounters();
+
+    /* GridObserver interface */
+    void squareChanged(const Grid &grid, const Point &p, Square previous);
+    void costChanged(const Grid &grid, const Point &p, uint8_t previous);
+    void gridReset(const Grid &grid);
+
+ private:
+    struct Entry {
+        PathKey key;
+        Path path;
+        std::size_t bytes;
+        bool sides;
+        int size;
+    };
+
+    typedef std::list<Entry> EntryList;
+    typedef std::map<PathKey, EntryList::iterator> EntryMap;
+
+    /* Maps each cell to the entries whose routes visit it */
+    typedef std::multimap<Point, EntryList::iterator> CellIndex;
+
+    std::size_t budget;
+    std::size_t memoryUsage;
+
+    /* Number of entries stored with `sides` set */
+    std::size_t sidedEntries;
+
+    /* Biggest agent size stored since the cache was last emptied */
+    int maxSize;
+
+    /* Entries, most recently used first */
+    EntryList entries;
+    EntryMap table;
+    CellIndex cells;
+
+    /* Grid the entries were built on, and the version they are valid for */
+    const Grid *grid;
+    Grid *attached;
+    unsigned long version;
+
+    unsigned long hits;
+    unsigned long subPathHits;
+    unsigned long misses;
+
+    /**
+     * Empty the cache if `grid` isn't the Grid and version we hold paths for
+     */
+    void sync(const Grid &grid);
+
+    /**
+     * Find a cached route visiting `start` and later `end`, copying that part
+     * of it to `path`
+     */
+    bool lookupSubPath(const PathKey &key, Path &path);
+
+    /**
+     * Drop every route stored with `sides` that makes a diagonal move beside
+     * a square its agent would cover `p` from, which may no longer be allowed
+     * now that `p` is FULL
+     */
+    void invalidateBeside(const Point &p);
+
+    /**
+     * Drop the routes of agents bigger than one square covering `p`, or with
+     * `beside` those of invalidateBeside()
+     */
+    void invalidateNear(const Point &p, bool beside);
+
+    void erase(EntryList::iterator entry);
+    void evict();
+
+    /* Not copyable as the index holds iterators into `entries` */
+    PathCache(const PathCache &);
+    PathCache &operator=(const PathCache &);
+};
+
+#endif /* PATH_CACHE_H_ */
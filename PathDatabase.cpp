@@ -0,0 +1,525 @@
+#include "PathDatabase.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <queue>
+#include <utility>
+
+#if __cplusplus >= 201103L
+#include <atomic>
+#include <thread>
+#endif
+
+#if defined(__unix__) || defined(__APPLE__)
+#define PATH_DATABASE_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/* Start of every database file, ending in the format version */
+static const char magic[4] = {'C', 'P', 'D', '1'};
+
+/* Run entries hold a place in the order above 3 bits of move */
+static const int moveBits = 3;
+static const std::size_t maxSquares = (std::size_t)1 << (32 - moveBits);
+
+/* A target whose first move can be anything */
+static const unsigned anyMove = 0xFF;
+
+/**
+ * Lowest move in the non-empty set `moves`
+ */
+static inline uint32_t lowestMove(unsigned moves)
+{
+    uint32_t move = 0;
+    while ((moves & (1u << move)) == 0)
+        ++move;
+
+    return move;
+}
+
+/**
+ * The grid as a graph, worked out once and shared by the threads building
+ */
+struct SearchGraph {
+    int width;
+    int squares;
+
+    /* Moves allowed out of each square, and their costs at square * 8 + move */
+    std::vector<uint8_t> moves;
+    std::vector<int> costs;
+
+    /* As PathDatabase */
+    std::vector<uint32_t> positions;
+    std::vector<int32_t> labels;
+
+    /* Square at each place in the order */
+    std::vector<int> order;
+};
+
+/**
+ * Work out the moves, costs, components and depth-first order of `grid`
+ */
+static void makeGraph(const Grid &grid, int cardinalCost, int diagonalCost, Movement movement,
+                      SearchGraph &graph)
+{
+    int width = grid.getWidth(), height = grid.getHeight();
+    graph.width = width;
+    graph.squares = width * height;
+    graph.moves.assign(graph.squares, 0);
+    graph.costs.assign(graph.squares * 8, 0);
+
+    for (int s = 0; s < graph.squares; ++s) {
+        Point p(s % width, s / width);
+        if (grid.getSquare(p) != EMPTY)
+            continue;
+
+        graph.moves[s] = grid.getMoves(p, movement);
+        for (int m = 0; m < 8; ++m)
+            if (graph.moves[s] & (1u << m)) {
+                Point q(p.getx() + moveDx[m], p.gety() + moveDy[m]);
+                int base = (moveDx[m] != 0 && moveDy[m] != 0) ? diagonalCost : cardinalCost;
+                graph.costs[s * 8 + m] = base * (grid.getCost(p) + grid.getCost(q)) / 2;
+            }
+    }
+
+    // Depth-first from each square not yet reached labels a component and
+    // numbers its squares. FULL squares go at the end
+    graph.labels.assign(graph.squares, -1);
+    graph.positions.assign(graph.squares, 0);
+    graph.order.clear();
+
+    int label = 0;
+    std::vector<std::pair<int, int> > stack;
+    for (int s = 0; s < graph.squares; ++s) {
+        if (graph.labels[s] != -1 || grid.getSquare(Point(s % width, s / width)) != EMPTY)
+            continue;
+
+        graph.labels[s] = label;
+        graph.positions[s] = graph.order.size();
+        graph.order.push_back(s);
+        stack.push_back(std::make_pair(s, 0));
+
+        while (!stack.empty()) {
+            int square = stack.back().first;
+            int &m = stack.back().second;
+
+            while (m < 8 && !(graph.moves[square] & (1u << m) &&
+                              graph.labels[square + moveDy[m] * width + moveDx[m]] == -1))
+                ++m;
+
+            if (m == 8) {
+                stack.pop_back();
+                continue;
+            }
+
+            int next = square + moveDy[m] * width + moveDx[m];
+            graph.labels[next] = label;
+            graph.positions[next] = graph.order.size();
+            graph.order.push_back(next);
+            stack.push_back(std::make_pair(next, 0));
+        }
+
+        ++label;
+    }
+
+    for (int s = 0; s < graph.squares; ++s)
+        if (graph.labels[s] == -1) {
+            graph.positions[s] = graph.order.size();
+            graph.order.push_back(s);
+        }
+}
+
+/**
+ * Search state of one thread, kept between sources
+ */
+struct BuildScratch {
+    std::vector<int> distance;
+    std::vector<uint8_t> firstMoves;
+};
+
+/**
+ * Set `runs` to the runs of first moves from `source`
+ */
+static void buildRuns(const SearchGraph &graph, int source, BuildScratch &scratch,
+                      std::vector<uint32_t> &runs)
+{
+    typedef std::pair<int, int> Entry;
+
+    runs.clear();
+    if (graph.labels[source] == -1) {
+        runs.push_back(0);
+        return;
+    }
+
+    // Dijkstra, carrying the set of first moves that start a cheapest path
+    // to each square: those of every square it is cheapest to come from
+    std::vector<int> &distance = scratch.distance;
+    std::vector<uint8_t> &firstMoves = scratch.firstMoves;
+    distance.assign(graph.squares, -1);
+    firstMoves.assign(graph.squares, 0);
+
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry> > queue;
+    distance[source] = 0;
+    queue.push(Entry(0, source));
+
+    while (!queue.empty()) {
+        Entry entry = queue.top();
+        queue.pop();
+
+        int square = entry.second;
+        if (entry.first != distance[square])
+            continue;
+
+        for (int m = 0; m < 8; ++m) {
+            if ((graph.moves[square] & (1u << m)) == 0)
+                continue;
+
+            int next = square + moveDy[m] * graph.width + moveDx[m];
+            int cost = entry.first + graph.costs[square * 8 + m];
+            uint8_t moves = square == source ? 1u << m : firstMoves[square];
+
+            if (distance[next] == -1 || cost < distance[next]) {
+                distance[next] = cost;
+                firstMoves[next] = moves;
+                queue.push(Entry(cost, next));
+            } else if (cost == distance[next]) {
+                firstMoves[next] |= moves;
+            }
+        }
+    }
+
+    // Each run takes targets in order while some move is cheapest for all of
+    // them, so runs are as long as they can be
+    unsigned common = anyMove;
+    uint32_t start = 0;
+
+    for (int i = 0; i < graph.squares; ++i) {
+        int target = graph.order[i];
+        unsigned moves = graph.labels[target] == graph.labels[source] && target != source ?
+            firstMoves[target] : anyMove;
+
+        if ((common & moves) == 0) {
+            runs.push_back(start << moveBits | lowestMove(common));
+            start = i;
+            common = moves;
+        } else {
+            common &= moves;
+        }
+    }
+
+    runs.push_back(start << moveBits | lowestMove(common));
+}
+
+#if __cplusplus >= 201103L
+/**
+ * Build the runs of sources `next` onwards, taking them a few at a time,
+ * into `rows`
+ */
+static void buildRows(const SearchGraph &graph, std::atomic<int> &next,
+                      std::vector<std::vector<uint32_t> > &rows)
+{
+    BuildScratch scratch;
+    const int batch = 16;
+
+    for (int first = next.fetch_add(batch); first < graph.squares; first = next.fetch_add(batch))
+        for (int s = first; s < std::min(first + batch, graph.squares); ++s)
+            buildRuns(graph, s, scratch, rows[s]);
+}
+#endif
+
+PathDatabase::PathDatabase()
+    : header(0), offsets(0), positions(0), labels(0), runs(0), mapping(0), mappingSize(0)
+{
+}
+
+PathDatabase::~PathDatabase()
+{
+    unmap();
+}
+
+bool PathDatabase::build(const Grid &grid, int cardinalCost, int diagonalCost,
+                         Movement movement, int threads)
+{
+    unmap();
+    std::vector<uint64_t>().swap(buffer);
+    header = 0;
+
+    std::size_t squares = (std::size_t)grid.getWidth() * grid.getHeight();
+    if (squares == 0 || squares > maxSquares)
+        return false;
+
+    SearchGraph graph;
+    makeGraph(grid, cardinalCost, diagonalCost, movement, graph);
+
+    std::vector<std::vector<uint32_t> > rows(squares);
+
+#if __cplusplus >= 201103L
+    if (threads <= 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+
+    std::atomic<int> next(0);
+    std::vector<std::thread> workers;
+    for (int i = 1; i < threads; ++i)
+        workers.push_back(std::thread(buildRows, std::cref(graph), std::ref(next),
+                                      std::ref(rows)));
+
+    buildRows(graph, next, rows);
+    for (std::size_t i = 0; i < workers.size(); ++i)
+        workers[i].join();
+#else
+    BuildScratch scratch;
+    for (std::size_t s = 0; s < squares; ++s)
+        buildRuns(graph, s, scratch, rows[s]);
+#endif
+
+    // Lay it out as in the file
+    std::size_t runCount = 0;
+    for (std::size_t s = 0; s < squares; ++s)
+        runCount += rows[s].size();
+
+    std::size_t bytes = sizeof(Header) + (squares + 1) * sizeof(uint64_t) +
+        squares * (sizeof(uint32_t) + sizeof(int32_t)) + runCount * sizeof(uint32_t);
+    buffer.assign((bytes + sizeof(uint64_t) - 1) / sizeof(uint64_t), 0);
+
+    char *data = (char *)&buffer[0];
+    Header *h = (Header *)data;
+    std::memcpy(h->magic, magic, sizeof(magic));
+    h->width = grid.getWidth();
+    h->height = grid.getHeight();
+    h->cardinalCost = cardinalCost;
+    h->diagonalCost = diagonalCost;
+    h->movement = movement;
+    h->checksum = checksum(grid);
+    h->runCount = runCount;
+
+    uint64_t *o = (uint64_t *)(data + sizeof(Header));
+    uint32_t *p = (uint32_t *)(o + squares + 1);
+    int32_t *l = (int32_t *)(p + squares);
+    uint32_t *r = (uint32_t *)(l + squares);
+
+    o[0] = 0;
+    for (std::size_t s = 0; s < squares; ++s) {
+        std::copy(rows[s].begin(), rows[s].end(), r + o[s]);
+        o[s + 1] = o[s] + rows[s].size();
+        std::vector<uint32_t>().swap(rows[s]);
+    }
+
+    std::copy(graph.positions.begin(), graph.positions.end(), p);
+    std::copy(graph.labels.begin(), graph.labels.end(), l);
+
+    return attach(data, bytes);
+}
+
+bool PathDatabase::save(const std::string &path) const
+{
+    if (empty())
+        return false;
+
+    std::ofstream file(path.c_str(), std::ios::binary | std::ios::trunc);
+    file.write((const char *)header, getBytes());
+
+    return file.good();
+}
+
+bool PathDatabase::load(const std::string &path)
+{
+#ifdef PATH_DATABASE_MMAP
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd == -1)
+        return false;
+
+    struct stat status;
+    void *data = MAP_FAILED;
+    if (fstat(fd, &status) == 0 && status.st_size > 0)
+        data = mmap(0, status.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (data == MAP_FAILED)
+        return false;
+
+    // Check it before letting go of the database in use
+    PathDatabase check;
+    if (!check.attach(data, status.st_size)) {
+        munmap(data, status.st_size);
+        return false;
+    }
+
+    unmap();
+    std::vector<uint64_t>().swap(buffer);
+    mapping = data;
+    mappingSize = status.st_size;
+
+    return attach(data, status.st_size);
+#else
+    std::ifstream file(path.c_str(), std::ios::binary);
+    if (!file)
+        return false;
+
+    file.seekg(0, std::ios::end);
+    std::streamoff size = file.tellg();
+    file.seekg(0);
+    if (size <= 0)
+        return false;
+
+    std::vector<uint64_t> data((size + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+    file.read((char *)&data[0], size);
+    if (!file)
+        return false;
+
+    PathDatabase check;
+    if (!check.attach(&data[0], size))
+        return false;
+
+    unmap();
+    buffer.swap(data);
+    return attach(&buffer[0], size);
+#endif
+}
+
+bool PathDatabase::matches(const Grid &grid, int cardinalCost, int diagonalCost,
+                           Movement movement) const
+{
+    return !empty() && header->width == grid.getWidth() && header->height == grid.getHeight() &&
+        header->cardinalCost == cardinalCost && header->diagonalCost == diagonalCost &&
+        header->movement == movement && header->checksum == checksum(grid);
+}
+
+int PathDatabase::firstMove(const Point &from, const Point &to) const
+{
+    if (!contains(from) || !contains(to))
+        return -1;
+
+    int source = index(from), target = index(to);
+    if (source == target || labels[source] == -1 || labels[source] != labels[target])
+        return -1;
+
+    // The last run starting at or before the target's place
+    const uint32_t *first = runs + offsets[source];
+    const uint32_t *last = runs + offsets[source + 1];
+    uint32_t key = positions[target] << moveBits | ((1u << moveBits) - 1);
+
+    return *(std::upper_bound(first, last, key) - 1) & ((1u << moveBits) - 1);
+}
+
+Path PathDatabase::find(const Point &start, const Point &end) const
+{
+    Path path;
+    if (start == end) {
+        if (contains(start) && labels[index(start)] != -1)
+            path.push_back(start);
+        return path;
+    }
+
+    if (firstMove(start, end) == -1)
+        return path;
+
+    // Every step is along a cheapest path, so it gets there without
+    // visiting a square twice, unless the file was damaged
+    std::size_t squares = (std::size_t)header->width * header->height;
+    Point p = start;
+    path.push_back(p);
+    while (p != end) {
+        int move = firstMove(p, end);
+        if (move == -1 || path.size() > squares)
+            return Path();
+
+        p = Point(p.getx() + moveDx[move], p.gety() + moveDy[move]);
+        path.push_back(p);
+    }
+
+    std::reverse(path.begin(), path.end());
+    return path;
+}
+
+std::size_t PathDatabase::getRunCount() const
+{
+    return empty() ? 0 : header->runCount;
+}
+
+std::size_t PathDatabase::getBytes() const
+{
+    if (empty())
+        return 0;
+
+    std::size_t squares = (std::size_t)header->width * header->height;
+    return sizeof(Header) + (squares + 1) * sizeof(uint64_t) +
+        squares * (sizeof(uint32_t) + sizeof(int32_t)) + header->runCount * sizeof(uint32_t);
+}
+
+bool PathDatabase::attach(const void *data, std::size_t size)
+{
+    const char *bytes = (const char *)data;
+    const Header *h = (const Header *)bytes;
+
+    if (size < sizeof(Header) || std::memcmp(h->magic, magic, sizeof(magic)) != 0 ||
+        h->width <= 0 || h->height <= 0 || (std::size_t)h->width * h->height > maxSquares)
+        return false;
+
+    std::size_t squares = (std::size_t)h->width * h->height;
+    std::size_t runsAt = sizeof(Header) + (squares + 1) * sizeof(uint64_t) +
+        squares * (sizeof(uint32_t) + sizeof(int32_t));
+    if (size < runsAt || (size - runsAt) / sizeof(uint32_t) < h->runCount)
+        return false;
+
+    const uint64_t *o = (const uint64_t *)(bytes + sizeof(Header));
+    const uint32_t *p = (const uint32_t *)(o + squares + 1);
+    const int32_t *l = (const int32_t *)(p + squares);
+    const uint32_t *r = (const uint32_t *)(l + squares);
+
+    if (o[0] != 0 || o[squares] != h->runCount)
+        return false;
+
+    // Lookups index with these unchecked, so a damaged file must not get
+    // past here. Every square has at least one run, the first starting at
+    // place 0 and the others further on each time, within the order
+    for (std::size_t s = 0; s < squares; ++s) {
+        if (p[s] >= squares || l[s] < -1 || (std::size_t)l[s] + 1 > squares)
+            return false;
+
+        if (o[s + 1] <= o[s] || r[o[s]] >> moveBits != 0)
+            return false;
+
+        for (uint64_t i = o[s] + 1; i < o[s + 1]; ++i)
+            if (r[i] >> moveBits <= r[i - 1] >> moveBits || r[i] >> moveBits >= squares)
+                return false;
+    }
+
+    header = h;
+    offsets = o;
+    positions = p;
+    labels = l;
+    runs = r;
+
+    return true;
+}
+
+void PathDatabase::unmap()
+{
+#ifdef PATH_DATABASE_MMAP
+    if (mapping)
+        munmap(mapping, mappingSize);
+#endif
+
+    mapping = 0;
+    mappingSize = 0;
+}
+
+uint64_t PathDatabase::checksum(const Grid &grid)
+{
+    // FNV-1a over each square and its cost
+    uint64_t hash = 0xcbf29ce484222325ULL;
+
+    for (int y = 0; y < grid.getHeight(); ++y)
+        for (int x = 0; x < grid.getWidth(); ++x) {
+            Point p(x, y);
+            hash = (hash ^ grid.getSquare(p)) * 0x100000001b3ULL;
+            hash = (hash ^ grid.getCost(p)) * 0x100000001b3ULL;
+        }
+
+    return hash;
+}
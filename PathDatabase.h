@@ -0,0 +1,138 @@
+#ifndef PATH_DATABASE_H_
+#define PATH_DATABASE_H_
+
+#include <cstddef>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "Grid.h"
+#include "Movement.h"
+#include "Point.h"
+
+/**
+ * Compressed path database for a Grid that doesn't change: for every source
+ * square, the first move of a cheapest path to every target, so a whole path
+ * is found by following first moves with no search at all.
+ *
+ * The targets are numbered in depth-first order, which keeps squares that
+ * are near each other, and so mostly share a first move, next to each other.
+ * Each source's moves are then stored as runs of that order with the same
+ * move, a run starting wherever no single move is cheapest for all of the
+ * run's targets. FULL and unreachable targets fit any run. A lookup is a
+ * binary search of one source's runs.
+ *
+ * Building takes a Dijkstra search from every square, spread over threads
+ * when compiled as C++11. The database is held in the same layout as its
+ * file, which load() maps into memory rather than reading where it can,
+ * after checking that every run and index in it is in range.
+ */
+class PathDatabase {
+ public:
+    PathDatabase();
+    ~PathDatabase();
+
+    /**
+     * Build the database for `grid` with AStar's move costs and movement
+     * rule, using `threads` threads, or one per core if 0. Returns false,
+     * leaving the database empty, if the grid has too many squares
+     */
+    bool build(const Grid &grid, int cardinalCost = 10, int diagonalCost = 14,
+               Movement movement = EIGHT_CONNECTED, int threads = 0);
+
+    /**
+     * Write the database to the file at `path`, or use the one in it in
+     * place of this one. Return false on failure, leaving the database as
+     * it was on a failed load
+     */
+    bool save(const std::string &path) const;
+    bool load(const std::string &path);
+
+    /**
+     * Return true if this is a database for `grid`, as it is now, with these
+     * move costs and movement rule
+     */
+    bool matches(const Grid &grid, int cardinalCost, int diagonalCost, Movement movement) const;
+
+    /**
+     * First move (see Movement.h) of a cheapest path from `from` to `to`, or
+     * -1 if there is no path or they are the same square
+     */
+    int firstMove(const Point &from, const Point &to) const;
+
+    /**
+     * A cheapest path from `start` to `end` in reverse order, as AStar
+     * returns, or an empty path if there is none
+     */
+    Path find(const Point &start, const Point &end) const;
+
+    bool empty() const { return header == 0; }
+
+    /**
+     * Number of runs, and the size of the database in bytes
+     */
+    std::size_t getRunCount() const;
+    std::size_t getBytes() const;
+
+ private:
+    /* Start of the file, followed by the arrays below in order */
+    struct Header {
+        char magic[4];
+        int32_t width;
+        int32_t height;
+        int32_t cardinalCost;
+        int32_t diagonalCost;
+        int32_t movement;
+        uint64_t checksum;
+        uint64_t runCount;
+        uint64_t reserved[3];
+    };
+
+    const Header *header;
+
+    /* Runs of square s are runs[offsets[s]] up to runs[offsets[s + 1]] */
+    const uint64_t *offsets;
+
+    /* Place of each square in the order the runs cover */
+    const uint32_t *positions;
+
+    /* Connected component of each square, or -1 if FULL */
+    const int32_t *labels;
+
+    /* Each run's first place in the order, shifted up 3, and its move */
+    const uint32_t *runs;
+
+    /* The database when built or read in */
+    std::vector<uint64_t> buffer;
+
+    /* The database when mapped, or 0 */
+    void *mapping;
+    std::size_t mappingSize;
+
+    /**
+     * Point the arrays into `data`, which holds a whole database, returning
+     * false if it isn't one, or is damaged so that lookups could read
+     * outside it
+     */
+    bool attach(const void *data, std::size_t size);
+
+    void unmap();
+
+    bool contains(const Point &p) const {
+        return header != 0 && p.getx() >= 0 && p.gety() >= 0 &&
+            p.getx() < header->width && p.gety() < header->height;
+    }
+
+    int index(const Point &p) const { return p.gety() * header->width + p.getx(); }
+
+    /**
+     * Checksum of the squares and costs of `grid`
+     */
+    static uint64_t checksum(const Grid &grid);
+
+    // Not copyable, as it may own a mapping
+    PathDatabase(const PathDatabase &);
+    PathDatabase &operator=(const PathDatabase &);
+};
+
+#endif /* PATH_DATABASE_H_ */
@@ -1,7 +1,60 @@
 
+#include <algorithm>
 #include <utility>
 #include "PathFinder.h"
 
+PathFinder::~PathFinder()
+{
+    if (cache != 0)
+	cache->detach(&grid);
+}
+
+/**
+ * Build path, going through the cache if there is one.
+ */
+Path PathFinder::find(const Point &start, const Point &end)
+{
+    if (cache == 0)
+	return this->build(start, end);
+
+    std::vector<int> costs = this->getCostParameters();
+
+    Path path;
+    if (cache->lookup(grid, start, end, costs, path))
+	return path;
+
+    path = this->build(start, end);
+
+    // A cancelled search says nothing about whether there is a path
+    if (!cancelled())
+	cache->insert(grid, start, end, costs, path, this->diagonalsNeedSides(),
+		      this->getAgentSize());
+
+    return path;
+}
+
+void PathFinder::setCache(PathCache *cache)
+{
+    if (this->cache != 0)
+	this->cache->detach(&grid);
+
+    this->cache = cache;
+
+    if (cache != 0)
+	cache->attach(&grid);
+}
+
+/**
+ * Check the waypoints can all be reached from each other.
+ */
+bool PathFinder::allConnected(const std::vector<Point> &waypoints) const
+{
+    for (std::size_t i = 1; i < waypoints.size(); ++i)
+	if (!components.connected(waypoints.front(), waypoints.at(i)))
+	    return false;
+
+    return true;
+}
 
 /**
  * Build path from waypoints in order.
@@ -12,18 +65,27 @@ Path PathFinder::buildFromWaypoints(std::vector<Point> waypoints)
     if (waypoints.size() < 2)
 	return Path();
 
+    // Move blocked waypoints as build() would before checking them, so the
+    // legs join up where the searches really start and end
+    for (std::size_t i = 0; i < waypoints.size(); ++i)
+	waypoints[i] = this->snap(waypoints[i]);
+
+    // Don't solve any legs if one of them is bound to fail
+    if (!allConnected(waypoints))
+	return Path();
+
     // Path to return
     Path path;
 
     /* For each pair of points starting with the second point, get the path
      * between the current and previous point and append it to the current list
      * of points. */
-    for (int i = 1; i < waypoints.size(); ++i) {
+    for (std::size_t i = 1; i < waypoints.size(); ++i) {
 	// Generate path between previous and this waypoint
-	Path path2 = this->build(waypoints.at(i - 1), waypoints.at(i));
+	Path path2 = this->find(waypoints.at(i - 1), waypoints.at(i));
 
-	// If any of the paths are empty, return empty path
-	if (path2.size() == 0)
+	// If any of the paths are empty, or we were cancelled, return empty path
+	if (path2.size() == 0 || cancelled())
 	    return Path();
 
 	// Concatenate the new path onto the current path
@@ -52,9 +114,18 @@ Path PathFinder::buildWithHeuristic(std::vector<Point> waypoints)
     if (waypoints.size() < 2)
 	return Path();
 
+    // Move blocked waypoints as build() would before checking them, so the
+    // legs join up where the searches really start and end
+    for (std::size_t i = 0; i < waypoints.size(); ++i)
+	waypoints[i] = this->snap(waypoints[i]);
+
+    // Don't solve any legs if one of them is bound to fail
+    if (!allConnected(waypoints))
+	return Path();
+
     // If only two points, just build from start to end
     if (waypoints.size() == 2)
-	return this->build(waypoints.at(0), waypoints.at(1));
+	return this->find(waypoints.at(0), waypoints.at(1));
 
     Path path;
 
@@ -80,20 +151,20 @@ Path PathFinder::buildWithHeuristic(std::vector<Point> waypoints)
 	      compareByManhattan);
     
     // Build the path from start to the first point
-    path = this->build(start, midpointsAndHeuristics.at(0).first);
+    path = this->find(start, midpointsAndHeuristics.at(0).first);
 
-    // If start path empty, return empty path
-    if (path.size() == 0)
+    // If start path empty, or we were cancelled, return empty path
+    if (path.size() == 0 || cancelled())
 	return Path();
 
     // Now generate the paths in order of heuristic
-    for (int i = 1; i < midpointsAndHeuristics.size(); ++i) {
+    for (std::size_t i = 1; i < midpointsAndHeuristics.size(); ++i) {
 	// Generate path between previous and this waypoint
-	Path path2 = this->build(midpointsAndHeuristics.at(i - 1).first,
+	Path path2 = this->find(midpointsAndHeuristics.at(i - 1).first,
 				 midpointsAndHeuristics.at(i).first);
 
-	// If any of the paths are empty, return empty path
-	if (path2.size() == 0)
+	// If any of the paths are empty, or we were cancelled, return empty path
+	if (path2.size() == 0 || cancelled())
 	    return Path();
 
 	// Concatenate the new path onto the current path
@@ -101,7 +172,7 @@ Path PathFinder::buildWithHeuristic(std::vector<Point> waypoints)
     }
 
     // Add final path
-    Path path2 = this->build(midpointsAndHeuristics.back().first, end);
+    Path path2 = this->find(midpointsAndHeuristics.back().first, end);
 
     // If final path empty, return empty path
     if (path2.size() == 0)
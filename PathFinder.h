@@ -1,7 +1,12 @@
 #ifndef PATH_FINDER_H_
 #define PATH_FINDER_H_
 
+#include "Components.h"
 #include "Grid.h"
+#include "PathCache.h"
+#include "SearchControl.h"
+#include "SearchStats.h"
+#include "SearchTrace.h"
 
 typedef std::vector<Point> Path;
 
@@ -10,7 +15,9 @@ typedef std::vector<Point> Path;
  */
 class PathFinder {
  public:
- PathFinder(Grid grid) : grid(grid) { }
+ PathFinder(Grid grid) : grid(grid), stats(0), observer(0), control(0), cache(0),
+	components(&this->grid) { }
+    virtual ~PathFinder();
 	
     /**
      * Construct path between start and end point
@@ -19,11 +26,52 @@ class PathFinder {
      */
     virtual Path build(const Point &start, const Point &end) = 0;
 
+    /**
+     * Same as build() but answered from the attached PathCache when possible,
+     * storing the result in it otherwise. The waypoint methods below go
+     * through this
+     */
+    Path find(const Point &start, const Point &end);
+
+    /**
+     * Cost settings that change the result of build(), used to key the cache.
+     * Subclasses with such settings must override this
+     */
+    virtual std::vector<int> getCostParameters() const { return std::vector<int>(); }
+
+    /**
+     * Return true if build() only makes a diagonal move depending on the
+     * Squares beside it, so that blocking one of them can change the result.
+     * Subclasses with such movement rules must override this
+     */
+    virtual bool diagonalsNeedSides() const { return false; }
+
+    /**
+     * How many squares across the agent build() plans for is, its paths
+     * being of the agent's top-left corner. Subclasses planning for bigger
+     * agents must override this
+     */
+    virtual int getAgentSize() const { return 1; }
+
+    /**
+     * Attach `cache` (or 0 to remove it), watching this->grid so that edits
+     * to it invalidate the cached paths. The cache must outlive its use here
+     */
+    void setCache(PathCache *cache);
+    PathCache *getCache() const { return cache; }
+
+    /**
+     * Connected components of this->grid, kept up to date as it changes, for
+     * rejecting unreachable queries without searching
+     */
+    const Components &getComponents() const { return components; }
+
     /**
      * Construct path from series of waypoints, visiting them in order
      *
      * Returns empty path if the length of the waypoints vector is less than 2
-     * as we need at least one start and end point
+     * as we need at least one start and end point, or straight away if the
+     * waypoints are not all in the same component
      */
     Path buildFromWaypoints(std::vector<Point> waypoints);
 
@@ -34,14 +82,64 @@ class PathFinder {
      * furthest points will be visited first.
      *
      * Returns empty path if the length of the waypoints vector is less than 2
-     * as we need at least one start and end point
+     * as we need at least one start and end point, or straight away if the
+     * waypoints are not all in the same component
      */
     Path buildWithHeuristic(std::vector<Point> waypoints);
 
+    /**
+     * Attach `stats` to accumulate statistics of every search (only recorded
+     * when built with PATHFINDER_STATS), or `observer` to follow each search
+     * as it runs. Pass 0 to remove them
+     */
+    void setStats(SearchStats *stats) { this->stats = stats; }
+    void setObserver(SearchObserver *observer) { this->observer = observer; }
+
+    /**
+     * Attach `control` to be able to cancel searches and follow their
+     * progress, or 0 to remove it
+     */
+    void setControl(SearchControl *control) { this->control = control; }
+
     /**
      * The grid to pathfind on.
      */
     Grid grid;
+
+ protected:
+    SearchStats *stats;
+    SearchObserver *observer;
+    SearchControl *control;
+
+    /**
+     * Number of expansions between polls of this->control
+     */
+    static const int controlInterval = 256;
+
+    /**
+     * Return true if there is a control and it has cancelled the search
+     */
+    bool cancelled() const { return control != 0 && control->cancelled(); }
+
+    /**
+     * The point build() would really search from or to in place of `p`, for
+     * subclasses that move blocked points. `p` itself by default
+     */
+    virtual Point snap(const Point &p) const { return p; }
+
+ private:
+    PathCache *cache;
+
+    Components components;
+
+    /**
+     * Return true if every waypoint is in the same component as the first
+     */
+    bool allConnected(const std::vector<Point> &waypoints) const;
+
+    /* Not copyable as the cache watches this->grid */
+    PathFinder(const PathFinder &);
+    PathFinder &operator=(const PathFinder &);
 };
 
 #endif /* PATH_FINDER_H_ */
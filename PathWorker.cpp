@@ -0,0 +1,130 @@
+#include <utility>
+
+#include "Clock.h"
+#include "PathWorker.h"
+
+PathWorker::PathWorker(ResultCallback onResult, ProgressCallback onProgress, void *data,
+                       double progressInterval)
+    : onResult(onResult), onProgress(onProgress), data(data),
+      progressInterval(progressInterval), latest(0), stopping(false),
+      hasPending(false), snapshotSource(0), snapshotVersion(0), pathfinder(Grid(0, 0))
+{
+    thread = std::thread(&PathWorker::run, this);
+}
+
+PathWorker::~PathWorker()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        hasPending = false;
+    }
+
+    wake.notify_one();
+    thread.join();
+}
+
+unsigned long PathWorker::submit(const Grid &grid, const std::vector<Point> &waypoints,
+                                 bool heuristic, std::shared_ptr<SearchObserver> observer)
+{
+    // Copied before taking the lock, so the worker never waits on the copy
+    std::unique_ptr<Grid> snapshot;
+    if (&grid != snapshotSource || grid.getVersion() != snapshotVersion) {
+        snapshot.reset(new Grid(grid));
+        snapshotSource = &grid;
+        snapshotVersion = grid.getVersion();
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    // Bumping `latest` cancels whatever is running
+    pending.id = ++latest;
+    if (snapshot)
+        pending.grid = std::move(snapshot);
+    pending.version = grid.getVersion();
+    pending.waypoints = waypoints;
+    pending.heuristic = heuristic;
+    pending.observer = observer;
+    hasPending = true;
+
+    wake.notify_one();
+
+    return pending.id;
+}
+
+void PathWorker::cancel()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    ++latest;
+    hasPending = false;
+    pending.observer.reset();
+}
+
+void PathWorker::run()
+{
+    for (;;) {
+        Request request;
+
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this] { return hasPending || stopping; });
+
+            if (stopping)
+                return;
+
+            // Moved out, leaving no snapshot or observer behind
+            request = std::move(pending);
+            hasPending = false;
+        }
+
+        solve(request);
+    }
+}
+
+void PathWorker::solve(Request &request)
+{
+    // A new snapshot takes the place of the old grid without copying either
+    if (request.grid)
+        pathfinder.grid.swap(*request.grid);
+
+    Control control(this, request.id);
+    pathfinder.setControl(&control);
+    pathfinder.setObserver(request.observer.get());
+
+    PathResult result;
+    result.id = request.id;
+    result.version = request.version;
+
+    if (request.heuristic)
+        result.path = pathfinder.buildWithHeuristic(request.waypoints);
+    else
+        result.path = pathfinder.buildFromWaypoints(request.waypoints);
+
+    result.cost = pathfinder.pathCost(result.path);
+
+    pathfinder.setControl(0);
+    pathfinder.setObserver(0);
+
+    // Superseded requests have nobody waiting for them
+    if (!control.cancelled())
+        onResult(result, data);
+}
+
+bool PathWorker::Control::cancelled()
+{
+    return worker->stopping || worker->latest != id;
+}
+
+void PathWorker::Control::progress(long expanded)
+{
+    if (worker->onProgress == 0)
+        return;
+
+    double time = wallSeconds();
+    if (time - lastReport < worker->progressInterval)
+        return;
+
+    lastReport = time;
+    worker->onProgress(id, expanded, worker->data);
+}
@@ -0,0 +1,151 @@
+#ifndef PATH_WORKER_H_
+#define PATH_WORKER_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "AStar.h"
+#include "Grid.h"
+#include "SearchControl.h"
+#include "SearchTrace.h"
+
+/**
+ * Result of a PathWorker request, identified by the id submit() returned
+ */
+struct PathResult {
+    unsigned long id;
+
+    /* Version the submitted grid had when submitted, which the path was
+       found on */
+    unsigned long version;
+
+    Path path;
+
+    /* Cost of `path` (see AStar::pathCost) */
+    int cost;
+};
+
+/**
+ * Runs pathfinding requests on a background thread so that the caller (e.g.
+ * the GUI thread) never blocks on a search.
+ *
+ * Only the newest request matters: submitting one replaces any request still
+ * waiting and cancels the one running. Results and progress are delivered
+ * through callbacks run on the worker thread, so callers that need them on
+ * another thread must pass them over themselves (GridView uses Fl::awake).
+ *
+ * Needs C++11 threads.
+ */
+class PathWorker {
+ public:
+    typedef void (*ResultCallback)(const PathResult &result, void *data);
+    typedef void (*ProgressCallback)(unsigned long id, long expanded, void *data);
+
+    /**
+     * Start the worker thread, which calls `onResult` for every request that
+     * finishes without being cancelled, and `onProgress` (if not 0) at most
+     * every `progressInterval` seconds while searching. Both get `data`
+     */
+    PathWorker(ResultCallback onResult, ProgressCallback onProgress, void *data,
+               double progressInterval = 0.1);
+
+    /**
+     * Cancel any search and wait for the thread to stop
+     */
+    ~PathWorker();
+
+    /**
+     * Request a path through `waypoints` on a snapshot of `grid`, in the
+     * given order or in heuristic order (see PathFinder::buildWithHeuristic),
+     * returning the id of the request. If given, `observer` watches the
+     * search on the worker thread, and is kept alive until it is done.
+     *
+     * The snapshot is copied on the calling thread, only if `grid` isn't the
+     * grid last submitted, at the same address and version, and is handed to
+     * the worker without copying it again. Requests must all be submitted
+     * from the same thread
+     */
+    unsigned long submit(const Grid &grid, const std::vector<Point> &waypoints,
+                         bool heuristic,
+                         std::shared_ptr<SearchObserver> observer = std::shared_ptr<SearchObserver>());
+
+    /**
+     * Drop the waiting request and cancel the running one
+     */
+    void cancel();
+
+ private:
+    struct Request {
+        unsigned long id;
+
+        /* Snapshot of the grid submitted, or null if the worker already has
+           one of it at this version */
+        std::unique_ptr<Grid> grid;
+
+        /* Version of the grid submitted */
+        unsigned long version;
+
+        std::vector<Point> waypoints;
+        bool heuristic;
+        std::shared_ptr<SearchObserver> observer;
+
+        Request() : id(0), version(0), heuristic(false) { }
+    };
+
+    /**
+     * SearchControl cancelling the search once a newer request arrives
+     */
+    class Control : public SearchControl {
+     public:
+        Control(PathWorker *worker, unsigned long id) : worker(worker), id(id), lastReport(0) { }
+
+        bool cancelled();
+        void progress(long expanded);
+
+     private:
+        PathWorker *worker;
+        unsigned long id;
+        double lastReport;
+    };
+
+    ResultCallback onResult;
+    ProgressCallback onProgress;
+    void *data;
+    double progressInterval;
+
+    /* Id of the newest request, which every other request is superseded by */
+    std::atomic<unsigned long> latest;
+    std::atomic<bool> stopping;
+
+    std::mutex mutex;
+    std::condition_variable wake;
+
+    /* Request waiting to run, guarded by `mutex`. A snapshot in it stays
+       when the request is cancelled or replaced by one without, as the
+       worker still needs it */
+    Request pending;
+    bool hasPending;
+
+    /* Grid and version last snapshotted, used by the submitting thread only */
+    const Grid *snapshotSource;
+    unsigned long snapshotVersion;
+
+    /* Pathfinder kept between requests, so the components of an unchanged
+       grid are reused, whose grid is swapped with each new snapshot. Used on
+       the worker thread only */
+    AStar pathfinder;
+
+    std::thread thread;
+
+    void run();
+    void solve(Request &request);
+
+    PathWorker(const PathWorker &);
+    PathWorker &operator=(const PathWorker &);
+};
+
+#endif /* PATH_WORKER_H_ */
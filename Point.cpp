@@ -27,7 +27,7 @@ bool operator==(const Point &p1, const Point &p2) {
 }
 
 bool operator!=(const Point &p1, const Point &p2) {
-    return !(p1.getx() == p2.getx()) && (p1.gety() == p2.gety());
+    return !(p1 == p2);
 }
 
 std::ostream& operator<<(std::ostream &os, const Point &p) {
@@ -1,6 +1,8 @@
 #ifndef POINT_H_
 #define POINT_H_
 
+#include <iosfwd>
+
 /**
  * Class that represents a Point on the Grid. Interface to an (x, y) integer pair
  */
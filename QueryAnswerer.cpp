@@ -0,0 +1,132 @@
+#include "QueryAnswerer.h"
+
+#include <cstring>
+
+#include "BasicAStar.h"
+
+/**
+ * Search of `grid` under movement rule `M` with heuristic `Base`, guided by
+ * `landmarks` too unless 0. It only reads the grid, so searches on every
+ * thread can share it
+ */
+template <class Base, Movement M>
+static SearchTask *makeSearch(const Grid *grid, const Landmarks *landmarks,
+                              int cardinalCost, int diagonalCost)
+{
+    // Scaled by the cheapest terrain, as AStar does, so it never overestimates
+    int minCost = grid->getMinCost();
+    Base base(minCost * cardinalCost, minCost * diagonalCost);
+
+    if (landmarks) {
+        typedef BasicAStar<Grid, LandmarkHeuristic<Base>, int, MovePolicy<M> > Search;
+        Search search(grid, cardinalCost, diagonalCost);
+        search.setHeuristic(LandmarkHeuristic<Base>(base, landmarks));
+        return new BasicSearchTask<Search>(search);
+    }
+
+    typedef BasicAStar<Grid, Base, int, MovePolicy<M> > Search;
+    Search search(grid, cardinalCost, diagonalCost);
+    search.setHeuristic(base);
+    return new BasicSearchTask<Search>(search);
+}
+
+static SearchTask *makeSearch(const Grid *grid, const Landmarks *landmarks, Movement movement,
+                              int cardinalCost, int diagonalCost)
+{
+    switch (movement) {
+    case FOUR_CONNECTED:
+        return makeSearch<ManhattanHeuristic<int>, FOUR_CONNECTED>(grid, landmarks, cardinalCost,
+                                                                   diagonalCost);
+    case NO_CORNER_CUTTING:
+        return makeSearch<OctileHeuristic<int>, NO_CORNER_CUTTING>(grid, landmarks, cardinalCost,
+                                                                   diagonalCost);
+    case NO_SQUEEZING:
+        return makeSearch<OctileHeuristic<int>, NO_SQUEEZING>(grid, landmarks, cardinalCost,
+                                                              diagonalCost);
+    default:
+        return makeSearch<OctileHeuristic<int>, EIGHT_CONNECTED>(grid, landmarks, cardinalCost,
+                                                                 diagonalCost);
+    }
+}
+
+QueryAnswerer::QueryAnswerer(const std::vector<Grid> &maps,
+                             const std::vector<Components *> &components,
+                             const std::vector<Landmarks *> &landmarks, Movement movement,
+                             int cardinalCost, int diagonalCost)
+    : maps(maps), components(components)
+{
+    for (std::size_t i = 0; i < maps.size(); ++i)
+        searches.push_back(makeSearch(&maps[i], landmarks[i], movement, cardinalCost,
+                                      diagonalCost));
+}
+
+QueryAnswerer::~QueryAnswerer()
+{
+    for (std::size_t i = 0; i < searches.size(); ++i)
+        delete searches[i];
+}
+
+void QueryAnswerer::answer(const QueryRequest &request, QueryReply &reply,
+                           std::vector<QueryPoint> &path)
+{
+    reply.id = request.id;
+    reply.flags = request.flags;
+    reply.status = QUERY_INVALID;
+    reply.cost = -1;
+    reply.length = 0;
+    path.clear();
+
+    if (request.map >= searches.size())
+        return;
+
+    const Grid &grid = maps[request.map];
+    if (request.startX >= grid.getWidth() || request.startY >= grid.getHeight() ||
+        request.endX >= grid.getWidth() || request.endY >= grid.getHeight())
+        return;
+
+    // Points in different components would flood the whole component of
+    // the start for nothing
+    Point start(request.startX, request.startY), end(request.endX, request.endY);
+    reply.status = QUERY_NO_PATH;
+    if (!components[request.map]->connected(start, end))
+        return;
+
+    SearchTask *search = searches[request.map];
+    search->begin(start, end);
+    if (search->step(-1) != SEARCH_FOUND)
+        return;
+
+    Path found = search->getPath();
+
+    reply.status = QUERY_FOUND;
+    reply.cost = search->getCost();
+    reply.length = found.size();
+
+    // Paths come end first
+    if (request.flags & QUERY_WANT_PATH) {
+        path.resize(found.size());
+        for (std::size_t i = 0; i < found.size(); ++i) {
+            const Point &p = found[found.size() - 1 - i];
+            path[i].x = p.getx();
+            path[i].y = p.gety();
+        }
+    }
+}
+
+void takeRequests(std::string &in, std::vector<QueryRequest> &requests)
+{
+    std::size_t used = 0;
+    for (; used + sizeof(QueryRequest) <= in.size(); used += sizeof(QueryRequest)) {
+        QueryRequest request;
+        std::memcpy(&request, in.data() + used, sizeof(QueryRequest));
+        requests.push_back(request);
+    }
+    in.erase(0, used);
+}
+
+void appendReply(std::string &out, const QueryReply &reply, const std::vector<QueryPoint> &path)
+{
+    out.append((const char *)&reply, sizeof(QueryReply));
+    if (!path.empty())
+        out.append((const char *)&path[0], path.size() * sizeof(QueryPoint));
+}
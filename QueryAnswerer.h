@@ -0,0 +1,58 @@
+#ifndef QUERY_ANSWERER_H_
+#define QUERY_ANSWERER_H_
+
+#include <string>
+#include <vector>
+
+#include "Components.h"
+#include "Grid.h"
+#include "Landmarks.h"
+#include "Movement.h"
+#include "QueryProtocol.h"
+#include "SearchTask.h"
+
+/**
+ * Answers the query server's requests (see QueryProtocol.h) on its maps, one
+ * at a time, with a search of its own for each map. The maps, their
+ * components and landmarks are only read, so answerers on every thread can
+ * share them, and all must outlive the answerer.
+ */
+class QueryAnswerer {
+ public:
+    /**
+     * Answerer for `maps`, with the components of each in `components` and
+     * the landmarks of each in `landmarks`, or 0 to search without, using
+     * `movement` and the move costs given
+     */
+    QueryAnswerer(const std::vector<Grid> &maps, const std::vector<Components *> &components,
+                  const std::vector<Landmarks *> &landmarks, Movement movement,
+                  int cardinalCost, int diagonalCost);
+    ~QueryAnswerer();
+
+    /**
+     * Answer `request` in `reply`, with the squares of the path from start
+     * to end in `path` if it was found and asked for, and none otherwise
+     */
+    void answer(const QueryRequest &request, QueryReply &reply, std::vector<QueryPoint> &path);
+
+ private:
+    const std::vector<Grid> &maps;
+    const std::vector<Components *> &components;
+    std::vector<SearchTask *> searches;
+
+    QueryAnswerer(const QueryAnswerer &);
+    QueryAnswerer &operator=(const QueryAnswerer &);
+};
+
+/**
+ * Move the whole requests at the front of `in`, bytes as read from a
+ * client, to the end of `requests`, leaving any part of one still to come
+ */
+void takeRequests(std::string &in, std::vector<QueryRequest> &requests);
+
+/**
+ * Append `reply`, and `path` after it, to `out` as written to a client
+ */
+void appendReply(std::string &out, const QueryReply &reply, const std::vector<QueryPoint> &path);
+
+#endif /* QUERY_ANSWERER_H_ */
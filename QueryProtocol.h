@@ -0,0 +1,47 @@
+#ifndef QUERY_PROTOCOL_H_
+#define QUERY_PROTOCOL_H_
+
+#include <stdint.h>
+
+/*
+ * Wire format of the query server (Server.cpp) on its Unix domain socket.
+ *
+ * Clients write QueryRequests and read QueryReplies, each a fixed 16 bytes
+ * in host byte order, as both ends are on one machine. A reply for a
+ * request with QUERY_WANT_PATH is followed by `length` QueryPoints, from
+ * start to end. Clients may write many requests without waiting for their
+ * replies, and replies may come back in any order, so they carry the id of
+ * their request.
+ */
+
+enum QueryFlags {
+    QUERY_WANT_PATH = 1
+};
+
+enum QueryStatus {
+    QUERY_FOUND,
+    QUERY_NO_PATH,
+    QUERY_INVALID   // No such map, or a point off it
+};
+
+struct QueryRequest {
+    uint32_t id;
+    uint16_t map;       // Index of the map, in the order the server loaded them
+    uint16_t flags;
+    uint16_t startX, startY;
+    uint16_t endX, endY;
+};
+
+struct QueryReply {
+    uint32_t id;
+    uint16_t flags;     // Those of the request
+    uint16_t status;
+    int32_t cost;       // -1 unless QUERY_FOUND
+    uint32_t length;    // Squares on the path, start and end included
+};
+
+struct QueryPoint {
+    uint16_t x, y;
+};
+
+#endif /* QUERY_PROTOCOL_H_ */
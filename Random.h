@@ -0,0 +1,79 @@
+#ifndef RANDOM_H_
+#define RANDOM_H_
+
+#include <stdint.h>
+
+/**
+ * Small, fast, seedable pseudo-random number generator (xoshiro256**), used
+ * instead of std::rand so that generated grids are reproducible from a seed
+ * and independent of any other code using std::rand.
+ *
+ * The four words of state are filled from the seed with splitmix64, as the
+ * xoshiro authors recommend, so any seed (including 0) is fine.
+ */
+class Random {
+ public:
+    Random(uint64_t seed = 0) { setSeed(seed); }
+
+    void setSeed(uint64_t seed) {
+        for (int i = 0; i < 4; ++i) {
+            seed += 0x9e3779b97f4a7c15ULL;
+            uint64_t z = seed;
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+            s[i] = z ^ (z >> 31);
+        }
+    }
+
+    /**
+     * Return the next 64 random bits
+     */
+    uint64_t next() {
+        uint64_t result = rotl(s[1] * 5, 7) * 9;
+        uint64_t t = s[1] << 17;
+
+        s[2] ^= s[0];
+        s[3] ^= s[1];
+        s[1] ^= s[2];
+        s[0] ^= s[3];
+        s[2] ^= t;
+        s[3] = rotl(s[3], 45);
+
+        return result;
+    }
+
+    /**
+     * Return a uniformly distributed integer in [0, n), for n > 0
+     */
+    uint32_t nextBelow(uint32_t n) {
+        // Lemire's multiply and reject method, which avoids a division
+        uint64_t m = (next() >> 32) * n;
+        uint32_t low = (uint32_t)m;
+
+        if (low < n) {
+            uint32_t threshold = -n % n;
+            while (low < threshold) {
+                m = (next() >> 32) * n;
+                low = (uint32_t)m;
+            }
+        }
+
+        return (uint32_t)(m >> 32);
+    }
+
+    /**
+     * Return a uniformly distributed double in [0, 1)
+     */
+    double nextDouble() {
+        return (next() >> 11) * (1.0 / 9007199254740992.0);
+    }
+
+ private:
+    uint64_t s[4];
+
+    static uint64_t rotl(uint64_t x, int k) {
+        return (x << k) | (x >> (64 - k));
+    }
+};
+
+#endif /* RANDOM_H_ */
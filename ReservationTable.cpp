@@ -0,0 +1,59 @@
+#include "ReservationTable.h"
+
+const uint64_t ReservationTable::emptyKey;
+
+ReservationTable::ReservationTable() : keys(1024, emptyKey), agents(1024, -1), count(0)
+{
+}
+
+void ReservationTable::reserve(uint64_t key, int agent)
+{
+    if (2 * (count + 1) > keys.size())
+        grow();
+
+    std::size_t i = slot(key);
+    while (keys[i] != emptyKey && keys[i] != key)
+        i = (i + 1) & (keys.size() - 1);
+
+    if (keys[i] == emptyKey) {
+        keys[i] = key;
+        ++count;
+    }
+
+    agents[i] = agent;
+}
+
+int ReservationTable::find(uint64_t key) const
+{
+    std::size_t i = slot(key);
+    while (keys[i] != emptyKey) {
+        if (keys[i] == key)
+            return agents[i];
+
+        i = (i + 1) & (keys.size() - 1);
+    }
+
+    return -1;
+}
+
+void ReservationTable::clear()
+{
+    if (count == 0)
+        return;
+
+    keys.assign(keys.size(), emptyKey);
+    count = 0;
+}
+
+void ReservationTable::grow()
+{
+    std::vector<uint64_t> oldKeys(keys.size() * 2, emptyKey);
+    std::vector<int> oldAgents(agents.size() * 2, -1);
+    oldKeys.swap(keys);
+    oldAgents.swap(agents);
+
+    count = 0;
+    for (std::size_t i = 0; i < oldKeys.size(); ++i)
+        if (oldKeys[i] != emptyKey)
+            reserve(oldKeys[i], oldAgents[i]);
+}
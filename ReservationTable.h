@@ -0,0 +1,77 @@
+#ifndef RESERVATION_TABLE_H_
+#define RESERVATION_TABLE_H_
+
+#include <cstddef>
+#include <stdint.h>
+#include <vector>
+
+/**
+ * Hash table from space-time keys to the agent holding them, for planning
+ * several agents on one Grid without collisions.
+ *
+ * A key is either a square at a timestep (vertexKey()) or a move out of a
+ * square during a timestep (edgeKey()), with squares numbered y * width + x
+ * and moves numbered as in Movement.h. Keys are kept in one open-addressed
+ * array with linear probing, so a lookup is usually a single cache line and
+ * clear() keeps the memory for the next plan.
+ */
+class ReservationTable {
+ public:
+    ReservationTable();
+
+    /**
+     * Key for being on `square` at timestep `time`
+     */
+    static uint64_t vertexKey(int square, int time) {
+        return ((uint64_t)time << 36) | (uint32_t)square;
+    }
+
+    /**
+     * Key for taking move `move` out of `square` between timesteps `time`
+     * and `time + 1`
+     */
+    static uint64_t edgeKey(int square, int move, int time) {
+        return ((uint64_t)time << 36) | ((uint64_t)(move + 1) << 32) | (uint32_t)square;
+    }
+
+    /**
+     * Give `key` to `agent`, replacing any agent already holding it
+     */
+    void reserve(uint64_t key, int agent);
+
+    /**
+     * Agent holding `key`, or -1 if it is free
+     */
+    int find(uint64_t key) const;
+
+    /**
+     * Free every key
+     */
+    void clear();
+
+    /**
+     * Number of keys held
+     */
+    std::size_t size() const { return count; }
+
+ private:
+    /* Marks an unused slot; no real key has every bit set */
+    static const uint64_t emptyKey = ~(uint64_t)0;
+
+    /* Slots, a power of two of them, never more than half full */
+    std::vector<uint64_t> keys;
+    std::vector<int> agents;
+
+    std::size_t count;
+
+    std::size_t slot(uint64_t key) const {
+        return (std::size_t)((key * 0x9E3779B97F4A7C15ULL) >> 32) & (keys.size() - 1);
+    }
+
+    /**
+     * Double the number of slots and insert every key again
+     */
+    void grow();
+};
+
+#endif /* RESERVATION_TABLE_H_ */
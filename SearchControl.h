@@ -0,0 +1,25 @@
+#ifndef SEARCH_CONTROL_H_
+#define SEARCH_CONTROL_H_
+
+/**
+ * Interface for steering a search from outside it, e.g. from another thread,
+ * attached with PathFinder::setControl(). Searches poll it every few hundred
+ * expansions and between the legs of a waypoint route, so implementations
+ * must be cheap and safe to call from the searching thread.
+ */
+class SearchControl {
+ public:
+    virtual ~SearchControl() { }
+
+    /**
+     * Return true to make the search give up and return an empty path
+     */
+    virtual bool cancelled() = 0;
+
+    /**
+     * Called with the number of nodes the current search has expanded so far
+     */
+    virtual void progress(long expanded) { }
+};
+
+#endif /* SEARCH_CONTROL_H_ */
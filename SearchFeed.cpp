@@ -0,0 +1,64 @@
+#include "SearchFeed.h"
+
+SearchFeed::SearchFeed(long budget) : budget(budget), stopped(false) { }
+
+void SearchFeed::nodeGenerated(const Point &p, int gvalue)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (stopped)
+        return;
+
+    SearchEvent event = { SearchEvent::GENERATED, p, gvalue };
+    events.push_back(event);
+}
+
+void SearchFeed::nodeExpanded(const Point &p, int gvalue)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+
+    // Hold the search here until the viewer allows another expansion
+    granted.wait(lock, [this] { return budget != 0 || stopped; });
+
+    if (stopped)
+        return;
+
+    if (budget > 0)
+        --budget;
+
+    SearchEvent event = { SearchEvent::EXPANDED, p, gvalue };
+    events.push_back(event);
+}
+
+void SearchFeed::drain(std::vector<SearchEvent> &events)
+{
+    events.clear();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    events.swap(this->events);
+}
+
+void SearchFeed::grant(long expansions)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        if (expansions < 0)
+            budget = -1;
+        else if (budget >= 0)
+            budget += expansions;
+    }
+
+    granted.notify_all();
+}
+
+void SearchFeed::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopped = true;
+        events.clear();
+    }
+
+    granted.notify_all();
+}
@@ -0,0 +1,76 @@
+#ifndef SEARCH_FEED_H_
+#define SEARCH_FEED_H_
+
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+#include "Point.h"
+#include "SearchTrace.h"
+
+/**
+ * Node generated (added to the open set) or expanded (moved to the closed
+ * set) during a search
+ */
+struct SearchEvent {
+    enum Type {
+        GENERATED,
+        EXPANDED
+    };
+
+    Type type;
+    Point position;
+    int gvalue;
+};
+
+/**
+ * SearchObserver buffering the events of a search running on another thread,
+ * so that a viewer can take them a frame at a time with drain().
+ *
+ * The feed can also pace the search: with a budget set, every expansion
+ * waits until the viewer has granted one, which lets the search be stepped
+ * through or animated. stop() releases the search for good and drops any
+ * later events, so a feed is used for one request only.
+ *
+ * Needs C++11 threads.
+ */
+class SearchFeed : public SearchObserver {
+ public:
+    /**
+     * Start with `budget` expansions allowed, or unpaced if `budget` < 0
+     */
+    explicit SearchFeed(long budget = -1);
+
+    void nodeGenerated(const Point &p, int gvalue);
+    void nodeExpanded(const Point &p, int gvalue);
+
+    /**
+     * Move the events buffered since the last call into `events`, replacing
+     * its contents
+     */
+    void drain(std::vector<SearchEvent> &events);
+
+    /**
+     * Allow `expansions` more expansions, or any number if `expansions` < 0
+     */
+    void grant(long expansions);
+
+    /**
+     * Release the search and ignore everything it does from now on
+     */
+    void stop();
+
+ private:
+    std::mutex mutex;
+    std::condition_variable granted;
+
+    /* Events not yet drained, and expansions left to run (< 0 for any) */
+    std::vector<SearchEvent> events;
+    long budget;
+    bool stopped;
+
+    SearchFeed(const SearchFeed &);
+    SearchFeed &operator=(const SearchFeed &);
+};
+
+#endif /* SEARCH_FEED_H_ */
@@ -0,0 +1,83 @@
+#include "SearchScheduler.h"
+
+#include <algorithm>
+
+#include "Clock.h"
+
+SearchScheduler::SearchScheduler(long slice) : slice(slice > 0 ? slice : 1), nextId(0)
+{
+}
+
+SearchScheduler::~SearchScheduler()
+{
+    for (std::map<int, SearchTask *>::iterator i = tasks.begin(); i != tasks.end(); ++i)
+        delete i->second;
+}
+
+int SearchScheduler::add(SearchTask *task)
+{
+    int id = nextId++;
+    tasks[id] = task;
+
+    if (task->getStatus() == SEARCH_RUNNING)
+        running.push_back(id);
+
+    return id;
+}
+
+SearchTask *SearchScheduler::get(int id) const
+{
+    std::map<int, SearchTask *>::const_iterator i = tasks.find(id);
+    return i == tasks.end() ? 0 : i->second;
+}
+
+void SearchScheduler::remove(int id)
+{
+    std::map<int, SearchTask *>::iterator i = tasks.find(id);
+    if (i == tasks.end())
+        return;
+
+    delete i->second;
+    tasks.erase(i);
+    running.erase(std::remove(running.begin(), running.end(), id), running.end());
+}
+
+std::vector<int> SearchScheduler::step(long maxExpansions)
+{
+    std::vector<int> finished;
+
+    long remaining = maxExpansions;
+    while (remaining > 0 && !running.empty())
+        remaining -= turn(std::min(remaining, slice), finished);
+
+    return finished;
+}
+
+std::vector<int> SearchScheduler::runFor(double seconds)
+{
+    std::vector<int> finished;
+
+    double deadline = wallSeconds() + seconds;
+    while (!running.empty() && wallSeconds() < deadline)
+        turn(slice, finished);
+
+    return finished;
+}
+
+long SearchScheduler::turn(long maxExpansions, std::vector<int> &finished)
+{
+    int id = running.front();
+    running.pop_front();
+
+    SearchTask *task = tasks[id];
+    int before = task->getExpansions();
+
+    if (task->step(maxExpansions) == SEARCH_RUNNING)
+        running.push_back(id);
+    else
+        finished.push_back(id);
+
+    // A turn that expands nothing, e.g. finding the open set empty, still
+    // counts, so a budget always runs out
+    return std::max(1L, (long)(task->getExpansions() - before));
+}
@@ -0,0 +1,81 @@
+#ifndef SEARCH_SCHEDULER_H_
+#define SEARCH_SCHEDULER_H_
+
+#include <cstddef>
+#include <deque>
+#include <map>
+#include <vector>
+
+#include "SearchTask.h"
+
+/**
+ * Runs many SearchTasks a slice at a time within a budget per call, e.g.
+ * once per frame. The tasks still running take turns, each expanding up to
+ * `slice` nodes per turn, and the next call carries on with the task after
+ * the last one to run, so a budget too small for every task to get a turn
+ * still shares them out fairly over several calls.
+ *
+ * Finished tasks stay until removed, so their paths can be read.
+ */
+class SearchScheduler {
+ public:
+    explicit SearchScheduler(long slice = 64);
+    ~SearchScheduler();
+
+    /**
+     * Add `task`, which the scheduler then owns, and return its id
+     */
+    int add(SearchTask *task);
+
+    /**
+     * The task with id `id`, or 0 if there is none
+     */
+    SearchTask *get(int id) const;
+
+    /**
+     * Delete the task with id `id`, finished or not
+     */
+    void remove(int id);
+
+    /**
+     * Run tasks for up to `maxExpansions` expansions in all, returning the
+     * ids of those that finished
+     */
+    std::vector<int> step(long maxExpansions);
+
+    /**
+     * Run tasks for about `seconds` seconds of wall time, a slice at a time, returning the
+     * ids of those that finished
+     */
+    std::vector<int> runFor(double seconds);
+
+    /**
+     * Number of tasks, and of those still running
+     */
+    std::size_t size() const { return tasks.size(); }
+    std::size_t getRunningCount() const { return running.size(); }
+
+    long getSlice() const { return slice; }
+    void setSlice(long slice) { this->slice = slice > 0 ? slice : 1; }
+
+ private:
+    long slice;
+    int nextId;
+
+    std::map<int, SearchTask *> tasks;
+
+    /* Ids of the running tasks in the order they take turns */
+    std::deque<int> running;
+
+    /**
+     * Give the next running task a turn of up to `maxExpansions`, adding
+     * its id to `finished` if it finishes, and return how many it expanded
+     */
+    long turn(long maxExpansions, std::vector<int> &finished);
+
+    // Not copyable, as it owns the tasks
+    SearchScheduler(const SearchScheduler &);
+    SearchScheduler &operator=(const SearchScheduler &);
+};
+
+#endif /* SEARCH_SCHEDULER_H_ */
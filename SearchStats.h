@@ -0,0 +1,99 @@
+#ifndef SEARCH_STATS_H_
+#define SEARCH_STATS_H_
+
+#include <iostream>
+
+/**
+ * Counters and timers describing the work done by searches, filled in by a
+ * PathFinder when given one with PathFinder::setStats(). Values accumulate
+ * over every search until reset().
+ *
+ * Recording is only compiled in when PATHFINDER_STATS is defined, so normal
+ * builds pay nothing for it and leave the counters at zero.
+ */
+struct SearchStats {
+    SearchStats() { reset(); }
+
+    void reset() {
+        searches = 0;
+        expanded = 0;
+        generated = 0;
+        reopened = 0;
+        openPeak = 0;
+        heuristicEvaluations = 0;
+        neighbourTime = 0;
+        openListTime = 0;
+    }
+
+    /* Number of searches run */
+    long searches;
+
+    /* Nodes moved to the closed set */
+    long expanded;
+
+    /* Nodes created and added to the open set */
+    long generated;
+
+    /* Closed nodes moved back to the open set after finding a cheaper path */
+    long reopened;
+
+    /* Largest size the open set reached in any one search */
+    long openPeak;
+
+    long heuristicEvaluations;
+
+    /* Nanoseconds spent generating neighbours and maintaining the open set */
+    double neighbourTime;
+    double openListTime;
+};
+
+/**
+ * Output `stats` to `os` as "name=value" pairs on one line
+ */
+inline std::ostream &operator<<(std::ostream &os, const SearchStats &stats) {
+    return os << "searches=" << stats.searches
+              << " expanded=" << stats.expanded
+              << " generated=" << stats.generated
+              << " reopened=" << stats.reopened
+              << " openPeak=" << stats.openPeak
+              << " heuristicEvaluations=" << stats.heuristicEvaluations
+              << " neighbourTimeNs=" << stats.neighbourTime
+              << " openListTimeNs=" << stats.openListTime;
+}
+
+/**
+ * Recording macros for pathfinders, taking a possibly null SearchStats
+ * pointer. They expand to nothing unless PATHFINDER_STATS is defined
+ */
+#ifdef PATHFINDER_STATS
+
+#include <ctime>
+
+inline double searchStatsNow() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+#define STATS_ADD(stats, field, n) \
+    do { if (stats) (stats)->field += (n); } while (0)
+
+#define STATS_MAX(stats, field, n) \
+    do { if ((stats) && (long)(n) > (stats)->field) (stats)->field = (n); } while (0)
+
+#define STATS_TIMER_START(timer) \
+    double timer = searchStatsNow()
+
+#define STATS_TIMER_ADD(stats, field, timer) \
+    do { if (stats) (stats)->field += searchStatsNow() - (timer); } while (0)
+
+#else
+
+#define STATS_ADD(stats, field, n) ((void)0)
+#define STATS_MAX(stats, field, n) ((void)0)
+#define STATS_TIMER_START(timer) ((void)0)
+#define STATS_TIMER_ADD(stats, field, timer) ((void)0)
+
+#endif /* PATHFINDER_STATS */
+
+#endif /* SEARCH_STATS_H_ */
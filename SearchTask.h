@@ -0,0 +1,81 @@
+#ifndef SEARCH_TASK_H_
+#define SEARCH_TASK_H_
+
+#include "BasicAStar.h"
+
+/**
+ * A search in progress that can be run a slice at a time, e.g. a few hundred
+ * expansions per frame, keeping its open and closed sets between slices.
+ * Made by AStar::startSearch(), and run by a SearchScheduler or directly.
+ * The grid it searches must not change until it finishes.
+ */
+class SearchTask {
+ public:
+    virtual ~SearchTask() { }
+
+    /**
+     * Start again from `start` to `end`, forgetting the search so far but
+     * keeping its memory, so one task can run many searches in turn
+     */
+    virtual void begin(const Point &start, const Point &end) = 0;
+
+    /**
+     * Expand up to `maxExpansions` more nodes, or as many as it takes if
+     * negative, and return where the search stands
+     */
+    virtual SearchStatus step(long maxExpansions) = 0;
+
+    virtual SearchStatus getStatus() const = 0;
+
+    /**
+     * The path found in reverse order, or an empty path until there is one
+     */
+    virtual Path getPath() const = 0;
+
+    /**
+     * The path found, or while still searching the path so far to the
+     * square that looks nearest the end, in reverse order
+     */
+    virtual Path getBestPath() const = 0;
+
+    /**
+     * Cost of the path found, or -1 until there is one
+     */
+    virtual int getCost() const = 0;
+
+    /**
+     * Number of nodes expanded so far
+     */
+    virtual int getExpansions() const = 0;
+};
+
+/**
+ * SearchTask running a BasicAStar instantiation `Search`
+ */
+template <class Search>
+class BasicSearchTask : public SearchTask {
+ public:
+    /**
+     * Task for `search`, which is copied, and must be begun with begin()
+     * before it has anything to do. getSearch() gives the copy, for settings
+     * the task doesn't forward
+     */
+    explicit BasicSearchTask(const Search &search) : search(search) { }
+
+    void begin(const Point &start, const Point &end) { search.begin(start, end); }
+    SearchStatus step(long maxExpansions) { return search.step(maxExpansions); }
+    SearchStatus getStatus() const { return search.getStatus(); }
+
+    Path getPath() const { return search.getPath(); }
+    Path getBestPath() const { return search.getBestPath(); }
+
+    int getCost() const { return (int)search.getCost(); }
+    int getExpansions() const { return search.getExpansions(); }
+
+    Search &getSearch() { return search; }
+
+ private:
+    Search search;
+};
+
+#endif /* SEARCH_TASK_H_ */
@@ -0,0 +1,65 @@
+#include "SearchTrace.h"
+
+std::vector<int> SearchTrace::order(const Grid &grid) const {
+    int width = grid.getWidth();
+    std::vector<int> order(width * grid.getHeight(), -1);
+
+    for (std::size_t i = 0; i < expanded.size(); ++i) {
+        const Point &p = expanded[i];
+
+        if (p.getx() < 0 || p.gety() < 0 || p.getx() >= width || p.gety() >= grid.getHeight())
+            continue;
+
+        int &cell = order[p.gety() * width + p.getx()];
+        if (cell == -1)
+            cell = i;
+    }
+
+    return order;
+}
+
+void SearchTrace::writeOrder(std::ostream &os, const Grid &grid) const {
+    std::vector<int> order = this->order(grid);
+
+    for (int y = 0; y < grid.getHeight(); ++y) {
+        for (int x = 0; x < grid.getWidth(); ++x) {
+            if (x != 0)
+                os << ",";
+
+            if (grid.getSquare(Point(x, y)) == FULL)
+                os << -2;
+            else
+                os << order[y * grid.getWidth() + x];
+        }
+
+        os << "\n";
+    }
+}
+
+void SearchTrace::writeHeatMap(std::ostream &os, const Grid &grid) const {
+    std::vector<int> order = this->order(grid);
+
+    // Expanded squares fade from white down to mid-grey, leaving dark grey for
+    // unexpanded ones
+    double scale = expanded.empty() ? 0 : 127.0 / expanded.size();
+
+    os << "P2\n" << grid.getWidth() << " " << grid.getHeight() << "\n255\n";
+
+    for (int y = 0; y < grid.getHeight(); ++y) {
+        for (int x = 0; x < grid.getWidth(); ++x) {
+            int value;
+            int index = order[y * grid.getWidth() + x];
+
+            if (grid.getSquare(Point(x, y)) == FULL)
+                value = 0;
+            else if (index == -1)
+                value = 64;
+            else
+                value = 255 - (int)(index * scale);
+
+            os << (x == 0 ? "" : " ") << value;
+        }
+
+        os << "\n";
+    }
+}
@@ -0,0 +1,86 @@
+#ifndef SEARCH_TRACE_H_
+#define SEARCH_TRACE_H_
+
+#include <iostream>
+#include <vector>
+
+#include "Grid.h"
+#include "Point.h"
+
+/**
+ * Interface for watching a search as it runs, attached with
+ * PathFinder::setObserver(). The defaults do nothing, so observers only
+ * override the events they want. With no observer attached a search only
+ * pays for a null pointer check per event.
+ */
+class SearchObserver {
+ public:
+    virtual ~SearchObserver() { }
+
+    /**
+     * A search from `start` to `end` is starting
+     */
+    virtual void searchStarted(const Point &start, const Point &end) { }
+
+    /**
+     * The node at `p` was added to the open set with g-value `gvalue`
+     */
+    virtual void nodeGenerated(const Point &p, int gvalue) { }
+
+    /**
+     * The node at `p` was moved to the closed set with g-value `gvalue`
+     */
+    virtual void nodeExpanded(const Point &p, int gvalue) { }
+
+    /**
+     * The search finished with `path`, which is empty on failure
+     */
+    virtual void searchFinished(const Path &path) { }
+};
+
+/**
+ * SearchObserver recording the order nodes are expanded in, which can be
+ * written out as a heat map of the grid for offline inspection. Records every
+ * search until clear()
+ */
+class SearchTrace : public SearchObserver {
+ public:
+    SearchTrace() : generated(0) { }
+
+    void nodeGenerated(const Point &p, int gvalue) { ++generated; }
+    void nodeExpanded(const Point &p, int gvalue) { expanded.push_back(p); }
+
+    /**
+     * Points in the order they were expanded
+     */
+    const std::vector<Point> &getExpanded() const { return expanded; }
+
+    long getGenerated() const { return generated; }
+
+    void clear() { expanded.clear(); generated = 0; }
+
+    /**
+     * Write the trace as comma-separated rows of `grid`'s width, holding the
+     * index at which each square was first expanded, -1 for squares never
+     * expanded and -2 for FULL squares
+     */
+    void writeOrder(std::ostream &os, const Grid &grid) const;
+
+    /**
+     * Write the trace as a plain PGM image of `grid`, one pixel per square,
+     * where squares expanded earlier are brighter, unexpanded EMPTY squares
+     * are dark grey and FULL squares are black
+     */
+    void writeHeatMap(std::ostream &os, const Grid &grid) const;
+
+ private:
+    std::vector<Point> expanded;
+    long generated;
+
+    /**
+     * Index of the first expansion of each square of `grid`, row by row
+     */
+    std::vector<int> order(const Grid &grid) const;
+};
+
+#endif /* SEARCH_TRACE_H_ */
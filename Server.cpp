@@ -0,0 +1,537 @@
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "CommandLine.h"
+#include "Components.h"
+#include "Grid.h"
+#include "Landmarks.h"
+#include "MapFile.h"
+#include "QueryAnswerer.h"
+#include "QueryProtocol.h"
+
+/*
+ * Query server: loads maps once and answers queries on them for other
+ * processes on the machine over a Unix domain socket (see QueryProtocol.h),
+ * so they needn't each keep their own copy of the grids.
+ *
+ * One thread does all the socket I/O with poll() and queues the requests it
+ * reads. A pool of workers takes them off the queue in batches, so queries
+ * that arrive while the workers are busy are answered together, with one
+ * lock and one wakeup per batch rather than per query. Answers come back
+ * the same way and are written as soon as each batch is done, so a client
+ * with many queries in flight gets replies while the rest are answered.
+ */
+
+static const char usage[] =
+    "Usage: server [options] MAP...\n"
+    "\n"
+    "Answers queries on the MAPs, numbered from 0 in the order given, on a\n"
+    "Unix domain socket until interrupted.\n"
+    "\n"
+    "Options:\n"
+    "  -s SOCKET     path of the socket, /tmp/pathfinder.sock by default\n"
+    "  -j THREADS    worker threads, 0 for one per core (default)\n"
+    "  -b BATCH      most queries a worker takes at once, 64 by default\n"
+    "  -a ALGORITHM  astar (default) or landmarks\n"
+    "  -m MOVEMENT   eight (default), four, no-corner-cutting or no-squeezing\n"
+    "  -c C,D        cardinal and diagonal move costs, 10,14 by default\n";
+
+struct Options {
+    Options() : socket("/tmp/pathfinder.sock"), threads(0), batch(64), landmarks(false),
+                movement(EIGHT_CONNECTED), cardinalCost(10), diagonalCost(14) { }
+
+    std::vector<std::string> maps;
+    std::string socket;
+    int threads;
+    std::size_t batch;
+    bool landmarks;
+    Movement movement;
+    int cardinalCost;
+    int diagonalCost;
+};
+
+/* A request, and the connection to answer it on */
+struct Job {
+    unsigned long connection;
+    QueryRequest request;
+};
+
+struct Answer {
+    unsigned long connection;
+    QueryReply reply;
+    std::vector<QueryPoint> path;
+};
+
+struct Connection {
+    int fd;
+    std::string in;
+    std::string out;
+};
+
+/* Set by signals to stop the server, which the wake pipe then notices */
+static volatile std::sig_atomic_t stopRequested = 0;
+static int wakeWrite = -1;
+
+static void requestStop(int)
+{
+    stopRequested = 1;
+    char c = 0;
+    if (write(wakeWrite, &c, 1) < 0) { }
+}
+
+static bool setNonBlocking(int fd)
+{
+    int flags = fcntl(fd, F_GETFL);
+    return flags != -1 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) != -1;
+}
+
+class Server {
+ public:
+    Server(const Options &options, const std::vector<Grid> &maps)
+        : options(options), maps(maps), listenFd(-1), nextConnection(0), stopping(false),
+          batches(0), answered(0), accepted(0) {
+        wakeFds[0] = wakeFds[1] = -1;
+
+        // The maps, their components and landmark tables are only read while
+        // searching, so one of each per map does for every worker
+        for (std::size_t i = 0; i < this->maps.size(); ++i) {
+            components.push_back(new Components(&this->maps[i]));
+            landmarks.push_back(options.landmarks ?
+                                new Landmarks(&this->maps[i], 8, options.cardinalCost,
+                                              options.diagonalCost, options.movement) : 0);
+        }
+    }
+
+    ~Server() {
+        for (std::size_t i = 0; i < maps.size(); ++i) {
+            delete components[i];
+            delete landmarks[i];
+        }
+    }
+
+    /**
+     * Serve until a signal asks to stop, returning false if the socket
+     * can't be set up
+     */
+    bool run();
+
+ private:
+    const Options &options;
+    std::vector<Grid> maps;
+    std::vector<Components *> components;
+
+    /* Landmarks of each map, or 0 without -a landmarks */
+    std::vector<Landmarks *> landmarks;
+
+    int listenFd;
+    int wakeFds[2];
+    std::map<unsigned long, Connection> connections;
+    unsigned long nextConnection;
+
+    /* Shared with the workers, under `mutex` */
+    std::mutex mutex;
+    std::condition_variable ready;
+    std::deque<Job> jobs;
+    std::vector<Answer> answers;
+    bool stopping;
+    unsigned long batches;
+    unsigned long answered;
+
+    std::vector<std::thread> workers;
+    unsigned long accepted;
+
+    bool listen();
+    void acceptAll();
+    bool readFrom(unsigned long id, Connection &connection, std::vector<Job> &read);
+    bool flush(Connection &connection);
+    void close(unsigned long id);
+    void deliver();
+    void work();
+};
+
+bool Server::listen()
+{
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+
+    if (options.socket.size() >= sizeof(address.sun_path)) {
+        std::cerr << options.socket << ": socket path too long" << std::endl;
+        return false;
+    }
+    std::strcpy(address.sun_path, options.socket.c_str());
+
+    listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listenFd == -1) {
+        std::perror("socket");
+        return false;
+    }
+
+    // A socket left behind by a server that didn't stop cleanly
+    unlink(options.socket.c_str());
+
+    if (bind(listenFd, (sockaddr *)&address, sizeof(address)) == -1 ||
+        ::listen(listenFd, SOMAXCONN) == -1 || !setNonBlocking(listenFd)) {
+        std::perror(options.socket.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+bool Server::run()
+{
+    if (pipe(wakeFds) == -1 || !setNonBlocking(wakeFds[0]) || !setNonBlocking(wakeFds[1])) {
+        std::perror("pipe");
+        return false;
+    }
+    wakeWrite = wakeFds[1];
+
+    if (!listen())
+        return false;
+
+    std::signal(SIGPIPE, SIG_IGN);
+    std::signal(SIGINT, requestStop);
+    std::signal(SIGTERM, requestStop);
+
+    for (int i = 0; i < options.threads; ++i)
+        workers.push_back(std::thread(&Server::work, this));
+
+    std::cerr << "Serving " << maps.size() << " maps on " << options.socket << " with "
+              << options.threads << " workers" << std::endl;
+
+    // Connections whose replies would fill more than this aren't read from
+    // until they catch up, so a client that stops reading can't use up memory
+    const std::size_t backlog = 1 << 20;
+
+    std::vector<pollfd> polled;
+    std::vector<unsigned long> ids;
+    std::vector<Job> read;
+
+    while (!stopRequested) {
+        polled.clear();
+        ids.clear();
+
+        pollfd listening = { listenFd, POLLIN, 0 };
+        pollfd waking = { wakeFds[0], POLLIN, 0 };
+        polled.push_back(listening);
+        polled.push_back(waking);
+
+        for (std::map<unsigned long, Connection>::iterator i = connections.begin();
+             i != connections.end(); ++i) {
+            pollfd p = { i->second.fd, 0, 0 };
+            if (i->second.out.size() < backlog)
+                p.events |= POLLIN;
+            if (!i->second.out.empty())
+                p.events |= POLLOUT;
+
+            polled.push_back(p);
+            ids.push_back(i->first);
+        }
+
+        if (poll(&polled[0], polled.size(), -1) == -1) {
+            if (errno == EINTR)
+                continue;
+            std::perror("poll");
+            break;
+        }
+
+        if (polled[1].revents)
+            deliver();
+
+        if (polled[0].revents)
+            acceptAll();
+
+        read.clear();
+        for (std::size_t i = 0; i < ids.size(); ++i) {
+            short revents = polled[i + 2].revents;
+            std::map<unsigned long, Connection>::iterator c = connections.find(ids[i]);
+            if (!revents || c == connections.end())
+                continue;
+
+            bool open = true;
+            if (revents & POLLOUT)
+                open = flush(c->second);
+            if (open && (revents & (POLLIN | POLLHUP | POLLERR)))
+                open = readFrom(ids[i], c->second, read);
+            if (!open)
+                close(ids[i]);
+        }
+
+        if (!read.empty()) {
+            std::lock_guard<std::mutex> lock(mutex);
+            jobs.insert(jobs.end(), read.begin(), read.end());
+            ready.notify_all();
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        ready.notify_all();
+    }
+    for (std::size_t i = 0; i < workers.size(); ++i)
+        workers[i].join();
+
+    while (!connections.empty())
+        close(connections.begin()->first);
+    ::close(listenFd);
+    unlink(options.socket.c_str());
+
+    char summary[256];
+    std::sprintf(summary, "%lu queries from %lu connections in %lu batches, %.1f per batch",
+                 answered, accepted, batches, batches ? (double)answered / batches : 0.0);
+    std::cerr << summary << std::endl;
+
+    return true;
+}
+
+void Server::acceptAll()
+{
+    int fd;
+    while ((fd = accept(listenFd, 0, 0)) != -1) {
+        if (!setNonBlocking(fd)) {
+            ::close(fd);
+            continue;
+        }
+
+        connections[nextConnection++].fd = fd;
+        ++accepted;
+    }
+}
+
+/**
+ * Read what `connection` has sent, adding its complete requests to `read`,
+ * and return false if it has closed
+ */
+bool Server::readFrom(unsigned long id, Connection &connection, std::vector<Job> &read)
+{
+    char buffer[65536];
+    ssize_t n = ::read(connection.fd, buffer, sizeof(buffer));
+
+    if (n == 0)
+        return false;
+    if (n == -1)
+        return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+
+    connection.in.append(buffer, n);
+
+    std::vector<QueryRequest> requests;
+    takeRequests(connection.in, requests);
+    for (std::size_t i = 0; i < requests.size(); ++i) {
+        Job job;
+        job.connection = id;
+        job.request = requests[i];
+        read.push_back(job);
+    }
+
+    return true;
+}
+
+/**
+ * Write as much of `connection`'s replies as it will take, returning false
+ * if it has closed
+ */
+bool Server::flush(Connection &connection)
+{
+    while (!connection.out.empty()) {
+        ssize_t n = write(connection.fd, connection.out.data(), connection.out.size());
+        if (n == -1)
+            return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+
+        connection.out.erase(0, n);
+    }
+
+    return true;
+}
+
+void Server::close(unsigned long id)
+{
+    std::map<unsigned long, Connection>::iterator c = connections.find(id);
+    ::close(c->second.fd);
+    connections.erase(c);
+}
+
+/**
+ * Write the answers the workers have finished to their connections
+ */
+void Server::deliver()
+{
+    char drained[256];
+    while (::read(wakeFds[0], drained, sizeof(drained)) > 0) { }
+
+    std::vector<Answer> finished;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        finished.swap(answers);
+    }
+
+    std::vector<unsigned long> written;
+    for (std::size_t i = 0; i < finished.size(); ++i) {
+        const Answer &answer = finished[i];
+
+        // The client may have gone while its queries were being answered
+        std::map<unsigned long, Connection>::iterator c = connections.find(answer.connection);
+        if (c == connections.end())
+            continue;
+
+        appendReply(c->second.out, answer.reply, answer.path);
+
+        if (written.empty() || written.back() != answer.connection)
+            written.push_back(answer.connection);
+    }
+
+    std::sort(written.begin(), written.end());
+    written.erase(std::unique(written.begin(), written.end()), written.end());
+
+    for (std::size_t i = 0; i < written.size(); ++i)
+        if (!flush(connections[written[i]]))
+            close(written[i]);
+}
+
+void Server::work()
+{
+    // Each worker has its own search state for each map, but not its own
+    // copy of the map
+    QueryAnswerer answerer(maps, components, landmarks, options.movement,
+                           options.cardinalCost, options.diagonalCost);
+
+    std::vector<Job> batch;
+    std::vector<Answer> done;
+
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (jobs.empty() && !stopping)
+                ready.wait(lock);
+            if (stopping)
+                break;
+
+            // An even share of the queue, so other idle workers get some
+            std::size_t share = (jobs.size() + workers.size() - 1) / workers.size();
+            std::size_t take = std::min(share, options.batch);
+
+            batch.assign(jobs.begin(), jobs.begin() + take);
+            jobs.erase(jobs.begin(), jobs.begin() + take);
+            ++batches;
+        }
+
+        done.resize(batch.size());
+        for (std::size_t i = 0; i < batch.size(); ++i) {
+            done[i].connection = batch[i].connection;
+            answerer.answer(batch[i].request, done[i].reply, done[i].path);
+        }
+
+        bool wake;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            wake = answers.empty();
+            answers.insert(answers.end(), done.begin(), done.end());
+            answered += batch.size();
+        }
+
+        // The I/O thread takes all the answers at once, so it only needs
+        // waking for the first
+        if (wake) {
+            char c = 0;
+            if (write(wakeFds[1], &c, 1) < 0) { }
+        }
+    }
+}
+
+static bool parseOptions(int argc, char **argv, Options &options)
+{
+    int i = 1;
+    for (; i < argc && argv[i][0] == '-'; ++i) {
+        std::string option = argv[i];
+
+        if (i + 1 == argc)
+            return false;
+
+        std::string value = argv[++i];
+
+        if (option == "-s") {
+            options.socket = value;
+        } else if (option == "-j") {
+            options.threads = std::atoi(value.c_str());
+        } else if (option == "-b") {
+            int batch = std::atoi(value.c_str());
+            if (batch <= 0)
+                return false;
+            options.batch = batch;
+        } else if (option == "-a") {
+            if (value == "astar")
+                options.landmarks = false;
+            else if (value == "landmarks")
+                options.landmarks = true;
+            else
+                return false;
+        } else if (option == "-m") {
+            if (!parseMovement(value, options.movement))
+                return false;
+        } else if (option == "-c") {
+            if (!parseMoveCosts(value, options.cardinalCost, options.diagonalCost))
+                return false;
+        } else {
+            return false;
+        }
+    }
+
+    if (i == argc)
+        return false;
+
+    options.maps.assign(argv + i, argv + argc);
+
+    if (options.threads <= 0)
+        options.threads = std::max(1u, std::thread::hardware_concurrency());
+
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        std::cerr << usage;
+        return 2;
+    }
+
+    std::vector<Grid> maps;
+    for (std::size_t i = 0; i < options.maps.size(); ++i) {
+        Grid grid(1, 1);
+        std::string error;
+        if (!loadMap(options.maps[i], grid, error)) {
+            std::cerr << options.maps[i] << ": " << error << std::endl;
+            return 1;
+        }
+
+        // Points in requests are 16 bits
+        if (grid.getWidth() > 65536 || grid.getHeight() > 65536) {
+            std::cerr << options.maps[i] << ": too large to serve" << std::endl;
+            return 1;
+        }
+
+        maps.push_back(grid);
+    }
+
+    Server server(options, maps);
+    return server.run() ? 0 : 1;
+}
@@ -0,0 +1,225 @@
+#include "SharedGrid.h"
+
+#if __cplusplus >= 201103L
+
+#include <algorithm>
+
+const int GridPage::pageBits;
+const int GridPage::pageSize;
+const uint64_t SharedGrid::unpinned;
+
+static const int pageMask = GridPage::pageSize - 1;
+
+/* Smallest cost on `page`, for GridSnapshot::getMinCost() */
+static void updateMinCost(GridPage &page)
+{
+    page.minCost = page.costs.empty() ? 1 :
+        *std::min_element(page.costs.begin(), page.costs.end());
+}
+
+SharedGrid::SharedGrid(const Grid &grid)
+    : width(grid.getWidth()), height(grid.getHeight()),
+      pagesAcross((width + pageMask) >> GridPage::pageBits), current(0), epoch(1), slots(0)
+{
+    int pagesDown = (height + pageMask) >> GridPage::pageBits;
+
+    pending.resize((std::size_t)pagesAcross * pagesDown);
+    copied.assign(pending.size(), false);
+
+    for (int py = 0; py < pagesDown; ++py) {
+        for (int px = 0; px < pagesAcross; ++px) {
+            GridPage *page = new GridPage;
+
+            for (int y = 0; y < GridPage::pageSize; ++y) {
+                uint64_t word = 0;
+
+                // Squares past the edge are FULL, as Grid has them
+                for (int x = 0; x < GridPage::pageSize; ++x) {
+                    Point p(px * GridPage::pageSize + x, py * GridPage::pageSize + y);
+                    uint8_t cost = grid.getCost(p);
+
+                    if (grid.getSquare(p) == FULL)
+                        word |= (uint64_t)1 << x;
+
+                    if (cost != 1) {
+                        if (page->costs.empty())
+                            page->costs.assign(GridPage::pageSize * GridPage::pageSize, 1);
+                        page->costs[y * GridPage::pageSize + x] = cost;
+                    }
+                }
+
+                page->bits[y] = word;
+            }
+
+            updateMinCost(*page);
+            pending[py * pagesAcross + px] = page;
+        }
+    }
+
+    current.store(makeVersion(1));
+}
+
+SharedGrid::~SharedGrid()
+{
+    while (!retired.empty()) {
+        Retired &r = retired.front();
+        for (std::size_t i = 0; i < r.pages.size(); ++i)
+            delete r.pages[i];
+        delete r.version;
+        retired.pop_front();
+    }
+
+    // The pages of the current version are either still pending or replaced
+    // by copies since
+    for (std::size_t i = 0; i < pending.size(); ++i)
+        delete pending[i];
+    for (std::size_t i = 0; i < replaced.size(); ++i)
+        delete replaced[i];
+    delete current.load();
+
+    Slot *slot = slots.load();
+    while (slot) {
+        Slot *next = slot->next;
+        delete slot;
+        slot = next;
+    }
+}
+
+void SharedGrid::setSquare(Point p, Square s)
+{
+    if (!inBounds(p))
+        return;
+
+    uint64_t bit = (uint64_t)1 << (p.getx() & pageMask);
+    int y = p.gety() & pageMask;
+
+    // Only copy pages that really change
+    if (((pending[pageIndex(p)]->bits[y] & bit) != 0) == (s == FULL))
+        return;
+
+    pageForWrite(p).bits[y] ^= bit;
+}
+
+void SharedGrid::setCost(Point p, uint8_t cost)
+{
+    if (!inBounds(p))
+        return;
+
+    if (cost == 0)
+        cost = 1;
+
+    const GridPage &page = *pending[pageIndex(p)];
+    int offset = (p.gety() & pageMask) * GridPage::pageSize + (p.getx() & pageMask);
+    if ((page.costs.empty() ? 1 : page.costs[offset]) == cost)
+        return;
+
+    GridPage &copy = pageForWrite(p);
+    if (copy.costs.empty())
+        copy.costs.assign(GridPage::pageSize * GridPage::pageSize, 1);
+    copy.costs[offset] = cost;
+}
+
+GridPage &SharedGrid::pageForWrite(const Point &p)
+{
+    int i = pageIndex(p);
+
+    if (!copied[i]) {
+        replaced.push_back(pending[i]);
+        pending[i] = new GridPage(*pending[i]);
+        copied[i] = true;
+        copiedPages.push_back(i);
+    }
+
+    return *pending[i];
+}
+
+unsigned long SharedGrid::publish()
+{
+    const GridVersion *old = current.load();
+    if (copiedPages.empty())
+        return old->number;
+
+    for (std::size_t i = 0; i < copiedPages.size(); ++i) {
+        updateMinCost(*pending[copiedPages[i]]);
+        copied[copiedPages[i]] = false;
+    }
+    copiedPages.clear();
+
+    const GridVersion *version = makeVersion(old->number + 1);
+    current.store(version);
+
+    // Readers that pin from the next epoch on can only see the new version,
+    // so the old one can go once every reader pinned has pinned since
+    uint64_t e = epoch.load();
+    retired.push_back(Retired());
+    retired.back().epoch = e;
+    retired.back().version = old;
+    retired.back().pages.swap(replaced);
+    epoch.store(e + 1);
+
+    reclaim();
+
+    return version->number;
+}
+
+void SharedGrid::reclaim()
+{
+    uint64_t oldest = unpinned;
+    for (Slot *slot = slots.load(); slot != 0; slot = slot->next)
+        oldest = std::min(oldest, (uint64_t)slot->epoch.load());
+
+    while (!retired.empty() && retired.front().epoch < oldest) {
+        Retired &r = retired.front();
+        for (std::size_t i = 0; i < r.pages.size(); ++i)
+            delete r.pages[i];
+        delete r.version;
+        retired.pop_front();
+    }
+}
+
+const GridVersion *SharedGrid::makeVersion(unsigned long number) const
+{
+    GridVersion *version = new GridVersion;
+    version->width = width;
+    version->height = height;
+    version->pagesAcross = pagesAcross;
+    version->number = number;
+    version->pages.assign(pending.begin(), pending.end());
+
+    version->minCost = 255;
+    for (std::size_t i = 0; i < pending.size(); ++i)
+        version->minCost = std::min(version->minCost, (int)pending[i]->minCost);
+
+    return version;
+}
+
+SharedGrid::Slot *SharedGrid::claimSlot()
+{
+    for (Slot *slot = slots.load(); slot != 0; slot = slot->next) {
+        bool unclaimed = false;
+        if (slot->claimed.compare_exchange_strong(unclaimed, true))
+            return slot;
+    }
+
+    Slot *slot = new Slot;
+    slot->claimed.store(true);
+
+    Slot *head = slots.load();
+    do {
+        slot->next = head;
+    } while (!slots.compare_exchange_weak(head, slot));
+
+    return slot;
+}
+
+SnapshotReader::SnapshotReader(SharedGrid &grid) : grid(grid), slot(grid.claimSlot())
+{
+}
+
+SnapshotReader::~SnapshotReader()
+{
+    slot->epoch.store(SharedGrid::unpinned);
+    slot->claimed.store(false);
+}
+
+#endif /* __cplusplus >= 201103L */
@@ -0,0 +1,321 @@
+#ifndef SHARED_GRID_H_
+#define SHARED_GRID_H_
+
+#if __cplusplus >= 201103L
+
+#include <atomic>
+#include <cstddef>
+#include <deque>
+#include <stdint.h>
+#include <vector>
+
+#include "Grid.h"
+#include "Movement.h"
+#include "Point.h"
+#include "Square.h"
+
+/**
+ * A 64 by 64 page of a SharedGrid's squares, never changed once published
+ */
+struct GridPage {
+    static const int pageBits = 6;
+    static const int pageSize = 1 << pageBits;
+
+    /* Bit x of word y set if (x, y) is FULL */
+    uint64_t bits[pageSize];
+
+    /* Cost of (x, y) at y * pageSize + x, or empty if every cost is 1 */
+    std::vector<uint8_t> costs;
+
+    uint8_t minCost;
+};
+
+/**
+ * One published version of a SharedGrid: which page holds each 64 by 64
+ * block of squares, row by row. Versions share the pages they have in
+ * common
+ */
+struct GridVersion {
+    int width;
+    int height;
+    int pagesAcross;
+    int minCost;
+    unsigned long number;
+    std::vector<const GridPage *> pages;
+};
+
+/**
+ * Read-only view of one version of a SharedGrid, with the members BasicAStar
+ * needs, so searches can run on it while the grid changes. Only valid while
+ * the SnapshotReader it came from keeps it pinned
+ */
+class GridSnapshot {
+ public:
+    GridSnapshot() : version(0) { }
+
+    Square getSquare(const Point &p) const {
+        if (p.getx() < 0 || p.gety() < 0 || p.getx() >= version->width ||
+            p.gety() >= version->height)
+            return FULL;
+
+        const GridPage *page = pageOf(p);
+        int x = p.getx() & (GridPage::pageSize - 1), y = p.gety() & (GridPage::pageSize - 1);
+        return ((page->bits[y] >> x) & 1) ? FULL : EMPTY;
+    }
+
+    /**
+     * Cost multiplier of `p`, 1 off the grid
+     */
+    uint8_t getCost(const Point &p) const {
+        if (p.getx() < 0 || p.gety() < 0 || p.getx() >= version->width ||
+            p.gety() >= version->height)
+            return 1;
+
+        const GridPage *page = pageOf(p);
+        if (page->costs.empty())
+            return 1;
+
+        int x = p.getx() & (GridPage::pageSize - 1), y = p.gety() & (GridPage::pageSize - 1);
+        return page->costs[y * GridPage::pageSize + x];
+    }
+
+    int getMinCost() const { return version->minCost; }
+
+    /**
+     * Mask of the EMPTY neighbours of `p`, as Grid::getEmptyMask()
+     */
+    unsigned getEmptyMask(const Point &p) const {
+        unsigned mask = 0;
+        for (int i = 0; i < 8; ++i) {
+            Point q(p.getx() + moveDx[i], p.gety() + moveDy[i]);
+            mask |= (unsigned)(getSquare(q) == EMPTY) << i;
+        }
+        return mask;
+    }
+
+    template <Movement M>
+    unsigned getMoves(const Point &p) const { return allowedMoves<M>(getEmptyMask(p)); }
+
+    int getWidth() const { return version->width; }
+    int getHeight() const { return version->height; }
+
+    /**
+     * Number of the version, which goes up by one with each publish()
+     */
+    unsigned long getVersion() const { return version->number; }
+
+    bool isPinned() const { return version != 0; }
+
+ private:
+    friend class SnapshotReader;
+
+    const GridVersion *version;
+
+    const GridPage *pageOf(const Point &p) const {
+        return version->pages[(p.gety() >> GridPage::pageBits) * version->pagesAcross +
+                              (p.getx() >> GridPage::pageBits)];
+    }
+};
+
+/**
+ * Grid that one thread can change while others search it without locks.
+ *
+ * Squares are kept in 64 by 64 pages that are copied on write: the first
+ * change to a page since the last publish() copies it, and publish() then
+ * makes a new version, sharing the pages nobody changed, visible to readers
+ * with one atomic store. Readers never wait for the writer, and the writer
+ * only waits for the edit itself, never for readers.
+ *
+ * Each thread that reads has a SnapshotReader, which pins the latest
+ * version while it searches (see GridSnapshot), and every search on a pinned
+ * version sees the same squares however many versions are published
+ * meanwhile. Old versions, and the pages only they use, are freed by epoch
+ * based reclamation: each is tagged with the epoch in which it was
+ * replaced, and freed once every pinned reader has pinned in a later epoch.
+ * A reader that stays pinned therefore holds back reclamation, so pin for a
+ * search, not for the life of the thread.
+ *
+ * setSquare(), setCost(), publish() and reclaim() must only be called from
+ * one thread at a time. Publishing copies the table of page pointers, so on
+ * big grids batch edits into fewer publishes.
+ *
+ * Needs C++11 for std::atomic.
+ */
+class SharedGrid {
+ public:
+    explicit SharedGrid(const Grid &grid);
+
+    /**
+     * Free every version, which no SnapshotReader may still use
+     */
+    ~SharedGrid();
+
+    /**
+     * Change `p` in the next version. Points off the grid are ignored
+     */
+    void setSquare(Point p, Square s);
+
+    /**
+     * Set the cost multiplier of `p` in the next version, where 0 is taken
+     * as 1. Points off the grid are ignored
+     */
+    void setCost(Point p, uint8_t cost);
+
+    /**
+     * Make the changes since the last publish() visible to readers that pin
+     * from now on, freeing what readers can no longer see, and return the
+     * number of the new version. Does nothing without changes
+     */
+    unsigned long publish();
+
+    /**
+     * Free the old versions and pages no reader can still see
+     */
+    void reclaim();
+
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+
+    /**
+     * Number of the latest version published
+     */
+    unsigned long getVersion() const { return current.load()->number; }
+
+    /**
+     * Number of old versions waiting to be freed
+     */
+    std::size_t getRetiredCount() const { return retired.size(); }
+
+ private:
+    friend class SnapshotReader;
+
+    /**
+     * What a reader has pinned: the epoch it pinned in, or `unpinned`.
+     * Slots are claimed by readers and never freed until the grid is, so
+     * the writer can walk the list while readers come and go
+     */
+    struct Slot {
+        Slot() : epoch(unpinned), next(0), claimed(false) { }
+
+        std::atomic<uint64_t> epoch;
+        Slot *next;
+        std::atomic<bool> claimed;
+
+        // Keeps slots on their own cache lines, as readers write them often
+        char padding[64 - sizeof(std::atomic<uint64_t>) - sizeof(Slot *) -
+                     sizeof(std::atomic<bool>)];
+    };
+
+    /* A replaced version, and the pages only it and older versions used */
+    struct Retired {
+        uint64_t epoch;
+        const GridVersion *version;
+        std::vector<GridPage *> pages;
+    };
+
+    static const uint64_t unpinned = ~(uint64_t)0;
+
+    int width;
+    int height;
+    int pagesAcross;
+
+    std::atomic<const GridVersion *> current;
+    std::atomic<uint64_t> epoch;
+    std::atomic<Slot *> slots;
+
+    /* Pages of the next version, and whether each is a copy made since the
+       last publish(), so no reader can see it yet */
+    std::vector<GridPage *> pending;
+    std::vector<bool> copied;
+    std::vector<int> copiedPages;
+
+    /* Pages the copies replace, retired with the current version */
+    std::vector<GridPage *> replaced;
+
+    /* Oldest first, so in epoch order */
+    std::deque<Retired> retired;
+
+    /**
+     * Page of the next version holding `p`, copied first if readers can see
+     * it
+     */
+    GridPage &pageForWrite(const Point &p);
+
+    int pageIndex(const Point &p) const {
+        return (p.gety() >> GridPage::pageBits) * pagesAcross + (p.getx() >> GridPage::pageBits);
+    }
+
+    bool inBounds(const Point &p) const {
+        return p.getx() >= 0 && p.gety() >= 0 && p.getx() < width && p.gety() < height;
+    }
+
+    /**
+     * New version numbered `number` of the pages of the next version
+     */
+    const GridVersion *makeVersion(unsigned long number) const;
+
+    /**
+     * Claim a free slot for a new reader, adding one if there is none
+     */
+    Slot *claimSlot();
+
+    // Not copyable, as readers hold pointers into it
+    SharedGrid(const SharedGrid &);
+    SharedGrid &operator=(const SharedGrid &);
+};
+
+/**
+ * One thread's access to a SharedGrid. pin() before each search and unpin()
+ * after it; searches take a pointer to getSnapshot(), which stays the same
+ * object from pin to pin, e.g.
+ *
+ *     SnapshotReader reader(shared);
+ *     BasicAStar<GridSnapshot, OctileHeuristic<int>, int,
+ *                MovePolicy<EIGHT_CONNECTED> > search(&reader.getSnapshot());
+ *
+ *     reader.pin();
+ *     Path path = search.search(start, end, cost);
+ *     reader.unpin();
+ *
+ * A reader must only be used by one thread at a time, and must not outlive
+ * its grid.
+ */
+class SnapshotReader {
+ public:
+    explicit SnapshotReader(SharedGrid &grid);
+    ~SnapshotReader();
+
+    /**
+     * Pin the latest version and return it. Pinning again while pinned moves
+     * to the latest version
+     */
+    const GridSnapshot &pin() {
+        // The epoch must be visible before the version is read, so the
+        // writer can't free a version pinned in an epoch it didn't see
+        slot->epoch.store(grid.epoch.load());
+        snapshot.version = grid.current.load();
+        return snapshot;
+    }
+
+    /**
+     * Let the pinned version be freed once it is replaced
+     */
+    void unpin() {
+        snapshot.version = 0;
+        slot->epoch.store(SharedGrid::unpinned, std::memory_order_release);
+    }
+
+    const GridSnapshot &getSnapshot() const { return snapshot; }
+
+ private:
+    SharedGrid &grid;
+    SharedGrid::Slot *slot;
+    GridSnapshot snapshot;
+
+    SnapshotReader(const SnapshotReader &);
+    SnapshotReader &operator=(const SnapshotReader &);
+};
+
+#endif /* __cplusplus >= 201103L */
+
+#endif /* SHARED_GRID_H_ */
@@ -1,36 +1,473 @@
-
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <string>
+#include <vector>
+
+#if __cplusplus >= 201103L
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <thread>
+#endif
 
 #include "AStar.h"
-#include "PathFinder.h"
+#include "Clearance.h"
+#include "Clock.h"
+#include "CommandLine.h"
+#include "Dijkstra.h"
 #include "Grid.h"
+#include "Landmarks.h"
+#include "MapFile.h"
+#include "PathDatabase.h"
 #include "Point.h"
-#include "Square.h"
 
-int main()
+/*
+ * Batch driver: loads a map, reads queries a line at a time and writes one
+ * line of results per query, in the order read, each as soon as it and those
+ * before it are answered, for use from scripts and pipelines and for
+ * measuring throughput end to end.
+ */
+
+static const char usage[] =
+    "Usage: main [options] MAP\n"
+    "\n"
+    "Reads queries from standard input, one per line: the x and y of a start,\n"
+    "any waypoints and an end, separated by spaces. Blank lines and lines\n"
+    "starting with # are skipped. For each query writes a line of\n"
+    "\n"
+    "  NUMBER COST LENGTH EXPANSIONS MICROSECONDS [PATH]\n"
+    "\n"
+    "separated by tabs, where NUMBER counts queries from 1, COST is -1 if there\n"
+    "is no path, LENGTH is the number of squares on the path and PATH lists\n"
+    "them as x,y from start to end. Malformed queries get NUMBER invalid.\n"
+    "Throughput goes to standard error at the end.\n"
+    "\n"
+    "Options:\n"
+    "  -a ALGORITHM  astar (default), landmarks, dijkstra or database\n"
+    "  -m MOVEMENT   eight (default), four, no-corner-cutting or no-squeezing\n"
+    "  -c C,D        cardinal and diagonal move costs, 10,14 by default\n"
+    "  -s SIZE       with -a astar, plan for agents SIZE squares across, placed\n"
+    "                by their top-left corner, 1 by default\n"
+    "  -n            with -a astar or landmarks, move a blocked start or end to\n"
+    "                the nearest empty square rather than finding no path\n"
+    "  -j THREADS    threads to answer queries on, 0 for one per core (default 1)\n"
+    "  -q FILE       read queries from FILE instead of standard input\n"
+    "  -d FILE       with -a database, load the database from FILE if it is for\n"
+    "                this map, else build it and save it there\n"
+    "  -p            write the path of each query\n";
+
+enum Algorithm {
+    ASTAR_SEARCH,
+    LANDMARKS_SEARCH,
+    DIJKSTRA_SEARCH,
+    DATABASE_LOOKUP
+};
+
+struct Options {
+    Options() : algorithm(ASTAR_SEARCH), movement(EIGHT_CONNECTED), cardinalCost(10),
+                diagonalCost(14), agentSize(1), threads(1), snap(false), paths(false) { }
+
+    std::string map;
+    std::string queries;
+    std::string database;
+    Algorithm algorithm;
+    Movement movement;
+    int cardinalCost;
+    int diagonalCost;
+    int agentSize;
+    int threads;
+    bool snap;
+    bool paths;
+};
+
+struct Query {
+    long number;
+    bool valid;
+    std::vector<Point> points;
+};
+
+struct Result {
+    Result() : cost(-1), expansions(0), seconds(0) { }
+
+    int cost;
+    long expansions;
+    double seconds;
+    Path path;
+};
+
+/**
+ * Answers queries on its own copy of the grid, so each thread has one. The
+ * landmarks and database are only read, so every thread shares them
+ */
+class Solver {
+ public:
+    Solver(const Grid &grid, const Options &options, const Landmarks *landmarks,
+           const PathDatabase *database)
+        : astar(grid), dijkstra(0), clearance(0), database(database),
+          algorithm(options.algorithm) {
+        astar.setCardinalCost(options.cardinalCost);
+        astar.setDiagonalCost(options.diagonalCost);
+        astar.setMovement(options.movement);
+        astar.setSnapToEmpty(options.snap);
+
+        if (options.agentSize > 1) {
+            clearance = new Clearance(&astar.grid, std::max(16, options.agentSize));
+            astar.setAgentSize(options.agentSize, clearance);
+        } else if (algorithm == LANDMARKS_SEARCH) {
+            astar.setLandmarks(landmarks);
+        } else if (algorithm == DIJKSTRA_SEARCH) {
+            dijkstra = new Dijkstra(grid);
+            dijkstra->setCardinalCost(options.cardinalCost);
+            dijkstra->setDiagonalCost(options.diagonalCost);
+            dijkstra->setMovement(options.movement);
+        }
+    }
+
+    ~Solver() {
+        delete clearance;
+        delete dijkstra;
+    }
+
+    /**
+     * Answer `query` leg by leg into `result`, with the path from start to end
+     */
+    void solve(const Query &query, Result &result) {
+        double start = wallSeconds();
+
+        result.cost = 0;
+        result.expansions = 0;
+        result.path.clear();
+
+        for (std::size_t i = 1; i < query.points.size(); ++i) {
+            int cost;
+            Path leg = this->leg(query.points[i - 1], query.points[i], cost, result.expansions);
+
+            if (cost == -1) {
+                result.cost = -1;
+                result.path.clear();
+                break;
+            }
+
+            // Legs come end first, and each starts where the last ended
+            result.cost += cost;
+            for (std::size_t j = leg.size(); j-- > 0;)
+                if (result.path.empty() || result.path.back() != leg[j])
+                    result.path.push_back(leg[j]);
+        }
+
+        result.seconds = wallSeconds() - start;
+    }
+
+ private:
+    AStar astar;
+    Dijkstra *dijkstra;
+    Clearance *clearance;
+    const PathDatabase *database;
+    Algorithm algorithm;
+
+    Path leg(const Point &start, const Point &end, int &cost, long &expansions) {
+        Path path;
+
+        if (algorithm == DIJKSTRA_SEARCH) {
+            path = dijkstra->build(start, end, cost);
+            expansions += dijkstra->getExpansions();
+        } else if (algorithm == DATABASE_LOOKUP) {
+            path = database->find(start, end);
+            cost = path.empty() ? -1 : astar.pathCost(path);
+        } else {
+            path = astar.build(start, end, cost);
+            expansions += astar.getExpansions();
+        }
+
+        return path;
+    }
+
+    Solver(const Solver &);
+    Solver &operator=(const Solver &);
+};
+
+static void writeResult(std::ostream &out, const Query &query, const Result &result,
+                        bool paths)
+{
+    if (!query.valid) {
+        out << query.number << "\tinvalid\n";
+        return;
+    }
+
+    char timing[32];
+    std::sprintf(timing, "%.1f", result.seconds * 1e6);
+
+    out << query.number << '\t' << result.cost << '\t' << result.path.size() << '\t'
+        << result.expansions << '\t' << timing;
+
+    if (paths) {
+        out << '\t';
+        for (std::size_t i = 0; i < result.path.size(); ++i)
+            out << (i ? " " : "") << result.path[i].getx() << ',' << result.path[i].gety();
+    }
+
+    out << '\n';
+}
+
+/**
+ * Answer every query read from `in` on `solvers`, each on its own thread, and
+ * write the results to standard output in the order read, adding the number
+ * of valid queries to `answered` and their search time to `searching`.
+ * Results are flushed whenever no query is waiting to be answered, so a
+ * caller that waits for each answer before sending the next one gets it
+ */
+static void answerAll(std::istream &in, const Grid &grid, std::vector<Solver *> &solvers,
+                      bool paths, long &answered, double &searching)
+{
+    std::string line;
+
+#if __cplusplus >= 201103L
+    // Reading stops this far ahead of writing, so neither the queries nor the
+    // results answered out of turn pile up
+    const long maxUnwritten = 1024;
+
+    std::mutex mutex;
+    std::condition_variable queued, space;
+    std::deque<Query> waiting;
+    std::map<long, std::pair<Query, Result> > done;
+    long read = 0, written = 0;
+    bool finished = false;
+
+    std::vector<std::thread> workers;
+    for (std::size_t t = 0; t < solvers.size(); ++t)
+        workers.push_back(std::thread([&, t]() {
+            std::unique_lock<std::mutex> lock(mutex);
+            for (;;) {
+                while (waiting.empty() && !finished)
+                    queued.wait(lock);
+                if (waiting.empty())
+                    break;
+
+                Query query = waiting.front();
+                waiting.pop_front();
+                lock.unlock();
+
+                Result result;
+                if (query.valid)
+                    solvers[t]->solve(query, result);
+
+                lock.lock();
+                done[query.number] = std::make_pair(query, result);
+
+                // Write every result whose turn has come
+                std::map<long, std::pair<Query, Result> >::iterator next;
+                while ((next = done.find(written + 1)) != done.end()) {
+                    writeResult(std::cout, next->second.first, next->second.second, paths);
+                    if (next->second.first.valid) {
+                        ++answered;
+                        searching += next->second.second.seconds;
+                    }
+
+                    done.erase(next);
+                    ++written;
+                }
+
+                if (waiting.empty())
+                    std::cout.flush();
+                space.notify_one();
+            }
+        }));
+
+    while (std::getline(in, line)) {
+        Query query;
+        if (!parseQuery(line, grid, query.points, query.valid))
+            continue;
+
+        std::unique_lock<std::mutex> lock(mutex);
+        while (read - written >= maxUnwritten)
+            space.wait(lock);
+
+        query.number = ++read;
+        waiting.push_back(query);
+        queued.notify_one();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        finished = true;
+    }
+    queued.notify_all();
+
+    for (std::size_t t = 0; t < workers.size(); ++t)
+        workers[t].join();
+#else
+    long number = 0;
+    while (std::getline(in, line)) {
+        Query query;
+        if (!parseQuery(line, grid, query.points, query.valid))
+            continue;
+
+        query.number = ++number;
+        Result result;
+        if (query.valid) {
+            solvers[0]->solve(query, result);
+            ++answered;
+            searching += result.seconds;
+        }
+
+        writeResult(std::cout, query, result, paths);
+
+        // Nothing more has arrived, so the writer may be waiting for this
+        if (in.rdbuf()->in_avail() <= 0)
+            std::cout.flush();
+    }
+#endif
+
+    std::cout.flush();
+}
+
+static bool parseOptions(int argc, char **argv, Options &options)
 {
-    Grid grid(10, 12);
-    //grid.populate(40);
-
-    AStar pathfinder(grid);
-
-    std::vector<Point> waypoints;
-    waypoints.push_back(Point(5, 5));
-    waypoints.push_back(Point(3, 11));
-    waypoints.push_back(Point(8, 3));
-    waypoints.push_back(Point(3, 3));
-    waypoints.push_back(Point(0, 0));
-    waypoints.push_back(Point(7, 1));
-   
-    Path path = pathfinder.buildFromWaypoints(waypoints);
-    Path path2 = pathfinder.buildWithHeuristic(waypoints);
-
-    std::cout << grid.getDimensions() << std::endl;
-    
-    std::cout << grid;
-    std::cout << std::endl;
-    std::cout << grid.toStringWithPath(path);
-    std::cout << grid.toStringWithPath(path2);
-    
+    int i = 1;
+    for (; i < argc && argv[i][0] == '-'; ++i) {
+        std::string option = argv[i];
+
+        if (option == "-p") {
+            options.paths = true;
+            continue;
+        }
+
+        if (option == "-n") {
+            options.snap = true;
+            continue;
+        }
+
+        if (i + 1 == argc)
+            return false;
+
+        std::string value = argv[++i];
+
+        if (option == "-a") {
+            if (value == "astar")
+                options.algorithm = ASTAR_SEARCH;
+            else if (value == "landmarks")
+                options.algorithm = LANDMARKS_SEARCH;
+            else if (value == "dijkstra")
+                options.algorithm = DIJKSTRA_SEARCH;
+            else if (value == "database")
+                options.algorithm = DATABASE_LOOKUP;
+            else
+                return false;
+        } else if (option == "-m") {
+            if (!parseMovement(value, options.movement))
+                return false;
+        } else if (option == "-c") {
+            if (!parseMoveCosts(value, options.cardinalCost, options.diagonalCost))
+                return false;
+        } else if (option == "-s") {
+            options.agentSize = std::atoi(value.c_str());
+            if (options.agentSize < 1 || options.agentSize > 255)
+                return false;
+        } else if (option == "-j") {
+            options.threads = std::atoi(value.c_str());
+        } else if (option == "-q") {
+            options.queries = value;
+        } else if (option == "-d") {
+            options.database = value;
+        } else {
+            return false;
+        }
+    }
+
+    if (i + 1 != argc || (options.agentSize > 1 && options.algorithm != ASTAR_SEARCH) ||
+        (options.snap && options.algorithm != ASTAR_SEARCH && options.algorithm != LANDMARKS_SEARCH))
+        return false;
+
+    options.map = argv[i];
+
+#if __cplusplus >= 201103L
+    if (options.threads <= 0)
+        options.threads = std::max(1u, std::thread::hardware_concurrency());
+#else
+    options.threads = 1;
+#endif
+
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        std::cerr << usage;
+        return 2;
+    }
+
+    double setupStart = wallSeconds();
+
+    Grid grid(1, 1);
+    std::string error;
+    if (!loadMap(options.map, grid, error)) {
+        std::cerr << options.map << ": " << error << std::endl;
+        return 1;
+    }
+
+    std::ifstream queryFile;
+    if (!options.queries.empty()) {
+        queryFile.open(options.queries.c_str());
+        if (!queryFile) {
+            std::cerr << "Can't open " << options.queries << std::endl;
+            return 1;
+        }
+    }
+    std::istream &in = options.queries.empty() ? std::cin : queryFile;
+
+    PathDatabase database;
+    if (options.algorithm == DATABASE_LOOKUP) {
+        bool loaded = !options.database.empty() && database.load(options.database) &&
+            database.matches(grid, options.cardinalCost, options.diagonalCost, options.movement);
+
+        if (!loaded) {
+            if (!database.build(grid, options.cardinalCost, options.diagonalCost,
+                                options.movement, options.threads)) {
+                std::cerr << options.map << ": too large for a path database" << std::endl;
+                return 1;
+            }
+
+            if (!options.database.empty() && !database.save(options.database))
+                std::cerr << "Can't save the database to " << options.database << std::endl;
+        }
+    }
+
+    // Landmark tables are only read while searching, so one set does for
+    // every thread
+    Landmarks *landmarks = 0;
+    if (options.algorithm == LANDMARKS_SEARCH)
+        landmarks = new Landmarks(&grid, 8, options.cardinalCost, options.diagonalCost,
+                                  options.movement);
+
+    std::vector<Solver *> solvers;
+    for (int t = 0; t < options.threads; ++t)
+        solvers.push_back(new Solver(grid, options, landmarks, &database));
+
+    double setup = wallSeconds() - setupStart;
+
+    long answered = 0;
+    double start = wallSeconds(), searching = 0;
+    answerAll(in, grid, solvers, options.paths, answered, searching);
+
+    double elapsed = wallSeconds() - start;
+
+    for (std::size_t t = 0; t < solvers.size(); ++t)
+        delete solvers[t];
+    delete landmarks;
+
+    char summary[256];
+    std::sprintf(summary, "%ld queries in %.3f s on %d threads: %.0f queries/s, "
+                 "%.1f us per query, %.3f s setup", answered, elapsed, options.threads,
+                 elapsed > 0 ? answered / elapsed : 0.0,
+                 answered ? searching / answered * 1e6 : 0.0, setup);
+    std::cerr << summary << std::endl;
+
     return 0;
 }